@@ -0,0 +1,101 @@
+// Measures a common-free-time search: masks for a group of users over a
+// range of days, built from Monday-to-Friday working hours and random
+// meetings, then intersected and scanned for the first free stretches.
+// Then next-free-slot lookups on one user's FreeSlotIndex holding a year of
+// such meetings.
+//
+// Usage: availability_bench [users] [days] [queries]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "engine/Availability.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double microsSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::micro>(Clock::now() - start)
+      .count();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const size_t users = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 50;
+  const int64_t days = argc > 2 ? std::strtol(argv[2], nullptr, 10) : 31;
+  const size_t queries = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 1000;
+
+  std::mt19937_64 rng(15);
+  const int64_t firstDay = 20000;
+  std::vector<engine::WorkWindow> windows;
+  for (int weekday = 0; weekday < 5; ++weekday)
+    windows.push_back({weekday, 9 * 60, 18 * 60});
+  // About two meetings per user and working day.
+  std::vector<std::vector<engine::Interval>> busy(users);
+  for (auto& blocks : busy)
+    for (int64_t i = 0; i < days * 2; ++i) {
+      const engine::Minute start =
+          (firstDay + static_cast<int64_t>(rng() % days)) *
+              engine::kMinutesPerDay +
+          9 * 60 + static_cast<engine::Minute>(rng() % (8 * 4)) * 15;
+      const engine::Minute length = 30 + static_cast<int64_t>(rng() % 4) * 15;
+      blocks.push_back({start, start + length});
+    }
+
+  size_t found = 0, freeSlots = 0;
+  double buildUs = 0, searchUs = 0;
+  for (size_t q = 0; q < queries; ++q) {
+    auto start = Clock::now();
+    std::vector<engine::FreeBusyMask> masks;
+    masks.reserve(users);
+    for (size_t u = 0; u < users; ++u) {
+      masks.emplace_back(firstDay, days);
+      masks.back().addWindows(windows);
+      for (const auto& b : busy[u]) masks.back().addBusy(b);
+    }
+    buildUs += microsSince(start);
+
+    start = Clock::now();
+    engine::FreeBusyMask common = masks[0];
+    for (size_t u = 1; u < users; ++u) common.intersect(masks[u]);
+    freeSlots += common.freeSlots();
+    found += common.findRuns(2, 10).size();
+    searchUs += microsSince(start);
+  }
+  const auto n = static_cast<double>(queries);
+  std::printf("%zu users x %lld days: build %.2f us, intersect+search %.2f us "
+              "per query (%zu common slots, %zu results)\n",
+              users, static_cast<long long>(days), buildUs / n, searchUs / n,
+              freeSlots / queries, found / queries);
+
+  std::vector<engine::Interval> year;
+  for (int64_t i = 0; i < 365 * 4; ++i) {
+    const engine::Minute start =
+        (firstDay + static_cast<int64_t>(rng() % 365)) *
+            engine::kMinutesPerDay +
+        9 * 60 + static_cast<engine::Minute>(rng() % (8 * 4)) * 15;
+    year.push_back({start, start + 60});
+  }
+  auto start = Clock::now();
+  engine::FreeSlotIndex index(windows, firstDay);
+  index.assign(year);
+  std::printf("index of %zu blocks: build %.2f us\n", year.size(),
+              microsSince(start));
+  size_t hits = 0;
+  start = Clock::now();
+  for (size_t q = 0; q < queries * 100; ++q) {
+    const engine::Minute after =
+        firstDay * engine::kMinutesPerDay +
+        static_cast<engine::Minute>(rng() % (365 * engine::kMinutesPerDay));
+    hits += index.next(after, 30 + static_cast<int64_t>(rng() % 8) * 30)
+                .has_value();
+  }
+  std::printf("next free slot: %.3f us per query (%zu found)\n",
+              microsSince(start) / static_cast<double>(queries * 100), hits);
+  return 0;
+}
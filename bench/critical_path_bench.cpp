@@ -0,0 +1,81 @@
+// Measures CriticalPath on a synthetic project: tasks of 1-40 hours, each
+// depending on up to three tasks created shortly before it, with a mix of
+// dependency kinds. Reports the full build and analysis, then the cost of
+// incremental duration and edge changes.
+//
+// Usage: critical_path_bench [tasks] [changes]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "engine/DependencyGraph.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double millisSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const uint32_t tasks =
+      argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10))
+               : 100000;
+  const size_t changes = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 10000;
+
+  std::mt19937_64 rng(11);
+  std::vector<int64_t> durations(tasks);
+  for (auto& d : durations) d = (1 + static_cast<int64_t>(rng() % 40)) * 60;
+  std::vector<engine::DependencyGraph::Edge> edges;
+  for (uint32_t to = 1; to < tasks; ++to) {
+    const int deps = static_cast<int>(rng() % 4);
+    for (int i = 0; i < deps; ++i) {
+      const uint32_t back = 1 + static_cast<uint32_t>(rng() % 200);
+      if (back > to) continue;
+      const auto kind = rng() % 10 == 0 ? engine::DependencyKind::StartStart
+                                        : engine::DependencyKind::FinishStart;
+      edges.push_back({to - back, to, kind});
+    }
+  }
+
+  auto start = Clock::now();
+  engine::CriticalPath path(engine::DependencyGraph(durations, edges));
+  const double buildMs = millisSince(start);
+  const auto critical = path.criticalPath();
+  std::printf("%u tasks, %zu edges: build + analysis %.2f ms, makespan %lld "
+              "h, %zu tasks on the critical path\n",
+              tasks, path.graph().edgeCount(), buildMs,
+              static_cast<long long>(path.makespan() / 60), critical.size());
+
+  start = Clock::now();
+  for (size_t i = 0; i < changes; ++i)
+    path.setDuration(static_cast<uint32_t>(rng() % tasks),
+                     (1 + static_cast<int64_t>(rng() % 40)) * 60);
+  const double durationMs = millisSince(start);
+
+  start = Clock::now();
+  size_t added = 0;
+  for (size_t i = 0; i < changes; ++i) {
+    const auto to = 1 + static_cast<uint32_t>(rng() % (tasks - 1));
+    const uint32_t back = 1 + static_cast<uint32_t>(rng() % 200);
+    if (back > to) continue;
+    if (path.addEdge({to - back, to, engine::DependencyKind::FinishStart})) {
+      path.removeEdge(to - back, to);
+      ++added;
+    }
+  }
+  const double edgeMs = millisSince(start);
+
+  std::printf("duration change: %.1f us each\n",
+              durationMs * 1e3 / static_cast<double>(changes));
+  std::printf("edge add + remove: %.1f us each (%zu pairs)\n",
+              added ? edgeMs * 1e3 / static_cast<double>(added) : 0.0, added);
+  return 0;
+}
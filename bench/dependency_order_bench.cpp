@@ -0,0 +1,81 @@
+// Measures cycle checks on DependencyOrder: a project-like graph where tasks
+// depend on tasks created shortly before them, then random single inserts
+// (some of which close cycles) and the same number of arcs as batches.
+//
+// Usage: dependency_order_bench [tasks] [inserts] [batch]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "engine/DependencyOrder.hpp"
+
+namespace {
+
+using Arc = engine::DependencyOrder::Arc;
+using Clock = std::chrono::steady_clock;
+
+double microsSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::micro>(Clock::now() - start)
+      .count();
+}
+
+std::vector<Arc> randomArcs(std::mt19937_64& rng, uint32_t tasks, size_t n) {
+  std::vector<Arc> arcs;
+  arcs.reserve(n);
+  while (arcs.size() < n) {
+    const auto a = static_cast<uint32_t>(rng() % tasks);
+    const auto b =
+        static_cast<uint32_t>((a + 1 + rng() % 500) % tasks);
+    arcs.push_back(rng() % 20 == 0 ? Arc{b, a} : Arc{a, b});
+  }
+  return arcs;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const uint32_t tasks =
+      argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10))
+               : 100000;
+  const size_t inserts = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 20000;
+  const size_t batch = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 100;
+
+  std::mt19937_64 rng(5);
+  std::vector<Arc> base;
+  for (uint32_t to = 1; to < tasks; ++to)
+    for (int i = 0, n = static_cast<int>(rng() % 4); i < n; ++i) {
+      const uint32_t back = 1 + static_cast<uint32_t>(rng() % 200);
+      if (back <= to) base.push_back({to - back, to});
+    }
+
+  engine::DependencyOrder order;
+  auto start = Clock::now();
+  order.build(tasks, base);
+  std::printf("%u tasks, %zu arcs: build %.2f ms\n", tasks, base.size(),
+              microsSince(start) / 1e3);
+
+  const auto singles = randomArcs(rng, tasks, inserts);
+  size_t rejected = 0;
+  start = Clock::now();
+  for (const auto& a : singles) rejected += !order.addArc(a.first, a.second);
+  const double singleUs = microsSince(start);
+  std::printf("single inserts: %.2f us each, %zu of %zu rejected\n",
+              singleUs / static_cast<double>(inserts), rejected, inserts);
+
+  const auto batched = randomArcs(rng, tasks, inserts);
+  size_t batchesRejected = 0;
+  start = Clock::now();
+  for (size_t i = 0; i < batched.size(); i += batch) {
+    const std::vector<Arc> chunk(
+        batched.begin() + static_cast<long>(i),
+        batched.begin() + static_cast<long>(std::min(i + batch, inserts)));
+    batchesRejected += !order.addArcs(chunk);
+  }
+  const double batchUs = microsSince(start);
+  std::printf("batches of %zu: %.2f us per arc, %zu batches rejected\n",
+              batch, batchUs / static_cast<double>(inserts), batchesRejected);
+  return 0;
+}
@@ -0,0 +1,80 @@
+// Measures forecastProject() on a synthetic project shaped like the one in
+// critical_path_bench: tasks of 1-40 hours, each depending on up to three
+// tasks created shortly before it. Assignees work 20-40 hours a week and a
+// tenth of the tasks cannot start for a few weeks. Runs the trials on one
+// thread and then on every core.
+//
+// Usage: forecast_bench [tasks] [trials]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "engine/Forecast.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double millisSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const uint32_t taskCount =
+      argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10))
+               : 5000;
+  const uint32_t trials =
+      argc > 2 ? static_cast<uint32_t>(std::strtoul(argv[2], nullptr, 10))
+               : 10000;
+
+  std::mt19937_64 rng(13);
+  std::vector<int64_t> durations(taskCount);
+  for (auto& d : durations) d = (1 + static_cast<int64_t>(rng() % 40)) * 60;
+  std::vector<engine::DependencyGraph::Edge> edges;
+  for (uint32_t to = 1; to < taskCount; ++to) {
+    const int deps = static_cast<int>(rng() % 4);
+    for (int i = 0; i < deps; ++i) {
+      const uint32_t back = 1 + static_cast<uint32_t>(rng() % 200);
+      if (back > to) continue;
+      const auto kind = rng() % 10 == 0 ? engine::DependencyKind::StartStart
+                                        : engine::DependencyKind::FinishStart;
+      edges.push_back({to - back, to, kind});
+    }
+  }
+  const engine::CriticalPath path(engine::DependencyGraph(durations, edges));
+
+  std::vector<engine::ForecastTask> tasks(taskCount);
+  for (auto& t : tasks) {
+    const double weekly = (20 + static_cast<double>(rng() % 21)) * 60;
+    t.pace = 7.0 * engine::kMinutesPerDay / weekly;
+    if (rng() % 10 == 0)
+      t.release = static_cast<int64_t>(rng() % 30) * engine::kMinutesPerDay;
+  }
+
+  for (const unsigned threads :
+       {1u, std::max(1u, std::thread::hardware_concurrency())}) {
+    engine::ForecastOptions options;
+    options.trials = trials;
+    options.threads = threads;
+    const auto start = Clock::now();
+    const auto forecast = engine::forecastProject(path, tasks, options);
+    const double ms = millisSince(start);
+    std::printf("%u tasks, %zu edges, %u trials on %u threads: %.1f ms, "
+                "P50 %lld d, P90 %lld d\n",
+                taskCount, path.graph().edgeCount(), forecast.trials(),
+                threads, ms,
+                static_cast<long long>(forecast.percentile(0.5) /
+                                       engine::kMinutesPerDay),
+                static_cast<long long>(forecast.percentile(0.9) /
+                                       engine::kMinutesPerDay));
+  }
+  return 0;
+}
@@ -0,0 +1,123 @@
+// Compares building the GET /api/tasks body through Json::Value trees (the
+// previous handler code) with writing it directly through JsonWriter.
+//
+// Usage: json_bench [rows] [iterations]
+
+#include <json/json.h>
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "serialization/JsonWriter.hpp"
+
+namespace {
+
+constexpr std::array<const char*, 15> kColumns = {
+    "id",         "parent_task_id", "title",           "description",
+    "priority",   "status",         "estimated_hours", "start_date",
+    "due_date",   "project_root_id", "created_by",     "created_at",
+    "updated_at", "assigned_hours", "role"};
+
+using Row = std::array<std::optional<std::string>, kColumns.size()>;
+
+std::vector<Row> makeRows(size_t n) {
+  std::vector<Row> rows(n);
+  for (size_t i = 0; i < n; ++i) {
+    char id[40];
+    std::snprintf(id, sizeof(id), "3f2b8c1e-7a4d-4e2b-9c1a-%012zx", i);
+    Row& r = rows[i];
+    r[0] = id;
+    if (i % 3) r[1] = "9d4c2a7e-1b3f-4c5d-8e6f-0a1b2c3d4e5f";
+    r[2] = "Prepare quarterly report #" + std::to_string(i);
+    r[3] = "Collect figures from \"finance\" and draft the summary.\n"
+           "Double-check totals before sending.";
+    r[4] = "normal";
+    r[5] = "in_progress";
+    r[6] = "16.00";
+    r[7] = "2024-01-10";
+    r[8] = "2024-01-20";
+    r[9] = "9d4c2a7e-1b3f-4c5d-8e6f-0a1b2c3d4e5f";
+    r[10] = "5e6f7a8b-9c0d-4e1f-a2b3-c4d5e6f7a8b9";
+    r[11] = "2024-01-05 10:15:30.123456+00";
+    r[12] = "2024-01-06 11:00:00.654321+00";
+    r[13] = "8.00";
+    r[14] = "owner";
+  }
+  return rows;
+}
+
+std::string viaJsoncpp(const std::vector<Row>& rows) {
+  Json::Value out(Json::arrayValue);
+  for (const auto& r : rows) {
+    Json::Value item(Json::objectValue);
+    for (size_t c = 0; c < kColumns.size(); ++c)
+      item[kColumns[c]] = r[c] ? Json::Value(*r[c]) : Json::Value();
+    item["schedule"] = Json::Value(Json::arrayValue);
+    out.append(item);
+  }
+  Json::StreamWriterBuilder builder;
+  builder["indentation"] = "";
+  return Json::writeString(builder, out);
+}
+
+std::string viaWriter(const std::vector<Row>& rows) {
+  serialization::JsonWriter out(512 * rows.size() + 2);
+  out.beginArray();
+  for (const auto& r : rows) {
+    out.beginObject();
+    for (size_t c = 0; c < kColumns.size(); ++c) {
+      out.key(kColumns[c]);
+      if (r[c])
+        out.string(*r[c]);
+      else
+        out.null();
+    }
+    out.key("schedule");
+    out.beginArray();
+    out.endArray();
+    out.endObject();
+  }
+  out.endArray();
+  return out.release();
+}
+
+template <typename F>
+void run(const char* name, F&& f, const std::vector<Row>& rows,
+         int iterations) {
+  size_t bytes = f(rows).size();  // warm up
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) bytes = f(rows).size();
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  const double perCall = elapsed.count() / iterations;
+  std::printf("%-10s %10.1f us/body %8.1f ns/row %8.1f MB/s  (%zu bytes)\n",
+              name, perCall * 1e6, perCall * 1e9 / rows.size(),
+              bytes / perCall / 1e6, bytes);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const size_t n = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 2000;
+  const int iterations = argc > 2 ? std::atoi(argv[2]) : 200;
+  const auto rows = makeRows(n);
+
+  // Both paths must produce the same document.
+  Json::Value a, b;
+  Json::Reader reader;
+  if (!reader.parse(viaJsoncpp(rows), a) || !reader.parse(viaWriter(rows), b) ||
+      a != b) {
+    std::fprintf(stderr, "outputs differ\n");
+    return 1;
+  }
+
+  std::printf("%zu rows, %d iterations\n", n, iterations);
+  run("jsoncpp", viaJsoncpp, rows, iterations);
+  run("writer", viaWriter, rows, iterations);
+  return 0;
+}
@@ -0,0 +1,182 @@
+// Measures PermissionEngine::allowed() on a synthetic project forest: tasks
+// nested 5-10 levels deep, a few roles per task, some delegations and
+// project-scoped grants, and a role matrix shaped like the seed data.
+//
+// Usage: permission_bench [tasks] [users] [checks] [threads]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "engine/PermissionEngine.hpp"
+
+namespace {
+
+using engine::PermissionEngine;
+using engine::PermissionMatrix;
+using engine::Role;
+using engine::TaskAcl;
+using engine::Uuid;
+
+const std::vector<std::string> kKeys = {
+    "assignment.assign.local", "assignment.reassign.local",
+    "audit.view",              "schedule.adjust.local",
+    "schedule.view.local",     "task.change_status.local",
+    "task.create.local",       "task.delete.global",
+    "task.delete.local",       "task.update.local",
+    "task.view.local"};
+
+std::shared_ptr<const PermissionMatrix> makeMatrix() {
+  std::vector<PermissionMatrix::Entry> grants;
+  for (const auto& key : kKeys) grants.push_back({"admin", key, true});
+  for (const auto& key : kKeys)
+    grants.push_back({"owner", key, key == "task.delete.global"});
+  for (const char* key :
+       {"task.view.local", "task.create.local", "task.update.local",
+        "assignment.assign.local", "assignment.reassign.local",
+        "schedule.view.local", "schedule.adjust.local"})
+    grants.push_back({"supervisor", key, false});
+  grants.push_back({"supervisor", "audit.view", true});
+  for (const char* key : {"task.view.local", "task.change_status.local",
+                          "schedule.view.local"})
+    grants.push_back({"executor", key, false});
+  grants.push_back({"spectator", "task.view.local", false});
+  return std::make_shared<PermissionMatrix>(kKeys, grants);
+}
+
+Uuid makeId(uint64_t kind, uint64_t n) {
+  return Uuid{kind << 56 | n, n * 7919};
+}
+
+struct Check {
+  Uuid user;
+  Uuid task;
+  const char* key;
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const size_t taskCount =
+      argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+  const size_t userCount =
+      argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 5000;
+  const size_t checkCount =
+      argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 2000000;
+  const unsigned threads =
+      argc > 4 ? static_cast<unsigned>(std::atoi(argv[4])) : 1;
+
+  std::mt19937_64 rng(42);
+  auto pick = [&](size_t n) { return static_cast<size_t>(rng() % n); };
+  auto user = [&] { return makeId(1, pick(userCount)); };
+
+  // Projects of ~200 tasks; each task hangs under a random earlier task of
+  // its project that is shallow enough to keep the tree 5-10 levels deep.
+  std::vector<TaskAcl> tasks(taskCount);
+  std::vector<int> depth(taskCount);
+  size_t projectStart = 0;
+  int projectDepth = 5;
+  for (size_t i = 0; i < taskCount; ++i) {
+    TaskAcl& t = tasks[i];
+    t.id = makeId(2, i);
+    t.createdBy = user();
+    if (i % 200 == 0) {
+      projectStart = i;
+      projectDepth = 5 + static_cast<int>(pick(6));
+      depth[i] = 0;
+      t.roles.push_back({user(), 0, engine::roleBit(Role::Supervisor)});
+    } else {
+      size_t parent;
+      do {
+        parent = projectStart + pick(i - projectStart);
+      } while (depth[parent] + 1 >= projectDepth);
+      t.parent = tasks[parent].id;
+      depth[i] = depth[parent] + 1;
+    }
+    for (size_t r = pick(3) + 1; r > 0; --r)
+      t.roles.push_back(
+          {user(), engine::roleBit(r == 1 ? Role::Executor : Role::Spectator),
+           0});
+    if (pick(20) == 0) {
+      TaskAcl::Delegation d;
+      d.grantee = user();
+      d.allow = 1u << 9;  // task.update.local
+      t.delegations.push_back(d);
+    }
+  }
+
+  std::unordered_map<Uuid, engine::RoleSet, engine::UuidHash> globalRoles;
+  for (size_t i = 0; i < userCount / 500 + 1; ++i)
+    globalRoles[user()] = engine::roleBit(Role::Admin);
+
+  // Half of the checks come from someone who holds a role on the task path,
+  // so both the grant and the deny paths are exercised. The hot set models
+  // a busy service where most checks hit a small working set of tasks.
+  auto makeChecks = [&](size_t span) {
+    std::vector<Check> checks(checkCount);
+    for (auto& c : checks) {
+      const size_t i = pick(span);
+      c.task = tasks[i].id;
+      c.user = pick(2) ? tasks[i].roles[0].user : user();
+      c.key = kKeys[pick(kKeys.size())].c_str();
+    }
+    return checks;
+  };
+  const auto coldChecks = makeChecks(taskCount);
+  const auto hotChecks = makeChecks(std::min<size_t>(taskCount, 1000));
+
+  PermissionEngine engine;
+  const auto loadStart = std::chrono::steady_clock::now();
+  engine.load(makeMatrix(), std::move(globalRoles), std::move(tasks));
+  const std::chrono::duration<double> loadTime =
+      std::chrono::steady_clock::now() - loadStart;
+
+  std::printf("%zu tasks, %zu users, loaded in %.1f ms\n", taskCount,
+              userCount, loadTime.count() * 1e3);
+
+  auto run = [&](const char* name, const std::vector<Check>& checks) {
+    std::atomic<size_t> allowed{0};
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (unsigned w = 0; w < threads; ++w) {
+      workers.emplace_back([&, w] {
+        size_t n = 0;
+        for (size_t i = w; i < checks.size(); i += threads)
+          n += engine.allowed(checks[i].user, checks[i].task, checks[i].key,
+                              0);
+        allowed += n;
+      });
+    }
+    for (auto& t : workers) t.join();
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    std::printf("%-5s %zu checks on %u thread(s): %7.1f ns/check, %.1f%% "
+                "allowed\n",
+                name, checks.size(), threads,
+                elapsed.count() * 1e9 * threads / checks.size(),
+                100.0 * allowed.load() / checks.size());
+  };
+  run("cold", coldChecks);
+  run("hot", hotChecks);
+
+  // Hook writes replace part of the snapshot; what they copy should not
+  // grow with the number of tasks.
+  const size_t writeCount = 2000;
+  const auto writeStart = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < writeCount; ++i) {
+    const Uuid task = makeId(2, pick(taskCount));
+    engine.grantRoles(task, user(), engine::roleBit(Role::Spectator));
+  }
+  const std::chrono::duration<double> writeTime =
+      std::chrono::steady_clock::now() - writeStart;
+  std::printf("write %zu role grants: %7.1f ns/write\n", writeCount,
+              writeTime.count() * 1e9 / writeCount);
+  return 0;
+}
@@ -0,0 +1,70 @@
+// Measures workload rebalancing on a project shaped like the target case:
+// a team working Monday to Friday under an 8-hour daily project limit, with
+// a share of their days booked over it and the rest partly free.
+//
+// Usage: rebalance_bench [users] [days] [tasks]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "engine/Rebalance.hpp"
+
+int main(int argc, char** argv) {
+  const uint32_t users =
+      argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10))
+               : 200;
+  const int64_t days = argc > 2 ? std::strtol(argv[2], nullptr, 10) : 92;
+  const uint32_t taskCount =
+      argc > 3 ? static_cast<uint32_t>(std::strtoul(argv[3], nullptr, 10))
+               : 1000;
+
+  std::mt19937_64 rng(18);
+  const int64_t firstDay = 20000;
+  std::vector<engine::RebalanceTask> tasks(taskCount);
+  for (auto& task : tasks) {
+    task.priority = static_cast<int>(rng() % 4);
+    task.firstDay = firstDay + static_cast<int64_t>(rng() % days);
+    task.lastDay =
+        std::min(firstDay + days - 1,
+                 task.firstDay + 7 + static_cast<int64_t>(rng() % 30));
+  }
+
+  // Every tenth working day of a user is booked 1-4 hours over the limit,
+  // split across two or three tasks; the others have 0-4 hours left.
+  std::vector<engine::Overload> overloads;
+  std::vector<engine::Spare> spare;
+  for (uint32_t user = 0; user < users; ++user)
+    for (int64_t day = firstDay; day < firstDay + days; ++day) {
+      if (engine::weekdayOf(day) >= 5) continue;
+      if (rng() % 10 == 0) {
+        engine::Overload over{user, day, 60 + static_cast<int64_t>(rng() % 181),
+                              {}};
+        const size_t shares = 2 + rng() % 2;
+        for (size_t i = 0; i < shares; ++i)
+          over.tasks.push_back({static_cast<uint32_t>(rng() % taskCount),
+                                120 + static_cast<int64_t>(rng() % 181)});
+        overloads.push_back(std::move(over));
+      } else if (const auto left = static_cast<int64_t>(rng() % 5) * 60) {
+        spare.push_back({user, day, left});
+      }
+    }
+
+  const auto start = std::chrono::steady_clock::now();
+  const auto moves = engine::rebalance(tasks, overloads, spare);
+  const double ms = std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+
+  engine::Minute excess = 0, moved = 0;
+  for (const auto& over : overloads) excess += over.excess;
+  for (const auto& move : moves) moved += move.minutes;
+  std::printf("%u users x %lld days, %zu overloads, %zu spare entries: "
+              "%.1f ms, %zu moves, %.1f of %.1f excess hours moved\n",
+              users, static_cast<long long>(days), overloads.size(),
+              spare.size(), ms, moves.size(), static_cast<double>(moved) / 60,
+              static_cast<double>(excess) / 60);
+}
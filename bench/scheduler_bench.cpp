@@ -0,0 +1,87 @@
+// Measures AutoScheduler::place() on a synthetic quarter: users with
+// weekday working windows (some with a lunch break), a few manually booked
+// blocks each, and assignments of 2-40 hours spread over 5-30 day ranges.
+//
+// Usage: scheduler_bench [assignments] [users]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "engine/Scheduler.hpp"
+
+namespace {
+
+using engine::AutoScheduler;
+using engine::Interval;
+using engine::kMinutesPerDay;
+using engine::WorkWindow;
+
+// 2024-01-01, a Monday.
+constexpr int64_t kFirstDay = 19723;
+constexpr int64_t kDays = 91;
+
+std::vector<WorkWindow> makeWindows(std::mt19937_64& rng) {
+  std::vector<WorkWindow> windows;
+  const bool lunch = rng() % 2;
+  const int start = 8 * 60 + static_cast<int>(rng() % 3) * 60;
+  for (int day = 0; day < 5; ++day) {
+    if (lunch) {
+      windows.push_back({day, start, start + 4 * 60});
+      windows.push_back({day, start + 5 * 60, start + 9 * 60});
+    } else {
+      windows.push_back({day, start, start + 8 * 60});
+    }
+  }
+  return windows;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const size_t assignmentCount =
+      argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 50000;
+  const size_t userCount = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 2000;
+
+  std::mt19937_64 rng(7);
+  AutoScheduler scheduler;
+  for (size_t u = 0; u < userCount; ++u) {
+    scheduler.addUser(makeWindows(rng));
+    for (int b = 0; b < 10; ++b) {
+      const int64_t day = kFirstDay + static_cast<int64_t>(rng() % kDays);
+      const engine::Minute start =
+          day * kMinutesPerDay + 9 * 60 + static_cast<int64_t>(rng() % 8) * 60;
+      scheduler.user(u).addBusy(Interval{start, start + 90});
+    }
+  }
+
+  std::vector<AutoScheduler::Assignment> assignments(assignmentCount);
+  for (auto& a : assignments) {
+    a.user = rng() % userCount;
+    a.startDay = kFirstDay + static_cast<int64_t>(rng() % (kDays - 30));
+    a.dueDay = a.startDay + 5 + static_cast<int64_t>(rng() % 26);
+    a.minutes = (2 + static_cast<int64_t>(rng() % 39)) * 60;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  const auto result = scheduler.place(assignments);
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  size_t partial = 0;
+  engine::Minute missing = 0;
+  for (const auto m : result.unplaced) {
+    partial += m > 0;
+    missing += m;
+  }
+  std::printf("%zu assignments, %zu users: %.1f ms, %.0f assignments/s\n",
+              assignmentCount, userCount, elapsed.count() * 1e3,
+              assignmentCount / elapsed.count());
+  std::printf("%zu blocks placed, %zu assignments short by %lld hours in "
+              "total\n",
+              result.blocks.size(), partial,
+              static_cast<long long>(missing / 60));
+  return 0;
+}
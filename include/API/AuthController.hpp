@@ -1,6 +1,7 @@
 #pragma once
 
 #include <drogon/HttpController.h>
+#include <drogon/utils/coroutine.h>
 using namespace drogon;
 
 class AuthController : public drogon::HttpController<AuthController> {
@@ -13,12 +14,8 @@ class AuthController : public drogon::HttpController<AuthController> {
   ADD_METHOD_TO(AuthController::me, "/api/auth/me", Get, "AuthFilter");
   METHOD_LIST_END
 
-  void registerUser(
-      const drogon::HttpRequestPtr& req,
-      std::function<void(const drogon::HttpResponsePtr&)>&& callback);
+  Task<HttpResponsePtr> registerUser(HttpRequestPtr req);
 
-  void login(const drogon::HttpRequestPtr& req,
-             std::function<void(const drogon::HttpResponsePtr&)>&& callback);
-  void me(const drogon::HttpRequestPtr& req,
-          std::function<void(const drogon::HttpResponsePtr&)>&& callback);
+  Task<HttpResponsePtr> login(HttpRequestPtr req);
+  Task<HttpResponsePtr> me(HttpRequestPtr req);
 };
\ No newline at end of file
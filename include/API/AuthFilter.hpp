@@ -4,9 +4,24 @@
 #include <jwt-cpp/jwt.h>
 #include <json/json.h>
 
+#include "engine/TokenCache.hpp"
+#include "metrics/Metrics.hpp"
+
 class AuthFilter : public drogon::HttpFilter<AuthFilter> {
 public:
+    // Reads JWT_SECRET and AUTH_TOKEN_CACHE_SIZE once; drogon creates a
+    // single instance when routes are registered.
+    AuthFilter();
+
     void doFilter(const drogon::HttpRequestPtr &req,
                   drogon::FilterCallback &&fcb,
                   drogon::FilterChainCallback &&fccb) override;
-};
\ No newline at end of file
+
+private:
+    decltype(jwt::verify()) verifier_;
+    // Tokens that already passed verification, until they expire.
+    engine::TokenCache tokens_;
+    metrics::Histogram &cost_;
+    metrics::Counter &hits_;
+    metrics::Counter &misses_;
+};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <drogon/HttpController.h>
+#include <drogon/utils/coroutine.h>
 
 using namespace drogon;
 
@@ -10,8 +11,13 @@ class CalendarController : public drogon::HttpController<CalendarController> {
 
   ADD_METHOD_TO(CalendarController::getCalendarTasks, "/api/calendar/tasks",
                 Get, "AuthFilter");
+  ADD_METHOD_TO(CalendarController::getAvailability,
+                "/api/calendar/availability", Get, "AuthFilter");
+  ADD_METHOD_TO(CalendarController::getNextFreeSlot,
+                "/api/calendar/next-free-slot", Get, "AuthFilter");
   METHOD_LIST_END
 
-  void getCalendarTasks(const HttpRequestPtr& req,
-                        std::function<void(const HttpResponsePtr&)>&& callback);
+  Task<HttpResponsePtr> getCalendarTasks(HttpRequestPtr req);
+  Task<HttpResponsePtr> getAvailability(HttpRequestPtr req);
+  Task<HttpResponsePtr> getNextFreeSlot(HttpRequestPtr req);
 };
\ No newline at end of file
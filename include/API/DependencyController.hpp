@@ -0,0 +1,23 @@
+#pragma once
+
+#include <drogon/HttpController.h>
+#include <drogon/utils/coroutine.h>
+
+#include <string>
+
+using namespace drogon;
+
+class DependencyController
+    : public drogon::HttpController<DependencyController> {
+ public:
+  METHOD_LIST_BEGIN
+  ADD_METHOD_TO(DependencyController::createDependency,
+                "/api/tasks/{task_id}/dependencies", Post, "AuthFilter");
+  ADD_METHOD_TO(DependencyController::createDependencies,
+                "/api/dependencies/batch", Post, "AuthFilter");
+  METHOD_LIST_END
+
+  Task<HttpResponsePtr> createDependency(HttpRequestPtr req,
+                                         std::string taskId);
+  Task<HttpResponsePtr> createDependencies(HttpRequestPtr req);
+};
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <drogon/HttpController.h>
+#include <drogon/utils/coroutine.h>
+
+using namespace drogon;
+
+class MetricsController : public drogon::HttpController<MetricsController> {
+ public:
+  METHOD_LIST_BEGIN
+
+  ADD_METHOD_TO(MetricsController::getMetrics, "/metrics", Get);
+  METHOD_LIST_END
+
+  Task<HttpResponsePtr> getMetrics(HttpRequestPtr req);
+};
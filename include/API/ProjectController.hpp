@@ -0,0 +1,25 @@
+#pragma once
+
+#include <drogon/HttpController.h>
+#include <drogon/utils/coroutine.h>
+
+#include <string>
+
+using namespace drogon;
+
+class ProjectController : public drogon::HttpController<ProjectController> {
+ public:
+  METHOD_LIST_BEGIN
+  ADD_METHOD_TO(ProjectController::getCriticalPath,
+                "/api/projects/{project_id}/critical-path", Get, "AuthFilter");
+  ADD_METHOD_TO(ProjectController::simulate,
+                "/api/projects/{project_id}/simulate", Post, "AuthFilter");
+  ADD_METHOD_TO(ProjectController::getForecast,
+                "/api/projects/{project_id}/forecast", Get, "AuthFilter");
+  METHOD_LIST_END
+
+  Task<HttpResponsePtr> getCriticalPath(HttpRequestPtr req,
+                                        std::string projectId);
+  Task<HttpResponsePtr> simulate(HttpRequestPtr req, std::string projectId);
+  Task<HttpResponsePtr> getForecast(HttpRequestPtr req, std::string projectId);
+};
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <drogon/HttpController.h>
+#include <drogon/utils/coroutine.h>
+
+#include <string>
+
+using namespace drogon;
+
+class ScheduleController : public drogon::HttpController<ScheduleController> {
+ public:
+  METHOD_LIST_BEGIN
+  ADD_METHOD_TO(ScheduleController::autoSchedule,
+                "/api/tasks/{task_id}/auto-schedule", Post, "AuthFilter");
+  METHOD_LIST_END
+
+  Task<HttpResponsePtr> autoSchedule(HttpRequestPtr req, std::string taskId);
+};
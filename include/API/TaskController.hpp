@@ -1,6 +1,9 @@
 #pragma once
 
 #include <drogon/HttpController.h>
+#include <drogon/utils/coroutine.h>
+
+#include <string>
 
 using namespace drogon;
 
@@ -9,6 +12,9 @@ class TaskController : public drogon::HttpController<TaskController> {
   METHOD_LIST_BEGIN
   ADD_METHOD_TO(TaskController::createTask, "/api/tasks", Post, "AuthFilter");
 
+  ADD_METHOD_TO(TaskController::createTasksBulk, "/api/tasks:bulk", Post,
+                "AuthFilter");
+
   ADD_METHOD_TO(TaskController::getTasks, "/api/tasks", Get, "AuthFilter");
 
   // Specific routes with longer paths first
@@ -21,6 +27,9 @@ class TaskController : public drogon::HttpController<TaskController> {
   ADD_METHOD_TO(TaskController::getSubtasks, "/api/tasks/{task_id}/subtasks", Get,
                 "AuthFilter");
 
+  ADD_METHOD_TO(TaskController::getTree, "/api/tasks/{task_id}/tree", Get,
+                "AuthFilter");
+
   // Generic task routes (shorter paths)
   ADD_METHOD_TO(TaskController::updateTask, "/api/tasks/{task_id}", Put,
                 "AuthFilter");
@@ -32,27 +41,26 @@ class TaskController : public drogon::HttpController<TaskController> {
                 Delete, "AuthFilter");
   METHOD_LIST_END
 
-  void createTask(const HttpRequestPtr& req,
-                  std::function<void(const HttpResponsePtr&)>&& callback);
+  Task<HttpResponsePtr> createTask(HttpRequestPtr req);
+
+  // A whole tree in one transaction; parents are named by client temp ids.
+  Task<HttpResponsePtr> createTasksBulk(HttpRequestPtr req);
+
+  Task<HttpResponsePtr> getTasks(HttpRequestPtr req);
 
-  void getTasks(const HttpRequestPtr& req,
-                std::function<void(const HttpResponsePtr&)>&& callback);
+  Task<HttpResponsePtr> updateTask(HttpRequestPtr req);
 
-  void updateTask(const HttpRequestPtr& req,
-                  std::function<void(const HttpResponsePtr&)>&& callback);
+  Task<HttpResponsePtr> deleteTask(HttpRequestPtr req);
 
-  void deleteTask(const HttpRequestPtr& req,
-                  std::function<void(const HttpResponsePtr&)>&& callback);
+  Task<HttpResponsePtr> getSubtasks(HttpRequestPtr req);
 
-  void getSubtasks(const HttpRequestPtr& req,
-                   std::function<void(const HttpResponsePtr&)>&& callback);
+  // The task and all of its descendants in depth-first order, with `depth`
+  // relative to the task.
+  Task<HttpResponsePtr> getTree(HttpRequestPtr req, std::string taskId);
 
-  void createAssignment(const HttpRequestPtr& req,
-                        std::function<void(const HttpResponsePtr&)>&& callback);
+  Task<HttpResponsePtr> createAssignment(HttpRequestPtr req);
 
-  void listAssignments(const HttpRequestPtr& req,
-                       std::function<void(const HttpResponsePtr&)>&& callback);
+  Task<HttpResponsePtr> listAssignments(HttpRequestPtr req);
 
-  void deleteAssignment(const HttpRequestPtr& req,
-                        std::function<void(const HttpResponsePtr&)>&& callback);
+  Task<HttpResponsePtr> deleteAssignment(HttpRequestPtr req);
 };
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <drogon/HttpController.h>
+#include <drogon/utils/coroutine.h>
 
 using namespace drogon;
 
@@ -18,15 +19,11 @@ class UsersController : public drogon::HttpController<UsersController> {
   ADD_METHOD_TO(UsersController::getUserProfile, "/api/users/{id}", Get);
   METHOD_LIST_END
 
-  void setWorkSchedule(const HttpRequestPtr& req,
-                       std::function<void(const HttpResponsePtr&)>&& callback);
+  Task<HttpResponsePtr> setWorkSchedule(HttpRequestPtr req);
 
-  void getWorkSchedule(const HttpRequestPtr& req,
-                       std::function<void(const HttpResponsePtr&)>&& callback);
+  Task<HttpResponsePtr> getWorkSchedule(HttpRequestPtr req);
 
-  void searchUsers(const HttpRequestPtr& req,
-                   std::function<void(const HttpResponsePtr&)>&& callback);
+  Task<HttpResponsePtr> searchUsers(HttpRequestPtr req);
 
-  void getUserProfile(const HttpRequestPtr& req,
-                      std::function<void(const HttpResponsePtr&)>&& callback);
+  Task<HttpResponsePtr> getUserProfile(HttpRequestPtr req);
 };
\ No newline at end of file
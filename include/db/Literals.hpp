@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <utility>
+
+// Text forms of values bound as statement parameters or written raw into
+// JSON.
+namespace db {
+
+// Hours with the two decimals of the NUMERIC(10,2) hour columns, for a
+// numeric[] element or a raw JSON number.
+inline std::string formatHours(double hours) {
+  char buf[32];
+  std::snprintf(buf, sizeof(buf), "%.2f", hours);
+  return buf;
+}
+
+// Builds a Postgres array literal ("{a,b,c}") to bind as one parameter and
+// cast in SQL, e.g. `$1::uuid[]`. Elements go in as they are, so they must
+// not need quoting: uuids, numbers, enum labels and NULL.
+class ArrayLiteral {
+ public:
+  ArrayLiteral() : text_("{") {}
+
+  void add(std::string_view element) {
+    if (text_.size() > 1) text_ += ',';
+    text_ += element;
+  }
+
+  bool empty() const { return text_.size() == 1; }
+
+  // The finished literal; the builder is spent afterwards.
+  std::string release() {
+    text_ += '}';
+    return std::move(text_);
+  }
+
+ private:
+  std::string text_;
+};
+
+}  // namespace db
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <drogon/orm/DbClient.h>
+#include <drogon/orm/Result.h>
+#include <drogon/utils/coroutine.h>
+
+#include <cstddef>
+#include <string>
+#include <utility>
+
+#include "metrics/Metrics.hpp"
+
+namespace db {
+
+struct ConnectionInfo {
+  std::string host;
+  unsigned short port = 5432;
+  std::string database;
+  std::string user;
+  std::string password;
+};
+
+struct PoolSettings {
+  // Connections in the pool; per IO thread when `fast` is set.
+  size_t connections = 4;
+  // Use drogon's per-event-loop clients, which skip the cross-thread hop
+  // for queries issued from request handlers.
+  bool fast = false;
+};
+
+// A named group of database connections. Short OLTP statements and heavy
+// range reads run on separate pools so a burst of calendar queries cannot
+// starve task writes. Every query that goes through exec() is counted in the
+// pool's in-flight gauge and latency histogram.
+class Pool {
+ public:
+  explicit Pool(std::string name);
+
+  Pool(const Pool&) = delete;
+  Pool& operator=(const Pool&) = delete;
+
+  const std::string& name() const { return name_; }
+
+  // Registers the drogon clients backing this pool. Must be called before
+  // app().run().
+  void configure(const ConnectionInfo& conn, const PoolSettings& settings);
+
+  // The client for the calling thread: the per-loop client on IO threads
+  // when the pool is fast, the shared one everywhere else.
+  drogon::orm::DbClientPtr client() const;
+
+  // Counts one in-flight statement or transaction against the pool.
+  class Lease {
+   public:
+    Lease() = default;
+    explicit Lease(metrics::Gauge& inflight) : inflight_(&inflight) {
+      inflight_->add(1);
+    }
+    Lease(Lease&& o) noexcept : inflight_(std::exchange(o.inflight_, nullptr)) {}
+    Lease& operator=(Lease&& o) noexcept {
+      if (this != &o) {
+        release();
+        inflight_ = std::exchange(o.inflight_, nullptr);
+      }
+      return *this;
+    }
+    Lease(const Lease&) = delete;
+    Lease& operator=(const Lease&) = delete;
+    ~Lease() { release(); }
+
+   private:
+    void release() {
+      if (inflight_) inflight_->add(-1);
+      inflight_ = nullptr;
+    }
+
+    metrics::Gauge* inflight_ = nullptr;
+  };
+
+  Lease lease() { return Lease(inflight_); }
+  metrics::Histogram& acquireWait() { return acquireWait_; }
+
+  template <typename... Args>
+  drogon::Task<drogon::orm::Result> exec(std::string sql, Args... args) {
+    auto held = lease();
+    metrics::ScopedTimer timer(queryLatency_);
+    co_return co_await client()->execSqlCoro(sql, std::move(args)...);
+  }
+
+ private:
+  std::string name_;
+  std::string sharedName_;
+  bool fast_ = false;
+  size_t capacity_ = 0;
+  metrics::Gauge& inflight_;
+  metrics::Histogram& queryLatency_;
+  metrics::Histogram& acquireWait_;
+};
+
+// Short reads and writes on tasks, users and assignments.
+Pool& oltp();
+// Calendar ranges, searches and other scans that may hold a connection for
+// a while.
+Pool& reports();
+
+}  // namespace db
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "db/Transaction.hpp"
+
+// Upkeep of task_closure (migration 006): one row per ancestor/descendant
+// pair of the task tree, the task itself included at depth 0. The helpers
+// queue their statements on the writer's pipeline so the closure changes
+// in the same transaction as parent_task_id.
+namespace db {
+
+// Links a new task below `parentId` (empty for a root task). Queue it after
+// the task row is inserted.
+void closureInsert(Pipeline& writes, const std::string& taskId,
+                   const std::string& parentId);
+
+// closureInsert for many new tasks in one statement. The parents (empty for
+// roots) must already have their closure rows, so a tree goes in one depth
+// level per call, top level first.
+void closureInsertMany(Pipeline& writes,
+                       const std::vector<std::string>& taskIds,
+                       const std::vector<std::string>& parentIds);
+
+// Re-links the subtree of `taskId` below `parentId` (empty to make it a
+// root): pairs with the old ancestors are dropped, pairs with the new ones
+// added. Depths inside the subtree are unchanged.
+void closureMove(Pipeline& writes, const std::string& taskId,
+                 const std::string& parentId);
+
+// Points project_root_id of every task in the subtree of `taskId` at the
+// top of its tree, in one statement whatever the subtree's size. Queue it
+// after closureInsert or closureMove.
+void resetProjectRoot(Pipeline& writes, const std::string& taskId);
+
+}  // namespace db
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <drogon/orm/DbClient.h>
+#include <drogon/orm/Result.h>
+#include <drogon/utils/coroutine.h>
+
+#include <exception>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "db/Pools.hpp"
+
+namespace db {
+
+// A batch of statements that are handed to the client back to back and
+// awaited once. Inside a transaction drogon queues them on the transaction's
+// connection, so the statements go out without a coroutine round trip
+// between them. Results come back in the order the statements were added.
+class Pipeline {
+ public:
+  using ResultCallback = std::function<void(const drogon::orm::Result&)>;
+  using ExceptPtrCallback = std::function<void(const std::exception_ptr&)>;
+  using Statement = std::function<void(const drogon::orm::DbClientPtr&,
+                                       ResultCallback&&, ExceptPtrCallback&&)>;
+
+  template <typename... Args>
+  Pipeline& add(std::string sql, Args&&... args) {
+    statements_.emplace_back(
+        [sql = std::move(sql), ... args = std::forward<Args>(args)](
+            const drogon::orm::DbClientPtr& client, ResultCallback&& rcb,
+            ExceptPtrCallback&& ecb) mutable {
+          client->execSqlAsync(sql, std::move(rcb), std::move(ecb),
+                               std::move(args)...);
+        });
+    return *this;
+  }
+
+  size_t size() const { return statements_.size(); }
+  bool empty() const { return statements_.empty(); }
+
+  // Sends every queued statement and resumes when all of them finished. The
+  // first failure is rethrown after the rest have completed.
+  drogon::Task<std::vector<drogon::orm::Result>> run(
+      drogon::orm::DbClientPtr client);
+
+ private:
+  std::vector<Statement> statements_;
+};
+
+// Owns one drogon transaction for the lifetime of a handler. Use client() for
+// queries and mappers inside the transaction and commit() once all writes
+// succeeded. A Tx that goes out of scope without commit() rolls back, so
+// early returns and exceptions never leave half-applied writes behind.
+class Tx {
+ public:
+  // Starts a transaction on `pool`, recording how long it waited for a
+  // connection. The transaction counts as in flight until it finishes.
+  static drogon::Task<Tx> begin(Pool& pool);
+
+  Tx(Tx&&) noexcept = default;
+  Tx& operator=(Tx&&) noexcept = default;
+  Tx(const Tx&) = delete;
+  Tx& operator=(const Tx&) = delete;
+  ~Tx();
+
+  drogon::orm::DbClientPtr client() const { return trans_; }
+
+  // Waits until COMMIT has been acknowledged, so reads issued afterwards on
+  // any pooled connection see the writes. Every other copy of client() must
+  // be released before this is awaited (mappers should be temporaries); a
+  // commit still waiting on one after a few seconds is logged. Throws if
+  // COMMIT failed or drogon already rolled back after a failed statement.
+  drogon::Task<> commit();
+
+  void rollback();
+
+ private:
+  Tx(std::shared_ptr<drogon::orm::Transaction> trans, Pool::Lease lease);
+
+  std::shared_ptr<drogon::orm::Transaction> trans_;
+  Pool::Lease lease_;
+};
+
+}  // namespace db
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "engine/Scheduler.hpp"
+
+// Free time of users, in two shapes:
+//
+// - FreeBusyMask: several users at a fixed 15-minute resolution. Each user's
+//   free time over a range of days is one bitset, so "when are all of these
+//   people free" is a word-wise AND and a scan for runs of set bits.
+// - FreeSlotIndex: one user at minute resolution, answering "earliest free
+//   stretch of this length after this time" with two binary searches.
+namespace engine {
+
+constexpr Minute kSlotMinutes = 15;
+constexpr int64_t kSlotsPerDay = kMinutesPerDay / kSlotMinutes;
+
+// Free time of one user over whole days [firstDay, firstDay + days), one bit
+// per slot, set = free. Starts out all busy.
+class FreeBusyMask {
+ public:
+  FreeBusyMask(int64_t firstDay, int64_t days);
+
+  // Frees the slots that lie entirely inside a working window.
+  void addWindows(const std::vector<WorkWindow>& windows);
+  // Takes every slot that overlaps `busy`.
+  void addBusy(Interval busy);
+
+  // Keeps only the slots that are also free in `other`, which must cover the
+  // same days.
+  void intersect(const FreeBusyMask& other);
+
+  size_t freeSlots() const;
+
+  // Up to `limit` non-overlapping stretches of `length` free slots, earliest
+  // first. Longer free stretches yield several back to back.
+  std::vector<Interval> findRuns(size_t length, size_t limit) const;
+
+  int64_t firstDay() const { return firstDay_; }
+  size_t slotCount() const { return slots_; }
+  Minute slotStart(size_t slot) const {
+    return firstDay_ * kMinutesPerDay +
+           static_cast<Minute>(slot) * kSlotMinutes;
+  }
+
+ private:
+  void setRange(size_t from, size_t to);
+  void clearRange(size_t from, size_t to);
+
+  int64_t firstDay_;
+  size_t slots_;
+  std::vector<uint64_t> bits_;
+};
+
+// Free working time of one user from `firstDay` on. The user's blocks are
+// kept in a sorted vector (they may overlap), and their complement within the
+// working windows as a sorted vector of free runs up to the day the last
+// block ends, with a max-length tree over it. After that the week simply
+// repeats.
+//
+// next() is O(log n) in the number of runs; each update() rebuilds the
+// runs, O(n + days covered).
+class FreeSlotIndex {
+ public:
+  FreeSlotIndex(const std::vector<WorkWindow>& windows, int64_t firstDay);
+
+  // Replaces all blocks; `blocks` need not be sorted.
+  void assign(std::vector<Interval> blocks);
+  // Drops one block equal to each of `removed` (if there is one), then adds
+  // `added`, rebuilding once.
+  void update(const std::vector<Interval>& removed,
+              const std::vector<Interval>& added);
+
+  // Earliest [s, s + length) with s >= after that lies in working time and
+  // overlaps no block. Working windows that touch, such as one ending at
+  // midnight and the next starting there, form one stretch. Empty if the
+  // user has no run that long.
+  std::optional<Interval> next(Minute after, Minute length) const;
+
+  size_t blockCount() const { return blocks_.size(); }
+  int64_t firstDay() const { return firstDay_; }
+
+ private:
+  void rebuild();
+  // First run at or after `from` that is at least `length` long.
+  size_t firstAtLeast(size_t from, Minute length) const;
+  std::optional<Interval> nextAfterHorizon(Minute from, Minute length) const;
+
+  UserCalendar windows_;  // working windows only
+  int64_t firstDay_;
+  Minute horizon_ = 0;    // runs_ covers [firstDay_, horizon_)
+  std::vector<Interval> blocks_;
+  std::vector<Interval> runs_;
+  std::vector<Minute> longest_;  // implicit tree, leaves from leaves_
+  size_t leaves_ = 1;
+};
+
+}  // namespace engine
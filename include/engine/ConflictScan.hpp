@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "engine/Scheduler.hpp"
+
+// Schedule checks for one user, run by the background conflict scanner.
+// Tasks and projects are indices chosen by the caller.
+namespace engine {
+
+struct ScanBlock {
+  uint32_t task = 0;
+  uint32_t project = 0;
+  Interval slot;
+};
+
+// project_allocation.hours_per_day of one project on one weekday.
+struct DailyLimit {
+  uint32_t project = 0;
+  int weekday = -1;  // -1 = every day
+  Minute minutes = 0;
+};
+
+struct Conflict {
+  enum class Kind { Overlap, OutsideWorkHours, Overallocation };
+
+  Kind kind = Kind::Overlap;
+  // Overlap: the block that starts later, and the task it collides with.
+  // Overallocation: the task with the most time that day, and the project.
+  uint32_t task = 0;
+  uint32_t other = 0;
+  // Overlap: the shared time. OutsideWorkHours: the block. Overallocation:
+  // the day.
+  Interval slot;
+  // OutsideWorkHours: minutes outside the windows. Overallocation: minutes
+  // booked on the project that day, and its limit.
+  Minute minutes = 0;
+  Minute limit = 0;
+};
+
+// Sweeps the blocks in start order and reports every pair of overlapping
+// blocks once, every block that reaches outside the working windows (if the
+// user has any), and every day on which the blocks of a project add up to
+// more than the sum of its limits for that weekday. Days are UTC days, as
+// everywhere in the scheduler.
+std::vector<Conflict> scanSchedule(std::vector<ScanBlock> blocks,
+                                   const UserCalendar& windows,
+                                   const std::vector<DailyLimit>& limits);
+
+}  // namespace engine
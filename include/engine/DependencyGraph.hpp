@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+// Task dependencies of one project and the critical-path analysis over them.
+// Nodes are dense indices 0..n-1 assigned by the caller; durations are whole
+// minutes. An edge from -> to means `to` depends on `from` (task_dependency
+// row with depends_on_id = from, task_id = to).
+namespace engine {
+
+enum class DependencyKind : uint8_t {
+  FinishStart,   // to starts after from finishes
+  StartStart,    // to starts after from starts
+  FinishFinish,  // to finishes after from finishes
+  StartFinish,   // to finishes after from starts
+};
+
+// task_dependency.kind values; unknown kinds are rejected.
+std::optional<DependencyKind> parseDependencyKind(std::string_view kind);
+const char* dependencyKindName(DependencyKind kind);
+
+// Smallest allowed ES(to) - ES(from) for an edge of `kind`.
+int64_t dependencyLag(DependencyKind kind, int64_t fromDuration,
+                      int64_t toDuration);
+
+// Adjacency in compressed sparse row form, both directions: the successors
+// of v are outTarget[outOffset[v] .. outOffset[v + 1]) and its predecessors
+// the same range of the in* arrays. Edge insertion and removal shift the
+// arrays in place, which is a memmove over the edge list rather than a
+// rebuild.
+class DependencyGraph {
+ public:
+  struct Edge {
+    uint32_t from = 0;
+    uint32_t to = 0;
+    DependencyKind kind = DependencyKind::FinishStart;
+  };
+
+  DependencyGraph() = default;
+  // Edges with an endpoint out of range, self-loops and duplicates are
+  // dropped.
+  DependencyGraph(std::vector<int64_t> durations,
+                  const std::vector<Edge>& edges);
+
+  size_t nodeCount() const { return duration_.size(); }
+  size_t edgeCount() const { return outTarget_.size(); }
+
+  int64_t duration(uint32_t v) const { return duration_[v]; }
+  void setDuration(uint32_t v, int64_t minutes) { duration_[v] = minutes; }
+
+  uint32_t outBegin(uint32_t v) const { return outOffset_[v]; }
+  uint32_t outEnd(uint32_t v) const { return outOffset_[v + 1]; }
+  uint32_t outTarget(uint32_t e) const { return outTarget_[e]; }
+  DependencyKind outKind(uint32_t e) const { return outKind_[e]; }
+
+  uint32_t inBegin(uint32_t v) const { return inOffset_[v]; }
+  uint32_t inEnd(uint32_t v) const { return inOffset_[v + 1]; }
+  uint32_t inSource(uint32_t e) const { return inSource_[e]; }
+  DependencyKind inKind(uint32_t e) const { return inKind_[e]; }
+
+  bool hasEdge(uint32_t from, uint32_t to) const;
+  // False if the edge is invalid or already present.
+  bool addEdge(const Edge& edge);
+  // False if there was no such edge.
+  bool removeEdge(uint32_t from, uint32_t to);
+
+ private:
+  std::vector<int64_t> duration_;
+  std::vector<uint32_t> outOffset_;
+  std::vector<uint32_t> outTarget_;
+  std::vector<DependencyKind> outKind_;
+  std::vector<uint32_t> inOffset_;
+  std::vector<uint32_t> inSource_;
+  std::vector<DependencyKind> inKind_;
+};
+
+// Earliest/latest start and total float of every task, in minutes from the
+// project start. The forward pass gives the earliest start ES; the backward
+// pass keeps, for each task, the longest chain from its start to the end of
+// the project (its "tail"), so the latest start is makespan - tail and a
+// change of the makespan does not invalidate anything.
+//
+// After construction the analysis is kept current under single edge and
+// duration changes: only tasks whose values actually move are revisited, in
+// topological order.
+class CriticalPath {
+ public:
+  explicit CriticalPath(DependencyGraph graph);
+
+  // False when the dependencies contain a cycle; nothing else is meaningful
+  // then.
+  bool acyclic() const { return acyclic_; }
+  const DependencyGraph& graph() const { return graph_; }
+
+  void setDuration(uint32_t v, int64_t minutes);
+  // Rejects the edge (returns false) when it would close a cycle.
+  bool addEdge(const DependencyGraph::Edge& edge);
+  bool removeEdge(uint32_t from, uint32_t to);
+
+  int64_t makespan() const { return makespan_; }
+  int64_t earliestStart(uint32_t v) const { return es_[v]; }
+  int64_t earliestFinish(uint32_t v) const {
+    return es_[v] + graph_.duration(v);
+  }
+  int64_t latestStart(uint32_t v) const { return makespan_ - tail_[v]; }
+  int64_t latestFinish(uint32_t v) const {
+    return latestStart(v) + graph_.duration(v);
+  }
+  int64_t totalFloat(uint32_t v) const { return latestStart(v) - es_[v]; }
+
+  // Tasks of one zero-float chain from the project start to its end, in
+  // order.
+  std::vector<uint32_t> criticalPath() const;
+
+  // Position of each task in the topological order in use.
+  const std::vector<uint32_t>& rank() const { return rank_; }
+
+ private:
+  bool sort();
+  void recomputeAll();
+  void propagateForward(const std::vector<uint32_t>& seeds);
+  void propagateBackward(const std::vector<uint32_t>& seeds);
+  int64_t computeEs(uint32_t v) const;
+  int64_t computeTail(uint32_t v) const;
+  void updateMakespan();
+
+  DependencyGraph graph_;
+  bool acyclic_ = true;
+  std::vector<uint32_t> order_;  // nodes in topological order
+  std::vector<uint32_t> rank_;   // inverse of order_
+  std::vector<int64_t> es_;
+  std::vector<int64_t> tail_;
+  std::vector<uint8_t> queued_;
+  int64_t makespan_ = 0;
+};
+
+}  // namespace engine
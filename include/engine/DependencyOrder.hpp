@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Topological order of the whole task_dependency graph, kept current as
+// edges are inserted so a new dependency can be checked for cycles without
+// walking the graph. Single insertions use the Pearce-Kelly algorithm: only
+// the tasks ranked between the two endpoints are searched and re-ranked.
+// Batches are validated together in one pass over the affected rank window.
+//
+// Nodes are dense indices; an arc (from, to) means `to` depends on `from`.
+namespace engine {
+
+class DependencyOrder {
+ public:
+  using Arc = std::pair<uint32_t, uint32_t>;  // from, to
+
+  // Replaces the graph. Arcs that would close a cycle (which the table may
+  // hold from before validation existed) are left out and returned.
+  std::vector<Arc> build(size_t nodes, const std::vector<Arc>& arcs);
+
+  // Appends a node ranked after all others.
+  uint32_t addNode();
+  size_t nodeCount() const { return out_.size(); }
+  uint32_t rank(uint32_t v) const { return rank_[v]; }
+
+  bool hasArc(uint32_t from, uint32_t to) const;
+
+  // Inserts the arc unless it closes a cycle. On rejection `cycle` (when
+  // given) receives the offending path from `from` back to itself, e.g.
+  // from, to, ..., from. Existing arcs are accepted as no-ops.
+  bool addArc(uint32_t from, uint32_t to,
+              std::vector<uint32_t>* cycle = nullptr);
+
+  // Inserts all arcs or none. One validation pass covers the whole batch;
+  // on rejection `cycle` receives one cycle formed with the new arcs, in the
+  // same form as above and starting with one of them.
+  bool addArcs(const std::vector<Arc>& arcs,
+               std::vector<uint32_t>* cycle = nullptr);
+
+  void removeArc(uint32_t from, uint32_t to);
+  // Drops every arc of `v`, e.g. after its task was deleted.
+  void clearNode(uint32_t v);
+
+ private:
+  void insert(uint32_t from, uint32_t to);
+  // Kahn's algorithm over the nodes ranked lo..hi; on success they are
+  // re-ranked within that window. Otherwise fills `cycle` and changes
+  // nothing.
+  bool sortWindow(uint32_t lo, uint32_t hi, std::vector<uint32_t>* cycle);
+  static void startAtNewArc(std::vector<uint32_t>& cycle,
+                            const std::vector<Arc>& fresh);
+
+  std::vector<std::vector<uint32_t>> out_;
+  std::vector<std::vector<uint32_t>> in_;
+  std::vector<uint32_t> order_;  // rank -> node
+  std::vector<uint32_t> rank_;   // node -> rank
+  // Scratch space for the searches; mark_ is all zero between calls.
+  std::vector<uint8_t> mark_;
+  std::vector<uint32_t> parent_;
+};
+
+}  // namespace engine
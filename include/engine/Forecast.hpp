@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "engine/DependencyGraph.hpp"
+#include "engine/Scheduler.hpp"
+
+// Monte Carlo forecast of when a project finishes. Each trial draws the work
+// of every task around its estimate (the durations of the CriticalPath's
+// graph), stretches it to calendar time at the pace its assignees work, and
+// runs the forward pass of the dependency analysis over the result. The
+// spread of the trials' finishing times gives the P50/P90 dates.
+//
+// Trials are split into fixed chunks with seeds of their own, so the result
+// depends on the seed only, not on how many threads ran the chunks.
+namespace engine {
+
+struct ForecastTask {
+  Minute release = 0;  // earliest start, minutes from now
+  // Calendar minutes per minute of work; 0 for a task with nothing left.
+  double pace = 1.0;
+};
+
+struct ForecastOptions {
+  uint32_t trials = 10000;
+  unsigned threads = 0;  // 0: one per core
+  uint64_t seed = 1;
+  // A task's work is drawn from a triangular distribution over
+  // [optimistic, pessimistic] times its estimate, peaking at the estimate.
+  double optimistic = 0.75;
+  double pessimistic = 1.75;
+};
+
+class Forecast {
+ public:
+  Forecast() = default;
+  explicit Forecast(std::vector<Minute> finishes);
+
+  uint32_t trials() const { return static_cast<uint32_t>(finishes_.size()); }
+  // Finishing time, in minutes from now, that a share `q` of the trials
+  // meet; 0 without trials.
+  Minute percentile(double q) const;
+  double mean() const;
+  // Share of the trials finished by `deadline`.
+  double within(Minute deadline) const;
+
+ private:
+  std::vector<Minute> finishes_;  // sorted
+};
+
+// `tasks` is indexed like the path's nodes. An empty forecast is returned
+// when the dependencies contain a cycle.
+Forecast forecastProject(const CriticalPath& path,
+                         const std::vector<ForecastTask>& tasks,
+                         const ForecastOptions& options = {});
+
+}  // namespace engine
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "engine/Rcu.hpp"
+#include "engine/Uuid.hpp"
+
+// In-process evaluation of the permission model in the schema: the
+// role_permission matrix, task-level roles (task_role_assignment), scoped
+// role grants (global_role_grant) and delegations. Everything is compiled
+// into bitmasks held in an immutable snapshot, so a check walks the task's
+// ancestors once and never goes to the database.
+namespace engine {
+
+using PermissionMask = uint64_t;
+
+// Values of role_enum.
+enum class Role : uint8_t {
+  Admin,
+  Owner,
+  Supervisor,
+  Hybrid,
+  Executor,
+  Spectator,
+  Audit,
+};
+constexpr size_t kRoleCount = 7;
+using RoleSet = uint8_t;
+
+constexpr RoleSet roleBit(Role r) {
+  return static_cast<RoleSet>(1u << static_cast<unsigned>(r));
+}
+std::optional<Role> parseRole(std::string_view s);
+
+// Permission keys and what each role grants. Keys are numbered in sorted
+// order, so the same catalog always yields the same bits.
+class PermissionMatrix {
+ public:
+  struct Entry {
+    std::string role;
+    std::string key;
+    bool isGlobal = false;
+  };
+
+  PermissionMatrix() = default;
+  PermissionMatrix(std::vector<std::string> keys,
+                   const std::vector<Entry>& grants);
+
+  // Bit index for `key`, or -1 if the catalog does not know it.
+  int bit(std::string_view key) const;
+  size_t size() const { return keys_.size(); }
+
+  // Permissions of a set of roles held on a task (or via a task-scoped
+  // grant): the role's local permissions only.
+  PermissionMask local(RoleSet roles) const { return localBySet_[roles]; }
+  // Permissions of roles granted globally or for a whole project: every
+  // permission of the role, global ones included.
+  PermissionMask full(RoleSet roles) const { return fullBySet_[roles]; }
+
+ private:
+  std::vector<std::string> keys_;
+  std::array<PermissionMask, 1u << kRoleCount> localBySet_{};
+  std::array<PermissionMask, 1u << kRoleCount> fullBySet_{};
+};
+
+// Everything attached to one task. Rights found on a task apply to the task
+// and all of its descendants.
+struct TaskAcl {
+  struct RoleGrant {
+    Uuid user;
+    RoleSet local = 0;  // task_role_assignment, task-scoped grants
+    RoleSet full = 0;   // project-scoped grants rooted at this task
+  };
+  struct Delegation {
+    Uuid grantee;
+    PermissionMask allow = 0;
+    PermissionMask deny = 0;
+    int64_t expiresAt = 0;  // unix seconds, 0 = no expiry
+  };
+
+  Uuid id;
+  std::optional<Uuid> parent;
+  Uuid createdBy;
+  std::vector<RoleGrant> roles;
+  std::vector<Delegation> delegations;
+};
+
+struct PermissionResolution {
+  bool known = false;  // the task is in the snapshot
+  bool owner = false;  // creator or holder of the owner role on the path
+  PermissionMask mask = 0;
+};
+
+class PermissionEngine {
+ public:
+  // Tasks are spread over kShards * kBuckets buckets. A write copies the
+  // buckets it changes (about tasks / 16384 entries each) and the arrays
+  // above them; the rest of the snapshot is shared.
+  static constexpr size_t kShards = 64;
+  static constexpr size_t kBuckets = 256;
+  // Guards against parent cycles in inconsistent data.
+  static constexpr int kMaxDepth = 256;
+
+  PermissionEngine();
+
+  // Replaces everything with freshly loaded state.
+  void load(std::shared_ptr<const PermissionMatrix> matrix,
+            std::unordered_map<Uuid, RoleSet, UuidHash> globalRoles,
+            std::vector<TaskAcl> tasks);
+
+  // Inserts or replaces whole task entries; buckets that are not touched
+  // are shared with the previous snapshot.
+  void upsert(std::vector<TaskAcl> tasks);
+  void remove(const Uuid& task);
+  // Adds `roles` to the user's task-level roles on `task`.
+  void grantRoles(const Uuid& task, const Uuid& user, RoleSet roles);
+  // Drops the user's task-level roles on `task`.
+  void revokeRoles(const Uuid& task, const Uuid& user);
+  // Hangs `task` (and with it its subtree) under `parent`.
+  void reparent(const Uuid& task, std::optional<Uuid> parent);
+
+  int bit(std::string_view key) const;
+  bool hasTask(const Uuid& task) const;
+
+  // Effective permissions of `user` on `task`. `now` is unix seconds and is
+  // only used to skip expired delegations.
+  PermissionResolution resolve(const Uuid& user, const Uuid& task,
+                               int64_t now) const;
+
+  // Whether `user` holds `key` on `task`. When the catalog does not know the
+  // key (permission tables not seeded), ownership decides, as the original
+  // owner-only checks did.
+  bool allowed(const Uuid& user, const Uuid& task, std::string_view key,
+               int64_t now) const;
+
+ private:
+  using Bucket = std::unordered_map<Uuid, TaskAcl, UuidHash>;
+  using Shard = std::array<std::shared_ptr<const Bucket>, kBuckets>;
+
+  struct Snapshot {
+    std::shared_ptr<const PermissionMatrix> matrix;
+    std::shared_ptr<const std::unordered_map<Uuid, RoleSet, UuidHash>>
+        globalRoles;
+    std::array<std::shared_ptr<const Shard>, kShards> shards;
+  };
+
+  // Shards and buckets one update has already copied.
+  struct Copies {
+    std::array<Shard*, kShards> shards{};
+    std::unordered_map<size_t, Bucket*> buckets;
+  };
+
+  // Top bits of the remixed hash: UuidHash's low bits are poorly spread
+  // for ids that are not random.
+  static size_t slotOf(const Uuid& id) {
+    static_assert(kShards * kBuckets == size_t{1} << 14);
+    return static_cast<size_t>(
+        (uint64_t{UuidHash{}(id)} * 0x9e3779b97f4a7c15ULL) >> 50);
+  }
+  static const Bucket& bucketOf(const Snapshot& snap, const Uuid& task) {
+    const size_t slot = slotOf(task);
+    return *(*snap.shards[slot / kBuckets])[slot % kBuckets];
+  }
+  // Copies the shard and bucket holding `task` inside `snap`, unless
+  // `copies` says this update already did, so the bucket can be modified.
+  static Bucket& mutableBucket(Snapshot& snap, const Uuid& task,
+                               Copies& copies);
+  // The entry of `task` in a copied bucket, or null when the snapshot does
+  // not hold it.
+  static TaskAcl* mutableAcl(Snapshot& snap, const Uuid& task);
+  static PermissionResolution resolveIn(const Snapshot& snap, const Uuid& user,
+                                        const Uuid& task, int64_t now);
+
+  Rcu<Snapshot> state_;
+};
+
+}  // namespace engine
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace engine {
+
+namespace detail {
+
+struct RcuSlot {
+  uint64_t version = 0;
+  std::shared_ptr<const void> ptr;
+};
+
+// Per-thread cache of the last snapshot read from each Rcu cell.
+std::vector<RcuSlot>& rcuSlots();
+uint32_t nextRcuId();
+
+}  // namespace detail
+
+// Read-copy-update cell for immutable snapshots. Writers build a new value
+// and publish it; readers keep using whatever snapshot they already hold.
+// The common read path is one atomic load: each thread caches the last
+// snapshot it saw and only takes the lock after a publish.
+template <typename T>
+class Rcu {
+ public:
+  explicit Rcu(std::shared_ptr<const T> initial)
+      : id_(detail::nextRcuId()), current_(std::move(initial)) {}
+
+  Rcu(const Rcu&) = delete;
+  Rcu& operator=(const Rcu&) = delete;
+
+  // The current snapshot as seen by this thread. The reference stays valid
+  // until this thread calls local() on the same cell again, so it must not
+  // be held across co_await.
+  const T& local() const {
+    auto& slots = detail::rcuSlots();
+    if (slots.size() <= id_) slots.resize(id_ + 1);
+    auto& slot = slots[id_];
+    if (slot.version != version_.load(std::memory_order_acquire)) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      slot.ptr = current_;
+      slot.version = version_.load(std::memory_order_relaxed);
+    }
+    return *static_cast<const T*>(slot.ptr.get());
+  }
+
+  // A counted reference, safe to keep for as long as needed.
+  std::shared_ptr<const T> snapshot() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return current_;
+  }
+
+  void publish(std::shared_ptr<const T> next) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    current_ = std::move(next);
+    version_.fetch_add(1, std::memory_order_release);
+  }
+
+  // Copies the current value, lets `fn` modify the copy and publishes it.
+  // Concurrent updates are serialized.
+  template <typename F>
+  void update(F&& fn) {
+    std::lock_guard<std::mutex> writer(writerMutex_);
+    auto next = std::make_shared<T>(*snapshot());
+    fn(*next);
+    publish(std::move(next));
+  }
+
+ private:
+  const uint32_t id_;
+  mutable std::mutex mutex_;
+  std::mutex writerMutex_;
+  std::shared_ptr<const T> current_;
+  std::atomic<uint64_t> version_{1};
+};
+
+}  // namespace engine
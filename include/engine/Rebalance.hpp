@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "engine/Scheduler.hpp"
+
+// Workload rebalancing: hours that push a user over a project's daily limit
+// are moved to days on which someone on the project has time left, solved
+// as a min-cost flow over users, days and tasks.
+namespace engine {
+
+// Min-cost flow by successive shortest paths. Each phase runs Dijkstra on
+// reduced costs and then pushes a blocking flow along every shortest path
+// at once, so the number of phases is bounded by the number of distinct
+// path costs rather than by the number of augmenting paths. Costs must be
+// non-negative.
+class MinCostFlow {
+ public:
+  explicit MinCostFlow(size_t nodes);
+
+  uint32_t addNode();
+  // Returns the arc's id for flow().
+  size_t addArc(uint32_t from, uint32_t to, int64_t capacity, int64_t cost);
+
+  struct Result {
+    int64_t flow = 0;
+    int64_t cost = 0;
+  };
+  Result solve(uint32_t source, uint32_t sink,
+               int64_t limit = std::numeric_limits<int64_t>::max());
+
+  int64_t flow(size_t arc) const { return cap_[arc ^ 1]; }
+  size_t nodeCount() const { return head_.size(); }
+  size_t arcCount() const { return to_.size() / 2; }
+
+ private:
+  int64_t push(uint32_t v, uint32_t sink, int64_t limit);
+
+  std::vector<uint32_t> head_;  // first arc per node, kNone if none
+  std::vector<uint32_t> next_;
+  std::vector<uint32_t> to_;
+  std::vector<int64_t> cap_;    // residual capacity; arcs come in pairs
+  std::vector<int64_t> cost_;
+  std::vector<int64_t> potential_;
+  std::vector<int64_t> dist_;
+  std::vector<uint32_t> level_;
+  std::vector<uint32_t> current_;
+};
+
+// One task's share of a user's time on an overloaded day.
+struct TaskShare {
+  uint32_t task = 0;
+  Minute minutes = 0;
+};
+
+// A user whose project work on `day` exceeds the limit by `excess`.
+struct Overload {
+  uint32_t user = 0;
+  int64_t day = 0;
+  Minute excess = 0;
+  std::vector<TaskShare> tasks;
+};
+
+// Time a user could still spend on the project on `day`.
+struct Spare {
+  uint32_t user = 0;
+  int64_t day = 0;
+  Minute minutes = 0;
+};
+
+struct RebalanceTask {
+  int priority = 1;  // task_priority_enum order: 0 = low ... 3 = urgent
+  int64_t firstDay = 0;
+  int64_t lastDay = 0;  // inclusive; work is only moved inside the window
+};
+
+struct Move {
+  uint32_t task = 0;
+  uint32_t fromUser = 0;
+  int64_t fromDay = 0;
+  uint32_t toUser = 0;
+  int64_t toDay = 0;
+  Minute minutes = 0;
+};
+
+struct RebalanceOptions {
+  // Work moves at most this many days away from where it was booked.
+  int64_t maxShiftDays = 14;
+  // Cost per minute moved is priorityCost[priority] + dayCost * |shift|:
+  // low-priority work is moved first, and as little as possible in time.
+  Minute priorityCost[4] = {8, 16, 32, 64};
+  Minute dayCost = 1;
+};
+
+// Moves as much of the excess as the spare time allows, at least total
+// cost. Moves can go to other users on any day, or to the same user on
+// another day. Each overload gives up at most its excess, and no spare entry
+// takes more than its minutes.
+std::vector<Move> rebalance(const std::vector<RebalanceTask>& tasks,
+                            const std::vector<Overload>& overloads,
+                            const std::vector<Spare>& spare,
+                            const RebalanceOptions& options = {});
+
+}  // namespace engine
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Placement of assigned hours into users' working time. Times are whole
+// minutes since 1970-01-01 00:00 UTC and days are days since that date;
+// weekdays follow user_work_schedule.weekday, 0 = Monday.
+namespace engine {
+
+using Minute = int64_t;
+constexpr Minute kMinutesPerDay = 24 * 60;
+
+// Half-open [start, end).
+struct Interval {
+  Minute start = 0;
+  Minute end = 0;
+
+  Minute length() const { return end - start; }
+};
+
+struct WorkWindow {
+  int weekday = 0;
+  int startMinute = 0;  // minutes after midnight
+  int endMinute = 0;
+};
+
+inline int weekdayOf(int64_t day) {
+  // 1970-01-01 was a Thursday.
+  return static_cast<int>(((day + 3) % 7 + 7) % 7);
+}
+
+// "YYYY-MM-DD" and "YYYY-MM-DDTHH:MM:00Z".
+std::string formatDay(int64_t day);
+std::string formatMinute(Minute minute);
+
+// Working windows and booked time of one user. Busy time is kept as a
+// sorted vector of disjoint intervals, so lookups are binary searches and
+// the whole thing stays in a few cache lines for a typical user.
+class UserCalendar {
+ public:
+  UserCalendar() = default;
+  explicit UserCalendar(const std::vector<WorkWindow>& windows);
+
+  // Marks time as taken. Overlapping and adjacent intervals are merged.
+  void addBusy(Interval busy);
+  void addBusy(const std::vector<Interval>& sorted);
+  void removeBusy(Interval freed);
+
+  // Free working time in [from, to), earliest first, appended to `out`.
+  // Stops once `limit` minutes were collected (0 = no limit) and returns the
+  // minutes collected.
+  Minute freeSlots(Minute from, Minute to, std::vector<Interval>& out,
+                   Minute limit = 0) const;
+
+  // Books up to `minutes` of the earliest free working time between the
+  // start of `fromDay` and the end of `toDay`. Booked blocks are appended to
+  // `out`; returns the minutes that did not fit.
+  Minute place(int64_t fromDay, int64_t toDay, Minute minutes,
+               std::vector<Interval>& out);
+
+  const std::vector<Interval>& busy() const { return busy_; }
+  bool hasWindows() const { return hasWindows_; }
+
+ private:
+  // Working windows per weekday, sorted and disjoint, in minutes of the day.
+  std::array<std::vector<Interval>, 7> windows_;
+  bool hasWindows_ = false;
+  std::vector<Interval> busy_;
+};
+
+// Places a batch of assignments across the users' calendars, one at a time
+// from a heap ordered by priority, then due day, then the minute the
+// assignment becomes ready. An assignment is ready once everything it waits
+// for has been placed, and its work starts no earlier than the end of their
+// last blocks. When an assignment does not fit, it pre-empts blocks of
+// lower-priority assignments of the same user inside its range. Those
+// assignments go back on the heap and are placed again with what is left.
+// Assignments that others wait for are never pre-empted: their dependents
+// were released against the end of their blocks, which must not move.
+class AutoScheduler {
+ public:
+  struct Assignment {
+    size_t user = 0;        // index returned by addUser()
+    int64_t startDay = 0;   // first day work may be placed
+    int64_t dueDay = 0;     // last day, inclusive
+    Minute minutes = 0;     // time to place
+    int priority = 1;       // task_priority_enum order: 0 = low ... 3 = urgent
+    // Assignments in the batch that must be placed first.
+    std::vector<size_t> after;
+  };
+
+  struct Block {
+    size_t assignment = 0;  // index into the batch
+    Interval slot;
+  };
+
+  struct Result {
+    std::vector<Block> blocks;
+    // Minutes of each assignment that did not fit before its due day.
+    std::vector<Minute> unplaced;
+    // Blocks taken back from lower-priority assignments.
+    size_t preempted = 0;
+  };
+
+  size_t addUser(const std::vector<WorkWindow>& windows);
+  UserCalendar& user(size_t index) { return users_[index]; }
+  size_t userCount() const { return users_.size(); }
+
+  Result place(const std::vector<Assignment>& assignments);
+
+ private:
+  std::vector<UserCalendar> users_;
+};
+
+}  // namespace engine
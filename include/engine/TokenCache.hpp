@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Bounded LRU of bearer tokens that already passed signature verification,
+// mapped to the user id they carry. Entries are dropped once the token's
+// expiry passes, so a hit can be trusted without decoding the token again.
+// The cache is split into independently locked shards by token hash.
+namespace engine {
+
+class TokenCache {
+ public:
+  // `capacity` is the total across all shards; 0 disables the cache.
+  explicit TokenCache(size_t capacity, size_t shards = 16);
+
+  // User id for `token` if it is cached and not expired at `now` (unix
+  // seconds).
+  std::optional<std::string> find(std::string_view token, int64_t now);
+
+  // `expiresAt` is unix seconds; 0 means the token carries no expiry.
+  void insert(std::string_view token, std::string userId, int64_t expiresAt);
+
+  size_t size() const;
+  size_t capacity() const { return capacity_; }
+
+ private:
+  struct Entry {
+    std::string token;
+    std::string userId;
+    int64_t expiresAt = 0;
+  };
+
+  struct Shard {
+    std::mutex mutex;
+    // Most recently used first; the index points into it.
+    std::list<Entry> entries;
+    std::unordered_map<std::string_view, std::list<Entry>::iterator> index;
+  };
+
+  Shard& shardFor(std::string_view token);
+
+  size_t capacity_;
+  size_t perShard_;
+  std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+}  // namespace engine
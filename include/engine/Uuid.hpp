@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// Dense in-memory form of the UUID primary keys used throughout the schema,
+// so engines can hash and compare ids without touching strings.
+namespace engine {
+
+struct Uuid {
+  uint64_t hi = 0;
+  uint64_t lo = 0;
+
+  // Accepts the canonical 8-4-4-4-12 form in either case.
+  static std::optional<Uuid> parse(std::string_view s) {
+    if (s.size() != 36) return std::nullopt;
+    Uuid out;
+    int nibbles = 0;
+    for (size_t i = 0; i < s.size(); ++i) {
+      const char c = s[i];
+      if (i == 8 || i == 13 || i == 18 || i == 23) {
+        if (c != '-') return std::nullopt;
+        continue;
+      }
+      uint64_t v;
+      if (c >= '0' && c <= '9')
+        v = static_cast<uint64_t>(c - '0');
+      else if (c >= 'a' && c <= 'f')
+        v = static_cast<uint64_t>(c - 'a' + 10);
+      else if (c >= 'A' && c <= 'F')
+        v = static_cast<uint64_t>(c - 'A' + 10);
+      else
+        return std::nullopt;
+      uint64_t& half = nibbles < 16 ? out.hi : out.lo;
+      half = (half << 4) | v;
+      ++nibbles;
+    }
+    return out;
+  }
+
+  std::string str() const {
+    static const char kHex[] = "0123456789abcdef";
+    std::string s(36, '-');
+    size_t pos = 0;
+    for (int n = 0; n < 32; ++n) {
+      if (pos == 8 || pos == 13 || pos == 18 || pos == 23) ++pos;
+      const uint64_t half = n < 16 ? hi : lo;
+      s[pos++] = kHex[(half >> (4 * (15 - n % 16))) & 0xf];
+    }
+    return s;
+  }
+
+  bool isNil() const { return hi == 0 && lo == 0; }
+
+  friend bool operator==(const Uuid& a, const Uuid& b) {
+    return a.hi == b.hi && a.lo == b.lo;
+  }
+  friend bool operator!=(const Uuid& a, const Uuid& b) { return !(a == b); }
+  friend bool operator<(const Uuid& a, const Uuid& b) {
+    return a.hi != b.hi ? a.hi < b.hi : a.lo < b.lo;
+  }
+};
+
+struct UuidHash {
+  size_t operator()(const Uuid& u) const noexcept {
+    // Random UUIDs are already well mixed; fold the halves together.
+    return static_cast<size_t>(u.hi ^ (u.lo * 0x9e3779b97f4a7c15ULL));
+  }
+};
+
+}  // namespace engine
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "engine/DependencyGraph.hpp"
+#include "engine/Scheduler.hpp"
+
+// What-if simulation of one project. A PlanBaseline is the project as it is
+// now: its critical-path analysis, its assignments and the calendars of the
+// people doing them. It never changes once built, so any number of
+// scenarios can read it at the same time. A Scenario stores only its own
+// edits and the values they change. Everything else is read from the
+// baseline, so a scenario's memory grows with its edits rather than with
+// the project.
+namespace engine {
+
+struct PlanAssignment {
+  uint32_t task = 0;  // node in the baseline's dependency graph
+  uint32_t user = 0;
+  int64_t startDay = 0;
+  int64_t dueDay = 0;
+  Minute minutes = 0;  // still to place
+  int priority = 1;     // see AutoScheduler::Assignment
+};
+
+// Where an assignment's hours landed.
+struct PlacementSummary {
+  Minute start = -1;   // start of the first block, -1 if none was placed
+  Minute finish = -1;  // end of the last block
+  Minute unplaced = 0;
+
+  bool operator==(const PlacementSummary&) const = default;
+};
+
+class PlanBaseline {
+ public:
+  // `calendars[u]` holds user u's working windows and every block that is
+  // not re-placed. The assignments are placed against them once here.
+  PlanBaseline(CriticalPath path, std::vector<PlanAssignment> assignments,
+               std::vector<std::shared_ptr<const UserCalendar>> calendars);
+
+  const CriticalPath& path() const { return path_; }
+  const std::vector<PlanAssignment>& assignments() const {
+    return assignments_;
+  }
+  const std::vector<PlacementSummary>& placement() const { return placement_; }
+  size_t userCount() const { return calendars_.size(); }
+  const std::shared_ptr<const UserCalendar>& calendar(uint32_t user) const {
+    return calendars_[user];
+  }
+  // Indices into assignments() of each user's assignments, in order.
+  const std::vector<uint32_t>& assignmentsOf(uint32_t user) const {
+    return byUser_[user];
+  }
+
+ private:
+  CriticalPath path_;
+  std::vector<PlanAssignment> assignments_;
+  std::vector<std::shared_ptr<const UserCalendar>> calendars_;
+  std::vector<std::vector<uint32_t>> byUser_;
+  std::vector<PlacementSummary> placement_;
+};
+
+struct TaskShift {
+  uint32_t task = 0;
+  // Minutes from the project start.
+  int64_t startBefore = 0, startAfter = 0;
+  int64_t finishBefore = 0, finishAfter = 0;
+};
+
+struct AssignmentShift {
+  uint32_t assignment = 0;
+  PlacementSummary before;
+  PlacementSummary after;
+};
+
+struct ScenarioDiff {
+  int64_t makespanBefore = 0;
+  int64_t makespanAfter = 0;
+  std::vector<uint32_t> criticalPath;  // after the edits
+  // Only tasks and assignments that moved, by index.
+  std::vector<TaskShift> tasks;
+  std::vector<AssignmentShift> assignments;
+};
+
+// Hypothetical edits on top of a shared baseline. Edits to the same task or
+// user accumulate. run() can be called any number of times and does not
+// modify the scenario.
+class Scenario {
+ public:
+  explicit Scenario(std::shared_ptr<const PlanBaseline> base);
+
+  void setDuration(uint32_t task, Minute minutes);
+  // The task starts `minutes` later than the baseline lets it.
+  void delay(uint32_t task, Minute minutes);
+  // The user does no work on days [firstDay, lastDay]. Their calendar is
+  // copied on the first absence.
+  void addAbsence(uint32_t user, int64_t firstDay, int64_t lastDay);
+
+  // Replays the dependency analysis from the edited tasks, then places the
+  // assignments of every user whose work moved. Assignments follow their
+  // task: a later earliest start pushes both of their days back by whole
+  // days, and a new duration scales their hours.
+  ScenarioDiff run() const;
+
+  size_t editCount() const {
+    return duration_.size() + delay_.size() + calendars_.size();
+  }
+
+ private:
+  std::shared_ptr<const PlanBaseline> base_;
+  std::unordered_map<uint32_t, Minute> duration_;
+  std::unordered_map<uint32_t, Minute> delay_;
+  std::unordered_map<uint32_t, std::shared_ptr<UserCalendar>> calendars_;
+};
+
+}  // namespace engine
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Process-wide counters, gauges and latency histograms rendered in the
+// Prometheus text format by MetricsController. Metric objects are created
+// once and live for the whole process, so hot paths keep a reference and
+// only touch atomics.
+namespace metrics {
+
+class Counter {
+ public:
+  void inc(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+  uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<uint64_t> value_{0};
+};
+
+class Gauge {
+ public:
+  void add(int64_t n) { value_.fetch_add(n, std::memory_order_relaxed); }
+  void set(int64_t n) { value_.store(n, std::memory_order_relaxed); }
+  int64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<int64_t> value_{0};
+};
+
+// Fixed exponential buckets from 50us to ~13s, enough to size pools and
+// worker queues without configuring anything per metric.
+class Histogram {
+ public:
+  static constexpr size_t kBuckets = 19;
+  static const std::array<double, kBuckets>& bounds();
+
+  void observe(std::chrono::nanoseconds d);
+  void observeSeconds(double seconds);
+
+  uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+  double sumSeconds() const;
+  uint64_t bucket(size_t i) const {
+    return buckets_[i].load(std::memory_order_relaxed);
+  }
+
+ private:
+  std::array<std::atomic<uint64_t>, kBuckets> buckets_{};
+  std::atomic<uint64_t> count_{0};
+  std::atomic<uint64_t> sumNs_{0};
+};
+
+// Records the time between construction and destruction into a histogram.
+class ScopedTimer {
+ public:
+  explicit ScopedTimer(Histogram& h)
+      : hist_(&h), start_(std::chrono::steady_clock::now()) {}
+  ScopedTimer(ScopedTimer&& o) noexcept : hist_(o.hist_), start_(o.start_) {
+    o.hist_ = nullptr;
+  }
+  ScopedTimer(const ScopedTimer&) = delete;
+  ScopedTimer& operator=(const ScopedTimer&) = delete;
+  ScopedTimer& operator=(ScopedTimer&&) = delete;
+  ~ScopedTimer() {
+    if (hist_) hist_->observe(std::chrono::steady_clock::now() - start_);
+  }
+
+ private:
+  Histogram* hist_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+class Registry {
+ public:
+  // `labels` is the rendered label set without braces, e.g. pool="oltp".
+  Counter& counter(const std::string& name, const std::string& help,
+                   const std::string& labels = {});
+  Gauge& gauge(const std::string& name, const std::string& help,
+               const std::string& labels = {});
+  Histogram& histogram(const std::string& name, const std::string& help,
+                       const std::string& labels = {});
+  // Gauge evaluated at scrape time, for values owned by someone else.
+  void gaugeFn(const std::string& name, const std::string& help,
+               const std::string& labels, std::function<double()> fn);
+
+  std::string render() const;
+
+ private:
+  struct Family {
+    std::string help;
+    std::string type;
+    std::map<std::string, std::unique_ptr<Counter>> counters;
+    std::map<std::string, std::unique_ptr<Gauge>> gauges;
+    std::map<std::string, std::unique_ptr<Histogram>> histograms;
+    std::map<std::string, std::function<double()>> callbacks;
+  };
+
+  Family& family(const std::string& name, const std::string& help,
+                 const char* type);
+
+  mutable std::mutex mutex_;
+  std::map<std::string, Family> families_;
+};
+
+Registry& registry();
+
+}  // namespace metrics
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Writes JSON text straight into one growing buffer, without building a
+// Json::Value tree first. Used by the hot read endpoints, where rows are
+// copied from the database result into the response body as they are read.
+namespace serialization {
+
+// Appends `s` to `out` as the body of a JSON string (no surrounding quotes).
+// Runs of characters that need no escaping are found 16 bytes at a time and
+// copied in one piece.
+void appendEscaped(std::string& out, std::string_view s);
+
+class JsonWriter {
+ public:
+  explicit JsonWriter(size_t reserve = 4096) { out_.reserve(reserve); }
+
+  void beginObject() { open('{'); }
+  void endObject() { close('}'); }
+  void beginArray() { open('['); }
+  void endArray() { close(']'); }
+
+  // Object member name; the next call writes its value.
+  void key(std::string_view k) {
+    separate();
+    out_ += '"';
+    appendEscaped(out_, k);
+    out_ += "\":";
+    needComma_ = false;
+  }
+
+  void string(std::string_view s) {
+    separate();
+    out_ += '"';
+    appendEscaped(out_, s);
+    out_ += '"';
+    needComma_ = true;
+  }
+
+  void null() { literal("null"); }
+  void boolean(bool b) { literal(b ? "true" : "false"); }
+  void number(int64_t n) { literal(std::to_string(n)); }
+
+  // Appends already serialized JSON as one value.
+  void raw(std::string_view json) { literal(json); }
+
+  size_t size() const { return out_.size(); }
+  const std::string& str() const { return out_; }
+  std::string release() { return std::move(out_); }
+
+  // Hands the buffered text to the caller and starts over, for chunked
+  // output. Separator state is kept so the next value continues the current
+  // array or object.
+  std::string flush() {
+    std::string chunk = std::move(out_);
+    out_.clear();
+    out_.reserve(chunk.capacity());
+    return chunk;
+  }
+
+ private:
+  void separate() {
+    if (needComma_) out_ += ',';
+  }
+  void open(char c) {
+    separate();
+    out_ += c;
+    needComma_ = false;
+  }
+  void close(char c) {
+    out_ += c;
+    needComma_ = true;
+  }
+  void literal(std::string_view v) {
+    separate();
+    out_ += v;
+    needComma_ = true;
+  }
+
+  std::string out_;
+  bool needComma_ = false;
+};
+
+}  // namespace serialization
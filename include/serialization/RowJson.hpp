@@ -0,0 +1,38 @@
+#pragma once
+
+#include <drogon/HttpResponse.h>
+#include <drogon/orm/Field.h>
+
+#include <string>
+#include <string_view>
+
+#include "serialization/JsonWriter.hpp"
+
+// Glue between drogon result rows and JsonWriter. Field values are read in
+// their text form straight out of the result buffer.
+namespace serialization {
+
+inline std::string_view fieldView(const drogon::orm::Field& f) {
+  return {f.c_str(), static_cast<size_t>(f.length())};
+}
+
+// "key": "<text>" or "key": null.
+inline void writeField(JsonWriter& w, std::string_view key,
+                       const drogon::orm::Field& f) {
+  w.key(key);
+  if (f.isNull())
+    w.null();
+  else
+    w.string(fieldView(f));
+}
+
+inline drogon::HttpResponsePtr jsonResponse(
+    JsonWriter& w, drogon::HttpStatusCode code = drogon::k200OK) {
+  auto resp = drogon::HttpResponse::newHttpResponse();
+  resp->setStatusCode(code);
+  resp->setContentTypeCode(drogon::CT_APPLICATION_JSON);
+  resp->setBody(w.release());
+  return resp;
+}
+
+}  // namespace serialization
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <drogon/utils/coroutine.h>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "engine/Availability.hpp"
+#include "metrics/Metrics.hpp"
+
+// Free time of users: their user_work_schedule windows minus every
+// task_schedule block.
+//
+// - Common free time of a group is computed per request from 15-minute
+//   engine::FreeBusyMask bitsets intersected across the group.
+// - The next free slot of one user comes from an engine::FreeSlotIndex of
+//   the user's blocks from today on. Indexes of recently used users are
+//   cached and kept current by the hooks below, which every task_schedule
+//   and work-schedule write calls after committing.
+namespace services {
+
+struct CommonAvailability {
+  // Earliest free stretches of the requested length, back to back where a
+  // longer stretch is free.
+  std::vector<engine::Interval> slots;
+  // Minutes in the range when all users are free.
+  engine::Minute freeMinutes = 0;
+};
+
+struct UserSlots {
+  UserSlots(const std::vector<engine::WorkWindow>& windows, int64_t firstDay)
+      : index(windows, firstDay) {}
+
+  engine::FreeSlotIndex index;
+  // Held while reading or changing `index`.
+  std::mutex mutex;
+  uint64_t lastUsed = 0;
+};
+
+class AvailabilityService {
+ public:
+  AvailabilityService();
+
+  // Searches days [firstDay, lastDay] (days since 1970-01-01) for up to
+  // `limit` stretches of `minutes`, rounded up to whole slots. Time before
+  // now is never free.
+  drogon::Task<CommonAvailability> commonFreeTime(
+      std::vector<std::string> userIds, int64_t firstDay, int64_t lastDay,
+      engine::Minute minutes, size_t limit);
+
+  // Earliest stretch of `minutes` inside `userId`'s working hours that
+  // starts at `after` or later (and not before now) and overlaps no block.
+  drogon::Task<std::optional<engine::Interval>> nextFreeSlot(
+      std::string userId, engine::Minute after, engine::Minute minutes);
+
+  // Hooks for committed writes. Users whose index is not cached are ignored.
+  void blocksChanged(const std::string& userId,
+                     const std::vector<engine::Interval>& removed,
+                     const std::vector<engine::Interval>& added);
+  void workScheduleChanged(const std::string& userId);
+
+ private:
+  drogon::Task<std::shared_ptr<UserSlots>> load(std::string userId);
+
+  std::mutex mutex_;
+  std::unordered_map<std::string, std::shared_ptr<UserSlots>> users_;
+  uint64_t clock_ = 0;
+  // Bumped by every hook, so a load that raced with a write is served once
+  // but not cached.
+  uint64_t generation_ = 0;
+
+  metrics::Histogram& searchLatency_;
+  metrics::Histogram& loadLatency_;
+  metrics::Counter& hits_;
+  metrics::Counter& misses_;
+};
+
+AvailabilityService& availability();
+
+}  // namespace services
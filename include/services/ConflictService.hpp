@@ -0,0 +1,65 @@
+#pragma once
+
+#include <drogon/utils/coroutine.h>
+
+#include <cstddef>
+#include <mutex>
+#include <set>
+#include <string>
+
+#include "metrics/Metrics.hpp"
+
+// Finds schedule problems in the background and records them in
+// conflict_resolution as 'suggested' rows:
+//
+// - schedule_conflict: two of a user's blocks overlap, or a block reaches
+//   outside their working hours;
+// - overallocation: on some day a user's blocks in one project exceed the
+//   project_allocation.hours_per_day set for them;
+// - missing_assignment: an open assignment with hours has no block at all.
+//
+// Only blocks from today on are checked. Users are rescanned only after
+// something of theirs changed: writers mark them dirty and a timer drains
+// the queue in batches. Each scan brings the user's open suggestions up to
+// date in one transaction. New findings are inserted, findings that went
+// away are marked resolved, and a finding someone already accepted or
+// declined is not suggested again. Rows are told apart by payload->>'key'.
+// Projects with overallocation get proposed moves from RebalanceService at
+// the end of each round.
+namespace services {
+
+class ConflictService {
+ public:
+  ConflictService();
+
+  // Once the event loop runs, queues every user with blocks or open
+  // assignments, then scans up to `batch` queued users every
+  // `intervalSeconds`.
+  void start(double intervalSeconds, size_t batch);
+
+  // Queues `userId` for the next round. Cheap; call after committing any
+  // write to the user's blocks, assignments or working hours.
+  void markDirty(const std::string& userId);
+
+  // Scans one user now and returns the number of new suggestions.
+  drogon::Task<size_t> scanUser(std::string userId);
+
+ private:
+  drogon::Task<> drain();
+
+  std::mutex mutex_;
+  std::set<std::string> dirty_;
+  std::set<std::string> overallocated_;  // projects to rebalance
+  bool draining_ = false;
+  size_t batch_ = 64;
+
+  metrics::Histogram& scanLatency_;
+  metrics::Counter& suggestions_;
+  metrics::Counter& resolved_;
+  metrics::Counter& failures_;
+  metrics::Gauge& queued_;
+};
+
+ConflictService& conflicts();
+
+}  // namespace services
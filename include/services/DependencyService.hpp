@@ -0,0 +1,120 @@
+#pragma once
+
+#include <drogon/orm/DbClient.h>
+#include <drogon/utils/coroutine.h>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "engine/DependencyGraph.hpp"
+#include "engine/DependencyOrder.hpp"
+#include "engine/Uuid.hpp"
+#include "metrics/Metrics.hpp"
+
+// Owns task_dependency writes and keeps two views of the table in memory:
+//
+// - a topological order of the whole graph (engine::DependencyOrder), so a
+//   new dependency is checked for cycles by looking only at the tasks ranked
+//   between its endpoints;
+// - the graphs of recently used projects with their critical-path analysis.
+//   A project is a task together with all of its subtasks; dependencies
+//   leaving the project are ignored there.
+//
+// Both are loaded on first use and then kept current by the writes below and
+// the hooks, which apply duration and edge changes incrementally.
+namespace services {
+
+struct NewDependency {
+  std::string taskId;
+  std::string dependsOnId;
+  engine::DependencyKind kind = engine::DependencyKind::FinishStart;
+};
+
+struct CreatedDependency {
+  std::string id;
+  std::string taskId;
+  std::string dependsOnId;
+  engine::DependencyKind kind = engine::DependencyKind::FinishStart;
+};
+
+struct DependencyInsert {
+  std::vector<CreatedDependency> created;
+  // Requested dependencies that already existed; they are not written again.
+  size_t duplicates = 0;
+  // When the batch was rejected: task ids along a cycle it would close,
+  // each depending on the one before it, first and last being the same.
+  std::vector<std::string> cycle;
+};
+
+struct ProjectGraph {
+  explicit ProjectGraph(engine::CriticalPath p) : path(std::move(p)) {}
+
+  std::vector<engine::Uuid> ids;  // node index -> task id
+  std::unordered_map<engine::Uuid, uint32_t, engine::UuidHash> index;
+  engine::CriticalPath path;
+  // Held while reading or changing `path`.
+  std::mutex mutex;
+  uint64_t lastUsed = 0;
+};
+
+class DependencyService {
+ public:
+  DependencyService();
+
+  // The graph of `projectId`, or null when there is no such task.
+  drogon::Task<std::shared_ptr<ProjectGraph>> project(std::string projectId);
+
+  // Writes `dependencies` in one transaction after validating them together
+  // against the rest of the graph. Nothing is written if any of them would
+  // close a cycle. Ids must be valid task ids.
+  drogon::Task<DependencyInsert> add(std::vector<NewDependency> dependencies);
+
+  // Hooks for committed writes. Changes to projects that are not cached are
+  // ignored.
+  void durationChanged(const std::string& taskId, double estimatedHours);
+  void dependencyAdded(const std::string& taskId,
+                       const std::string& dependsOnId,
+                       engine::DependencyKind kind);
+  // A task was created under, moved from or deleted from the projects that
+  // contain `taskId`; those graphs are dropped and loaded again on next use.
+  void structureChanged(const std::string& taskId);
+  // The task and, through the cascade, its dependencies are gone.
+  void taskDeleted(const std::string& taskId);
+
+ private:
+  drogon::Task<std::shared_ptr<ProjectGraph>> load(engine::Uuid root);
+  // Reads the whole table into order_; the caller holds the write lock.
+  drogon::Task<> loadOrder(drogon::orm::DbClientPtr client);
+  // Node of `id` in order_, added if new. Requires orderMutex_.
+  uint32_t orderNode(const engine::Uuid& id);
+
+  std::mutex mutex_;
+  std::unordered_map<engine::Uuid, std::shared_ptr<ProjectGraph>,
+                     engine::UuidHash>
+      projects_;
+  uint64_t clock_ = 0;
+  // Bumped by every hook, so a load that raced with a write is served once
+  // but not cached.
+  uint64_t generation_ = 0;
+
+  std::mutex orderMutex_;
+  bool orderLoaded_ = false;
+  engine::DependencyOrder order_;
+  std::vector<engine::Uuid> orderIds_;
+  std::unordered_map<engine::Uuid, uint32_t, engine::UuidHash> orderIndex_;
+
+  metrics::Histogram& loadLatency_;
+  metrics::Counter& hits_;
+  metrics::Counter& misses_;
+  metrics::Histogram& validateLatency_;
+  metrics::Counter& cyclesRejected_;
+};
+
+DependencyService& dependencies();
+
+}  // namespace services
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <drogon/utils/coroutine.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+#include "engine/Forecast.hpp"
+#include "engine/Uuid.hpp"
+#include "metrics/Metrics.hpp"
+#include "services/WorkerPool.hpp"
+
+// Monte Carlo completion forecasts of projects (engine::forecastProject).
+// Trials run single-threaded on a small worker pool with a bounded queue,
+// not on the IO loop, and concurrent requests for the same project share
+// one run. A project's forecast is kept until the next task, assignment,
+// dependency or working-hours write: writers call changed() after
+// committing.
+//
+// A task's work is its estimated_hours. It is done at the pace of its
+// assignees' combined weekly working hours (40 hours for an assignee
+// without a work schedule, and for a task without assignees); completed and
+// cancelled tasks take no time.
+namespace services {
+
+struct ForecastSettings {
+  size_t workers = 2;
+  // Runs allowed to wait for a worker.
+  size_t queueLimit = 16;
+};
+
+// Every forecast worker is busy and the queue is full.
+class ForecastOverloaded : public std::runtime_error {
+ public:
+  explicit ForecastOverloaded(int retryAfterSeconds)
+      : std::runtime_error("forecast queue is full"),
+        retryAfterSeconds_(retryAfterSeconds) {}
+
+  int retryAfterSeconds() const { return retryAfterSeconds_; }
+
+ private:
+  int retryAfterSeconds_;
+};
+
+struct ProjectForecast {
+  engine::Forecast forecast;  // minutes from the start of `today`
+  int64_t today = 0;          // days since 1970-01-01
+  std::optional<int64_t> dueDay;
+};
+
+class ForecastService {
+ public:
+  ForecastService();
+
+  // Starts the workers; called once from main before the app runs.
+  void start(const ForecastSettings& settings);
+
+  // The forecast of `projectId` over `trials` trials, or null when there is
+  // no such task. Cycles give a forecast without trials. Throws
+  // ForecastOverloaded when the run cannot be queued.
+  drogon::Task<std::shared_ptr<const ProjectForecast>> forecast(
+      std::string projectId, uint32_t trials);
+
+  // A task, assignment, dependency or working-hours write was committed.
+  void changed();
+
+ private:
+  drogon::Task<std::shared_ptr<const ProjectForecast>> run(
+      engine::Uuid root, uint32_t trials);
+
+  // A run other requests for the same project and trials can wait for.
+  struct InFlight;
+  class InFlightAwaiter;
+
+  struct Entry {
+    std::shared_ptr<const ProjectForecast> forecast;
+    uint32_t trials = 0;
+    int64_t day = 0;  // UTC day it was made on; releases move with it
+    uint64_t lastUsed = 0;
+  };
+
+  std::mutex mutex_;
+  std::unordered_map<engine::Uuid, Entry, engine::UuidHash> forecasts_;
+  std::unordered_map<engine::Uuid, std::shared_ptr<InFlight>,
+                     engine::UuidHash>
+      inFlight_;
+  uint64_t clock_ = 0;
+  uint64_t generation_ = 0;
+  WorkerPool pool_;
+
+  metrics::Histogram& latency_;
+  metrics::Counter& hits_;
+  metrics::Counter& misses_;
+  metrics::Counter& shared_;
+};
+
+ForecastService& forecasts();
+
+}  // namespace services
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <drogon/utils/coroutine.h>
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+#include "metrics/Metrics.hpp"
+#include "services/WorkerPool.hpp"
+
+// bcrypt runs on its own small thread pool so a burst of logins cannot stall
+// the IO threads. The queue in front of it is bounded; when it is full the
+// caller gets HasherOverloaded right away instead of waiting.
+namespace services {
+
+struct PasswordHasherSettings {
+  size_t workers = 2;
+  // Jobs allowed to wait for a worker.
+  size_t queueLimit = 256;
+  // bcrypt work factor for new hashes; existing hashes keep their own.
+  unsigned cost = 10;
+};
+
+class HasherOverloaded : public std::runtime_error {
+ public:
+  explicit HasherOverloaded(int retryAfterSeconds)
+      : std::runtime_error("password hashing queue is full"),
+        retryAfterSeconds_(retryAfterSeconds) {}
+
+  // Rough time for the current backlog to drain.
+  int retryAfterSeconds() const { return retryAfterSeconds_; }
+
+ private:
+  int retryAfterSeconds_;
+};
+
+class PasswordHasher {
+ public:
+  PasswordHasher();
+
+  PasswordHasher(const PasswordHasher&) = delete;
+  PasswordHasher& operator=(const PasswordHasher&) = delete;
+
+  // Starts the workers; called once from main before the app runs.
+  void start(const PasswordHasherSettings& settings);
+
+  // Both resume on the calling IO loop and throw HasherOverloaded when the
+  // queue is full.
+  drogon::Task<std::string> hash(std::string password);
+  drogon::Task<bool> verify(std::string password, std::string hash);
+
+  int retryAfterSeconds() const;
+
+ private:
+  PasswordHasherSettings settings_;
+  WorkerPool pool_;
+
+  metrics::Histogram& hashLatency_;
+  metrics::Histogram& verifyLatency_;
+};
+
+PasswordHasher& passwords();
+
+}  // namespace services
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <drogon/utils/coroutine.h>
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "engine/PermissionEngine.hpp"
+#include "metrics/Metrics.hpp"
+
+// Keeps the permission engine in sync with the database. The whole model is
+// loaded at startup and periodically after that; handlers report their own
+// writes through the hooks below so checks see them immediately, and tasks
+// missing from the snapshot are loaded on first use.
+namespace services {
+
+// A task written together with the roles granted on it, for bulk hooks.
+struct CreatedTask {
+  std::string id;
+  std::string parentId;  // empty for a root task
+  std::vector<std::pair<std::string, std::string>> roles;  // user id, role
+};
+
+class PermissionService {
+ public:
+  PermissionService();
+
+  // Schedules the first load once the event loop is running and a full
+  // reload every `reloadSeconds` after that.
+  void start(double reloadSeconds);
+
+  drogon::Task<> reload();
+
+  // Whether `userId` holds permission `key` on `taskId` or one of its
+  // ancestors. Unknown or malformed ids are denied.
+  drogon::Task<bool> check(std::string userId, std::string taskId,
+                           std::string key);
+
+  // Hooks for committed writes. Ids that fail to parse are ignored; the next
+  // reload picks the change up anyway.
+  void taskCreated(const std::string& taskId, const std::string& parentId,
+                   const std::string& createdBy);
+  // taskCreated and roleGranted for many tasks in one snapshot update.
+  void tasksCreated(const std::vector<CreatedTask>& tasks,
+                    const std::string& createdBy);
+  void taskDeleted(const std::string& taskId);
+  void taskMoved(const std::string& taskId, const std::string& parentId);
+  void roleGranted(const std::string& taskId, const std::string& userId,
+                   const std::string& role);
+  void rolesRevoked(const std::string& taskId, const std::string& userId);
+
+  const engine::PermissionEngine& engine() const { return engine_; }
+
+ private:
+  // Loads `taskId` and its ancestors into the snapshot.
+  drogon::Task<> loadTask(std::string taskId);
+  // Applies a hook. Hooks that arrive while a reload is reading the tables
+  // are replayed on top of the loaded state, so the reload cannot undo them.
+  void apply(std::function<void()> op);
+
+  engine::PermissionEngine engine_;
+  std::mutex pendingMutex_;
+  bool reloading_ = false;
+  std::vector<std::function<void()>> pending_;
+
+  metrics::Counter& reloads_;
+  metrics::Counter& reloadFailures_;
+  metrics::Counter& misses_;
+};
+
+PermissionService& permissions();
+
+}  // namespace services
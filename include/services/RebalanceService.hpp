@@ -0,0 +1,40 @@
+#pragma once
+
+#include <drogon/utils/coroutine.h>
+
+#include <cstddef>
+#include <string>
+
+#include "metrics/Metrics.hpp"
+
+// Turns a project's overallocation suggestions into proposed moves. Over
+// the next three months, every team member's day has a capacity: their free
+// working time from user_work_schedule, capped by what project_allocation
+// still leaves them. Hours booked above the limit are moved by
+// engine::rebalance to days with capacity, either to teammates or to the
+// same user. Lower-priority tasks are moved first, and by as few days as
+// possible. The moves are written into the payload of the matching
+// 'suggested' daily_hours rows as
+//
+//   "moves": [{"task_id", "from_user_id", "from_date",
+//              "to_user_id", "to_date", "hours"}]
+//
+// and are empty when nothing fits.
+namespace services {
+
+class RebalanceService {
+ public:
+  RebalanceService();
+
+  // Recomputes the moves of `projectId`, a root task, and returns the
+  // number of suggestions updated.
+  drogon::Task<size_t> rebalanceProject(std::string projectId);
+
+ private:
+  metrics::Histogram& latency_;
+  metrics::Counter& moves_;
+};
+
+RebalanceService& rebalancing();
+
+}  // namespace services
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <drogon/utils/coroutine.h>
+
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "db/Transaction.hpp"
+#include "metrics/Metrics.hpp"
+
+// Subtree totals of estimated_hours, task_assignment.assigned_hours and
+// task_schedule.hours for every task, kept in task_rollup (migration 005).
+//
+// Writers never update an ancestor's row. Inside their own transaction they
+// append one task_rollup_delta row per affected task and ancestor, so
+// concurrent writes under the same busy parent do not queue on its row
+// lock. A timer folds the deltas into task_rollup in batches, one UPDATE
+// per task however many writes touched it. Readers add the task's pending
+// deltas to its task_rollup row (kCurrentSql).
+namespace services {
+
+// Change of one task's own hours, applied to it and all of its ancestors.
+struct RollupDelta {
+  std::string taskId;
+  double estimatedHours = 0;
+  double assignedHours = 0;
+  double scheduledHours = 0;
+};
+
+class RollupService {
+ public:
+  // Joined into task queries that alias the task as `t`; adds
+  // subtree_estimated_hours, subtree_assigned_hours and
+  // subtree_scheduled_hours through the alias `ru`.
+  static const char* const kCurrentSql;
+
+  RollupService();
+
+  // Once the event loop runs, folds up to `batch` deltas every
+  // `intervalSeconds` until none are left.
+  void start(double intervalSeconds, size_t batch);
+
+  // Queue the statements on the writer's pipeline. Ancestors come from
+  // task_closure, so the task's closure rows must be in place (or not yet
+  // moved, for detach). Deltas with nothing to add are skipped.
+  void add(db::Pipeline& writes, const std::vector<RollupDelta>& deltas);
+  // Records subtree totals computed by the caller for tasks created in the
+  // same transaction, leaving their ancestors alone; the totals of the
+  // created roots still have to be add()ed to the tree they hang from.
+  void seed(db::Pipeline& writes, const std::vector<RollupDelta>& totals);
+  // Takes the subtree of `taskId` off its ancestors' totals; queue it before
+  // the task is deleted or moved away.
+  void detach(db::Pipeline& writes, const std::string& taskId);
+  // Adds the subtree of `taskId` to the totals of its (new) ancestors.
+  void attach(db::Pipeline& writes, const std::string& taskId);
+
+  // Folds one batch now and returns the number of deltas folded.
+  drogon::Task<size_t> fold();
+
+ private:
+  drogon::Task<> drain();
+
+  std::mutex mutex_;
+  bool draining_ = false;
+  size_t batch_ = 10000;
+
+  metrics::Histogram& foldLatency_;
+  metrics::Counter& folded_;
+  metrics::Counter& failures_;
+};
+
+RollupService& rollups();
+
+}  // namespace services
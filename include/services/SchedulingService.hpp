@@ -0,0 +1,64 @@
+#pragma once
+
+#include <drogon/utils/coroutine.h>
+
+#include <string>
+#include <vector>
+
+#include "metrics/Metrics.hpp"
+
+// Fills task_schedule from task_assignment.assigned_hours and the
+// assignees' user_work_schedule windows using engine::AutoScheduler. Only
+// rows with auto_placed = true starting today or later are ever written or
+// replaced; blocks placed by hand stay where they are, count as busy time,
+// and count towards the hours of their own assignment, as do past blocks.
+// Auto-placed blocks of less important work of the same users in the run's
+// range are re-placed with the run, so urgent work can take their time.
+namespace services {
+
+struct UnplacedAssignment {
+  std::string taskId;
+  std::string userId;
+  double missingHours = 0;
+};
+
+struct ScheduleReport {
+  size_t assignments = 0;
+  size_t blocks = 0;
+  // Assignments whose hours did not fit before the task's due date.
+  std::vector<UnplacedAssignment> unplaced;
+};
+
+class SchedulingService {
+ public:
+  SchedulingService();
+
+  // Re-places every assignment on `rootTaskId` and its subtasks.
+  drogon::Task<ScheduleReport> scheduleTaskTree(std::string rootTaskId);
+
+  // Incremental re-placement after a change. Only assignments that already
+  // have auto-placed blocks are touched, and only their blocks from today on
+  // are dropped and placed again.
+  //
+  // rescheduleTask() follows a change of the task's dates or hours;
+  // rescheduleUser() follows a rewrite of the user's work schedule and
+  // covers the user's open assignments.
+  drogon::Task<ScheduleReport> rescheduleTask(std::string taskId);
+  drogon::Task<ScheduleReport> rescheduleUser(std::string userId);
+
+ private:
+  // Re-places the assignments returned by `selectSql`, which takes one
+  // parameter and yields task_id, user_id, hours, start_day, due_day and
+  // today (days since 1970-01-01). Runs in one transaction; concurrent runs are
+  // serialized so they cannot book the same free time twice.
+  drogon::Task<ScheduleReport> run(std::string selectSql, std::string param);
+
+  metrics::Histogram& runLatency_;
+  metrics::Counter& blocksPlaced_;
+  metrics::Counter& taskReschedules_;
+  metrics::Counter& userReschedules_;
+};
+
+SchedulingService& scheduling();
+
+}  // namespace services
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <drogon/utils/coroutine.h>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "engine/Uuid.hpp"
+#include "engine/WhatIf.hpp"
+#include "metrics/Metrics.hpp"
+
+// What-if simulations of a project. The project's plan is frozen into an
+// engine::PlanBaseline once, and every simulation request layers its edits
+// on that shared copy in an engine::Scenario. Nothing is written back. The
+// baseline of a project is reused until the next write that can change
+// it: writers call changed() after committing.
+namespace services {
+
+struct ProjectPlan {
+  explicit ProjectPlan(engine::PlanBaseline b) : baseline(std::move(b)) {}
+
+  engine::PlanBaseline baseline;
+  std::vector<engine::Uuid> taskIds;  // node index -> task id
+  std::unordered_map<engine::Uuid, uint32_t, engine::UuidHash> taskIndex;
+  std::vector<std::string> userIds;
+  std::unordered_map<std::string, uint32_t> userIndex;
+  uint64_t lastUsed = 0;
+};
+
+class SimulationService {
+ public:
+  SimulationService();
+
+  // The frozen plan of `projectId`, or null when there is no such task.
+  drogon::Task<std::shared_ptr<const ProjectPlan>> plan(std::string projectId);
+
+  // A task, assignment, dependency or working-hours write was committed.
+  void changed();
+
+ private:
+  drogon::Task<std::shared_ptr<const ProjectPlan>> load(engine::Uuid root);
+
+  std::mutex mutex_;
+  std::unordered_map<engine::Uuid, std::shared_ptr<ProjectPlan>,
+                     engine::UuidHash>
+      plans_;
+  uint64_t clock_ = 0;
+  uint64_t generation_ = 0;
+
+  metrics::Histogram& loadLatency_;
+  metrics::Counter& hits_;
+  metrics::Counter& misses_;
+};
+
+SimulationService& simulations();
+
+}  // namespace services
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <drogon/utils/coroutine.h>
+#include <trantor/net/EventLoop.h>
+
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "metrics/Metrics.hpp"
+
+// A fixed set of threads behind a bounded queue, for CPU-bound work that has
+// to stay off the IO loops. A job that finds the queue full is refused
+// instead of waiting.
+namespace services {
+
+class WorkerPool {
+ public:
+  // `prefix` names the pool's metrics (<prefix>_queue_depth,
+  // _queue_wait_seconds, _busy_workers, _rejected_total, _workers) and
+  // `what` starts their help text.
+  WorkerPool(const std::string& prefix, const std::string& what);
+  ~WorkerPool();
+
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+  // Starts the workers; called once from main before the app runs.
+  void start(size_t workers, size_t queueLimit);
+
+  // Queues `job` unless the queue is full.
+  bool tryEnqueue(std::function<void()> job);
+
+  // Rough time for the current backlog to drain at `secondsPerJob`.
+  int retryAfterSeconds(double secondsPerJob) const;
+
+  size_t workers() const { return workers_.size(); }
+
+ private:
+  void workerLoop();
+
+  std::string prefix_;
+  std::string what_;
+  size_t queueLimit_ = 0;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::deque<std::function<void()>> queue_;
+  std::vector<std::thread> workers_;
+  bool stopping_ = false;
+
+  metrics::Gauge& queueDepth_;
+  metrics::Gauge& busy_;
+  metrics::Histogram& queueWait_;
+  metrics::Counter& rejected_;
+};
+
+// Runs `job` on `pool` and resumes the awaiting coroutine on the event loop
+// it was suspended on. When the queue is full, co_await throws what
+// `rejected` returns without suspending.
+template <typename T>
+class PoolAwaiter : public drogon::CallbackAwaiter<T> {
+ public:
+  PoolAwaiter(WorkerPool& pool, std::function<T()> job,
+              std::function<std::exception_ptr()> rejected)
+      : pool_(pool), job_(std::move(job)), rejected_(std::move(rejected)) {}
+
+  bool await_suspend(std::coroutine_handle<> handle) {
+    trantor::EventLoop* loop =
+        trantor::EventLoop::getEventLoopOfCurrentThread();
+    const bool queued =
+        pool_.tryEnqueue([this, handle, loop, job = std::move(job_)] {
+          try {
+            this->setValue(job());
+          } catch (...) {
+            this->setException(std::current_exception());
+          }
+          if (loop)
+            loop->queueInLoop([handle] { handle.resume(); });
+          else
+            handle.resume();
+        });
+    if (!queued) {
+      this->setException(rejected_());
+      return false;
+    }
+    return true;
+  }
+
+ private:
+  WorkerPool& pool_;
+  std::function<T()> job_;
+  std::function<std::exception_ptr()> rejected_;
+};
+
+}  // namespace services
@@ -0,0 +1,18 @@
+-- ============================================================================
+-- Project Calendar - Keyset pagination indexes
+-- ============================================================================
+
+-- ============================================================================
+-- INDEXES: task listing
+-- Курсорная пагинация по (created_at, id) для /api/tasks и подзадач
+-- ============================================================================
+
+-- Обход задач в порядке выдачи с проверкой назначения по индексу
+CREATE INDEX IF NOT EXISTS idx_task_created_at_id
+    ON task(created_at DESC, id DESC);
+CREATE INDEX IF NOT EXISTS idx_task_assignment_user_id_task_id
+    ON task_assignment(user_id, task_id);
+
+-- Подзадачи одного родителя в порядке выдачи
+CREATE INDEX IF NOT EXISTS idx_task_parent_created_at_id
+    ON task(parent_task_id, created_at DESC, id DESC);
@@ -0,0 +1,19 @@
+-- ============================================================================
+-- Project Calendar - Conflict scanner
+-- ============================================================================
+
+-- ============================================================================
+-- INDEXES: conflict_resolution
+-- Фоновый сканер расписаний помечает свои предложения ключом payload->>'key'
+-- ============================================================================
+
+-- Одно открытое предложение на конфликт
+CREATE UNIQUE INDEX IF NOT EXISTS idx_conflict_resolution_suggested_key
+    ON conflict_resolution ((payload->>'key'))
+    WHERE status = 'suggested';
+
+-- Поиск уже рассмотренных предложений и открытых предложений пользователя
+CREATE INDEX IF NOT EXISTS idx_conflict_resolution_key
+    ON conflict_resolution ((payload->>'key'));
+CREATE INDEX IF NOT EXISTS idx_conflict_resolution_target_user_status
+    ON conflict_resolution (target_user_id, status);
@@ -0,0 +1,58 @@
+-- ============================================================================
+-- Project Calendar - Subtree rollups
+-- ============================================================================
+
+-- ============================================================================
+-- TABLE: task_rollup
+-- Суммы по поддереву задачи (сама задача и все потомки): estimated_hours,
+-- task_assignment.assigned_hours и task_schedule.hours
+-- ============================================================================
+
+CREATE TABLE IF NOT EXISTS task_rollup (
+    task_id UUID PRIMARY KEY REFERENCES task(id) ON DELETE CASCADE,
+    estimated_hours NUMERIC(14,2) NOT NULL DEFAULT 0,
+    assigned_hours NUMERIC(14,2) NOT NULL DEFAULT 0,
+    scheduled_hours NUMERIC(14,2) NOT NULL DEFAULT 0
+);
+
+-- ============================================================================
+-- TABLE: task_rollup_delta
+-- Изменения сумм, ещё не перенесённые в task_rollup. Запись добавляет строку
+-- на задачу и каждого предка вместо UPDATE общих родителей; фоновая свёртка
+-- переносит их пачками, по одному UPDATE на задачу. Текущее значение -
+-- task_rollup плюс сумма строк задачи здесь.
+-- ============================================================================
+
+CREATE TABLE IF NOT EXISTS task_rollup_delta (
+    id BIGSERIAL PRIMARY KEY,
+    task_id UUID NOT NULL REFERENCES task(id) ON DELETE CASCADE,
+    estimated_hours NUMERIC(14,2) NOT NULL DEFAULT 0,
+    assigned_hours NUMERIC(14,2) NOT NULL DEFAULT 0,
+    scheduled_hours NUMERIC(14,2) NOT NULL DEFAULT 0
+);
+
+CREATE INDEX IF NOT EXISTS idx_task_rollup_delta_task_id
+    ON task_rollup_delta(task_id);
+
+-- Начальное заполнение по существующему дереву
+WITH RECURSIVE pairs AS (
+    SELECT id AS ancestor, id AS descendant FROM task
+    UNION ALL
+    SELECT p.ancestor, t.id
+    FROM pairs p JOIN task t ON t.parent_task_id = p.descendant
+), own AS (
+    SELECT t.id,
+           COALESCE(t.estimated_hours, 0) AS estimated_hours,
+           COALESCE((SELECT sum(a.assigned_hours) FROM task_assignment a
+                     WHERE a.task_id = t.id), 0) AS assigned_hours,
+           COALESCE((SELECT sum(s.hours) FROM task_schedule s
+                     WHERE s.task_id = t.id), 0) AS scheduled_hours
+    FROM task t
+)
+INSERT INTO task_rollup (task_id, estimated_hours, assigned_hours,
+                         scheduled_hours)
+SELECT p.ancestor, sum(o.estimated_hours), sum(o.assigned_hours),
+       sum(o.scheduled_hours)
+FROM pairs p JOIN own o ON o.id = p.descendant
+GROUP BY p.ancestor
+ON CONFLICT (task_id) DO NOTHING;
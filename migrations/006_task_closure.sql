@@ -0,0 +1,32 @@
+-- ============================================================================
+-- Project Calendar - Task hierarchy closure
+-- ============================================================================
+
+-- ============================================================================
+-- TABLE: task_closure
+-- Все пары (предок, потомок) дерева задач, включая саму задачу с depth = 0.
+-- Поддерево и цепочка предков читаются одним индексным запросом вместо
+-- рекурсии по parent_task_id
+-- ============================================================================
+
+CREATE TABLE IF NOT EXISTS task_closure (
+    ancestor UUID NOT NULL REFERENCES task(id) ON DELETE CASCADE,
+    descendant UUID NOT NULL REFERENCES task(id) ON DELETE CASCADE,
+    depth INTEGER NOT NULL CHECK (depth >= 0),
+    PRIMARY KEY (ancestor, descendant)
+);
+
+-- Предки задачи (перенос поддерева, суммы по предкам)
+CREATE INDEX IF NOT EXISTS idx_task_closure_descendant_depth
+    ON task_closure(descendant, depth);
+
+-- Начальное заполнение по существующему дереву
+WITH RECURSIVE pairs AS (
+    SELECT id AS ancestor, id AS descendant, 0 AS depth FROM task
+    UNION ALL
+    SELECT p.ancestor, t.id, p.depth + 1
+    FROM pairs p JOIN task t ON t.parent_task_id = p.descendant
+)
+INSERT INTO task_closure (ancestor, descendant, depth)
+SELECT ancestor, descendant, depth FROM pairs
+ON CONFLICT (ancestor, descendant) DO NOTHING;
@@ -0,0 +1,19 @@
+-- ============================================================================
+-- Project Calendar - project_root_id backfill
+-- ============================================================================
+
+-- ============================================================================
+-- TABLE: task
+-- project_root_id - корень дерева задачи (для корня - сама задача).
+-- Ведётся при создании и переносе задач; здесь заполняется для
+-- существующих строк по task_closure
+-- ============================================================================
+
+UPDATE task t SET project_root_id = top.ancestor
+FROM (
+    SELECT DISTINCT ON (descendant) descendant, ancestor
+    FROM task_closure
+    ORDER BY descendant, depth DESC
+) top
+WHERE t.id = top.descendant
+  AND t.project_root_id IS DISTINCT FROM top.ancestor;
@@ -2,24 +2,23 @@
 
 #include <drogon/drogon.h>
 #include <drogon/orm/DbClient.h>
-#include <drogon/orm/Mapper.h>
+#include <drogon/orm/CoroMapper.h>
 #include <drogon/orm/Result.h>
 #include <json/json.h>
 #include <jwt-cpp/jwt.h>
 #include <trantor/utils/Logger.h>
 
 #include <algorithm>
-#include <bcrypt.h>
 #include <cctype>
 #include <exception>
 #include <functional>
 #include <utility>
 
+#include "db/Transaction.hpp"
 #include "models/AppUser.hpp"
-#include "models/UserWorkSchedule.hpp"
+#include "services/PasswordHasher.hpp"
 
 using drogon_model::project_calendar::AppUser;
-using drogon_model::project_calendar::UserWorkSchedule;
 
 static bool containsCaseInsensitive(const std::string& hay,
                                     const std::string& needle) {
@@ -32,15 +31,21 @@ static bool containsCaseInsensitive(const std::string& hay,
   return it != hay.end();
 }
 
-void AuthController::registerUser(
-    const HttpRequestPtr& req,
-    std::function<void(const HttpResponsePtr&)>&& callback) {
+static HttpResponsePtr overloadedResponse(
+    const services::HasherOverloaded& e) {
+  auto resp = HttpResponse::newHttpJsonResponse(
+      Json::Value("Too many authentication requests, retry later"));
+  resp->setStatusCode(k503ServiceUnavailable);
+  resp->addHeader("Retry-After", std::to_string(e.retryAfterSeconds()));
+  return resp;
+}
+
+Task<HttpResponsePtr> AuthController::registerUser(HttpRequestPtr req) {
   auto jsonPtr = req->getJsonObject();
   if (!jsonPtr || !jsonPtr->isObject()) {
     auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Invalid JSON"));
     resp->setStatusCode(k400BadRequest);
-    callback(resp);
-    return;
+    co_return resp;
   }
   const Json::Value& j = *jsonPtr;
 
@@ -49,8 +54,7 @@ void AuthController::registerUser(
     auto resp = HttpResponse::newHttpJsonResponse(
         Json::Value("Missing required fields"));
     resp->setStatusCode(k400BadRequest);
-    callback(resp);
-    return;
+    co_return resp;
   }
 
   const std::string email = j["email"].asString();
@@ -69,33 +73,31 @@ void AuthController::registerUser(
     auto resp = HttpResponse::newHttpJsonResponse(
         Json::Value("Password must be at least 8 characters"));
     resp->setStatusCode(k400BadRequest);
-    callback(resp);
-    return;
+    co_return resp;
   }
 
   if (!workScheduleJson.isArray() || workScheduleJson.size() == 0) {
     auto resp = HttpResponse::newHttpJsonResponse(
         Json::Value("work_schedule must be a non-empty array"));
     resp->setStatusCode(k400BadRequest);
-    callback(resp);
-    return;
+    co_return resp;
   }
 
-  auto dbClient = app().getDbClient();
+  auto& pool = db::oltp();
   try {
-    auto res = dbClient->execSqlSync(
+    auto res = co_await pool.exec(
         "SELECT id FROM app_user WHERE email = $1 LIMIT 1", email);
     if (res.size() > 0) {
       auto resp = HttpResponse::newHttpJsonResponse(
           Json::Value("Email already exists"));
       resp->setStatusCode(k409Conflict);
-      callback(resp);
-      return;
+      co_return resp;
     }
 
-    const std::string hash = bcrypt::generateHash(password);
+    const std::string hash =
+        co_await services::passwords().hash(password);
 
-    dbClient->execSqlSync("BEGIN");
+    auto tx = co_await db::Tx::begin(pool);
 
     AppUser user;
     user.setEmail(email);
@@ -109,64 +111,62 @@ void AuthController::registerUser(
     user.setCreatedAt(::trantor::Date::now());
     user.setUpdatedAt(::trantor::Date::now());
 
-    drogon::orm::Mapper<AppUser> usersMapper(dbClient);
-    usersMapper.insert(user);
+    auto inserted =
+        co_await drogon::orm::CoroMapper<AppUser>(tx.client()).insert(user);
 
     std::string createdUserId;
     try {
-      createdUserId = user.getValueOfId();
+      createdUserId = inserted.getValueOfId();
     } catch (...) {
       createdUserId.clear();
     }
     if (createdUserId.empty()) {
-      auto idRes = dbClient->execSqlSync(
+      auto idRes = co_await tx.client()->execSqlCoro(
           "SELECT id FROM app_user WHERE email = $1 LIMIT 1", email);
       if (idRes.size() == 0) {
-        dbClient->execSqlSync("ROLLBACK");
         LOG_ERROR
             << "registerUser: inserted user but cannot determine id for email "
             << email;
         auto resp = HttpResponse::newHttpJsonResponse(
             Json::Value("Internal server error"));
         resp->setStatusCode(k500InternalServerError);
-        callback(resp);
-        return;
+        co_return resp;
       }
       createdUserId = idRes[0]["id"].as<std::string>();
     }
 
-    drogon::orm::Mapper<UserWorkSchedule> wsMapper(dbClient);
+    db::Pipeline scheduleInserts;
     for (Json::UInt i = 0; i < workScheduleJson.size(); ++i) {
       const Json::Value item = workScheduleJson[i];
       if (!item.isObject()) {
-        dbClient->execSqlSync("ROLLBACK");
         auto resp = HttpResponse::newHttpJsonResponse(
             Json::Value("Invalid work_schedule item"));
         resp->setStatusCode(k400BadRequest);
-        callback(resp);
-        return;
+        co_return resp;
       }
       if (!item.isMember("weekday")) {
-        dbClient->execSqlSync("ROLLBACK");
         auto resp = HttpResponse::newHttpJsonResponse(
             Json::Value("Each work_schedule item must contain weekday"));
         resp->setStatusCode(k400BadRequest);
-        callback(resp);
-        return;
-      }
-      UserWorkSchedule ws;
-      ws.setUserId(createdUserId);
-      ws.setWeekday(static_cast<int32_t>(item["weekday"].asInt()));
-      if (item.isMember("start_time") && item["start_time"].isString()) {
-        ws.setStartTime(item["start_time"].asString());
-      }
-      if (item.isMember("end_time") && item["end_time"].isString()) {
-        ws.setEndTime(item["end_time"].asString());
+        co_return resp;
       }
-      wsMapper.insert(ws);
+      const std::string startTime =
+          item.isMember("start_time") && item["start_time"].isString()
+              ? item["start_time"].asString()
+              : std::string();
+      const std::string endTime =
+          item.isMember("end_time") && item["end_time"].isString()
+              ? item["end_time"].asString()
+              : std::string();
+      scheduleInserts.add(
+          "INSERT INTO user_work_schedule (user_id, weekday, start_time, "
+          "end_time) VALUES ($1, $2::int, NULLIF($3, '')::time, "
+          "NULLIF($4, '')::time)",
+          createdUserId, std::to_string(item["weekday"].asInt()), startTime,
+          endTime);
     }
-
-    dbClient->execSqlSync("COMMIT");
+    co_await scheduleInserts.run(tx.client());
+    co_await tx.commit();
 
     const char* envSecret = std::getenv("JWT_SECRET");
     const std::string secret = envSecret ? envSecret : "secret_key";
@@ -193,13 +193,11 @@ void AuthController::registerUser(
 
     auto resp = HttpResponse::newHttpJsonResponse(response);
     resp->setStatusCode(k201Created);
-    callback(resp);
-    return;
+    co_return resp;
+  } catch (const services::HasherOverloaded& e) {
+    LOG_WARN << "registerUser rejected: " << e.what();
+    co_return overloadedResponse(e);
   } catch (const std::exception& e) {
-    try {
-      dbClient->execSqlSync("ROLLBACK");
-    } catch (...) {
-    }
     const std::string what = e.what() ? e.what() : std::string();
     if (containsCaseInsensitive(what, "duplicate") ||
         containsCaseInsensitive(what, "unique")) {
@@ -207,27 +205,22 @@ void AuthController::registerUser(
       auto resp = HttpResponse::newHttpJsonResponse(
           Json::Value("Email already exists"));
       resp->setStatusCode(k409Conflict);
-      callback(resp);
-      return;
+      co_return resp;
     }
     LOG_ERROR << "registerUser failed: " << what;
     auto resp =
         HttpResponse::newHttpJsonResponse(Json::Value("Internal server error"));
     resp->setStatusCode(k500InternalServerError);
-    callback(resp);
-    return;
+    co_return resp;
   }
 }
 
-void AuthController::login(
-    const HttpRequestPtr& req,
-    std::function<void(const HttpResponsePtr&)>&& callback) {
+Task<HttpResponsePtr> AuthController::login(HttpRequestPtr req) {
   auto jsonPtr = req->getJsonObject();
   if (!jsonPtr || !jsonPtr->isObject()) {
     auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Invalid JSON"));
     resp->setStatusCode(k400BadRequest);
-    callback(resp);
-    return;
+    co_return resp;
   }
   const Json::Value& j = *jsonPtr;
 
@@ -235,116 +228,94 @@ void AuthController::login(
     auto resp = HttpResponse::newHttpJsonResponse(
         Json::Value("Missing email or password"));
     resp->setStatusCode(k400BadRequest);
-    callback(resp);
-    return;
+    co_return resp;
   }
 
   const std::string email = j["email"].asString();
   const std::string password = j["password"].asString();
 
-  auto dbClient = app().getDbClient();
-
-  auto callbackCopy = std::move(callback);
-
-  std::function<void(const drogon::orm::Result&)> loginResultCb =
-      [callbackCopy, password](const drogon::orm::Result& r) mutable {
-        try {
-          if (r.size() == 0) {
-            auto resp =
-                HttpResponse::newHttpJsonResponse(Json::Value("Unauthorized"));
-            resp->setStatusCode(k401Unauthorized);
-            callbackCopy(resp);
-            return;
-          }
-
-          const auto& row = r[0];
-          if (row["password_hash"].isNull()) {
-            auto resp =
-                HttpResponse::newHttpJsonResponse(Json::Value("Unauthorized"));
-            resp->setStatusCode(k401Unauthorized);
-            callbackCopy(resp);
-            return;
-          }
-          const std::string passHash = row["password_hash"].as<std::string>();
-
-          bool ok = bcrypt::validatePassword(password, passHash);
-          if (!ok) {
-            auto resp =
-                HttpResponse::newHttpJsonResponse(Json::Value("Unauthorized"));
-            resp->setStatusCode(k401Unauthorized);
-            callbackCopy(resp);
-            return;
-          }
-
-          const char* envSecret = std::getenv("JWT_SECRET");
-          const std::string secret =
-              envSecret ? envSecret : "replace_with_real_secret";
-
-          using namespace std::chrono;
-          auto now = system_clock::now();
-          auto expires = now + hours(24);
-
-          const std::string userId =
-              row["id"].isNull() ? std::string() : row["id"].as<std::string>();
-          const std::string displayName =
-              row["display_name"].isNull()
-                  ? std::string()
-                  : row["display_name"].as<std::string>();
-          const std::string emailVal = row["email"].isNull()
-                                           ? std::string()
-                                           : row["email"].as<std::string>();
-
-          auto token =
-              jwt::create()
-                  .set_issued_at(now)
-                  .set_expires_at(expires)
-                  .set_type("JWT")
-                  .set_issuer("project-calendar")
-                  .set_payload_claim("sub", jwt::claim(userId))
-                  .set_payload_claim("display_name", jwt::claim(displayName))
-                  .set_payload_claim("email", jwt::claim(emailVal))
-                  .sign(jwt::algorithm::hs256{secret});
-
-          Json::Value respJson;
-          respJson["token"] = token;
-          Json::Value userJson;
-          userJson["id"] = userId;
-          if (!displayName.empty()) userJson["display_name"] = displayName;
-          if (!emailVal.empty()) userJson["email"] = emailVal;
-          respJson["user"] = userJson;
-
-          auto resp = HttpResponse::newHttpJsonResponse(respJson);
-          resp->setStatusCode(k200OK);
-          callbackCopy(resp);
-        } catch (const std::exception& ex) {
-          LOG_ERROR << "login handler failed: " << ex.what();
-          auto resp = HttpResponse::newHttpJsonResponse(
-              Json::Value("Internal server error"));
-          resp->setStatusCode(k500InternalServerError);
-          callbackCopy(resp);
-        }
-      };
-
-  auto exceptPtrCb = [](const std::exception_ptr& ep) {
-    try {
-      if (ep) std::rethrow_exception(ep);
-    } catch (const std::exception& e) {
-      LOG_WARN << "DB error in execSqlAsync (login): " << e.what();
-    } catch (...) {
-      LOG_WARN << "Unknown DB error in execSqlAsync (login)";
+  auto& pool = db::oltp();
+
+  try {
+    auto r = co_await pool.exec(
+        "SELECT id, password_hash, display_name, email, created_at::text AS "
+        "created_at, updated_at::text AS updated_at "
+        "FROM app_user WHERE email = $1 LIMIT 1",
+        email);
+    if (r.size() == 0) {
+      auto resp =
+          HttpResponse::newHttpJsonResponse(Json::Value("Unauthorized"));
+      resp->setStatusCode(k401Unauthorized);
+      co_return resp;
     }
-  };
 
-  dbClient->execSqlAsync(
-      "SELECT id, password_hash, display_name, email, created_at::text AS "
-      "created_at, updated_at::text AS updated_at "
-      "FROM app_user WHERE email = $1 LIMIT 1",
-      std::move(loginResultCb), exceptPtrCb, email);
+    const auto& row = r[0];
+    if (row["password_hash"].isNull()) {
+      auto resp =
+          HttpResponse::newHttpJsonResponse(Json::Value("Unauthorized"));
+      resp->setStatusCode(k401Unauthorized);
+      co_return resp;
+    }
+    const std::string passHash = row["password_hash"].as<std::string>();
+
+    bool ok = co_await services::passwords().verify(password, passHash);
+    if (!ok) {
+      auto resp =
+          HttpResponse::newHttpJsonResponse(Json::Value("Unauthorized"));
+      resp->setStatusCode(k401Unauthorized);
+      co_return resp;
+    }
+
+    const char* envSecret = std::getenv("JWT_SECRET");
+    const std::string secret =
+        envSecret ? envSecret : "replace_with_real_secret";
+
+    using namespace std::chrono;
+    auto now = system_clock::now();
+    auto expires = now + hours(24);
+
+    const std::string userId =
+        row["id"].isNull() ? std::string() : row["id"].as<std::string>();
+    const std::string displayName =
+        row["display_name"].isNull() ? std::string()
+                                     : row["display_name"].as<std::string>();
+    const std::string emailVal =
+        row["email"].isNull() ? std::string() : row["email"].as<std::string>();
+
+    auto token = jwt::create()
+                     .set_issued_at(now)
+                     .set_expires_at(expires)
+                     .set_type("JWT")
+                     .set_issuer("project-calendar")
+                     .set_payload_claim("sub", jwt::claim(userId))
+                     .set_payload_claim("display_name", jwt::claim(displayName))
+                     .set_payload_claim("email", jwt::claim(emailVal))
+                     .sign(jwt::algorithm::hs256{secret});
+
+    Json::Value respJson;
+    respJson["token"] = token;
+    Json::Value userJson;
+    userJson["id"] = userId;
+    if (!displayName.empty()) userJson["display_name"] = displayName;
+    if (!emailVal.empty()) userJson["email"] = emailVal;
+    respJson["user"] = userJson;
+
+    auto resp = HttpResponse::newHttpJsonResponse(respJson);
+    resp->setStatusCode(k200OK);
+    co_return resp;
+  } catch (const services::HasherOverloaded& e) {
+    LOG_WARN << "login rejected: " << e.what();
+    co_return overloadedResponse(e);
+  } catch (const std::exception& ex) {
+    LOG_ERROR << "login handler failed: " << ex.what();
+    auto resp =
+        HttpResponse::newHttpJsonResponse(Json::Value("Internal server error"));
+    resp->setStatusCode(k500InternalServerError);
+    co_return resp;
+  }
 }
 
-void AuthController::me(
-    const HttpRequestPtr& req,
-    std::function<void(const HttpResponsePtr&)>&& callback) {
+Task<HttpResponsePtr> AuthController::me(HttpRequestPtr req) {
   const std::string authHeader = req->getHeader("Authorization");
   const std::string bearerPrefix = "Bearer ";
   if (authHeader.size() <= bearerPrefix.size() ||
@@ -352,8 +323,7 @@ void AuthController::me(
     auto resp = HttpResponse::newHttpJsonResponse(
         Json::Value("Missing or invalid Authorization header"));
     resp->setStatusCode(k401Unauthorized);
-    callback(resp);
-    return;
+    co_return resp;
   }
 
   const std::string token = authHeader.substr(bearerPrefix.size());
@@ -361,13 +331,13 @@ void AuthController::me(
   const char* envSecret = std::getenv("JWT_SECRET");
   const std::string secret = envSecret ? envSecret : "replace_with_real_secret";
 
+  std::string userId;
   try {
     auto decoded = jwt::decode(token);
     auto verifier =
         jwt::verify().allow_algorithm(jwt::algorithm::hs256{secret});
     verifier.verify(decoded);
 
-    std::string userId;
     if (decoded.has_payload_claim("sub")) {
       userId = decoded.get_payload_claim("sub").as_string();
     } else if (decoded.has_payload_claim("user_id")) {
@@ -376,68 +346,47 @@ void AuthController::me(
       auto resp = HttpResponse::newHttpJsonResponse(
           Json::Value("Token does not contain user id"));
       resp->setStatusCode(k401Unauthorized);
-      callback(resp);
-      return;
+      co_return resp;
     }
-
-    auto dbClient = app().getDbClient();
-
-    auto callbackCopy = std::move(callback);
-
-    std::function<void(const drogon::orm::Result&)> meResultCb =
-        [callbackCopy](const drogon::orm::Result& r) {
-          try {
-            if (r.size() == 0) {
-              auto resp = HttpResponse::newHttpJsonResponse(
-                  Json::Value("User not found"));
-              resp->setStatusCode(k404NotFound);
-              callbackCopy(resp);
-              return;
-            }
-            const auto& row = r[0];
-            Json::Value userJson;
-            userJson["id"] = row["id"].as<std::string>();
-            if (!row["display_name"].isNull())
-              userJson["display_name"] = row["display_name"].as<std::string>();
-            if (!row["email"].isNull())
-              userJson["email"] = row["email"].as<std::string>();
-            if (!row["created_at"].isNull())
-              userJson["created_at"] = row["created_at"].as<std::string>();
-            if (!row["updated_at"].isNull())
-              userJson["updated_at"] = row["updated_at"].as<std::string>();
-            auto resp = HttpResponse::newHttpJsonResponse(userJson);
-            resp->setStatusCode(k200OK);
-            callbackCopy(resp);
-          } catch (const std::exception& ex) {
-            LOG_ERROR << "me handler DB callback failed: " << ex.what();
-            auto resp = HttpResponse::newHttpJsonResponse(
-                Json::Value("Internal server error"));
-            resp->setStatusCode(k500InternalServerError);
-            callbackCopy(resp);
-          }
-        };
-
-    auto exceptPtrCb = [](const std::exception_ptr& ep) {
-      try {
-        if (ep) std::rethrow_exception(ep);
-      } catch (const std::exception& e) {
-        LOG_WARN << "DB error in execSqlAsync (me): " << e.what();
-      } catch (...) {
-        LOG_WARN << "Unknown DB error in execSqlAsync (me)";
-      }
-    };
-
-    dbClient->execSqlAsync(
-        "SELECT id, display_name, email, created_at::text AS created_at, "
-        "updated_at::text AS updated_at "
-        "FROM app_user WHERE id = $1 LIMIT 1",
-        std::move(meResultCb), exceptPtrCb, userId);
-
   } catch (const std::exception& e) {
     LOG_WARN << "me token verification failed: " << e.what();
     auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Invalid token"));
     resp->setStatusCode(k401Unauthorized);
-    callback(resp);
-    return;
+    co_return resp;
+  }
+
+  auto& pool = db::oltp();
+  try {
+    auto r = co_await pool.exec(
+        "SELECT id, display_name, email, created_at::text AS created_at, "
+        "updated_at::text AS updated_at "
+        "FROM app_user WHERE id = $1 LIMIT 1",
+        userId);
+    if (r.size() == 0) {
+      auto resp =
+          HttpResponse::newHttpJsonResponse(Json::Value("User not found"));
+      resp->setStatusCode(k404NotFound);
+      co_return resp;
+    }
+    const auto& row = r[0];
+    Json::Value userJson;
+    userJson["id"] = row["id"].as<std::string>();
+    if (!row["display_name"].isNull())
+      userJson["display_name"] = row["display_name"].as<std::string>();
+    if (!row["email"].isNull())
+      userJson["email"] = row["email"].as<std::string>();
+    if (!row["created_at"].isNull())
+      userJson["created_at"] = row["created_at"].as<std::string>();
+    if (!row["updated_at"].isNull())
+      userJson["updated_at"] = row["updated_at"].as<std::string>();
+    auto resp = HttpResponse::newHttpJsonResponse(userJson);
+    resp->setStatusCode(k200OK);
+    co_return resp;
+  } catch (const std::exception& ex) {
+    LOG_ERROR << "me handler DB query failed: " << ex.what();
+    auto resp =
+        HttpResponse::newHttpJsonResponse(Json::Value("Internal server error"));
+    resp->setStatusCode(k500InternalServerError);
+    co_return resp;
   }
 }
\ No newline at end of file
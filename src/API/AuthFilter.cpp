@@ -6,79 +6,131 @@
 #include <jwt-cpp/jwt.h>
 #include <trantor/utils/Logger.h>
 
+#include <chrono>
+#include <cstdlib>
+#include <optional>
+#include <string_view>
+
 using namespace drogon;
 
+namespace {
+
+constexpr size_t kDefaultTokenCacheSize = 20000;
+
+std::string jwtSecret() {
+  const char* envSecret = std::getenv("JWT_SECRET");
+  return envSecret ? envSecret : "replace_with_real_secret";
+}
+
+// 0 disables the cache.
+size_t tokenCacheSize() {
+  const char* value = std::getenv("AUTH_TOKEN_CACHE_SIZE");
+  if (!value || !*value) return kDefaultTokenCacheSize;
+  try {
+    return std::stoul(value);
+  } catch (const std::exception&) {
+    LOG_WARN << "Ignoring invalid AUTH_TOKEN_CACHE_SIZE=" << value;
+    return kDefaultTokenCacheSize;
+  }
+}
+
+HttpResponsePtr errorResponse(const char* message, HttpStatusCode code) {
+  Json::Value j;
+  j["error"] = message;
+  auto resp = HttpResponse::newHttpJsonResponse(j);
+  resp->setStatusCode(code);
+  return resp;
+}
+
+}  // namespace
+
+AuthFilter::AuthFilter()
+    : verifier_(jwt::verify().allow_algorithm(
+          jwt::algorithm::hs256{jwtSecret()})),
+      tokens_(tokenCacheSize()),
+      cost_(metrics::registry().histogram(
+          "pc_auth_filter_seconds",
+          "Time spent authenticating a request in AuthFilter")),
+      hits_(metrics::registry().counter(
+          "pc_auth_token_cache_hits_total",
+          "Requests authenticated from the verified-token cache")),
+      misses_(metrics::registry().counter(
+          "pc_auth_token_cache_misses_total",
+          "Requests whose token had to be decoded and verified")) {
+  const engine::TokenCache* tokens = &tokens_;
+  metrics::registry().gaugeFn(
+      "pc_auth_token_cache_entries", "Verified tokens currently cached", {},
+      [tokens] { return static_cast<double>(tokens->size()); });
+}
+
 void AuthFilter::doFilter(const HttpRequestPtr& req, FilterCallback&& fcb,
                           FilterChainCallback&& fccb) {
-  const std::string auth = req->getHeader("Authorization");
-  const std::string prefix = "Bearer ";
+  const auto start = std::chrono::steady_clock::now();
+  auto reject = [&](const char* message,
+                    HttpStatusCode code = k401Unauthorized) {
+    cost_.observe(std::chrono::steady_clock::now() - start);
+    fcb(errorResponse(message, code));
+  };
+
+  const std::string& auth = req->getHeader("Authorization");
+  constexpr std::string_view prefix = "Bearer ";
   if (auth.size() <= prefix.size() ||
       auth.compare(0, prefix.size(), prefix) != 0) {
-    Json::Value j;
-    j["error"] = "Missing or invalid Authorization header";
-    auto resp = HttpResponse::newHttpJsonResponse(j);
-    resp->setStatusCode(k401Unauthorized);
-    fcb(resp);
+    reject("Missing or invalid Authorization header");
     return;
   }
 
-  const std::string token = auth.substr(prefix.size());
+  const std::string_view token = std::string_view(auth).substr(prefix.size());
+  const auto now = std::chrono::system_clock::now();
+  const int64_t nowSeconds =
+      std::chrono::duration_cast<std::chrono::seconds>(now.time_since_epoch())
+          .count();
 
-  const char* envSecret = std::getenv("JWT_SECRET");
-  const std::string secret = envSecret ? envSecret : "replace_with_real_secret";
+  std::optional<std::string> userId = tokens_.find(token, nowSeconds);
+  if (userId) {
+    hits_.inc();
+  } else {
+    misses_.inc();
+    try {
+      auto decoded = jwt::decode(std::string(token));
+      verifier_.verify(decoded);
 
-  try {
-    auto decoded = jwt::decode(token);
-
-    auto verifier =
-        jwt::verify().allow_algorithm(jwt::algorithm::hs256{secret});
-    verifier.verify(decoded);
-
-    std::string userId;
-    if (decoded.has_payload_claim("user_id")) {
-      userId = decoded.get_payload_claim("user_id").as_string();
-    } else if (decoded.has_payload_claim("sub")) {
-      userId = decoded.get_payload_claim("sub").as_string();
-    } else {
-      Json::Value j;
-      j["error"] = "Token does not contain user id";
-      auto resp = HttpResponse::newHttpJsonResponse(j);
-      resp->setStatusCode(k401Unauthorized);
-      fcb(resp);
-      return;
-    }
+      if (decoded.has_payload_claim("user_id")) {
+        userId = decoded.get_payload_claim("user_id").as_string();
+      } else if (decoded.has_payload_claim("sub")) {
+        userId = decoded.get_payload_claim("sub").as_string();
+      } else {
+        reject("Token does not contain user id");
+        return;
+      }
 
-    try {
-      req->attributes()->insert("user_id", userId);
-    } catch (const std::exception& ex) {
-      LOG_ERROR << "AuthFilter: failed to insert attribute user_id: "
-                << ex.what();
-      Json::Value j;
-      j["error"] = "Internal server error";
-      auto resp = HttpResponse::newHttpJsonResponse(j);
-      resp->setStatusCode(k500InternalServerError);
-      fcb(resp);
+      int64_t expiresAt = 0;
+      if (decoded.has_expires_at())
+        expiresAt = std::chrono::duration_cast<std::chrono::seconds>(
+                        decoded.get_expires_at().time_since_epoch())
+                        .count();
+      tokens_.insert(token, *userId, expiresAt);
+
+    } catch (const jwt::error::token_verification_exception& e) {
+      LOG_WARN << "AuthFilter token verification failed: " << e.what();
+      reject("Invalid or expired token");
+      return;
+    } catch (const std::exception& e) {
+      LOG_WARN << "AuthFilter token error: " << e.what();
+      reject("Invalid token");
       return;
     }
+  }
 
-    fccb();
-    return;
-
-  } catch (const jwt::error::token_verification_exception& e) {
-    LOG_WARN << "AuthFilter token verification failed: " << e.what();
-    Json::Value j;
-    j["error"] = "Invalid or expired token";
-    auto resp = HttpResponse::newHttpJsonResponse(j);
-    resp->setStatusCode(k401Unauthorized);
-    fcb(resp);
-    return;
-  } catch (const std::exception& e) {
-    LOG_WARN << "AuthFilter token error: " << e.what();
-    Json::Value j;
-    j["error"] = "Invalid token";
-    auto resp = HttpResponse::newHttpJsonResponse(j);
-    resp->setStatusCode(k401Unauthorized);
-    fcb(resp);
+  try {
+    req->attributes()->insert("user_id", *userId);
+  } catch (const std::exception& ex) {
+    LOG_ERROR << "AuthFilter: failed to insert attribute user_id: "
+              << ex.what();
+    reject("Internal server error", k500InternalServerError);
     return;
   }
-}
\ No newline at end of file
+
+  cost_.observe(std::chrono::steady_clock::now() - start);
+  fccb();
+}
@@ -6,30 +6,305 @@
 #include <json/json.h>
 #include <trantor/utils/Logger.h>
 
+#include <algorithm>
 #include <any>
+#include <cctype>
+#include <chrono>
 #include <exception>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
+#include "db/Literals.hpp"
+#include "db/Pools.hpp"
+#include "engine/Scheduler.hpp"
+#include "engine/Uuid.hpp"
+#include "serialization/RowJson.hpp"
+#include "services/AvailabilityService.hpp"
+#include "services/PermissionService.hpp"
+
 using namespace drogon;
 
-void CalendarController::getCalendarTasks(
-    const HttpRequestPtr& req,
-    std::function<void(const HttpResponsePtr&)>&& callback) {
+namespace {
+
+// Ranges longer than this are streamed unless the client asks otherwise.
+constexpr int kStreamThresholdDays = 31;
+// Task rows fetched and written per chunk in streaming mode.
+constexpr int kStreamBatchRows = 500;
+// Task rows one streamed response may hold; longer ranges are refused.
+constexpr int kStreamMaxRows = 50000;
+// Bounds of one availability search.
+constexpr size_t kMaxAvailabilityUsers = 200;
+constexpr int kMaxAvailabilityDays = 92;
+constexpr size_t kMaxAvailabilitySlots = 100;
+
+// Rows are ordered by a full key so streaming can resume after the last row
+// of a batch; a task appears once per assignment/role pair of the user.
+constexpr const char* kTasksSql = R"sql(
+        SELECT t.id AS task_id,
+               t.title AS title,
+               t.start_date::text AS start_date,
+               t.due_date::text   AS end_date,
+               a.assigned_hours AS allocated_hours,
+               r.role AS role,
+               a.id AS assignment_key,
+               COALESCE(r.id, '00000000-0000-0000-0000-000000000000'::uuid)
+                 AS role_key
+        FROM task t
+        JOIN task_assignment a ON a.task_id = t.id AND a.user_id = $1
+        LEFT JOIN task_role_assignment r ON r.task_id = t.id AND r.user_id = $1
+        WHERE t.start_date <= $2::date
+          AND t.due_date   >= $3::date
+      )sql";
+
+constexpr const char* kTasksOrderSql = R"sql(
+        ORDER BY t.start_date, t.title, t.id, a.id,
+                 COALESCE(r.id, '00000000-0000-0000-0000-000000000000'::uuid)
+      )sql";
+
+// Counts the users in `userIds` that share a project with `callerId`: both
+// hold a role or an assignment somewhere in the same task tree.
+constexpr const char* kSharedProjectSql = R"sql(
+        WITH mine AS (
+          SELECT COALESCE(t.project_root_id, t.id) AS root
+          FROM task t JOIN task_role_assignment r ON r.task_id = t.id
+          WHERE r.user_id = $1::uuid
+          UNION
+          SELECT COALESCE(t.project_root_id, t.id)
+          FROM task t JOIN task_assignment a ON a.task_id = t.id
+          WHERE a.user_id = $1::uuid
+        ), members AS (
+          SELECT r.user_id, COALESCE(t.project_root_id, t.id) AS root
+          FROM task t JOIN task_role_assignment r ON r.task_id = t.id
+          WHERE r.user_id = ANY($2::uuid[])
+          UNION
+          SELECT a.user_id, COALESCE(t.project_root_id, t.id)
+          FROM task t JOIN task_assignment a ON a.task_id = t.id
+          WHERE a.user_id = ANY($2::uuid[])
+        )
+        SELECT count(DISTINCT m.user_id) AS shared
+        FROM members m JOIN mine USING (root)
+      )sql";
+
+// Whether `callerId` may see the free/busy time of every user in `userIds`:
+// their own, that of people they share a project with, and anyone's while
+// planning `taskId` (empty: none) on which they may assign users.
+drogon::Task<bool> maySeeFreeBusy(std::string callerId,
+                                  std::vector<std::string> userIds,
+                                  std::string taskId) {
+  std::erase(userIds, callerId);
+  if (userIds.empty()) co_return true;
+  if (!taskId.empty())
+    co_return co_await services::permissions().check(
+        callerId, taskId, "assignment.assign.local");
+  db::ArrayLiteral users;
+  for (const auto& id : userIds) users.add(id);
+  auto shared =
+      co_await db::reports().exec(kSharedProjectSql, callerId, users.release());
+  co_return shared[0]["shared"].as<int64_t>() ==
+      static_cast<int64_t>(userIds.size());
+}
+
+bool parseDate(const std::string& s, std::chrono::sys_days& out) {
+  if (s.size() != 10 || s[4] != '-' || s[7] != '-') return false;
+  try {
+    const std::chrono::year_month_day ymd{
+        std::chrono::year{std::stoi(s.substr(0, 4))},
+        std::chrono::month{static_cast<unsigned>(std::stoi(s.substr(5, 2)))},
+        std::chrono::day{static_cast<unsigned>(std::stoi(s.substr(8, 2)))}};
+    if (!ymd.ok()) return false;
+    out = std::chrono::sys_days{ymd};
+    return true;
+  } catch (...) {
+    return false;
+  }
+}
+
+// Parses "YYYY-MM-DDTHH:MM", optionally followed by ":SS" and "Z", as UTC
+// minutes since the epoch. Seconds are rounded up to the next minute.
+bool parseMinute(const std::string& s, int64_t& out) {
+  std::chrono::sys_days day;
+  if (s.size() < 16 || s[10] != 'T' || s[13] != ':' ||
+      !parseDate(s.substr(0, 10), day))
+    return false;
+  std::string rest = s.substr(11);
+  if (!rest.empty() && rest.back() == 'Z') rest.pop_back();
+  if (rest.size() != 5 && (rest.size() != 8 || rest[5] != ':')) return false;
+  for (size_t i = 0; i < rest.size(); ++i)
+    if (i != 2 && i != 5 && !std::isdigit(static_cast<unsigned char>(rest[i])))
+      return false;
+  const int hour = std::stoi(rest.substr(0, 2));
+  const int minute = std::stoi(rest.substr(3, 2));
+  const int second = rest.size() == 8 ? std::stoi(rest.substr(6, 2)) : 0;
+  if (hour > 23 || minute > 59 || second > 59) return false;
+  out = day.time_since_epoch().count() * 1440 + hour * 60 + minute +
+        (second > 0 ? 1 : 0);
+  return true;
+}
+
+// Drops fractional seconds and everything after them, as earlier versions of
+// this endpoint did.
+std::string_view stripFraction(std::string_view time) {
+  const auto dot = time.find('.');
+  return dot == std::string_view::npos ? time : time.substr(0, dot);
+}
+
+// start_ts/end_ts arrive as "YYYY-MM-DD HH:MM:SS..." and are reported as a
+// date plus start and end times.
+void writeSchedule(serialization::JsonWriter& out,
+                   const drogon::orm::Row& srow) {
+  out.beginObject();
+
+  const auto& startTs = srow["start_ts"];
+  std::string_view date, startTime;
+  bool hasDate = false, hasStartTime = false;
+  if (!startTs.isNull()) {
+    const std::string_view ts = serialization::fieldView(startTs);
+    const auto pos = ts.find(' ');
+    hasDate = true;
+    if (pos != std::string_view::npos) {
+      date = ts.substr(0, pos);
+      startTime = stripFraction(ts.substr(pos + 1));
+      hasStartTime = true;
+    } else {
+      date = ts;
+    }
+  }
+  out.key("date");
+  if (hasDate)
+    out.string(date);
+  else
+    out.null();
+  out.key("start_time");
+  if (hasStartTime)
+    out.string(startTime);
+  else
+    out.null();
+
+  const auto& endTs = srow["end_ts"];
+  out.key("end_time");
+  const auto pos = endTs.isNull() ? std::string_view::npos
+                                  : serialization::fieldView(endTs).find(' ');
+  if (pos != std::string_view::npos)
+    out.string(stripFraction(serialization::fieldView(endTs).substr(pos + 1)));
+  else
+    out.null();
+
+  serialization::writeField(out, "hours", srow["hours"]);
+  out.endObject();
+}
+
+// Schedule rows of `schedules` grouped by task id; the views point into the
+// result buffer.
+using SchedulesByTask =
+    std::unordered_map<std::string_view, std::vector<size_t>>;
+
+SchedulesByTask groupSchedules(const drogon::orm::Result& schedules) {
+  SchedulesByTask byTask;
+  byTask.reserve(schedules.size());
+  for (size_t i = 0; i < schedules.size(); ++i)
+    byTask[serialization::fieldView(schedules[i]["task_id"])].push_back(i);
+  return byTask;
+}
+
+void writeTask(serialization::JsonWriter& out, const drogon::orm::Row& row,
+               const drogon::orm::Result& schedules,
+               const SchedulesByTask& byTask) {
+  out.beginObject();
+  for (const char* column : {"task_id", "title", "start_date", "end_date",
+                             "allocated_hours", "role"})
+    serialization::writeField(out, column, row[column]);
+  out.key("schedule");
+  out.beginArray();
+  auto it = byTask.find(serialization::fieldView(row["task_id"]));
+  if (it != byTask.end())
+    for (auto i : it->second) writeSchedule(out, schedules[i]);
+  out.endArray();
+  out.endObject();
+}
+
+// Writes the calendar as a JSON array, one batch of tasks (with their
+// schedule blocks) per chunk, so the first chunk goes out as soon as the
+// first batch is read. drogon's response stream cannot tell when a chunk
+// has drained, so chunks a slow client has not read yet queue up in the
+// connection; the caller keeps the total below kStreamMaxRows rows. Errors
+// after the headers were sent can only be reported by cutting the stream
+// short.
+AsyncTask streamCalendarTasks(ResponseStreamPtr stream, std::string userId,
+                              std::string startDate, std::string endDate) {
+  auto& pool = db::reports();
+  serialization::JsonWriter out(64 * 1024);
+
+  std::string lastStart, lastTitle, lastTask, lastAssignment, lastRole;
+  try {
+    out.beginArray();
+    for (;;) {
+      const std::string sql =
+          std::string(kTasksSql) +
+          " AND ($4 = '' OR (t.start_date, t.title, t.id, a.id, "
+          "COALESCE(r.id, '00000000-0000-0000-0000-000000000000'::uuid)) > "
+          "($4::date, $5, $6::uuid, $7::uuid, $8::uuid))" +
+          kTasksOrderSql + " LIMIT " + std::to_string(kStreamBatchRows);
+      auto tasksRes =
+          co_await pool.exec(sql, userId, endDate, startDate, lastStart,
+                             lastTitle, lastTask, lastAssignment, lastRole);
+      if (tasksRes.empty()) break;
+
+      db::ArrayLiteral idLiteral;
+      for (const auto& row : tasksRes)
+        idLiteral.add(serialization::fieldView(row["task_id"]));
+      const std::string idArray = idLiteral.release();
+
+      auto schedulesRes = co_await pool.exec(
+          R"sql(
+          SELECT ts.task_id::text AS task_id,
+                 ts.start_ts::text AS start_ts,
+                 ts.end_ts::text   AS end_ts,
+                 ts.hours
+          FROM task_schedule ts
+          WHERE ts.task_id = ANY($1::uuid[])
+            AND ts.start_ts::date >= $2::date
+            AND ts.start_ts::date <= $3::date
+          ORDER BY ts.task_id, ts.start_ts
+        )sql",
+          idArray, startDate, endDate);
+      const auto byTask = groupSchedules(schedulesRes);
+      for (const auto& row : tasksRes)
+        writeTask(out, row, schedulesRes, byTask);
+      if (!stream->send(out.flush())) co_return;
+
+      const auto& last = tasksRes[tasksRes.size() - 1];
+      lastStart = last["start_date"].as<std::string>();
+      lastTitle = last["title"].as<std::string>();
+      lastTask = last["task_id"].as<std::string>();
+      lastAssignment = last["assignment_key"].as<std::string>();
+      lastRole = last["role_key"].as<std::string>();
+      if (tasksRes.size() < static_cast<size_t>(kStreamBatchRows)) break;
+    }
+    out.endArray();
+    stream->send(out.flush());
+  } catch (const std::exception& e) {
+    LOG_ERROR << "streaming calendar failed for user " << userId << ": "
+              << e.what();
+  }
+  stream->close();
+}
+
+}  // namespace
+
+Task<HttpResponsePtr> CalendarController::getCalendarTasks(HttpRequestPtr req) {
   auto attrsPtr = req->attributes();
   if (!attrsPtr || !attrsPtr->find("user_id")) {
     auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Unauthorized"));
     resp->setStatusCode(k401Unauthorized);
-    callback(resp);
-    return;
+    co_return resp;
   }
   const std::string userId = attrsPtr->get<std::string>("user_id");
   if (userId.empty()) {
     auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Unauthorized"));
     resp->setStatusCode(k401Unauthorized);
-    callback(resp);
-    return;
+    co_return resp;
   }
 
   const std::string startParam = req->getParameter("start_date");
@@ -38,54 +313,73 @@ void CalendarController::getCalendarTasks(
     auto resp = HttpResponse::newHttpJsonResponse(
         Json::Value("Missing start_date or end_date"));
     resp->setStatusCode(k400BadRequest);
-    callback(resp);
-    return;
+    co_return resp;
   }
-  if (startParam.size() != 10 || endParam.size() != 10) {
+  std::chrono::sys_days startDay, endDay;
+  if (!parseDate(startParam, startDay) || !parseDate(endParam, endDay)) {
     auto resp = HttpResponse::newHttpJsonResponse(
         Json::Value("Invalid date format (expected YYYY-MM-DD)"));
     resp->setStatusCode(k400BadRequest);
-    callback(resp);
-    return;
+    co_return resp;
   }
-  if (startParam > endParam) {
+  if (startDay > endDay) {
     auto resp = HttpResponse::newHttpJsonResponse(
         Json::Value("start_date must be earlier or equal to end_date"));
     resp->setStatusCode(k400BadRequest);
-    callback(resp);
-    return;
+    co_return resp;
   }
 
-  auto dbClient = app().getDbClient();
+  // stream=1 forces chunked output, stream=0 forces a single buffered body;
+  // otherwise long ranges are streamed.
+  const std::string streamParam = req->getParameter("stream");
+  const bool streaming =
+      streamParam.empty()
+          ? (endDay - startDay).count() > kStreamThresholdDays
+          : (streamParam == "1" || streamParam == "true");
+  if (streaming) {
+    try {
+      auto counted = co_await db::reports().exec(
+          "SELECT count(*) AS n FROM (" + std::string(kTasksSql) + " LIMIT " +
+              std::to_string(kStreamMaxRows + 1) + ") capped",
+          userId, endParam, startParam);
+      if (counted[0]["n"].as<int64_t>() > kStreamMaxRows) {
+        auto resp = HttpResponse::newHttpJsonResponse(
+            Json::Value("Range has more than " +
+                        std::to_string(kStreamMaxRows) +
+                        " calendar rows; request a shorter range"));
+        resp->setStatusCode(k400BadRequest);
+        co_return resp;
+      }
+    } catch (const std::exception& e) {
+      LOG_ERROR << "getCalendarTasks failed for user " << userId << ": "
+                << e.what();
+      auto resp = HttpResponse::newHttpJsonResponse(
+          Json::Value("Internal server error"));
+      resp->setStatusCode(k500InternalServerError);
+      co_return resp;
+    }
+    auto resp = HttpResponse::newAsyncStreamResponse(
+        [userId, startParam, endParam](ResponseStreamPtr stream) {
+          streamCalendarTasks(std::move(stream), userId, startParam, endParam);
+        });
+    resp->setContentTypeCode(CT_APPLICATION_JSON);
+    co_return resp;
+  }
 
-  try {
-    auto tasksRes = dbClient->execSqlSync(
-        R"sql(
-        SELECT t.id AS task_id,
-               t.title AS title,
-               t.start_date::text AS start_date,
-               t.due_date::text   AS end_date,
-               a.assigned_hours AS allocated_hours,
-               r.role AS role
-        FROM task t
-        JOIN task_assignment a ON a.task_id = t.id AND a.user_id = $1
-        LEFT JOIN task_role_assignment r ON r.task_id = t.id AND r.user_id = $1
-        WHERE t.start_date <= $2::date
-          AND t.due_date   >= $3::date
-        ORDER BY t.start_date, t.title
-      )sql",
-        userId, endParam, startParam);
+  auto& pool = db::reports();
 
-    Json::Value out(Json::arrayValue);
+  try {
+    auto tasksRes = co_await pool.exec(std::string(kTasksSql) + kTasksOrderSql,
+                                       userId, endParam, startParam);
 
     if (tasksRes.size() == 0) {
-      auto resp = HttpResponse::newHttpJsonResponse(out);
+      auto resp =
+          HttpResponse::newHttpJsonResponse(Json::Value(Json::arrayValue));
       resp->setStatusCode(k200OK);
-      callback(resp);
-      return;
+      co_return resp;
     }
 
-    auto schedulesRes = dbClient->execSqlSync(
+    auto schedulesRes = co_await pool.exec(
         R"sql(
         SELECT ts.task_id::text AS task_id,
                ts.start_ts::text AS start_ts,
@@ -99,119 +393,220 @@ void CalendarController::getCalendarTasks(
       )sql",
         userId, startParam, endParam);
 
-    std::unordered_map<std::string, std::vector<Json::Value>> schedulesByTask;
-    schedulesByTask.reserve(std::max<size_t>(1, schedulesRes.size()));
-    for (const auto& srow : schedulesRes) {
-      const std::string tid = srow["task_id"].as<std::string>();
-      Json::Value s(Json::objectValue);
-
-      if (!srow["start_ts"].isNull()) {
-        std::string startTs = srow["start_ts"].as<std::string>();
-        auto pos = startTs.find(' ');
-        if (pos != std::string::npos) {
-          std::string datePart = startTs.substr(0, pos);
-          std::string timePart = startTs.substr(pos + 1);
-          auto dot = timePart.find('.');
-          if (dot != std::string::npos) timePart.erase(dot);
-          s["date"] = Json::Value(datePart);
-          s["start_time"] = Json::Value(timePart);
-        } else {
-          s["date"] = Json::Value(startTs);
-          s["start_time"] = Json::Value();
-        }
-      } else {
-        s["date"] = Json::Value();
-        s["start_time"] = Json::Value();
-      }
+    const auto byTask = groupSchedules(schedulesRes);
+    serialization::JsonWriter out(256 * tasksRes.size() + 2);
+    out.beginArray();
+    for (const auto& row : tasksRes) writeTask(out, row, schedulesRes, byTask);
+    out.endArray();
 
-      if (!srow["end_ts"].isNull()) {
-        std::string endTs = srow["end_ts"].as<std::string>();
-        auto pos = endTs.find(' ');
-        if (pos != std::string::npos) {
-          std::string timePart = endTs.substr(pos + 1);
-          auto dot = timePart.find('.');
-          if (dot != std::string::npos) timePart.erase(dot);
-          s["end_time"] = Json::Value(timePart);
-        } else {
-          s["end_time"] = Json::Value();
-        }
-      } else {
-        s["end_time"] = Json::Value();
-      }
+    co_return serialization::jsonResponse(out);
 
-      if (!srow["hours"].isNull()) {
-        try {
-          s["hours"] = Json::Value(srow["hours"].as<std::string>());
-        } catch (...) {
-          try {
-            s["hours"] = Json::Value(srow["hours"].as<double>());
-          } catch (...) {
-            s["hours"] = Json::Value();
-          }
-        }
-      } else {
-        s["hours"] = Json::Value();
-      }
+  } catch (const std::exception& e) {
+    LOG_ERROR << "getCalendarTasks failed for user "
+              << attrsPtr->get<std::string>("user_id") << ": " << e.what();
+    auto resp =
+        HttpResponse::newHttpJsonResponse(Json::Value("Internal server error"));
+    resp->setStatusCode(k500InternalServerError);
+    co_return resp;
+  }
+}
+
+Task<HttpResponsePtr> CalendarController::getAvailability(HttpRequestPtr req) {
+  auto attrsPtr = req->attributes();
+  if (!attrsPtr || !attrsPtr->find("user_id")) {
+    auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Unauthorized"));
+    resp->setStatusCode(k401Unauthorized);
+    co_return resp;
+  }
+  auto badRequest = [](const std::string& message) {
+    auto resp = HttpResponse::newHttpJsonResponse(Json::Value(message));
+    resp->setStatusCode(k400BadRequest);
+    return resp;
+  };
+
+  // user_ids is a comma-separated list.
+  std::vector<std::string> userIds;
+  const std::string usersParam = req->getParameter("user_ids");
+  if (usersParam.empty()) co_return badRequest("Missing user_ids");
+  for (size_t pos = 0; pos <= usersParam.size();) {
+    auto end = usersParam.find(',', pos);
+    if (end == std::string::npos) end = usersParam.size();
+    const auto id = engine::Uuid::parse(usersParam.substr(pos, end - pos));
+    if (!id) co_return badRequest("Invalid user id in user_ids");
+    userIds.push_back(id->str());
+    pos = end + 1;
+  }
+  std::sort(userIds.begin(), userIds.end());
+  userIds.erase(std::unique(userIds.begin(), userIds.end()), userIds.end());
+  if (userIds.size() > kMaxAvailabilityUsers)
+    co_return badRequest("At most " + std::to_string(kMaxAvailabilityUsers) +
+                         " users per search");
+
+  std::chrono::sys_days startDay, endDay;
+  if (!parseDate(req->getParameter("start_date"), startDay) ||
+      !parseDate(req->getParameter("end_date"), endDay))
+    co_return badRequest(
+        "Missing or invalid start_date/end_date (expected YYYY-MM-DD)");
+  if (startDay > endDay)
+    co_return badRequest("start_date must be earlier or equal to end_date");
+  if ((endDay - startDay).count() >= kMaxAvailabilityDays)
+    co_return badRequest("At most " + std::to_string(kMaxAvailabilityDays) +
+                         " days per search");
+
+  int64_t minutes = 60;
+  size_t limit = 10;
+  try {
+    const auto durationParam = req->getParameter("duration_minutes");
+    if (!durationParam.empty()) minutes = std::stoll(durationParam);
+    const auto limitParam = req->getParameter("limit");
+    if (!limitParam.empty()) limit = std::stoul(limitParam);
+  } catch (...) {
+    co_return badRequest("Invalid duration_minutes or limit");
+  }
+  if (minutes <= 0 || minutes > engine::kMinutesPerDay)
+    co_return badRequest("duration_minutes must be between 1 and 1440");
+  if (limit == 0 || limit > kMaxAvailabilitySlots)
+    co_return badRequest("limit must be between 1 and " +
+                         std::to_string(kMaxAvailabilitySlots));
+  std::string taskId = req->getParameter("task_id");
+  if (!taskId.empty()) {
+    const auto task = engine::Uuid::parse(taskId);
+    if (!task) co_return badRequest("Invalid task_id");
+    taskId = task->str();
+  }
 
-      schedulesByTask[tid].push_back(std::move(s));
+  try {
+    db::ArrayLiteral idLiteral;
+    for (const auto& id : userIds) idLiteral.add(id);
+    const std::string idArray = idLiteral.release();
+    auto found = co_await db::reports().exec(
+        "SELECT count(*) AS found FROM app_user WHERE id = ANY($1::uuid[])",
+        idArray);
+    if (found[0]["found"].as<int64_t>() !=
+        static_cast<int64_t>(userIds.size())) {
+      auto resp =
+          HttpResponse::newHttpJsonResponse(Json::Value("User not found"));
+      resp->setStatusCode(k404NotFound);
+      co_return resp;
+    }
+    if (!co_await maySeeFreeBusy(attrsPtr->get<std::string>("user_id"),
+                                 userIds, taskId)) {
+      auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Forbidden"));
+      resp->setStatusCode(k403Forbidden);
+      co_return resp;
     }
 
-    for (const auto& row : tasksRes) {
-      Json::Value item(Json::objectValue);
-      const std::string taskId = row["task_id"].as<std::string>();
-      item["task_id"] = taskId;
-      item["title"] = row["title"].isNull()
-                          ? Json::Value()
-                          : Json::Value(row["title"].as<std::string>());
-      item["start_date"] =
-          row["start_date"].isNull()
-              ? Json::Value()
-              : Json::Value(row["start_date"].as<std::string>());
-      item["end_date"] = row["end_date"].isNull()
-                             ? Json::Value()
-                             : Json::Value(row["end_date"].as<std::string>());
-
-      if (!row["allocated_hours"].isNull()) {
-        try {
-          item["allocated_hours"] =
-              Json::Value(row["allocated_hours"].as<std::string>());
-        } catch (...) {
-          try {
-            item["allocated_hours"] =
-                Json::Value(row["allocated_hours"].as<double>());
-          } catch (...) {
-            item["allocated_hours"] = Json::Value();
-          }
-        }
-      } else
-        item["allocated_hours"] = Json::Value();
-
-      item["role"] = row["role"].isNull()
-                         ? Json::Value()
-                         : Json::Value(row["role"].as<std::string>());
-
-      Json::Value scheduleArr(Json::arrayValue);
-      auto it = schedulesByTask.find(taskId);
-      if (it != schedulesByTask.end()) {
-        for (const auto& s : it->second) scheduleArr.append(s);
-      }
-      item["schedule"] = scheduleArr;
+    const auto result = co_await services::availability().commonFreeTime(
+        userIds, startDay.time_since_epoch().count(),
+        endDay.time_since_epoch().count(), minutes, limit);
 
-      out.append(item);
+    serialization::JsonWriter out(96 * result.slots.size() + 64);
+    out.beginObject();
+    out.key("slots");
+    out.beginArray();
+    for (const auto& slot : result.slots) {
+      out.beginObject();
+      out.key("start");
+      out.string(engine::formatMinute(slot.start));
+      out.key("end");
+      out.string(engine::formatMinute(slot.end));
+      out.endObject();
     }
+    out.endArray();
+    out.key("common_free_hours");
+    out.raw(db::formatHours(result.freeMinutes / 60.0));
+    out.endObject();
+    co_return serialization::jsonResponse(out);
+  } catch (const std::exception& e) {
+    LOG_ERROR << "getAvailability failed: " << e.what();
+    auto resp =
+        HttpResponse::newHttpJsonResponse(Json::Value("Internal server error"));
+    resp->setStatusCode(k500InternalServerError);
+    co_return resp;
+  }
+}
 
-    auto resp = HttpResponse::newHttpJsonResponse(out);
-    resp->setStatusCode(k200OK);
-    callback(resp);
-    return;
+Task<HttpResponsePtr> CalendarController::getNextFreeSlot(HttpRequestPtr req) {
+  auto attrsPtr = req->attributes();
+  if (!attrsPtr || !attrsPtr->find("user_id")) {
+    auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Unauthorized"));
+    resp->setStatusCode(k401Unauthorized);
+    co_return resp;
+  }
+  auto badRequest = [](const std::string& message) {
+    auto resp = HttpResponse::newHttpJsonResponse(Json::Value(message));
+    resp->setStatusCode(k400BadRequest);
+    return resp;
+  };
+
+  // Defaults to the caller.
+  std::string targetId = req->getParameter("user_id");
+  if (targetId.empty()) targetId = attrsPtr->get<std::string>("user_id");
+  const auto target = engine::Uuid::parse(targetId);
+  if (!target) co_return badRequest("Invalid user_id");
+  targetId = target->str();
 
+  int64_t after = 0;  // not before now either way
+  const std::string afterParam = req->getParameter("after");
+  if (!afterParam.empty() && !parseMinute(afterParam, after))
+    co_return badRequest("Invalid after (expected YYYY-MM-DDTHH:MM[:SS]Z)");
+  int64_t minutes = 60;
+  try {
+    const auto durationParam = req->getParameter("duration_minutes");
+    if (!durationParam.empty()) minutes = std::stoll(durationParam);
+  } catch (...) {
+    co_return badRequest("Invalid duration_minutes");
+  }
+  if (minutes <= 0 || minutes > engine::kMinutesPerDay)
+    co_return badRequest("duration_minutes must be between 1 and 1440");
+  std::string taskId = req->getParameter("task_id");
+  if (!taskId.empty()) {
+    const auto task = engine::Uuid::parse(taskId);
+    if (!task) co_return badRequest("Invalid task_id");
+    taskId = task->str();
+  }
+
+  try {
+    auto found = co_await db::reports().exec(
+        "SELECT id FROM app_user WHERE id = $1::uuid LIMIT 1", targetId);
+    if (found.empty()) {
+      auto resp =
+          HttpResponse::newHttpJsonResponse(Json::Value("User not found"));
+      resp->setStatusCode(k404NotFound);
+      co_return resp;
+    }
+    if (!co_await maySeeFreeBusy(attrsPtr->get<std::string>("user_id"),
+                                 {targetId}, taskId)) {
+      auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Forbidden"));
+      resp->setStatusCode(k403Forbidden);
+      co_return resp;
+    }
+
+    const auto slot = co_await services::availability().nextFreeSlot(
+        targetId, after, minutes);
+
+    serialization::JsonWriter out(128);
+    out.beginObject();
+    out.key("user_id");
+    out.string(targetId);
+    out.key("start");
+    if (slot)
+      out.string(engine::formatMinute(slot->start));
+    else
+      out.null();
+    out.key("end");
+    if (slot)
+      out.string(engine::formatMinute(slot->end));
+    else
+      out.null();
+    out.endObject();
+    co_return serialization::jsonResponse(out);
   } catch (const std::exception& e) {
-    LOG_ERROR << "getCalendarTasks failed for user "
-              << attrsPtr->get<std::string>("user_id") << ": " << e.what();
+    LOG_ERROR << "getNextFreeSlot failed for user " << targetId << ": "
+              << e.what();
     auto resp =
         HttpResponse::newHttpJsonResponse(Json::Value("Internal server error"));
     resp->setStatusCode(k500InternalServerError);
-    callback(resp);
-    return;
+    co_return resp;
   }
-}
\ No newline at end of file
+}
@@ -0,0 +1,214 @@
+#include "API/DependencyController.hpp"
+
+#include <drogon/HttpResponse.h>
+#include <json/json.h>
+#include <trantor/utils/Logger.h>
+
+#include <exception>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "db/Literals.hpp"
+#include "db/Pools.hpp"
+#include "engine/Uuid.hpp"
+#include "services/DependencyService.hpp"
+#include "services/ForecastService.hpp"
+#include "services/PermissionService.hpp"
+#include "services/SimulationService.hpp"
+
+using namespace drogon;
+
+namespace {
+
+// Upper bound on one batch request.
+constexpr Json::ArrayIndex kMaxBatch = 10000;
+
+HttpResponsePtr badRequest(const std::string& message) {
+  auto resp = HttpResponse::newHttpJsonResponse(Json::Value(message));
+  resp->setStatusCode(k400BadRequest);
+  return resp;
+}
+
+// Reads depends_on_id and kind (and task_id unless it came from the path).
+// Returns an error message, empty on success.
+std::string parseDependency(const Json::Value& j,
+                            services::NewDependency& out) {
+  if (!j.isObject()) return "Each dependency must be an object";
+  if (out.taskId.empty()) {
+    if (!j["task_id"].isString()) return "Missing or invalid task_id";
+    out.taskId = j["task_id"].asString();
+  }
+  if (!j["depends_on_id"].isString())
+    return "Missing or invalid depends_on_id";
+  out.dependsOnId = j["depends_on_id"].asString();
+  const auto task = engine::Uuid::parse(out.taskId);
+  const auto dependsOn = engine::Uuid::parse(out.dependsOnId);
+  if (!task || !dependsOn) return "Invalid task id";
+  out.taskId = task->str();
+  out.dependsOnId = dependsOn->str();
+  if (out.taskId == out.dependsOnId) return "A task cannot depend on itself";
+  if (j.isMember("kind") && !j["kind"].isNull()) {
+    std::optional<engine::DependencyKind> kind;
+    if (j["kind"].isString())
+      kind = engine::parseDependencyKind(j["kind"].asString());
+    if (!kind)
+      return "kind must be one of finish_start, start_start, finish_finish, "
+             "start_finish";
+    out.kind = *kind;
+  }
+  return {};
+}
+
+Json::Value toJson(const services::CreatedDependency& d) {
+  Json::Value item(Json::objectValue);
+  item["id"] = d.id;
+  item["task_id"] = d.taskId;
+  item["depends_on_id"] = d.dependsOnId;
+  item["kind"] = engine::dependencyKindName(d.kind);
+  return item;
+}
+
+// Checks that every task exists and that `userId` may change the dependent
+// ones, then hands the batch to the dependency service.
+Task<HttpResponsePtr> insertDependencies(
+    std::string userId, std::vector<services::NewDependency> dependencies,
+    bool single) {
+  std::set<std::string> tasks, dependents;
+  for (const auto& d : dependencies) {
+    tasks.insert(d.taskId);
+    tasks.insert(d.dependsOnId);
+    dependents.insert(d.taskId);
+  }
+  db::ArrayLiteral idLiteral;
+  for (const auto& id : tasks) idLiteral.add(id);
+  const std::string idArray = idLiteral.release();
+
+  auto found = co_await db::oltp().exec(
+      "SELECT count(*) AS found FROM \"task\" WHERE id = ANY($1::uuid[])",
+      idArray);
+  const auto count = found[0]["found"].as<int64_t>();
+  if (count != static_cast<int64_t>(tasks.size())) {
+    auto resp =
+        HttpResponse::newHttpJsonResponse(Json::Value("Task not found"));
+    resp->setStatusCode(k404NotFound);
+    co_return resp;
+  }
+  for (const auto& taskId : dependents) {
+    if (!co_await services::permissions().check(userId, taskId,
+                                                "task.update.local")) {
+      auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Forbidden"));
+      resp->setStatusCode(k403Forbidden);
+      co_return resp;
+    }
+  }
+
+  const auto result =
+      co_await services::dependencies().add(std::move(dependencies));
+  if (!result.cycle.empty()) {
+    Json::Value out(Json::objectValue);
+    out["error"] = "Dependency would create a cycle";
+    Json::Value cycle(Json::arrayValue);
+    for (const auto& id : result.cycle) cycle.append(id);
+    out["cycle"] = cycle;
+    auto resp = HttpResponse::newHttpJsonResponse(out);
+    resp->setStatusCode(k409Conflict);
+    co_return resp;
+  }
+  if (!result.created.empty()) {
+    services::simulations().changed();
+    services::forecasts().changed();
+  }
+
+  if (single) {
+    if (result.created.empty()) {
+      auto resp = HttpResponse::newHttpJsonResponse(
+          Json::Value("Dependency already exists"));
+      resp->setStatusCode(k409Conflict);
+      co_return resp;
+    }
+    auto resp = HttpResponse::newHttpJsonResponse(toJson(result.created[0]));
+    resp->setStatusCode(k201Created);
+    co_return resp;
+  }
+
+  Json::Value out(Json::objectValue);
+  out["created"] = static_cast<Json::UInt64>(result.created.size());
+  out["duplicates"] = static_cast<Json::UInt64>(result.duplicates);
+  Json::Value created(Json::arrayValue);
+  for (const auto& d : result.created) created.append(toJson(d));
+  out["dependencies"] = created;
+  auto resp = HttpResponse::newHttpJsonResponse(out);
+  resp->setStatusCode(k201Created);
+  co_return resp;
+}
+
+}  // namespace
+
+Task<HttpResponsePtr> DependencyController::createDependency(
+    HttpRequestPtr req, std::string taskId) {
+  auto attrsPtr = req->attributes();
+  if (!attrsPtr || !attrsPtr->find("user_id")) {
+    auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Unauthorized"));
+    resp->setStatusCode(k401Unauthorized);
+    co_return resp;
+  }
+  const std::string userId = attrsPtr->get<std::string>("user_id");
+
+  auto jsonPtr = req->getJsonObject();
+  if (!jsonPtr || !jsonPtr->isObject()) co_return badRequest("Invalid JSON");
+  services::NewDependency dependency;
+  dependency.taskId = taskId;
+  const auto error = parseDependency(*jsonPtr, dependency);
+  if (!error.empty()) co_return badRequest(error);
+
+  try {
+    co_return co_await insertDependencies(userId, {dependency}, true);
+  } catch (const std::exception& e) {
+    LOG_ERROR << "createDependency failed for task " << taskId << ": "
+              << e.what();
+    auto resp =
+        HttpResponse::newHttpJsonResponse(Json::Value("Internal server error"));
+    resp->setStatusCode(k500InternalServerError);
+    co_return resp;
+  }
+}
+
+Task<HttpResponsePtr> DependencyController::createDependencies(
+    HttpRequestPtr req) {
+  auto attrsPtr = req->attributes();
+  if (!attrsPtr || !attrsPtr->find("user_id")) {
+    auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Unauthorized"));
+    resp->setStatusCode(k401Unauthorized);
+    co_return resp;
+  }
+  const std::string userId = attrsPtr->get<std::string>("user_id");
+
+  auto jsonPtr = req->getJsonObject();
+  if (!jsonPtr || !jsonPtr->isArray())
+    co_return badRequest("Invalid JSON: expected an array of dependencies");
+  const Json::Value& arr = *jsonPtr;
+  if (arr.empty()) co_return badRequest("No dependencies given");
+  if (arr.size() > kMaxBatch)
+    co_return badRequest("At most " + std::to_string(kMaxBatch) +
+                         " dependencies per request");
+
+  std::vector<services::NewDependency> dependencies(arr.size());
+  for (Json::ArrayIndex i = 0; i < arr.size(); ++i) {
+    const auto error = parseDependency(arr[i], dependencies[i]);
+    if (!error.empty())
+      co_return badRequest("Dependency " + std::to_string(i) + ": " + error);
+  }
+
+  try {
+    co_return co_await insertDependencies(userId, std::move(dependencies),
+                                          false);
+  } catch (const std::exception& e) {
+    LOG_ERROR << "createDependencies failed: " << e.what();
+    auto resp =
+        HttpResponse::newHttpJsonResponse(Json::Value("Internal server error"));
+    resp->setStatusCode(k500InternalServerError);
+    co_return resp;
+  }
+}
@@ -0,0 +1,15 @@
+#include "API/MetricsController.hpp"
+
+#include <drogon/HttpResponse.h>
+
+#include "metrics/Metrics.hpp"
+
+using namespace drogon;
+
+Task<HttpResponsePtr> MetricsController::getMetrics(HttpRequestPtr) {
+  auto resp = HttpResponse::newHttpResponse();
+  resp->setStatusCode(k200OK);
+  resp->setContentTypeString("text/plain; version=0.0.4");
+  resp->setBody(metrics::registry().render());
+  co_return resp;
+}
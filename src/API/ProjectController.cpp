@@ -0,0 +1,446 @@
+#include "API/ProjectController.hpp"
+
+#include <drogon/HttpResponse.h>
+#include <json/json.h>
+#include <trantor/utils/Logger.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include "db/Literals.hpp"
+#include "db/Pools.hpp"
+#include "engine/Uuid.hpp"
+#include "engine/WhatIf.hpp"
+#include "serialization/JsonWriter.hpp"
+#include "serialization/RowJson.hpp"
+#include "services/DependencyService.hpp"
+#include "services/ForecastService.hpp"
+#include "services/PermissionService.hpp"
+#include "services/SimulationService.hpp"
+
+using namespace drogon;
+
+namespace {
+
+// Minutes written as hours.
+void writeHours(serialization::JsonWriter& out, std::string_view key,
+                int64_t minutes) {
+  out.key(key);
+  out.raw(db::formatHours(minutes / 60.0));
+}
+
+// Edits per simulation request.
+constexpr Json::ArrayIndex kMaxEdits = 100;
+
+// Forecast trials: the default and the most one request may ask for.
+constexpr uint32_t kDefaultTrials = 10000;
+constexpr uint32_t kMaxTrials = 100000;
+
+// "YYYY-MM-DD" as days since 1970-01-01.
+bool parseDay(const std::string& s, int64_t& out) {
+  if (s.size() != 10 || s[4] != '-' || s[7] != '-') return false;
+  try {
+    const std::chrono::year_month_day ymd{
+        std::chrono::year{std::stoi(s.substr(0, 4))},
+        std::chrono::month{static_cast<unsigned>(std::stoi(s.substr(5, 2)))},
+        std::chrono::day{static_cast<unsigned>(std::stoi(s.substr(8, 2)))}};
+    if (!ymd.ok()) return false;
+    out = std::chrono::sys_days{ymd}.time_since_epoch().count();
+    return true;
+  } catch (...) {
+    return false;
+  }
+}
+
+// A block boundary as a timestamp, or null when nothing was placed.
+void writeMinute(serialization::JsonWriter& out, std::string_view key,
+                 engine::Minute minute) {
+  out.key(key);
+  if (minute < 0)
+    out.null();
+  else
+    out.string(engine::formatMinute(minute));
+}
+
+// The day a forecast finishing `minute` minutes into `today` ends on.
+void writeFinishDay(serialization::JsonWriter& out, std::string_view key,
+                    int64_t today, engine::Minute minute) {
+  out.key(key);
+  out.string(engine::formatDay(
+      today + (minute > 0 ? (minute - 1) / engine::kMinutesPerDay : 0)));
+}
+
+// Applies one edit of the request body to `scenario`; returns an error
+// message for a malformed one.
+std::string applyEdit(const Json::Value& edit,
+                      const services::ProjectPlan& plan,
+                      engine::Scenario& scenario) {
+  if (!edit.isObject() || !edit["type"].isString())
+    return "Each edit needs a type";
+  const std::string type = edit["type"].asString();
+  if (type == "absence") {
+    if (!edit["user_id"].isString() ||
+        !engine::Uuid::parse(edit["user_id"].asString()))
+      return "absence needs a valid user_id";
+    int64_t first = 0, last = 0;
+    if (!edit["start_date"].isString() || !edit["end_date"].isString() ||
+        !parseDay(edit["start_date"].asString(), first) ||
+        !parseDay(edit["end_date"].asString(), last) || last < first)
+      return "absence needs start_date <= end_date (YYYY-MM-DD)";
+    // Someone without work in the project is not affected by being away.
+    const auto user = plan.userIndex.find(edit["user_id"].asString());
+    if (user != plan.userIndex.end())
+      scenario.addAbsence(user->second, first, last);
+    return {};
+  }
+
+  if (!edit["task_id"].isString()) return type + " needs a task_id";
+  const auto id = engine::Uuid::parse(edit["task_id"].asString());
+  const auto task = id ? plan.taskIndex.find(*id) : plan.taskIndex.end();
+  if (task == plan.taskIndex.end())
+    return "Task " + edit["task_id"].asString() + " is not in this project";
+  if (type == "slip") {
+    if (!edit["days"].isInt() || edit["days"].asInt() <= 0)
+      return "slip needs a positive whole number of days";
+    scenario.delay(task->second,
+                   edit["days"].asInt64() * engine::kMinutesPerDay);
+    return {};
+  }
+  if (type == "duration") {
+    if (!edit["estimated_hours"].isNumeric() ||
+        edit["estimated_hours"].asDouble() < 0)
+      return "duration needs estimated_hours >= 0";
+    scenario.setDuration(task->second,
+                         std::llround(edit["estimated_hours"].asDouble() * 60));
+    return {};
+  }
+  return "Unknown edit type " + type + " (slip, duration or absence)";
+}
+
+}  // namespace
+
+Task<HttpResponsePtr> ProjectController::getCriticalPath(
+    HttpRequestPtr req, std::string projectId) {
+  auto attrsPtr = req->attributes();
+  if (!attrsPtr || !attrsPtr->find("user_id")) {
+    auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Unauthorized"));
+    resp->setStatusCode(k401Unauthorized);
+    co_return resp;
+  }
+  const std::string userId = attrsPtr->get<std::string>("user_id");
+  if (!engine::Uuid::parse(projectId)) {
+    auto resp =
+        HttpResponse::newHttpJsonResponse(Json::Value("Invalid project id"));
+    resp->setStatusCode(k400BadRequest);
+    co_return resp;
+  }
+
+  try {
+    auto exists = co_await db::oltp().exec(
+        "SELECT id FROM \"task\" WHERE id = $1 LIMIT 1", projectId);
+    if (exists.empty()) {
+      auto resp =
+          HttpResponse::newHttpJsonResponse(Json::Value("Project not found"));
+      resp->setStatusCode(k404NotFound);
+      co_return resp;
+    }
+    if (!co_await services::permissions().check(userId, projectId,
+                                                "task.view.local")) {
+      auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Forbidden"));
+      resp->setStatusCode(k403Forbidden);
+      co_return resp;
+    }
+
+    const auto project = co_await services::dependencies().project(projectId);
+    if (!project) {
+      auto resp =
+          HttpResponse::newHttpJsonResponse(Json::Value("Project not found"));
+      resp->setStatusCode(k404NotFound);
+      co_return resp;
+    }
+
+    std::lock_guard<std::mutex> lock(project->mutex);
+    const auto& path = project->path;
+    if (!path.acyclic()) {
+      auto resp = HttpResponse::newHttpJsonResponse(
+          Json::Value("Task dependencies of this project contain a cycle"));
+      resp->setStatusCode(k409Conflict);
+      co_return resp;
+    }
+
+    const auto& ids = project->ids;
+    serialization::JsonWriter out(160 * ids.size() + 256);
+    out.beginObject();
+    out.key("project_id");
+    out.string(projectId);
+    writeHours(out, "duration_hours", path.makespan());
+    out.key("critical_path");
+    out.beginArray();
+    for (const uint32_t v : path.criticalPath()) out.string(ids[v].str());
+    out.endArray();
+    // Offsets are in hours from the project start.
+    out.key("tasks");
+    out.beginArray();
+    for (uint32_t v = 0; v < ids.size(); ++v) {
+      out.beginObject();
+      out.key("id");
+      out.string(ids[v].str());
+      writeHours(out, "duration_hours", path.graph().duration(v));
+      writeHours(out, "earliest_start", path.earliestStart(v));
+      writeHours(out, "earliest_finish", path.earliestFinish(v));
+      writeHours(out, "latest_start", path.latestStart(v));
+      writeHours(out, "latest_finish", path.latestFinish(v));
+      writeHours(out, "total_float", path.totalFloat(v));
+      out.key("critical");
+      out.boolean(path.totalFloat(v) == 0);
+      out.endObject();
+    }
+    out.endArray();
+    out.endObject();
+    co_return serialization::jsonResponse(out);
+  } catch (const std::exception& e) {
+    LOG_ERROR << "getCriticalPath failed for project " << projectId << ": "
+              << e.what();
+    auto resp =
+        HttpResponse::newHttpJsonResponse(Json::Value("Internal server error"));
+    resp->setStatusCode(k500InternalServerError);
+    co_return resp;
+  }
+}
+
+Task<HttpResponsePtr> ProjectController::simulate(HttpRequestPtr req,
+                                                  std::string projectId) {
+  auto attrsPtr = req->attributes();
+  if (!attrsPtr || !attrsPtr->find("user_id")) {
+    auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Unauthorized"));
+    resp->setStatusCode(k401Unauthorized);
+    co_return resp;
+  }
+  const std::string userId = attrsPtr->get<std::string>("user_id");
+  auto badRequest = [](const std::string& message) {
+    auto resp = HttpResponse::newHttpJsonResponse(Json::Value(message));
+    resp->setStatusCode(k400BadRequest);
+    return resp;
+  };
+  if (!engine::Uuid::parse(projectId))
+    co_return badRequest("Invalid project id");
+  auto jsonPtr = req->getJsonObject();
+  if (!jsonPtr || !jsonPtr->isObject() || !(*jsonPtr)["edits"].isArray())
+    co_return badRequest("Invalid JSON: expected {\"edits\": [...]}");
+  const Json::Value& edits = (*jsonPtr)["edits"];
+  if (edits.size() > kMaxEdits)
+    co_return badRequest("At most " + std::to_string(kMaxEdits) +
+                         " edits per simulation");
+
+  try {
+    auto exists = co_await db::oltp().exec(
+        "SELECT id FROM \"task\" WHERE id = $1 LIMIT 1", projectId);
+    if (exists.empty()) {
+      auto resp =
+          HttpResponse::newHttpJsonResponse(Json::Value("Project not found"));
+      resp->setStatusCode(k404NotFound);
+      co_return resp;
+    }
+    if (!co_await services::permissions().check(userId, projectId,
+                                                "task.view.local")) {
+      auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Forbidden"));
+      resp->setStatusCode(k403Forbidden);
+      co_return resp;
+    }
+
+    const auto plan = co_await services::simulations().plan(projectId);
+    if (!plan) {
+      auto resp =
+          HttpResponse::newHttpJsonResponse(Json::Value("Project not found"));
+      resp->setStatusCode(k404NotFound);
+      co_return resp;
+    }
+    if (!plan->baseline.path().acyclic()) {
+      auto resp = HttpResponse::newHttpJsonResponse(
+          Json::Value("Task dependencies of this project contain a cycle"));
+      resp->setStatusCode(k409Conflict);
+      co_return resp;
+    }
+
+    // The scenario shares the frozen plan and keeps it alive.
+    engine::Scenario scenario(std::shared_ptr<const engine::PlanBaseline>(
+        plan, &plan->baseline));
+    for (const auto& edit : edits) {
+      const auto error = applyEdit(edit, *plan, scenario);
+      if (!error.empty()) co_return badRequest(error);
+    }
+    const auto diff = scenario.run();
+
+    const auto& ids = plan->taskIds;
+    const auto& assignments = plan->baseline.assignments();
+    serialization::JsonWriter out(192 * diff.tasks.size() +
+                                  320 * diff.assignments.size() +
+                                  48 * diff.criticalPath.size() + 256);
+    out.beginObject();
+    out.key("project_id");
+    out.string(projectId);
+    writeHours(out, "duration_hours_before", diff.makespanBefore);
+    writeHours(out, "duration_hours_after", diff.makespanAfter);
+    out.key("critical_path");
+    out.beginArray();
+    for (const uint32_t v : diff.criticalPath) out.string(ids[v].str());
+    out.endArray();
+    // Offsets are in hours from the project start, as in critical-path.
+    out.key("tasks");
+    out.beginArray();
+    for (const auto& t : diff.tasks) {
+      out.beginObject();
+      out.key("id");
+      out.string(ids[t.task].str());
+      writeHours(out, "earliest_start_before", t.startBefore);
+      writeHours(out, "earliest_start_after", t.startAfter);
+      writeHours(out, "earliest_finish_before", t.finishBefore);
+      writeHours(out, "earliest_finish_after", t.finishAfter);
+      out.endObject();
+    }
+    out.endArray();
+    out.key("assignments");
+    out.beginArray();
+    for (const auto& a : diff.assignments) {
+      const auto& assignment = assignments[a.assignment];
+      out.beginObject();
+      out.key("task_id");
+      out.string(ids[assignment.task].str());
+      out.key("user_id");
+      out.string(plan->userIds[assignment.user]);
+      writeMinute(out, "start_before", a.before.start);
+      writeMinute(out, "finish_before", a.before.finish);
+      writeHours(out, "unplaced_hours_before", a.before.unplaced);
+      writeMinute(out, "start_after", a.after.start);
+      writeMinute(out, "finish_after", a.after.finish);
+      writeHours(out, "unplaced_hours_after", a.after.unplaced);
+      out.endObject();
+    }
+    out.endArray();
+    out.endObject();
+    co_return serialization::jsonResponse(out);
+  } catch (const std::exception& e) {
+    LOG_ERROR << "simulate failed for project " << projectId << ": "
+              << e.what();
+    auto resp =
+        HttpResponse::newHttpJsonResponse(Json::Value("Internal server error"));
+    resp->setStatusCode(k500InternalServerError);
+    co_return resp;
+  }
+}
+
+Task<HttpResponsePtr> ProjectController::getForecast(HttpRequestPtr req,
+                                                     std::string projectId) {
+  auto attrsPtr = req->attributes();
+  if (!attrsPtr || !attrsPtr->find("user_id")) {
+    auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Unauthorized"));
+    resp->setStatusCode(k401Unauthorized);
+    co_return resp;
+  }
+  const std::string userId = attrsPtr->get<std::string>("user_id");
+  auto badRequest = [](const std::string& message) {
+    auto resp = HttpResponse::newHttpJsonResponse(Json::Value(message));
+    resp->setStatusCode(k400BadRequest);
+    return resp;
+  };
+  if (!engine::Uuid::parse(projectId))
+    co_return badRequest("Invalid project id");
+  unsigned long trials = kDefaultTrials;
+  try {
+    const auto trialsParam = req->getParameter("trials");
+    if (!trialsParam.empty()) trials = std::stoul(trialsParam);
+  } catch (...) {
+    co_return badRequest("Invalid trials");
+  }
+  if (trials == 0 || trials > kMaxTrials)
+    co_return badRequest("trials must be between 1 and " +
+                         std::to_string(kMaxTrials));
+
+  try {
+    auto exists = co_await db::oltp().exec(
+        "SELECT id FROM \"task\" WHERE id = $1 LIMIT 1", projectId);
+    if (exists.empty()) {
+      auto resp =
+          HttpResponse::newHttpJsonResponse(Json::Value("Project not found"));
+      resp->setStatusCode(k404NotFound);
+      co_return resp;
+    }
+    if (!co_await services::permissions().check(userId, projectId,
+                                                "task.view.local")) {
+      auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Forbidden"));
+      resp->setStatusCode(k403Forbidden);
+      co_return resp;
+    }
+
+    const auto result = co_await services::forecasts().forecast(
+        projectId, static_cast<uint32_t>(trials));
+    if (!result) {
+      auto resp =
+          HttpResponse::newHttpJsonResponse(Json::Value("Project not found"));
+      resp->setStatusCode(k404NotFound);
+      co_return resp;
+    }
+    const auto& forecast = result->forecast;
+    if (forecast.trials() == 0) {
+      auto resp = HttpResponse::newHttpJsonResponse(
+          Json::Value("Task dependencies of this project contain a cycle"));
+      resp->setStatusCode(k409Conflict);
+      co_return resp;
+    }
+
+    serialization::JsonWriter out(512);
+    out.beginObject();
+    out.key("project_id");
+    out.string(projectId);
+    out.key("trials");
+    out.raw(std::to_string(forecast.trials()));
+    out.key("start_date");
+    out.string(engine::formatDay(result->today));
+    writeFinishDay(out, "p50_finish_date", result->today,
+                   forecast.percentile(0.5));
+    writeFinishDay(out, "p90_finish_date", result->today,
+                   forecast.percentile(0.9));
+    // Calendar hours from the start of start_date.
+    writeHours(out, "p50_hours", forecast.percentile(0.5));
+    writeHours(out, "p90_hours", forecast.percentile(0.9));
+    writeHours(out, "mean_hours", std::llround(forecast.mean()));
+    out.key("due_date");
+    if (result->dueDay)
+      out.string(engine::formatDay(*result->dueDay));
+    else
+      out.null();
+    // Share of the trials finished by the end of the due date.
+    out.key("on_time_probability");
+    if (result->dueDay) {
+      char buf[16];
+      std::snprintf(buf, sizeof(buf), "%.3f",
+                    forecast.within((*result->dueDay - result->today + 1) *
+                                    engine::kMinutesPerDay));
+      out.raw(buf);
+    } else {
+      out.null();
+    }
+    out.endObject();
+    co_return serialization::jsonResponse(out);
+  } catch (const services::ForecastOverloaded& e) {
+    LOG_WARN << "getForecast rejected for project " << projectId << ": "
+             << e.what();
+    auto resp = HttpResponse::newHttpJsonResponse(
+        Json::Value("Too many forecasts running, retry later"));
+    resp->setStatusCode(k503ServiceUnavailable);
+    resp->addHeader("Retry-After", std::to_string(e.retryAfterSeconds()));
+    co_return resp;
+  } catch (const std::exception& e) {
+    LOG_ERROR << "getForecast failed for project " << projectId << ": "
+              << e.what();
+    auto resp =
+        HttpResponse::newHttpJsonResponse(Json::Value("Internal server error"));
+    resp->setStatusCode(k500InternalServerError);
+    co_return resp;
+  }
+}
@@ -0,0 +1,78 @@
+#include "API/ScheduleController.hpp"
+
+#include <drogon/HttpResponse.h>
+#include <json/json.h>
+#include <trantor/utils/Logger.h>
+
+#include <cmath>
+#include <exception>
+#include <string>
+
+#include "db/Pools.hpp"
+#include "engine/Uuid.hpp"
+#include "services/PermissionService.hpp"
+#include "services/SchedulingService.hpp"
+
+using namespace drogon;
+
+Task<HttpResponsePtr> ScheduleController::autoSchedule(HttpRequestPtr req,
+                                                       std::string taskId) {
+  auto attrsPtr = req->attributes();
+  if (!attrsPtr || !attrsPtr->find("user_id")) {
+    auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Unauthorized"));
+    resp->setStatusCode(k401Unauthorized);
+    co_return resp;
+  }
+  const std::string userId = attrsPtr->get<std::string>("user_id");
+  if (!engine::Uuid::parse(taskId)) {
+    auto resp =
+        HttpResponse::newHttpJsonResponse(Json::Value("Invalid task id"));
+    resp->setStatusCode(k400BadRequest);
+    co_return resp;
+  }
+
+  try {
+    auto exists = co_await db::oltp().exec(
+        "SELECT id FROM \"task\" WHERE id = $1 LIMIT 1", taskId);
+    if (exists.empty()) {
+      auto resp =
+          HttpResponse::newHttpJsonResponse(Json::Value("Task not found"));
+      resp->setStatusCode(k404NotFound);
+      co_return resp;
+    }
+    // Launching the auto-planner is part of assignment.assign.local.
+    if (!co_await services::permissions().check(userId, taskId,
+                                                "assignment.assign.local")) {
+      auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Forbidden"));
+      resp->setStatusCode(k403Forbidden);
+      co_return resp;
+    }
+
+    const auto report =
+        co_await services::scheduling().scheduleTaskTree(taskId);
+
+    Json::Value out(Json::objectValue);
+    out["task_id"] = taskId;
+    out["assignments"] = static_cast<Json::UInt64>(report.assignments);
+    out["blocks"] = static_cast<Json::UInt64>(report.blocks);
+    Json::Value unplaced(Json::arrayValue);
+    for (const auto& u : report.unplaced) {
+      Json::Value item(Json::objectValue);
+      item["task_id"] = u.taskId;
+      item["user_id"] = u.userId;
+      item["missing_hours"] = std::round(u.missingHours * 100.0) / 100.0;
+      unplaced.append(item);
+    }
+    out["unplaced"] = unplaced;
+
+    auto resp = HttpResponse::newHttpJsonResponse(out);
+    resp->setStatusCode(k200OK);
+    co_return resp;
+  } catch (const std::exception& e) {
+    LOG_ERROR << "autoSchedule failed for task " << taskId << ": " << e.what();
+    auto resp =
+        HttpResponse::newHttpJsonResponse(Json::Value("Internal server error"));
+    resp->setStatusCode(k500InternalServerError);
+    co_return resp;
+  }
+}
@@ -2,18 +2,39 @@
 
 #include <drogon/HttpResponse.h>
 #include <drogon/drogon.h>
-#include <drogon/orm/Mapper.h>
+#include <drogon/orm/CoroMapper.h>
 #include <drogon/orm/Result.h>
 #include <json/json.h>
 #include <trantor/utils/Logger.h>
 
 #include <algorithm>
+#include <cctype>
+#include <chrono>
 #include <exception>
+#include <memory>
 #include <optional>
 #include <set>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include "db/Literals.hpp"
+#include "db/Pools.hpp"
+#include "db/TaskClosure.hpp"
+#include "db/Transaction.hpp"
+#include "engine/PermissionEngine.hpp"
+#include "engine/Uuid.hpp"
+#include "serialization/RowJson.hpp"
+#include "services/AvailabilityService.hpp"
+#include "services/ConflictService.hpp"
+#include "services/DependencyService.hpp"
+#include "services/ForecastService.hpp"
+#include "services/PermissionService.hpp"
+#include "services/RollupService.hpp"
+#include "services/SchedulingService.hpp"
+#include "services/SimulationService.hpp"
 #include "models/Task.hpp"
 #include "models/TaskAssignment.hpp"
 #include "models/TaskRoleAssignment.hpp"
@@ -21,6 +42,13 @@
 
 using namespace drogon;
 
+// A subtree is written in chunks of about this many bytes.
+static constexpr size_t kTreeChunkBytes = 64 * 1024;
+// Largest subtree the tree endpoint returns. drogon's response stream
+// cannot wait for a chunk to drain, so a slow client leaves the unread
+// chunks queued in the connection; this bounds them.
+static constexpr int64_t kMaxTreeTasks = 100000;
+
 static std::string getPathVariableCompat(const HttpRequestPtr& req,
                                          const std::string& name = "id") {
   const std::string q = req->getParameter(name);
@@ -37,35 +65,72 @@ static std::string getPathVariableCompat(const HttpRequestPtr& req,
   return p.substr(start, pos - start + 1);
 }
 
-static bool hasOwnerPermission(
-    const std::shared_ptr<drogon::orm::DbClient>& dbClient,
-    const std::string& taskId, const std::string& userId) {
+// Opaque page cursor: url-safe base64 of "<created_at>|<id>" taken from the
+// last row of the previous page.
+static std::string encodeCursor(const std::string& createdAt,
+                                const std::string& id) {
+  const std::string raw = createdAt + "|" + id;
+  return drogon::utils::base64Encode(
+      reinterpret_cast<const unsigned char*>(raw.data()), raw.size(), true);
+}
+
+static bool decodeCursor(const std::string& cursor, std::string& createdAt,
+                         std::string& id) {
+  const std::string raw = drogon::utils::base64Decode(cursor);
+  const auto sep = raw.rfind('|');
+  if (sep == std::string::npos || sep == 0) return false;
+  createdAt = raw.substr(0, sep);
+  id = raw.substr(sep + 1);
+  if (!std::isdigit(static_cast<unsigned char>(createdAt[0]))) return false;
+  if (id.size() != 36) return false;
+  for (size_t i = 0; i < id.size(); ++i) {
+    const bool dash = i == 8 || i == 13 || i == 18 || i == 23;
+    if (dash ? id[i] != '-'
+             : !std::isxdigit(static_cast<unsigned char>(id[i])))
+      return false;
+  }
+  return true;
+}
+
+// The listed user's roles on a task folded into one row, so paging on
+// (created_at, id) sees every task once. `role` keeps the first of them for
+// older clients; `roles` is a JSON array.
+static constexpr const char* kRolesSql = R"sql(
+    CROSS JOIN LATERAL (
+      SELECT min(r.role)::text AS role,
+             COALESCE(json_agg(r.role ORDER BY r.role), '[]'::json)::text
+                 AS roles
+      FROM "task_role_assignment" r
+      WHERE r.task_id = t.id AND r.user_id = ta.user_id
+    ) tr
+  )sql";
+
+// A NUMERIC column as the model holds it; null and garbage count as 0.
+static double numericOrZero(const std::shared_ptr<std::string>& value) {
+  if (!value) return 0;
   try {
-    auto res = dbClient->execSqlSync(
-        "SELECT created_by FROM \"task\" WHERE id = $1 LIMIT 1", taskId);
-    if (res.empty()) return false;
-    if (!res[0]["created_by"].isNull() &&
-        res[0]["created_by"].as<std::string>() == userId)
-      return true;
-    auto r = dbClient->execSqlSync(
-        "SELECT 1 FROM \"task_role_assignment\" "
-        "WHERE task_id = $1 AND user_id = $2 AND role = $3 "
-        "LIMIT 1",
-        taskId, userId, std::string("owner"));
-    return !r.empty();
+    return std::stod(*value);
+  } catch (...) {
+    return 0;
+  }
+}
+
+static int64_t parseLimit(const std::string& param, int64_t fallback) {
+  if (param.empty()) return fallback;
+  try {
+    return std::clamp(static_cast<int64_t>(std::stoll(param)), int64_t(1),
+                      int64_t(2000));
   } catch (...) {
-    return false;
+    return fallback;
   }
 }
 
-void TaskController::createTask(
-    const HttpRequestPtr& req,
-    std::function<void(const HttpResponsePtr&)>&& callback) {
+Task<HttpResponsePtr> TaskController::createTask(HttpRequestPtr req) {
   auto jsonPtr = req->getJsonObject();
   if (!jsonPtr || !jsonPtr->isObject()) {
     auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Invalid JSON"));
     resp->setStatusCode(k400BadRequest);
-    return callback(resp);
+    co_return resp;
   }
   const Json::Value& j = *jsonPtr;
 
@@ -73,25 +138,25 @@ void TaskController::createTask(
     auto resp = HttpResponse::newHttpJsonResponse(
         Json::Value("Missing or invalid title"));
     resp->setStatusCode(k400BadRequest);
-    return callback(resp);
+    co_return resp;
   }
 
   auto attrsPtr = req->attributes();
   if (!attrsPtr || !attrsPtr->find("user_id")) {
     auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Unauthorized"));
     resp->setStatusCode(k401Unauthorized);
-    return callback(resp);
+    co_return resp;
   }
   const std::string userId = attrsPtr->get<std::string>("user_id");
   if (userId.empty()) {
     auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Unauthorized"));
     resp->setStatusCode(k401Unauthorized);
-    return callback(resp);
+    co_return resp;
   }
 
-  auto dbClient = app().getDbClient();
+  auto& pool = db::oltp();
   try {
-    dbClient->execSqlSync("BEGIN");
+    auto tx = co_await db::Tx::begin(pool);
 
     std::optional<std::string> parentId;
     if (j.isMember("parent_task_id") && !j["parent_task_id"].isNull()) {
@@ -99,18 +164,16 @@ void TaskController::createTask(
         auto resp = HttpResponse::newHttpJsonResponse(
             Json::Value("Invalid parent_task_id"));
         resp->setStatusCode(k400BadRequest);
-        dbClient->execSqlSync("ROLLBACK");
-        return callback(resp);
+        co_return resp;
       }
       parentId = j["parent_task_id"].asString();
-      auto parentRes = dbClient->execSqlSync(
+      auto parentRes = co_await tx.client()->execSqlCoro(
           "SELECT id FROM \"task\" WHERE id = $1 LIMIT 1", *parentId);
       if (parentRes.empty()) {
         auto resp = HttpResponse::newHttpJsonResponse(
             Json::Value("parent_task_id not found"));
         resp->setStatusCode(k400BadRequest);
-        dbClient->execSqlSync("ROLLBACK");
-        return callback(resp);
+        co_return resp;
       }
     }
 
@@ -128,51 +191,52 @@ void TaskController::createTask(
     task.setCreatedAt(::trantor::Date::now());
     task.setUpdatedAt(::trantor::Date::now());
 
-    drogon::orm::Mapper<drogon_model::project_calendar::Task> taskMapper(
-        dbClient);
-    taskMapper.insert(task);
+    auto inserted =
+        co_await drogon::orm::CoroMapper<drogon_model::project_calendar::Task>(
+            tx.client())
+            .insert(task);
 
     std::string taskId;
     try {
-      taskId = task.getValueOfId();
+      taskId = inserted.getValueOfId();
     } catch (...) {
       taskId.clear();
     }
     if (taskId.empty()) {
-      auto res = dbClient->execSqlSync(
+      auto res = co_await tx.client()->execSqlCoro(
           "SELECT id FROM \"task\" WHERE created_by = $1 AND title = $2 "
           "ORDER BY created_at DESC LIMIT 1",
           userId, task.getValueOfTitle());
       if (res.empty()) {
-        dbClient->execSqlSync("ROLLBACK");
         auto resp = HttpResponse::newHttpJsonResponse(
             Json::Value("Failed to determine inserted task id"));
         resp->setStatusCode(k500InternalServerError);
-        return callback(resp);
+        co_return resp;
       }
       taskId = res[0]["id"].as<std::string>();
     }
 
-    drogon_model::project_calendar::TaskAssignment ta;
-    ta.setTaskId(taskId);
-    ta.setUserId(userId);
-    ta.setAssignedAt(::trantor::Date::now());
-    drogon::orm::Mapper<drogon_model::project_calendar::TaskAssignment>
-        taMapper(dbClient);
-    taMapper.insert(ta);
-
-    drogon_model::project_calendar::TaskRoleAssignment tra;
-    tra.setTaskId(taskId);
-    tra.setUserId(userId);
-    tra.setRole(std::string("owner"));
-    tra.setAssignedAt(::trantor::Date::now());
-    drogon::orm::Mapper<drogon_model::project_calendar::TaskRoleAssignment>
-        traMapper(dbClient);
-    traMapper.insert(tra);
-
-    dbClient->execSqlSync("COMMIT");
-
-    auto finalRes = dbClient->execSqlSync(
+    db::Pipeline writes;
+    writes.add(
+        "INSERT INTO \"task_assignment\" (task_id, user_id, assigned_at) "
+        "VALUES ($1, $2, NOW())",
+        taskId, userId);
+    writes.add(
+        "INSERT INTO \"task_role_assignment\" (task_id, user_id, role, "
+        "assigned_at) VALUES ($1, $2, 'owner', NOW())",
+        taskId, userId);
+    db::closureInsert(writes, taskId, parentId.value_or(""));
+    db::resetProjectRoot(writes, taskId);
+    services::rollups().add(
+        writes, {{taskId, numericOrZero(inserted.getEstimatedHours())}});
+    co_await writes.run(tx.client());
+    co_await tx.commit();
+    services::permissions().taskCreated(taskId, parentId.value_or(""), userId);
+    if (parentId) services::dependencies().structureChanged(*parentId);
+    services::simulations().changed();
+    services::forecasts().changed();
+
+    auto finalRes = co_await pool.exec(
         R"sql(
         SELECT id, parent_task_id, title, description, priority, status, estimated_hours,
                start_date::text AS start_date, due_date::text AS due_date,
@@ -184,58 +248,515 @@ void TaskController::createTask(
       auto resp = HttpResponse::newHttpJsonResponse(
           Json::Value("Task created but cannot fetch it"));
       resp->setStatusCode(k500InternalServerError);
-      return callback(resp);
+      co_return resp;
     }
     drogon_model::project_calendar::Task created(finalRes[0], -1);
     auto out = created.toJson();
     auto resp = HttpResponse::newHttpJsonResponse(out);
     resp->setStatusCode(k201Created);
-    return callback(resp);
+    co_return resp;
 
   } catch (const std::exception& e) {
     LOG_ERROR << "createTask failed: " << e.what();
-    try {
-      dbClient->execSqlSync("ROLLBACK");
-    } catch (...) {
+    auto resp =
+        HttpResponse::newHttpJsonResponse(Json::Value("Internal server error"));
+    resp->setStatusCode(k500InternalServerError);
+    co_return resp;
+  }
+}
+
+// Upper bound on one bulk import and the rows sent per INSERT.
+static constexpr Json::ArrayIndex kMaxBulkTasks = 100000;
+static constexpr size_t kBulkChunkRows = 5000;
+
+namespace {
+
+struct BulkAssignment {
+  std::string userId;
+  std::string role;
+  double hours = 0;
+};
+
+// One entry of a bulk import, checked and normalized.
+struct BulkTask {
+  std::string tempId;
+  std::string parentTempId;
+  std::string title;
+  std::optional<std::string> description;
+  std::string priority = "normal";
+  std::string status = "open";
+  double estimatedHours = 0;
+  std::optional<std::string> startDate;
+  std::optional<std::string> dueDate;
+  std::vector<BulkAssignment> assignments;
+};
+
+// Rows for one table, queued as a json_to_recordset INSERT every
+// kBulkChunkRows rows. `sql` takes the JSON array as $1.
+class BulkRows {
+ public:
+  BulkRows(db::Pipeline& writes, const char* sql, size_t reserve)
+      : writes_(writes), sql_(sql), reserve_(reserve) {}
+
+  // Starts a row object; finish it with end().
+  serialization::JsonWriter& begin() {
+    if (!rows_) {
+      rows_.emplace(reserve_ * kBulkChunkRows);
+      rows_->beginArray();
+    }
+    rows_->beginObject();
+    return *rows_;
+  }
+
+  void end() {
+    rows_->endObject();
+    if (++count_ == kBulkChunkRows) flush();
+  }
+
+  void flush() {
+    if (!rows_) return;
+    rows_->endArray();
+    writes_.add(sql_, rows_->release());
+    rows_.reset();
+    count_ = 0;
+  }
+
+ private:
+  db::Pipeline& writes_;
+  const char* sql_;
+  size_t reserve_;
+  std::optional<serialization::JsonWriter> rows_;
+  size_t count_ = 0;
+};
+
+}  // namespace
+
+static bool isDate(const std::string& s) {
+  if (s.size() != 10 || s[4] != '-' || s[7] != '-') return false;
+  for (size_t i : {0, 1, 2, 3, 5, 6, 8, 9})
+    if (!std::isdigit(static_cast<unsigned char>(s[i]))) return false;
+  const std::chrono::year_month_day ymd{
+      std::chrono::year{std::stoi(s.substr(0, 4))},
+      std::chrono::month{static_cast<unsigned>(std::stoi(s.substr(5, 2)))},
+      std::chrono::day{static_cast<unsigned>(std::stoi(s.substr(8, 2)))}};
+  return ymd.ok();
+}
+
+// Hours that fit NUMERIC(10,2).
+static bool isHours(const Json::Value& v) {
+  return v.isNumeric() && v.asDouble() >= 0 && v.asDouble() < 1e8;
+}
+
+static void writeOptional(serialization::JsonWriter& w, std::string_view key,
+                          const std::optional<std::string>& value) {
+  w.key(key);
+  if (value)
+    w.string(*value);
+  else
+    w.null();
+}
+
+// Reads one task of a bulk import. Returns an error message, empty on
+// success.
+static std::string parseBulkTask(const Json::Value& j, BulkTask& out) {
+  static const std::set<std::string> kPriorities{"low", "normal", "high",
+                                                 "urgent"};
+  static const std::set<std::string> kStatuses{
+      "open", "in_progress", "completed", "cancelled", "pending"};
+
+  if (!j.isObject()) return "each task must be an object";
+  if (!j["temp_id"].isString() || j["temp_id"].asString().empty())
+    return "missing or invalid temp_id";
+  out.tempId = j["temp_id"].asString();
+  if (!j["parent_temp_id"].isNull()) {
+    if (!j["parent_temp_id"].isString()) return "invalid parent_temp_id";
+    out.parentTempId = j["parent_temp_id"].asString();
+  }
+  if (!j["title"].isString() || j["title"].asString().empty())
+    return "missing or invalid title";
+  out.title = j["title"].asString();
+  if (!j["description"].isNull()) {
+    if (!j["description"].isString()) return "invalid description";
+    out.description = j["description"].asString();
+  }
+  if (!j["priority"].isNull()) {
+    if (!j["priority"].isString() ||
+        !kPriorities.count(j["priority"].asString()))
+      return "priority must be one of low, normal, high, urgent";
+    out.priority = j["priority"].asString();
+  }
+  if (!j["status"].isNull()) {
+    if (!j["status"].isString() || !kStatuses.count(j["status"].asString()))
+      return "status must be one of open, in_progress, completed, "
+             "cancelled, pending";
+    out.status = j["status"].asString();
+  }
+  if (!j["estimated_hours"].isNull()) {
+    if (!isHours(j["estimated_hours"])) return "invalid estimated_hours";
+    out.estimatedHours = j["estimated_hours"].asDouble();
+  }
+  for (auto [field, value] : {std::pair{"start_date", &out.startDate},
+                              std::pair{"due_date", &out.dueDate}}) {
+    if (j[field].isNull()) continue;
+    if (!j[field].isString() || !isDate(j[field].asString()))
+      return std::string("invalid ") + field + " (expected YYYY-MM-DD)";
+    *value = j[field].asString();
+  }
+  if (out.startDate && out.dueDate && *out.startDate > *out.dueDate)
+    return "start_date must be earlier or equal to due_date";
+
+  const auto& assignments = j["assignments"];
+  if (assignments.isNull()) return {};
+  if (!assignments.isArray()) return "assignments must be an array";
+  for (const auto& a : assignments) {
+    if (!a.isObject()) return "each assignment must be an object";
+    const auto user = a["user_id"].isString()
+                          ? engine::Uuid::parse(a["user_id"].asString())
+                          : std::nullopt;
+    if (!user) return "missing or invalid assignment user_id";
+    BulkAssignment assignment{user->str(), "executor", 0};
+    for (const auto& other : out.assignments)
+      if (other.userId == assignment.userId)
+        return "user " + assignment.userId + " is assigned twice";
+    if (!a["role"].isNull()) {
+      if (!a["role"].isString() || !engine::parseRole(a["role"].asString()))
+        return "invalid assignment role";
+      assignment.role = a["role"].asString();
+    }
+    if (!a["assigned_hours"].isNull()) {
+      if (!isHours(a["assigned_hours"])) return "invalid assigned_hours";
+      assignment.hours = a["assigned_hours"].asDouble();
+    }
+    out.assignments.push_back(std::move(assignment));
+  }
+  return {};
+}
+
+Task<HttpResponsePtr> TaskController::createTasksBulk(HttpRequestPtr req) {
+  auto attrsPtr = req->attributes();
+  if (!attrsPtr || !attrsPtr->find("user_id")) {
+    auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Unauthorized"));
+    resp->setStatusCode(k401Unauthorized);
+    co_return resp;
+  }
+  const std::string userId = attrsPtr->get<std::string>("user_id");
+  if (userId.empty()) {
+    auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Unauthorized"));
+    resp->setStatusCode(k401Unauthorized);
+    co_return resp;
+  }
+  auto badRequest = [](const std::string& message) {
+    auto resp = HttpResponse::newHttpJsonResponse(Json::Value(message));
+    resp->setStatusCode(k400BadRequest);
+    return resp;
+  };
+
+  auto jsonPtr = req->getJsonObject();
+  if (!jsonPtr || !jsonPtr->isObject()) co_return badRequest("Invalid JSON");
+  const Json::Value& j = *jsonPtr;
+  const auto& items = j["tasks"];
+  if (!items.isArray() || items.empty())
+    co_return badRequest("Missing or empty tasks array");
+  if (items.size() > kMaxBulkTasks)
+    co_return badRequest("At most " + std::to_string(kMaxBulkTasks) +
+                         " tasks per request");
+  std::string parentId;
+  if (!j["parent_task_id"].isNull()) {
+    const auto parent =
+        j["parent_task_id"].isString()
+            ? engine::Uuid::parse(j["parent_task_id"].asString())
+            : std::nullopt;
+    if (!parent) co_return badRequest("Invalid parent_task_id");
+    parentId = parent->str();
+  }
+
+  // The whole tree is checked before the database is touched.
+  const size_t n = items.size();
+  std::vector<BulkTask> tasks(n);
+  std::unordered_map<std::string_view, size_t> byTempId;
+  byTempId.reserve(n);
+  for (size_t i = 0; i < n; ++i) {
+    const auto error =
+        parseBulkTask(items[static_cast<Json::ArrayIndex>(i)], tasks[i]);
+    if (!error.empty())
+      co_return badRequest("Task " + std::to_string(i) + ": " + error);
+    if (!byTempId.emplace(tasks[i].tempId, i).second)
+      co_return badRequest("Task " + std::to_string(i) +
+                           ": duplicate temp_id");
+  }
+
+  // Parents before children, breadth-first from the imported roots. Tasks
+  // that are never reached sit on a parent_temp_id cycle.
+  std::vector<int64_t> parentOf(n, -1);
+  std::vector<std::vector<size_t>> children(n);
+  std::vector<size_t> order;
+  order.reserve(n);
+  for (size_t i = 0; i < n; ++i) {
+    if (tasks[i].parentTempId.empty()) {
+      order.push_back(i);
+      continue;
+    }
+    auto it = byTempId.find(tasks[i].parentTempId);
+    if (it == byTempId.end())
+      co_return badRequest("Task " + std::to_string(i) +
+                           ": unknown parent_temp_id");
+    parentOf[i] = static_cast<int64_t>(it->second);
+    children[it->second].push_back(i);
+  }
+  for (size_t k = 0; k < order.size(); ++k)
+    for (size_t c : children[order[k]]) order.push_back(c);
+  if (order.size() < n)
+    co_return badRequest("parent_temp_id links form a cycle");
+
+  // The creator owns every task, as with POST /api/tasks. A creator who is
+  // also listed keeps the listed hours and role and gets owner besides.
+  std::set<std::string> users;
+  for (auto& t : tasks) {
+    bool listed = false;
+    for (const auto& a : t.assignments) {
+      users.insert(a.userId);
+      listed |= a.userId == userId;
+    }
+    if (!listed) t.assignments.push_back({userId, "owner", 0});
+  }
+
+  auto& pool = db::oltp();
+  try {
+    auto tx = co_await db::Tx::begin(pool);
+
+    std::string projectRoot;
+    if (!parentId.empty()) {
+      auto parentRes = co_await tx.client()->execSqlCoro(
+          "SELECT COALESCE(project_root_id, id)::text AS root FROM \"task\" "
+          "WHERE id = $1 LIMIT 1",
+          parentId);
+      if (parentRes.empty()) co_return badRequest("parent_task_id not found");
+      projectRoot = parentRes[0]["root"].as<std::string>();
+    }
+    if (!users.empty()) {
+      db::ArrayLiteral userLiteral;
+      for (const auto& u : users) userLiteral.add(u);
+      const std::string userArray = userLiteral.release();
+      auto found = co_await tx.client()->execSqlCoro(
+          "SELECT count(*) AS found FROM \"app_user\" "
+          "WHERE id = ANY($1::uuid[])",
+          userArray);
+      if (found[0]["found"].as<int64_t>() !=
+          static_cast<int64_t>(users.size()))
+        co_return badRequest("Unknown assignment user_id");
+    }
+
+    // Ids are drawn up front, so every row and parent link is known before
+    // the first INSERT and nothing has to be read back.
+    auto idRes = co_await tx.client()->execSqlCoro(
+        "SELECT gen_random_uuid()::text AS id "
+        "FROM generate_series(1, $1::int)",
+        std::to_string(n));
+    std::vector<std::string> ids(n), parents(n), roots(n);
+    std::vector<size_t> depth(n, 0);
+    for (size_t i = 0; i < n; ++i) ids[i] = idRes[i]["id"].as<std::string>();
+    for (size_t i : order) {
+      if (parentOf[i] < 0) {
+        parents[i] = parentId;
+        roots[i] = parentId.empty() ? ids[i] : projectRoot;
+      } else {
+        const auto p = static_cast<size_t>(parentOf[i]);
+        parents[i] = ids[p];
+        roots[i] = roots[p];
+        depth[i] = depth[p] + 1;
+      }
+    }
+
+    db::Pipeline writes;
+    // Input order survives in created_at, so siblings list as given.
+    BulkRows taskRows(writes, R"sql(
+        INSERT INTO "task"
+          (id, parent_task_id, title, description, priority, status,
+           estimated_hours, start_date, due_date, project_root_id,
+           created_by, created_at, updated_at)
+        SELECT x.id, x.parent_task_id, x.title, x.description,
+               x.priority::task_priority_enum, x.status::task_status_enum,
+               x.estimated_hours, x.start_date, x.due_date,
+               x.project_root_id, x.created_by,
+               now() + x.ord * interval '1 microsecond',
+               now() + x.ord * interval '1 microsecond'
+        FROM json_to_recordset($1::json) AS x(
+          id uuid, parent_task_id uuid, title text, description text,
+          priority text, status text, estimated_hours numeric,
+          start_date date, due_date date, project_root_id uuid,
+          created_by uuid, ord int)
+      )sql", 320);
+    BulkRows assignmentRows(writes, R"sql(
+        INSERT INTO "task_assignment"
+          (task_id, user_id, assigned_hours, assigned_at)
+        SELECT x.task_id, x.user_id, x.assigned_hours, now()
+        FROM json_to_recordset($1::json)
+             AS x(task_id uuid, user_id uuid, assigned_hours numeric)
+      )sql", 112);
+    BulkRows roleRows(writes, R"sql(
+        INSERT INTO "task_role_assignment"
+          (task_id, user_id, role, assigned_at)
+        SELECT x.task_id, x.user_id, x.role::role_enum, now()
+        FROM json_to_recordset($1::json)
+             AS x(task_id uuid, user_id uuid, role text)
+      )sql", 112);
+
+    std::vector<services::CreatedTask> created(n);
+    std::vector<services::RollupDelta> totals(n);
+    for (size_t i : order) {
+      const auto& t = tasks[i];
+      auto& row = taskRows.begin();
+      row.key("id");
+      row.string(ids[i]);
+      writeOptional(row, "parent_task_id",
+                    parents[i].empty() ? std::nullopt
+                                       : std::optional(parents[i]));
+      row.key("title");
+      row.string(t.title);
+      writeOptional(row, "description", t.description);
+      row.key("priority");
+      row.string(t.priority);
+      row.key("status");
+      row.string(t.status);
+      row.key("estimated_hours");
+      row.raw(db::formatHours(t.estimatedHours));
+      writeOptional(row, "start_date", t.startDate);
+      writeOptional(row, "due_date", t.dueDate);
+      row.key("project_root_id");
+      row.string(roots[i]);
+      row.key("created_by");
+      row.string(userId);
+      row.key("ord");
+      row.number(static_cast<int64_t>(i));
+      taskRows.end();
+
+      created[i].id = ids[i];
+      created[i].parentId = parents[i];
+      created[i].roles.push_back({userId, "owner"});
+      totals[i].taskId = ids[i];
+      totals[i].estimatedHours = t.estimatedHours;
+      for (const auto& a : t.assignments) {
+        auto& assignment = assignmentRows.begin();
+        assignment.key("task_id");
+        assignment.string(ids[i]);
+        assignment.key("user_id");
+        assignment.string(a.userId);
+        assignment.key("assigned_hours");
+        assignment.raw(db::formatHours(a.hours));
+        assignmentRows.end();
+        totals[i].assignedHours += a.hours;
+        if (a.userId != userId || a.role != "owner")
+          created[i].roles.push_back({a.userId, a.role});
+      }
+      for (const auto& [user, role] : created[i].roles) {
+        auto& grant = roleRows.begin();
+        grant.key("task_id");
+        grant.string(ids[i]);
+        grant.key("user_id");
+        grant.string(user);
+        grant.key("role");
+        grant.string(role);
+        roleRows.end();
+      }
     }
+    taskRows.flush();
+    assignmentRows.flush();
+    roleRows.flush();
+
+    // Closure rows one depth level per statement, top level first.
+    std::vector<std::vector<std::string>> levelIds, levelParents;
+    for (size_t i : order) {
+      if (depth[i] == levelIds.size()) {
+        levelIds.emplace_back();
+        levelParents.emplace_back();
+      }
+      levelIds[depth[i]].push_back(ids[i]);
+      levelParents[depth[i]].push_back(parents[i]);
+    }
+    for (size_t d = 0; d < levelIds.size(); ++d)
+      db::closureInsertMany(writes, levelIds[d], levelParents[d]);
+
+    // Subtree totals are summed here, children before parents, and written
+    // once per task; the tree above the import gets the roots' sum.
+    services::RollupDelta above{parentId};
+    for (auto k = order.rbegin(); k != order.rend(); ++k) {
+      const size_t i = *k;
+      auto& target = parentOf[i] < 0
+                         ? above
+                         : totals[static_cast<size_t>(parentOf[i])];
+      target.estimatedHours += totals[i].estimatedHours;
+      target.assignedHours += totals[i].assignedHours;
+    }
+    services::rollups().seed(writes, totals);
+    if (!parentId.empty()) services::rollups().add(writes, {above});
+
+    co_await writes.run(tx.client());
+    co_await tx.commit();
+    services::permissions().tasksCreated(created, userId);
+    if (!parentId.empty()) services::dependencies().structureChanged(parentId);
+    for (const auto& u : users) services::conflicts().markDirty(u);
+    services::simulations().changed();
+    services::forecasts().changed();
+
+    serialization::JsonWriter out(96 * n + 64);
+    out.beginObject();
+    out.key("created");
+    out.number(static_cast<int64_t>(n));
+    out.key("tasks");
+    out.beginArray();
+    for (size_t i = 0; i < n; ++i) {
+      out.beginObject();
+      out.key("temp_id");
+      out.string(tasks[i].tempId);
+      out.key("id");
+      out.string(ids[i]);
+      out.endObject();
+    }
+    out.endArray();
+    out.endObject();
+    co_return serialization::jsonResponse(out, k201Created);
+  } catch (const std::exception& e) {
+    LOG_ERROR << "createTasksBulk failed: " << e.what();
     auto resp =
         HttpResponse::newHttpJsonResponse(Json::Value("Internal server error"));
     resp->setStatusCode(k500InternalServerError);
-    return callback(resp);
+    co_return resp;
   }
 }
 
-void TaskController::getTasks(
-    const HttpRequestPtr& req,
-    std::function<void(const HttpResponsePtr&)>&& callback) {
+Task<HttpResponsePtr> TaskController::getTasks(HttpRequestPtr req) {
   auto attrsPtr = req->attributes();
   if (!attrsPtr || !attrsPtr->find("user_id")) {
     auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Unauthorized"));
     resp->setStatusCode(k401Unauthorized);
-    return callback(resp);
+    co_return resp;
   }
   const std::string userId = attrsPtr->get<std::string>("user_id");
   if (userId.empty()) {
     auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Unauthorized"));
     resp->setStatusCode(k401Unauthorized);
-    return callback(resp);
+    co_return resp;
   }
 
   const std::string parentParam = req->getParameter("parent_task_id");
   const std::string statusParam = req->getParameter("status");
   const std::string priorityParam = req->getParameter("priority");
-  int64_t limit = 100;
+  const int64_t limit = parseLimit(req->getParameter("limit"), 100);
+
+  // Keyset paging on (created_at, id); offset is kept for older clients.
+  const std::string cursorParam = req->getParameter("cursor");
+  std::string cursorCreatedAt;
+  std::string cursorId;
+  if (!cursorParam.empty() &&
+      !decodeCursor(cursorParam, cursorCreatedAt, cursorId)) {
+    auto resp =
+        HttpResponse::newHttpJsonResponse(Json::Value("Invalid cursor"));
+    resp->setStatusCode(k400BadRequest);
+    co_return resp;
+  }
   int64_t offset = 0;
-  const std::string limitParam = req->getParameter("limit");
   const std::string offsetParam = req->getParameter("offset");
-  if (!limitParam.empty()) {
-    try {
-      limit = std::clamp(static_cast<int64_t>(std::stoll(limitParam)), int64_t(1), int64_t(2000));
-    } catch (...) {
-      limit = 100;
-    }
-  }
-  if (!offsetParam.empty()) {
+  if (cursorParam.empty() && !offsetParam.empty()) {
     try {
       offset = std::max(int64_t(0), static_cast<int64_t>(std::stoll(offsetParam)));
     } catch (...) {
@@ -258,81 +779,50 @@ void TaskController::getTasks(
            t.created_by AS created_by,
            t.created_at::text AS created_at,
            t.updated_at::text AS updated_at,
+           to_char(t.created_at AT TIME ZONE 'UTC',
+                   'YYYY-MM-DD"T"HH24:MI:SS.US"Z"') AS created_at_key,
            ta.assigned_hours AS assigned_hours,
-           tr.role AS role
+           tr.role AS role,
+           tr.roles AS roles,
+           ru.subtree_estimated_hours,
+           ru.subtree_assigned_hours,
+           ru.subtree_scheduled_hours
     FROM "task" t
     JOIN "task_assignment" ta ON ta.task_id = t.id
-    LEFT JOIN "task_role_assignment" tr ON tr.task_id = t.id AND tr.user_id = ta.user_id
+  )sql" + std::string(kRolesSql) +
+                    std::string(services::RollupService::kCurrentSql) + R"sql(
     WHERE ta.user_id = $1::uuid
       AND ($2 = '' OR ($2 = 'null' AND t.parent_task_id IS NULL) OR t.parent_task_id = $2::uuid)
       AND ($3 = '' OR t.status::text = $3)
       AND ($4 = '' OR t.priority::text = $4)
-    ORDER BY t.created_at DESC
-    LIMIT )sql" + std::to_string(limit) + " OFFSET " + std::to_string(offset);
+      AND ($5 = '' OR (t.created_at, t.id) < ($5::timestamptz, $6::uuid))
+    ORDER BY t.created_at DESC, t.id DESC
+    LIMIT )sql" + std::to_string(limit + 1) + " OFFSET " + std::to_string(offset);
 
-  auto dbClient = app().getDbClient();
+  auto& pool = db::oltp();
   try {
-    auto tasksRes = dbClient->execSqlSync(sql, userId, parentParam, statusParam,
-                                          priorityParam);
-
-    Json::Value out(Json::arrayValue);
-    for (const auto& row : tasksRes) {
-      Json::Value item(Json::objectValue);
-      item["id"] = row["id"].as<std::string>();
-      if (!row["parent_task_id"].isNull())
-        item["parent_task_id"] = row["parent_task_id"].as<std::string>();
-      else
-        item["parent_task_id"] = Json::Value();
-      item["title"] = row["title"].isNull()
-                          ? Json::Value()
-                          : Json::Value(row["title"].as<std::string>());
-      item["description"] =
-          row["description"].isNull()
-              ? Json::Value()
-              : Json::Value(row["description"].as<std::string>());
-      item["priority"] = row["priority"].isNull()
-                             ? Json::Value()
-                             : Json::Value(row["priority"].as<std::string>());
-      item["status"] = row["status"].isNull()
-                           ? Json::Value()
-                           : Json::Value(row["status"].as<std::string>());
-      item["estimated_hours"] =
-          row["estimated_hours"].isNull()
-              ? Json::Value()
-              : Json::Value(row["estimated_hours"].as<std::string>());
-      item["start_date"] =
-          row["start_date"].isNull()
-              ? Json::Value()
-              : Json::Value(row["start_date"].as<std::string>());
-      item["due_date"] = row["due_date"].isNull()
-                             ? Json::Value()
-                             : Json::Value(row["due_date"].as<std::string>());
-      item["project_root_id"] =
-          row["project_root_id"].isNull()
-              ? Json::Value()
-              : Json::Value(row["project_root_id"].as<std::string>());
-      item["created_by"] =
-          row["created_by"].isNull()
-              ? Json::Value()
-              : Json::Value(row["created_by"].as<std::string>());
-      item["created_at"] =
-          row["created_at"].isNull()
-              ? Json::Value()
-              : Json::Value(row["created_at"].as<std::string>());
-      item["updated_at"] =
-          row["updated_at"].isNull()
-              ? Json::Value()
-              : Json::Value(row["updated_at"].as<std::string>());
-
-      item["assigned_hours"] =
-          row["assigned_hours"].isNull()
-              ? Json::Value()
-              : Json::Value(row["assigned_hours"].as<std::string>());
-      item["role"] = row["role"].isNull()
-                         ? Json::Value()
-                         : Json::Value(row["role"].as<std::string>());
-
-      auto schedules = dbClient->execSqlSync(
+    auto tasksRes = co_await pool.exec(sql, userId, parentParam, statusParam,
+                                       priorityParam, cursorCreatedAt,
+                                       cursorId);
+
+    // One extra row was requested to tell whether another page exists.
+    const size_t rows = std::min(tasksRes.size(), static_cast<size_t>(limit));
+    std::string nextCursor;
+    if (tasksRes.size() > rows)
+      nextCursor = encodeCursor(
+          tasksRes[rows - 1]["created_at_key"].as<std::string>(),
+          tasksRes[rows - 1]["id"].as<std::string>());
+
+    // One round trip for the schedules of the whole page, merged by task id.
+    std::unordered_map<std::string_view, std::vector<size_t>> schedulesByTask;
+    std::optional<drogon::orm::Result> schedules;
+    if (rows > 0) {
+      db::ArrayLiteral idLiteral;
+      for (size_t i = 0; i < rows; ++i)
+        idLiteral.add(serialization::fieldView(tasksRes[i]["id"]));
+      const std::string idArray = idLiteral.release();
+
+      schedules = co_await pool.exec(
           R"sql(
           SELECT ts.id::text AS id,
                  ts.task_id::text AS task_id,
@@ -341,57 +831,71 @@ void TaskController::getTasks(
                  ts.end_ts::time::text AS end_time,
                  ts.hours
           FROM "task_schedule" ts
-          WHERE ts.task_id = $1
-          ORDER BY ts.start_ts
+          WHERE ts.task_id = ANY($1::uuid[])
+          ORDER BY ts.task_id, ts.start_ts
         )sql",
-          item["id"].asString());
-      Json::Value scheduleArr(Json::arrayValue);
-      for (const auto& srow : schedules) {
-        Json::Value s(Json::objectValue);
-        s["id"] = srow["id"].isNull()
-                      ? Json::Value()
-                      : Json::Value(srow["id"].as<std::string>());
-        s["date"] = srow["date"].isNull()
-                        ? Json::Value()
-                        : Json::Value(srow["date"].as<std::string>());
-        s["start_time"] =
-            srow["start_time"].isNull()
-                ? Json::Value()
-                : Json::Value(srow["start_time"].as<std::string>());
-        s["end_time"] = srow["end_time"].isNull()
-                            ? Json::Value()
-                            : Json::Value(srow["end_time"].as<std::string>());
-        s["hours"] = srow["hours"].isNull()
-                         ? Json::Value()
-                         : Json::Value(srow["hours"].as<std::string>());
-        scheduleArr.append(s);
-      }
-      item["schedule"] = scheduleArr;
+          idArray);
+      schedulesByTask.reserve(rows);
+      for (size_t i = 0; i < schedules->size(); ++i)
+        schedulesByTask[serialization::fieldView((*schedules)[i]["task_id"])]
+            .push_back(i);
+    }
 
-      out.append(item);
+    serialization::JsonWriter out(512 * rows + 2);
+    out.beginArray();
+    for (size_t i = 0; i < rows; ++i) {
+      const auto& row = tasksRes[i];
+      out.beginObject();
+      for (const char* column :
+           {"id", "parent_task_id", "title", "description", "priority",
+            "status", "estimated_hours", "start_date", "due_date",
+            "project_root_id", "created_by", "created_at", "updated_at",
+            "assigned_hours", "role", "subtree_estimated_hours",
+            "subtree_assigned_hours", "subtree_scheduled_hours"})
+        serialization::writeField(out, column, row[column]);
+      out.key("roles");
+      out.raw(serialization::fieldView(row["roles"]));
+
+      out.key("schedule");
+      out.beginArray();
+      auto it = schedulesByTask.find(serialization::fieldView(row["id"]));
+      if (it != schedulesByTask.end()) {
+        for (auto si : it->second) {
+          const auto& srow = (*schedules)[si];
+          out.beginObject();
+          for (const char* column :
+               {"id", "date", "start_time", "end_time", "hours"})
+            serialization::writeField(out, column, srow[column]);
+          out.endObject();
+        }
+      }
+      out.endArray();
+      out.endObject();
     }
+    out.endArray();
 
-    auto resp = HttpResponse::newHttpJsonResponse(out);
-    resp->setStatusCode(k200OK);
-    return callback(resp);
+    // The body stays a plain array for existing clients; the cursor for the
+    // following page travels in a header.
+    auto resp = serialization::jsonResponse(out);
+    if (!nextCursor.empty()) resp->addHeader("X-Next-Cursor", nextCursor);
+    if (offset > 0) resp->addHeader("Deprecation", "true");
+    co_return resp;
 
   } catch (const std::exception& e) {
     LOG_ERROR << "getTasks failed for user " << userId << ": " << e.what();
     auto resp =
         HttpResponse::newHttpJsonResponse(Json::Value("Internal server error"));
     resp->setStatusCode(k500InternalServerError);
-    return callback(resp);
+    co_return resp;
   }
 }
 
-void TaskController::updateTask(
-    const HttpRequestPtr& req,
-    std::function<void(const HttpResponsePtr&)>&& callback) {
+Task<HttpResponsePtr> TaskController::updateTask(HttpRequestPtr req) {
   auto jsonPtr = req->getJsonObject();
   if (!jsonPtr || !jsonPtr->isObject()) {
     auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Invalid JSON"));
     resp->setStatusCode(k400BadRequest);
-    return callback(resp);
+    co_return resp;
   }
   const Json::Value& j = *jsonPtr;
 
@@ -403,51 +907,79 @@ void TaskController::updateTask(
     auto resp =
         HttpResponse::newHttpJsonResponse(Json::Value("Missing task id"));
     resp->setStatusCode(k400BadRequest);
-    return callback(resp);
+    co_return resp;
   }
 
   auto attrsPtr = req->attributes();
   if (!attrsPtr || !attrsPtr->find("user_id")) {
     auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Unauthorized"));
     resp->setStatusCode(k401Unauthorized);
-    return callback(resp);
+    co_return resp;
   }
   const std::string userId = attrsPtr->get<std::string>("user_id");
   if (userId.empty()) {
     auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Unauthorized"));
     resp->setStatusCode(k401Unauthorized);
-    return callback(resp);
+    co_return resp;
   }
 
-  auto dbClient = app().getDbClient();
+  auto& pool = db::oltp();
   try {
-    auto exists = dbClient->execSqlSync(
+    auto exists = co_await pool.exec(
         "SELECT id FROM \"task\" WHERE id = $1 LIMIT 1", taskId);
     if (exists.empty()) {
       auto resp =
           HttpResponse::newHttpJsonResponse(Json::Value("Task not found"));
       resp->setStatusCode(k404NotFound);
-      return callback(resp);
+      co_return resp;
     }
-    if (!hasOwnerPermission(dbClient, taskId, userId)) {
+    if (!co_await services::permissions().check(userId, taskId,
+                                                "task.update.local")) {
       auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Forbidden"));
       resp->setStatusCode(k403Forbidden);
-      return callback(resp);
+      co_return resp;
     }
 
-    auto res = dbClient->execSqlSync(
+    // Moving a task needs the same right on the parent it goes under.
+    const bool reparent = j.isMember("parent_task_id");
+    if (reparent && !j["parent_task_id"].isNull()) {
+      const auto& parent = j["parent_task_id"];
+      if (!parent.isString() || !engine::Uuid::parse(parent.asString())) {
+        auto resp = HttpResponse::newHttpJsonResponse(
+            Json::Value("Invalid parent_task_id"));
+        resp->setStatusCode(k400BadRequest);
+        co_return resp;
+      }
+      if (!co_await services::permissions().check(
+              userId, parent.asString(), "task.update.local")) {
+        auto resp =
+            HttpResponse::newHttpJsonResponse(Json::Value("Forbidden"));
+        resp->setStatusCode(k403Forbidden);
+        co_return resp;
+      }
+    }
+
+    // The row stays locked until commit so the rollup delta below is taken
+    // against the value this update replaces.
+    auto tx = co_await db::Tx::begin(pool);
+    // Moves run one at a time, so two of them cannot close a cycle between
+    // them. The lock comes before any row lock a move may wait on.
+    if (reparent)
+      co_await tx.client()->execSqlCoro(
+          "SELECT pg_advisory_xact_lock(hashtext('task.move'))");
+    auto res = co_await tx.client()->execSqlCoro(
         R"sql(
         SELECT id, parent_task_id, title, description, priority, status, estimated_hours,
                start_date::text AS start_date, due_date::text AS due_date,
                project_root_id, created_by, created_at::text AS created_at, updated_at::text AS updated_at
-        FROM "task" WHERE id = $1 LIMIT 1
+        FROM "task" WHERE id = $1 LIMIT 1 FOR UPDATE
       )sql",
         taskId);
     if (res.empty()) {
       auto resp =
           HttpResponse::newHttpJsonResponse(Json::Value("Task not found"));
       resp->setStatusCode(k404NotFound);
-      return callback(resp);
+      co_return resp;
     }
     drogon_model::project_calendar::Task task(res[0], -1);
 
@@ -456,13 +988,53 @@ void TaskController::updateTask(
     } catch (...) {
     }
     task.setUpdatedAt(::trantor::Date::now());
+    // project_root_id follows the tree and is not set by clients.
+    if (res[0]["project_root_id"].isNull())
+      task.setProjectRootIdToNull();
+    else
+      task.setProjectRootId(res[0]["project_root_id"].as<std::string>());
+
+    // A task that changes parent takes its subtree totals along.
+    const auto& oldParent = res[0]["parent_task_id"];
+    const auto& newParent = task.getParentTaskId();
+    const bool moving =
+        oldParent.isNull()
+            ? newParent != nullptr
+            : !newParent || *newParent != oldParent.as<std::string>();
+    if (moving && newParent) {
+      auto target = co_await tx.client()->execSqlCoro(
+          R"sql(
+          SELECT EXISTS (SELECT 1 FROM task_closure
+                         WHERE ancestor = $1::uuid
+                           AND descendant = $2::uuid) AS cycle
+          FROM "task" WHERE id = $2::uuid
+        )sql",
+          taskId, *newParent);
+      if (target.empty()) {
+        auto resp = HttpResponse::newHttpJsonResponse(
+            Json::Value("Parent task not found"));
+        resp->setStatusCode(k404NotFound);
+        co_return resp;
+      }
+      if (target[0]["cycle"].as<bool>()) {
+        auto resp = HttpResponse::newHttpJsonResponse(Json::Value(
+            "Cannot move a task under itself or one of its subtasks"));
+        resp->setStatusCode(k409Conflict);
+        co_return resp;
+      }
+    }
+    if (moving) {
+      db::Pipeline detach;
+      services::rollups().detach(detach, taskId);
+      co_await detach.run(tx.client());
+    }
 
-    drogon::orm::Mapper<drogon_model::project_calendar::Task> taskMapper(
-        dbClient);
     task.setId(taskId);
-    taskMapper.update(task);
+    co_await drogon::orm::CoroMapper<drogon_model::project_calendar::Task>(
+        tx.client())
+        .update(task);
 
-    auto finalRes = dbClient->execSqlSync(
+    auto finalRes = co_await tx.client()->execSqlCoro(
         R"sql(
         SELECT id, parent_task_id, title, description, priority, status, estimated_hours,
                start_date::text AS start_date, due_date::text AS due_date,
@@ -474,103 +1046,183 @@ void TaskController::updateTask(
       auto resp = HttpResponse::newHttpJsonResponse(
           Json::Value("Task updated but cannot fetch it"));
       resp->setStatusCode(k500InternalServerError);
-      return callback(resp);
+      co_return resp;
+    }
+    auto hoursOf = [](const drogon::orm::Result& r) {
+      const auto& hours = r[0]["estimated_hours"];
+      return hours.isNull() ? 0.0 : hours.as<double>();
+    };
+    db::Pipeline writes;
+    if (moving) {
+      const auto& parent = finalRes[0]["parent_task_id"];
+      db::closureMove(writes, taskId,
+                      parent.isNull() ? "" : parent.as<std::string>());
+      db::resetProjectRoot(writes, taskId);
+      services::rollups().attach(writes, taskId);
     }
+    services::rollups().add(writes,
+                            {{taskId, hoursOf(finalRes) - hoursOf(res)}});
+    co_await writes.run(tx.client());
+    co_await tx.commit();
+
+    auto changed = [&](const char* column) {
+      const auto& before = res[0][column];
+      const auto& after = finalRes[0][column];
+      return before.isNull() != after.isNull() ||
+             (!before.isNull() &&
+              before.as<std::string>() != after.as<std::string>());
+    };
+    if (changed("parent_task_id")) {
+      const auto& parent = finalRes[0]["parent_task_id"];
+      services::permissions().taskMoved(
+          taskId, parent.isNull() ? "" : parent.as<std::string>());
+      services::dependencies().structureChanged(taskId);
+      if (!res[0]["parent_task_id"].isNull())
+        services::dependencies().structureChanged(
+            res[0]["parent_task_id"].as<std::string>());
+      if (!parent.isNull())
+        services::dependencies().structureChanged(parent.as<std::string>());
+    } else if (changed("estimated_hours")) {
+      const auto& hours = finalRes[0]["estimated_hours"];
+      services::dependencies().durationChanged(
+          taskId, hours.isNull() ? 0.0 : hours.as<double>());
+    }
+    services::simulations().changed();
+    services::forecasts().changed();
+
+    // Auto-placed blocks follow the task's dates and hours.
+    const bool replan = changed("start_date") || changed("due_date") ||
+                        changed("estimated_hours");
+    if (replan) {
+      try {
+        co_await services::scheduling().rescheduleTask(taskId);
+      } catch (const std::exception& e) {
+        LOG_WARN << "Re-scheduling task " << taskId
+                 << " after update failed: " << e.what();
+      }
+    }
+
     drogon_model::project_calendar::Task updated(finalRes[0], -1);
     auto out = updated.toJson();
     auto resp = HttpResponse::newHttpJsonResponse(out);
     resp->setStatusCode(k200OK);
-    return callback(resp);
+    co_return resp;
 
   } catch (const std::exception& e) {
     LOG_ERROR << "updateTask failed: " << e.what();
     auto resp =
         HttpResponse::newHttpJsonResponse(Json::Value("Internal server error"));
     resp->setStatusCode(k500InternalServerError);
-    return callback(resp);
+    co_return resp;
   }
 }
 
-void TaskController::deleteTask(
-    const HttpRequestPtr& req,
-    std::function<void(const HttpResponsePtr&)>&& callback) {
+Task<HttpResponsePtr> TaskController::deleteTask(HttpRequestPtr req) {
   std::string taskId = getPathVariableCompat(req, "task_id");
   if (taskId.empty()) {
     auto resp =
         HttpResponse::newHttpJsonResponse(Json::Value("Missing task id"));
     resp->setStatusCode(k400BadRequest);
-    return callback(resp);
+    co_return resp;
   }
 
   auto attrsPtr = req->attributes();
   if (!attrsPtr || !attrsPtr->find("user_id")) {
     auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Unauthorized"));
     resp->setStatusCode(k401Unauthorized);
-    return callback(resp);
+    co_return resp;
   }
   const std::string userId = attrsPtr->get<std::string>("user_id");
   if (userId.empty()) {
     auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Unauthorized"));
     resp->setStatusCode(k401Unauthorized);
-    return callback(resp);
+    co_return resp;
   }
 
-  auto dbClient = app().getDbClient();
+  auto& pool = db::oltp();
   try {
-    auto exists = dbClient->execSqlSync(
+    auto exists = co_await pool.exec(
         "SELECT id FROM \"task\" WHERE id = $1 LIMIT 1", taskId);
     if (exists.empty()) {
       auto resp =
           HttpResponse::newHttpJsonResponse(Json::Value("Task not found"));
       resp->setStatusCode(k404NotFound);
-      return callback(resp);
+      co_return resp;
     }
-    if (!hasOwnerPermission(dbClient, taskId, userId)) {
+    if (!co_await services::permissions().check(userId, taskId,
+                                                "task.delete.local")) {
       auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Forbidden"));
       resp->setStatusCode(k403Forbidden);
-      return callback(resp);
+      co_return resp;
     }
 
-    dbClient->execSqlSync("BEGIN");
-    dbClient->execSqlSync("DELETE FROM \"task_schedule\" WHERE task_id = $1",
-                          taskId);
-    dbClient->execSqlSync(
-        "DELETE FROM \"task_role_assignment\" WHERE task_id = $1", taskId);
-    dbClient->execSqlSync("DELETE FROM \"task_assignment\" WHERE task_id = $1",
-                          taskId);
-    dbClient->execSqlSync("DELETE FROM \"task\" WHERE id = $1", taskId);
-    dbClient->execSqlSync("COMMIT");
+    auto tx = co_await db::Tx::begin(pool);
+    db::Pipeline deletes;
+    // Reads the subtree totals, so it goes before any of the deletes.
+    services::rollups().detach(deletes, taskId);
+    // Blocks of the subtasks would go with the cascade; deleting them here
+    // reports them for the free-slot indexes.
+    const size_t scheduleIdx = deletes.size();
+    deletes.add(
+        R"sql(
+        WITH RECURSIVE subtree AS (
+          SELECT id FROM task WHERE id = $1::uuid
+          UNION ALL
+          SELECT t.id FROM task t JOIN subtree s ON t.parent_task_id = s.id
+        )
+        DELETE FROM "task_schedule" ts
+        USING subtree s
+        WHERE ts.task_id = s.id
+        RETURNING ts.user_id::text AS user_id,
+                  floor(EXTRACT(EPOCH FROM ts.start_ts) / 60)::bigint
+                    AS start_minute,
+                  ceil(EXTRACT(EPOCH FROM ts.end_ts) / 60)::bigint
+                    AS end_minute
+      )sql",
+        taskId);
+    deletes.add("DELETE FROM \"task_role_assignment\" WHERE task_id = $1",
+                taskId);
+    deletes.add("DELETE FROM \"task_assignment\" WHERE task_id = $1", taskId);
+    deletes.add("DELETE FROM \"task\" WHERE id = $1", taskId);
+    const auto deleted = co_await deletes.run(tx.client());
+    co_await tx.commit();
+    services::permissions().taskDeleted(taskId);
+    services::dependencies().taskDeleted(taskId);
+    services::simulations().changed();
+    services::forecasts().changed();
+    std::unordered_map<std::string, std::vector<engine::Interval>> freed;
+    for (const auto& row : deleted[scheduleIdx])
+      freed[row["user_id"].as<std::string>()].push_back(
+          {row["start_minute"].as<int64_t>(), row["end_minute"].as<int64_t>()});
+    for (const auto& [user, blocks] : freed) {
+      services::availability().blocksChanged(user, blocks, {});
+      services::conflicts().markDirty(user);
+    }
 
     auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Deleted"));
     resp->setStatusCode(k200OK);
-    return callback(resp);
+    co_return resp;
   } catch (const std::exception& e) {
     LOG_ERROR << "deleteTask failed: " << e.what();
-    try {
-      dbClient->execSqlSync("ROLLBACK");
-    } catch (...) {
-    }
     auto resp =
         HttpResponse::newHttpJsonResponse(Json::Value("Internal server error"));
     resp->setStatusCode(k500InternalServerError);
-    return callback(resp);
+    co_return resp;
   }
 }
 
-void TaskController::getSubtasks(
-    const HttpRequestPtr& req,
-    std::function<void(const HttpResponsePtr&)>&& callback) {
+Task<HttpResponsePtr> TaskController::getSubtasks(HttpRequestPtr req) {
   auto attrsPtr = req->attributes();
   if (!attrsPtr || !attrsPtr->find("user_id")) {
     auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Unauthorized"));
     resp->setStatusCode(k401Unauthorized);
-    return callback(resp);
+    co_return resp;
   }
   const std::string userId = attrsPtr->get<std::string>("user_id");
   if (userId.empty()) {
     auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Unauthorized"));
     resp->setStatusCode(k401Unauthorized);
-    return callback(resp);
+    co_return resp;
   }
 
   const std::string parentId = getPathVariableCompat(req, "id");
@@ -578,72 +1230,194 @@ void TaskController::getSubtasks(
     auto resp = HttpResponse::newHttpJsonResponse(
         Json::Value("Missing parent task id"));
     resp->setStatusCode(k400BadRequest);
-    return callback(resp);
+    co_return resp;
   }
 
-  auto dbClient = app().getDbClient();
-  try {
-    auto res = dbClient->execSqlSync(
-        R"sql(
+  // Without limit or cursor every child is returned, as before.
+  const std::string limitParam = req->getParameter("limit");
+  const std::string cursorParam = req->getParameter("cursor");
+  const bool paged = !limitParam.empty() || !cursorParam.empty();
+  const int64_t limit = parseLimit(limitParam, 100);
+  std::string cursorCreatedAt;
+  std::string cursorId;
+  if (!cursorParam.empty() &&
+      !decodeCursor(cursorParam, cursorCreatedAt, cursorId)) {
+    auto resp =
+        HttpResponse::newHttpJsonResponse(Json::Value("Invalid cursor"));
+    resp->setStatusCode(k400BadRequest);
+    co_return resp;
+  }
+
+  std::string sql = R"sql(
         SELECT t.id, t.title, t.description, t.priority, t.status,
                t.start_date::text AS start_date, t.due_date::text AS due_date,
-               ta.assigned_hours, tr.role
+               to_char(t.created_at AT TIME ZONE 'UTC',
+                       'YYYY-MM-DD"T"HH24:MI:SS.US"Z"') AS created_at_key,
+               ta.assigned_hours, tr.role, tr.roles,
+               ru.subtree_estimated_hours, ru.subtree_assigned_hours,
+               ru.subtree_scheduled_hours
         FROM "task" t
         JOIN "task_assignment" ta ON ta.task_id = t.id
-        LEFT JOIN "task_role_assignment" tr ON tr.task_id = t.id AND tr.user_id = ta.user_id
+      )sql" + std::string(kRolesSql) +
+                    std::string(services::RollupService::kCurrentSql) + R"sql(
         WHERE ta.user_id = $1 AND t.parent_task_id = $2
-        ORDER BY t.created_at DESC
-      )sql",
-        userId, parentId);
+          AND ($3 = '' OR (t.created_at, t.id) < ($3::timestamptz, $4::uuid))
+        ORDER BY t.created_at DESC, t.id DESC
+      )sql";
+  if (paged) sql += " LIMIT " + std::to_string(limit + 1);
 
-    Json::Value out(Json::arrayValue);
-    for (const auto& row : res) {
-      Json::Value it(Json::objectValue);
-      it["id"] = row["id"].as<std::string>();
-      it["title"] = row["title"].isNull()
-                        ? Json::Value()
-                        : Json::Value(row["title"].as<std::string>());
-      it["description"] =
-          row["description"].isNull()
-              ? Json::Value()
-              : Json::Value(row["description"].as<std::string>());
-      it["priority"] = row["priority"].isNull()
-                           ? Json::Value()
-                           : Json::Value(row["priority"].as<std::string>());
-      it["status"] = row["status"].isNull()
-                         ? Json::Value()
-                         : Json::Value(row["status"].as<std::string>());
-      it["start_date"] = row["start_date"].isNull()
-                             ? Json::Value()
-                             : Json::Value(row["start_date"].as<std::string>());
-      it["due_date"] = row["due_date"].isNull()
-                           ? Json::Value()
-                           : Json::Value(row["due_date"].as<std::string>());
-      it["assigned_hours"] =
-          row["assigned_hours"].isNull()
-              ? Json::Value()
-              : Json::Value(row["assigned_hours"].as<std::string>());
-      it["role"] = row["role"].isNull()
-                       ? Json::Value()
-                       : Json::Value(row["role"].as<std::string>());
-      out.append(it);
+  auto& pool = db::oltp();
+  try {
+    auto res = co_await pool.exec(sql, userId, parentId, cursorCreatedAt,
+                                  cursorId);
+
+    const size_t rows =
+        paged ? std::min(res.size(), static_cast<size_t>(limit)) : res.size();
+    std::string nextCursor;
+    if (res.size() > rows)
+      nextCursor = encodeCursor(
+          res[rows - 1]["created_at_key"].as<std::string>(),
+          res[rows - 1]["id"].as<std::string>());
+
+    serialization::JsonWriter out(256 * rows + 2);
+    out.beginArray();
+    for (size_t i = 0; i < rows; ++i) {
+      const auto& row = res[i];
+      out.beginObject();
+      for (const char* column :
+           {"id", "title", "description", "priority", "status", "start_date",
+            "due_date", "assigned_hours", "role", "subtree_estimated_hours",
+            "subtree_assigned_hours", "subtree_scheduled_hours"})
+        serialization::writeField(out, column, row[column]);
+      out.key("roles");
+      out.raw(serialization::fieldView(row["roles"]));
+      out.endObject();
     }
+    out.endArray();
 
-    auto resp = HttpResponse::newHttpJsonResponse(out);
-    resp->setStatusCode(k200OK);
-    return callback(resp);
+    auto resp = serialization::jsonResponse(out);
+    if (!nextCursor.empty()) resp->addHeader("X-Next-Cursor", nextCursor);
+    co_return resp;
   } catch (const std::exception& e) {
     LOG_ERROR << "getSubtasks failed: " << e.what();
     auto resp =
         HttpResponse::newHttpJsonResponse(Json::Value("Internal server error"));
     resp->setStatusCode(k500InternalServerError);
-    return callback(resp);
+    co_return resp;
   }
 }
 
-void TaskController::createAssignment(
-    const HttpRequestPtr& req,
-    std::function<void(const HttpResponsePtr&)>&& callback) {
+Task<HttpResponsePtr> TaskController::getTree(HttpRequestPtr req,
+                                              std::string taskId) {
+  auto attrsPtr = req->attributes();
+  if (!attrsPtr || !attrsPtr->find("user_id")) {
+    auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Unauthorized"));
+    resp->setStatusCode(k401Unauthorized);
+    co_return resp;
+  }
+  const std::string userId = attrsPtr->get<std::string>("user_id");
+  if (!engine::Uuid::parse(taskId)) {
+    auto resp =
+        HttpResponse::newHttpJsonResponse(Json::Value("Invalid task id"));
+    resp->setStatusCode(k400BadRequest);
+    co_return resp;
+  }
+
+  try {
+    if (!co_await services::permissions().check(userId, taskId,
+                                                "task.view.local")) {
+      auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Forbidden"));
+      resp->setStatusCode(k403Forbidden);
+      co_return resp;
+    }
+
+    // The whole subtree in one range scan of the closure's primary key,
+    // parents before children and siblings in creation order.
+    auto res = co_await db::reports().exec(
+        std::string(R"sql(
+        SELECT t.id, t.parent_task_id, c.depth, t.title, t.description,
+               t.priority, t.status, t.estimated_hours,
+               t.start_date::text AS start_date, t.due_date::text AS due_date,
+               ru.subtree_estimated_hours, ru.subtree_assigned_hours,
+               ru.subtree_scheduled_hours
+        FROM task_closure c
+        JOIN "task" t ON t.id = c.descendant
+      )sql") + services::RollupService::kCurrentSql + R"sql(
+        WHERE c.ancestor = $1::uuid
+        ORDER BY c.depth, t.created_at, t.id
+        LIMIT )sql" + std::to_string(kMaxTreeTasks + 1),
+        taskId);
+    if (res.empty()) {
+      auto resp =
+          HttpResponse::newHttpJsonResponse(Json::Value("Task not found"));
+      resp->setStatusCode(k404NotFound);
+      co_return resp;
+    }
+    if (res.size() > static_cast<size_t>(kMaxTreeTasks)) {
+      auto resp = HttpResponse::newHttpJsonResponse(
+          Json::Value("Subtree has more than " +
+                      std::to_string(kMaxTreeTasks) +
+                      " tasks; request a smaller one"));
+      resp->setStatusCode(k400BadRequest);
+      co_return resp;
+    }
+
+    // Depth-first order from the parent links; children were read in
+    // sibling order, so they are pushed in reverse.
+    std::unordered_map<std::string_view, std::vector<size_t>> children;
+    children.reserve(res.size());
+    for (size_t i = 1; i < res.size(); ++i)
+      children[serialization::fieldView(res[i]["parent_task_id"])].push_back(
+          i);
+    auto order = std::make_shared<std::vector<size_t>>();
+    order->reserve(res.size());
+    std::vector<size_t> stack{0};
+    while (!stack.empty()) {
+      const size_t i = stack.back();
+      stack.pop_back();
+      order->push_back(i);
+      auto it = children.find(serialization::fieldView(res[i]["id"]));
+      if (it != children.end())
+        stack.insert(stack.end(), it->second.rbegin(), it->second.rend());
+    }
+
+    auto resp = HttpResponse::newAsyncStreamResponse(
+        [res, order](ResponseStreamPtr stream) {
+          serialization::JsonWriter out(kTreeChunkBytes + 1024);
+          out.beginArray();
+          for (const size_t i : *order) {
+            const auto& row = res[i];
+            out.beginObject();
+            for (const char* column : {"id", "parent_task_id"})
+              serialization::writeField(out, column, row[column]);
+            out.key("depth");
+            out.raw(serialization::fieldView(row["depth"]));
+            for (const char* column :
+                 {"title", "description", "priority", "status",
+                  "estimated_hours", "start_date", "due_date",
+                  "subtree_estimated_hours", "subtree_assigned_hours",
+                  "subtree_scheduled_hours"})
+              serialization::writeField(out, column, row[column]);
+            out.endObject();
+            if (out.size() >= kTreeChunkBytes && !stream->send(out.flush()))
+              return;
+          }
+          out.endArray();
+          stream->send(out.flush());
+          stream->close();
+        });
+    resp->setContentTypeCode(CT_APPLICATION_JSON);
+    co_return resp;
+  } catch (const std::exception& e) {
+    LOG_ERROR << "getTree failed for task " << taskId << ": " << e.what();
+    auto resp =
+        HttpResponse::newHttpJsonResponse(Json::Value("Internal server error"));
+    resp->setStatusCode(k500InternalServerError);
+    co_return resp;
+  }
+}
+
+Task<HttpResponsePtr> TaskController::createAssignment(HttpRequestPtr req) {
   // Get task_id from URL path
   std::string taskId = getPathVariableCompat(req, "task_id");
   
@@ -664,14 +1438,14 @@ void TaskController::createAssignment(
   if (taskId.empty()) {
     auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Missing task_id"));
     resp->setStatusCode(k400BadRequest);
-    return callback(resp);
+    co_return resp;
   }
 
   auto jsonPtr = req->getJsonObject();
   if (!jsonPtr || !jsonPtr->isObject()) {
     auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Invalid JSON"));
     resp->setStatusCode(k400BadRequest);
-    return callback(resp);
+    co_return resp;
   }
   const Json::Value& j = *jsonPtr;
 
@@ -680,7 +1454,7 @@ void TaskController::createAssignment(
   if (!attrsPtr || !attrsPtr->find("user_id")) {
     auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Unauthorized"));
     resp->setStatusCode(k401Unauthorized);
-    return callback(resp);
+    co_return resp;
   }
   const std::string requester = attrsPtr->get<std::string>("user_id");
 
@@ -700,24 +1474,25 @@ void TaskController::createAssignment(
     }
   }
 
-  auto dbClient = app().getDbClient();
+  auto& pool = db::oltp();
   try {
-    if (!hasOwnerPermission(dbClient, taskId, requester)) {
+    if (!co_await services::permissions().check(requester, taskId,
+                                                "assignment.assign.local")) {
       auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Forbidden"));
       resp->setStatusCode(k403Forbidden);
-      return callback(resp);
+      co_return resp;
     }
 
-    auto t = dbClient->execSqlSync(
+    auto t = co_await pool.exec(
         "SELECT id FROM \"task\" WHERE id = $1 LIMIT 1", taskId);
     if (t.empty()) {
       auto resp =
           HttpResponse::newHttpJsonResponse(Json::Value("Task not found"));
       resp->setStatusCode(k404NotFound);
-      return callback(resp);
+      co_return resp;
     }
 
-    auto ex = dbClient->execSqlSync(
+    auto ex = co_await pool.exec(
         "SELECT id FROM \"task_assignment\" WHERE task_id = $1 AND user_id = "
         "$2 LIMIT 1",
         taskId, assUserId);
@@ -725,29 +1500,29 @@ void TaskController::createAssignment(
       auto resp = HttpResponse::newHttpJsonResponse(
           Json::Value("Assignment already exists"));
       resp->setStatusCode(k409Conflict);
-      return callback(resp);
-    }
-
-    dbClient->execSqlSync("BEGIN");
-    drogon_model::project_calendar::TaskAssignment ta;
-    ta.setTaskId(taskId);
-    ta.setUserId(assUserId);
-    if (assignedHours) ta.setAssignedHours(std::to_string(*assignedHours));
-    ta.setAssignedAt(::trantor::Date::now());
-    drogon::orm::Mapper<drogon_model::project_calendar::TaskAssignment>
-        taMapper(dbClient);
-    taMapper.insert(ta);
-
-    drogon_model::project_calendar::TaskRoleAssignment tra;
-    tra.setTaskId(taskId);
-    tra.setUserId(assUserId);
-    tra.setRole(role);
-    tra.setAssignedAt(::trantor::Date::now());
-    drogon::orm::Mapper<drogon_model::project_calendar::TaskRoleAssignment>
-        traMapper(dbClient);
-    traMapper.insert(tra);
-
-    dbClient->execSqlSync("COMMIT");
+      co_return resp;
+    }
+
+    auto tx = co_await db::Tx::begin(pool);
+    db::Pipeline writes;
+    writes.add(
+        "INSERT INTO \"task_assignment\" (task_id, user_id, assigned_hours, "
+        "assigned_at) VALUES ($1, $2, COALESCE(NULLIF($3, '')::numeric, 0), "
+        "NOW())",
+        taskId, assUserId,
+        assignedHours ? std::to_string(*assignedHours) : std::string());
+    writes.add(
+        "INSERT INTO \"task_role_assignment\" (task_id, user_id, role, "
+        "assigned_at) VALUES ($1, $2, $3, NOW())",
+        taskId, assUserId, role);
+    services::rollups().add(writes,
+                            {{taskId, 0, assignedHours.value_or(0), 0}});
+    co_await writes.run(tx.client());
+    co_await tx.commit();
+    services::permissions().roleGranted(taskId, assUserId, role);
+    services::conflicts().markDirty(assUserId);
+    services::simulations().changed();
+    services::forecasts().changed();
 
     Json::Value out(Json::objectValue);
     out["task_id"] = taskId;
@@ -759,24 +1534,18 @@ void TaskController::createAssignment(
 
     auto resp = HttpResponse::newHttpJsonResponse(out);
     resp->setStatusCode(k201Created);
-    return callback(resp);
+    co_return resp;
 
   } catch (const std::exception& e) {
     LOG_ERROR << "createAssignment failed: " << e.what();
-    try {
-      dbClient->execSqlSync("ROLLBACK");
-    } catch (...) {
-    }
     auto resp =
         HttpResponse::newHttpJsonResponse(Json::Value("Internal server error"));
     resp->setStatusCode(k500InternalServerError);
-    return callback(resp);
+    co_return resp;
   }
 }
 
-void TaskController::listAssignments(
-    const HttpRequestPtr& req,
-    std::function<void(const HttpResponsePtr&)>&& callback) {
+Task<HttpResponsePtr> TaskController::listAssignments(HttpRequestPtr req) {
   std::string taskId = getPathVariableCompat(req, "task_id");
   
   // Fallback: parse from path manually if routing fails
@@ -800,33 +1569,33 @@ void TaskController::listAssignments(
     auto resp =
         HttpResponse::newHttpJsonResponse(Json::Value("Missing task_id"));
     resp->setStatusCode(k400BadRequest);
-    return callback(resp);
+    co_return resp;
   }
 
   auto attrsPtr = req->attributes();
   if (!attrsPtr || !attrsPtr->find("user_id")) {
     auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Unauthorized"));
     resp->setStatusCode(k401Unauthorized);
-    return callback(resp);
+    co_return resp;
   }
   const std::string requester = attrsPtr->get<std::string>("user_id");
 
-  auto dbClient = app().getDbClient();
+  auto& pool = db::oltp();
   try {
-    auto check = dbClient->execSqlSync(
+    auto check = co_await pool.exec(
         "SELECT 1 FROM \"task_assignment\" WHERE task_id = $1 AND user_id = $2 "
         "LIMIT 1",
         taskId, requester);
-    auto created = dbClient->execSqlSync(
+    auto created = co_await pool.exec(
         "SELECT 1 FROM \"task\" WHERE id = $1 AND created_by = $2 LIMIT 1",
         taskId, requester);
     if (check.empty() && created.empty()) {
       auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Forbidden"));
       resp->setStatusCode(k403Forbidden);
-      return callback(resp);
+      co_return resp;
     }
 
-    auto res = dbClient->execSqlSync(
+    auto res = co_await pool.exec(
         R"sql(
         SELECT ta.user_id::text AS user_id,
                ta.assigned_hours AS assigned_hours,
@@ -840,46 +1609,29 @@ void TaskController::listAssignments(
       )sql",
         taskId);
 
-    Json::Value out(Json::arrayValue);
+    serialization::JsonWriter out(160 * res.size() + 2);
+    out.beginArray();
     for (const auto& row : res) {
-      Json::Value it(Json::objectValue);
-      it["user_id"] = row["user_id"].isNull()
-                          ? Json::Value()
-                          : Json::Value(row["user_id"].as<std::string>());
-      it["assigned_hours"] =
-          row["assigned_hours"].isNull()
-              ? Json::Value()
-              : Json::Value(row["assigned_hours"].as<std::string>());
-      it["assigned_at"] =
-          row["assigned_at"].isNull()
-              ? Json::Value()
-              : Json::Value(row["assigned_at"].as<std::string>());
-      it["role"] = row["role"].isNull()
-                       ? Json::Value()
-                       : Json::Value(row["role"].as<std::string>());
-      it["role_assigned_at"] =
-          row["role_assigned_at"].isNull()
-              ? Json::Value()
-              : Json::Value(row["role_assigned_at"].as<std::string>());
-      out.append(it);
+      out.beginObject();
+      for (const char* column : {"user_id", "assigned_hours", "assigned_at",
+                                 "role", "role_assigned_at"})
+        serialization::writeField(out, column, row[column]);
+      out.endObject();
     }
+    out.endArray();
 
-    auto resp = HttpResponse::newHttpJsonResponse(out);
-    resp->setStatusCode(k200OK);
-    return callback(resp);
+    co_return serialization::jsonResponse(out);
 
   } catch (const std::exception& e) {
     LOG_ERROR << "listAssignments failed: " << e.what();
     auto resp =
         HttpResponse::newHttpJsonResponse(Json::Value("Internal server error"));
     resp->setStatusCode(k500InternalServerError);
-    return callback(resp);
+    co_return resp;
   }
 }
 
-void TaskController::deleteAssignment(
-    const HttpRequestPtr& req,
-    std::function<void(const HttpResponsePtr&)>&& callback) {
+Task<HttpResponsePtr> TaskController::deleteAssignment(HttpRequestPtr req) {
   std::string assId = getPathVariableCompat(req, "assignment_id");
   if (assId.empty()) {
     assId = req->getParameter("assignment_id");
@@ -888,67 +1640,77 @@ void TaskController::deleteAssignment(
     auto resp =
         HttpResponse::newHttpJsonResponse(Json::Value("Missing assignment id"));
     resp->setStatusCode(k400BadRequest);
-    return callback(resp);
+    co_return resp;
   }
 
   auto attrsPtr = req->attributes();
   if (!attrsPtr || !attrsPtr->find("user_id")) {
     auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Unauthorized"));
     resp->setStatusCode(k401Unauthorized);
-    return callback(resp);
+    co_return resp;
   }
   const std::string requester = attrsPtr->get<std::string>("user_id");
 
-  auto dbClient = app().getDbClient();
+  auto& pool = db::oltp();
   try {
-    auto taskRes = dbClient->execSqlSync(
+    auto taskRes = co_await pool.exec(
         "SELECT task_id FROM \"task_assignment\" WHERE id = $1", assId);
     if (taskRes.empty()) {
       auto resp = HttpResponse::newHttpJsonResponse(
           Json::Value("Assignment not found"));
       resp->setStatusCode(k404NotFound);
-      return callback(resp);
+      co_return resp;
     }
     const std::string taskId = taskRes[0]["task_id"].as<std::string>();
 
-    if (!hasOwnerPermission(dbClient, taskId, requester)) {
+    if (!co_await services::permissions().check(requester, taskId,
+                                                "assignment.assign.local")) {
       auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Forbidden"));
       resp->setStatusCode(k403Forbidden);
-      return callback(resp);
+      co_return resp;
     }
 
-    auto userRes = dbClient->execSqlSync(
+    auto userRes = co_await pool.exec(
         "SELECT user_id FROM \"task_assignment\" WHERE id = $1", assId);
     if (userRes.empty()) {
       auto resp = HttpResponse::newHttpJsonResponse(
           Json::Value("Assignment not found"));
       resp->setStatusCode(k404NotFound);
-      return callback(resp);
+      co_return resp;
     }
     const std::string assUserId = userRes[0]["user_id"].as<std::string>();
 
-    dbClient->execSqlSync("BEGIN");
-    dbClient->execSqlSync(
+    auto tx = co_await db::Tx::begin(pool);
+    db::Pipeline deletes;
+    deletes.add(
         "DELETE FROM \"task_role_assignment\" WHERE task_id = $1 AND user_id = "
         "$2",
         taskId, assUserId);
-    dbClient->execSqlSync(
-        "DELETE FROM \"task_assignment\" WHERE task_id = $1 AND user_id = $2",
+    deletes.add(
+        "DELETE FROM \"task_assignment\" WHERE task_id = $1 AND user_id = $2 "
+        "RETURNING assigned_hours::float8 AS hours",
         taskId, assUserId);
-    dbClient->execSqlSync("COMMIT");
+    const auto deleted = co_await deletes.run(tx.client());
+    std::vector<services::RollupDelta> released;
+    for (const auto& row : deleted[1])
+      released.push_back({taskId, 0, -row["hours"].as<double>(), 0});
+    db::Pipeline rollup;
+    services::rollups().add(rollup, released);
+    co_await rollup.run(tx.client());
+    co_await tx.commit();
+    services::permissions().rolesRevoked(taskId, assUserId);
+    services::conflicts().markDirty(assUserId);
+    services::simulations().changed();
+    services::forecasts().changed();
 
     auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Deleted"));
     resp->setStatusCode(k200OK);
-    return callback(resp);
+    co_return resp;
   } catch (const std::exception& e) {
     LOG_ERROR << "deleteAssignment failed: " << e.what();
-    try {
-      dbClient->execSqlSync("ROLLBACK");
-    } catch (...) {
-    }
     auto resp =
         HttpResponse::newHttpJsonResponse(Json::Value("Internal server error"));
     resp->setStatusCode(k500InternalServerError);
-    return callback(resp);
+    co_return resp;
   }
 }
\ No newline at end of file
@@ -1,6 +1,5 @@
 #include <drogon/HttpResponse.h>
 #include <drogon/drogon.h>
-#include <drogon/orm/Mapper.h>
 #include <json/json.h>
 #include <trantor/utils/Logger.h>
 
@@ -9,7 +8,14 @@
 #include <set>
 #include <vector>
 
+#include "db/Transaction.hpp"
+#include "serialization/RowJson.hpp"
 #include "models/UserWorkSchedule.hpp"
+#include "services/AvailabilityService.hpp"
+#include "services/ConflictService.hpp"
+#include "services/ForecastService.hpp"
+#include "services/SchedulingService.hpp"
+#include "services/SimulationService.hpp"
 #include "API/UsersController.hpp"
 
 using namespace drogon;
@@ -19,6 +25,12 @@ static bool isValidTime(const std::string& t) {
   return std::regex_match(t, re);
 }
 
+// The API numbers days 1 (Monday) to 7; user_work_schedule.weekday and the
+// scheduling engine use 0 (Monday) to 6.
+static int weekdayOf(int dayOfWeek) { return dayOfWeek - 1; }
+
+static int dayOfWeekOf(int weekday) { return weekday + 1; }
+
 static std::string getPathVariableCompat(const HttpRequestPtr& req,
                                          const std::string& name = "id") {
   const std::string q = req->getParameter(name);
@@ -36,22 +48,18 @@ static std::string getPathVariableCompat(const HttpRequestPtr& req,
   return p.substr(start, pos - start + 1);
 }
 
-void UsersController::setWorkSchedule(
-    const HttpRequestPtr& req,
-    std::function<void(const HttpResponsePtr&)>&& callback) {
+Task<HttpResponsePtr> UsersController::setWorkSchedule(HttpRequestPtr req) {
   auto attrsPtr = req->attributes();
   if (!attrsPtr || !attrsPtr->find("user_id")) {
     auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Unauthorized"));
     resp->setStatusCode(k401Unauthorized);
-    callback(resp);
-    return;
+    co_return resp;
   }
   const std::string requesterId = attrsPtr->get<std::string>("user_id");
   if (requesterId.empty()) {
     auto resp = HttpResponse::newHttpJsonResponse(Json::Value("Unauthorized"));
     resp->setStatusCode(k401Unauthorized);
-    callback(resp);
-    return;
+    co_return resp;
   }
 
   const std::string userId = getPathVariableCompat(req, "id");
@@ -59,15 +67,13 @@ void UsersController::setWorkSchedule(
     auto resp = HttpResponse::newHttpJsonResponse(
         Json::Value("Missing user id in path"));
     resp->setStatusCode(k400BadRequest);
-    callback(resp);
-    return;
+    co_return resp;
   }
   if (requesterId != userId) {
     auto resp = HttpResponse::newHttpJsonResponse(
         Json::Value("Forbidden: cannot set schedule for another user"));
     resp->setStatusCode(k403Forbidden);
-    callback(resp);
-    return;
+    co_return resp;
   }
 
   auto pj = req->getJsonObject();
@@ -75,16 +81,14 @@ void UsersController::setWorkSchedule(
     auto resp = HttpResponse::newHttpJsonResponse(
         Json::Value("Invalid JSON: expected array of 7 items"));
     resp->setStatusCode(k400BadRequest);
-    callback(resp);
-    return;
+    co_return resp;
   }
   const Json::Value& arr = *pj;
   if (arr.size() != 7) {
     auto resp = HttpResponse::newHttpJsonResponse(
         Json::Value("Array must contain 7 elements (one per weekday)"));
     resp->setStatusCode(k400BadRequest);
-    callback(resp);
-    return;
+    co_return resp;
   }
 
   std::set<int> daysSet;
@@ -94,30 +98,26 @@ void UsersController::setWorkSchedule(
       auto resp = HttpResponse::newHttpJsonResponse(
           Json::Value("Each array element must be an object"));
       resp->setStatusCode(k400BadRequest);
-      callback(resp);
-      return;
+      co_return resp;
     }
     if (!el.isMember("day_of_week") || !el["day_of_week"].isInt()) {
       auto resp = HttpResponse::newHttpJsonResponse(
           Json::Value("Each element must have integer day_of_week"));
       resp->setStatusCode(k400BadRequest);
-      callback(resp);
-      return;
+      co_return resp;
     }
     int dow = el["day_of_week"].asInt();
     if (dow < 1 || dow > 7) {
       auto resp = HttpResponse::newHttpJsonResponse(
           Json::Value("day_of_week must be in range 1..7"));
       resp->setStatusCode(k400BadRequest);
-      callback(resp);
-      return;
+      co_return resp;
     }
     if (daysSet.find(dow) != daysSet.end()) {
       auto resp = HttpResponse::newHttpJsonResponse(
           Json::Value("Duplicate day_of_week values are not allowed"));
       resp->setStatusCode(k400BadRequest);
-      callback(resp);
-      return;
+      co_return resp;
     }
     daysSet.insert(dow);
 
@@ -125,8 +125,7 @@ void UsersController::setWorkSchedule(
       auto resp = HttpResponse::newHttpJsonResponse(
           Json::Value("Each element must have boolean is_working_day"));
       resp->setStatusCode(k400BadRequest);
-      callback(resp);
-      return;
+      co_return resp;
     }
     bool isWorking = el["is_working_day"].asBool();
     if (isWorking) {
@@ -136,8 +135,7 @@ void UsersController::setWorkSchedule(
             Json::Value("Working day entries must include start_time and "
                         "end_time strings"));
         resp->setStatusCode(k400BadRequest);
-        callback(resp);
-        return;
+        co_return resp;
       }
       std::string st = el["start_time"].asString();
       std::string et = el["end_time"].asString();
@@ -145,84 +143,82 @@ void UsersController::setWorkSchedule(
         auto resp = HttpResponse::newHttpJsonResponse(
             Json::Value("start_time and end_time must be in HH:MM format"));
         resp->setStatusCode(k400BadRequest);
-        callback(resp);
-        return;
+        co_return resp;
       }
       if (st >= et) {
         auto resp = HttpResponse::newHttpJsonResponse(
             Json::Value("start_time must be earlier than end_time"));
         resp->setStatusCode(k400BadRequest);
-        callback(resp);
-        return;
+        co_return resp;
       }
     } else {
       if (el.isMember("start_time") && !el["start_time"].isNull()) {
         auto resp = HttpResponse::newHttpJsonResponse(
             Json::Value("Non-working day should not include start_time"));
         resp->setStatusCode(k400BadRequest);
-        callback(resp);
-        return;
+        co_return resp;
       }
       if (el.isMember("end_time") && !el["end_time"].isNull()) {
         auto resp = HttpResponse::newHttpJsonResponse(
             Json::Value("Non-working day should not include end_time"));
         resp->setStatusCode(k400BadRequest);
-        callback(resp);
-        return;
+        co_return resp;
       }
     }
   }
 
-  auto dbClient = app().getDbClient();
+  auto& pool = db::oltp();
   try {
-    dbClient->execSqlSync("BEGIN");
-    dbClient->execSqlSync("DELETE FROM user_work_schedule WHERE user_id = $1",
-                          userId);
+    auto tx = co_await db::Tx::begin(pool);
 
-    drogon::orm::Mapper<drogon_model::project_calendar::UserWorkSchedule>
-        wsMapper(dbClient);
-    Json::Value createdArr(Json::arrayValue);
+    db::Pipeline writes;
+    writes.add("DELETE FROM user_work_schedule WHERE user_id = $1", userId);
+    // Days off have no row (start_time/end_time are NOT NULL); the others
+    // remember which result holds their INSERT.
+    std::vector<size_t> resultOf(arr.size(), 0);
+    for (Json::UInt i = 0; i < arr.size(); ++i) {
+      const Json::Value& el = arr[i];
+      if (!el["is_working_day"].asBool()) continue;
+      resultOf[i] = writes.size();
+      writes.add(
+          "INSERT INTO user_work_schedule (user_id, weekday, start_time, "
+          "end_time) VALUES ($1, $2::int, $3::time, $4::time) "
+          "RETURNING id, start_time::text AS start_time, "
+          "end_time::text AS end_time",
+          userId, std::to_string(weekdayOf(el["day_of_week"].asInt())),
+          el["start_time"].asString(), el["end_time"].asString());
+    }
+    auto results = co_await writes.run(tx.client());
+    co_await tx.commit();
+
+    // Auto-placed blocks move to the new working hours.
+    services::availability().workScheduleChanged(userId);
+    services::conflicts().markDirty(userId);
+    services::simulations().changed();
+    services::forecasts().changed();
+    try {
+      co_await services::scheduling().rescheduleUser(userId);
+    } catch (const std::exception& e) {
+      LOG_WARN << "Re-scheduling user " << userId
+               << " after work schedule change failed: " << e.what();
+    }
 
+    Json::Value createdArr(Json::arrayValue);
     for (Json::UInt i = 0; i < arr.size(); ++i) {
       const Json::Value& el = arr[i];
       int dow = el["day_of_week"].asInt();
-      bool isWorking = el["is_working_day"].asBool();
-
-      drogon_model::project_calendar::UserWorkSchedule ws;
-      ws.setUserId(userId);
-      ws.setWeekday(static_cast<int32_t>(dow));
-      if (isWorking) {
-        ws.setStartTime(el["start_time"].asString());
-        ws.setEndTime(el["end_time"].asString());
-      }
-
-      try {
-        wsMapper.insert(ws);
-      } catch (const std::exception& insertEx) {
-        LOG_ERROR << "UserWorkSchedule insert failed for user " << userId
-                  << ": " << insertEx.what();
-        try {
-          dbClient->execSqlSync("ROLLBACK");
-        } catch (...) {
-        }
-        auto resp = HttpResponse::newHttpJsonResponse(
-            Json::Value("Internal server error"));
-        resp->setStatusCode(k500InternalServerError);
-        callback(resp);
-        return;
-      }
-
       Json::Value outItem;
-      outItem["id"] = ws.getId() ? ws.getValueOfId() : Json::Value();
       outItem["user_id"] = userId;
       outItem["day_of_week"] = dow;
-      if (isWorking) {
+      // results[0] belongs to the DELETE.
+      if (resultOf[i] != 0 && !results[resultOf[i]].empty()) {
+        const auto& inserted = results[resultOf[i]];
+        outItem["id"] = inserted[0]["id"].as<std::string>();
         outItem["is_working_day"] = true;
-        outItem["start_time"] =
-            ws.getStartTime() ? ws.getValueOfStartTime() : Json::Value();
-        outItem["end_time"] =
-            ws.getEndTime() ? ws.getValueOfEndTime() : Json::Value();
+        outItem["start_time"] = inserted[0]["start_time"].as<std::string>();
+        outItem["end_time"] = inserted[0]["end_time"].as<std::string>();
       } else {
+        outItem["id"] = Json::Value();
         outItem["is_working_day"] = false;
         outItem["start_time"] = Json::Value();
         outItem["end_time"] = Json::Value();
@@ -230,43 +226,32 @@ void UsersController::setWorkSchedule(
       createdArr.append(outItem);
     }
 
-    dbClient->execSqlSync("COMMIT");
-
     auto resp = HttpResponse::newHttpJsonResponse(createdArr);
     resp->setStatusCode(k201Created);
-    callback(resp);
-    return;
+    co_return resp;
 
   } catch (const std::exception& e) {
     LOG_ERROR << "setWorkSchedule failed for user " << userId << ": "
               << e.what();
-    try {
-      dbClient->execSqlSync("ROLLBACK");
-    } catch (...) {
-    }
     auto resp =
         HttpResponse::newHttpJsonResponse(Json::Value("Internal server error"));
     resp->setStatusCode(k500InternalServerError);
-    callback(resp);
-    return;
+    co_return resp;
   }
 }
 
-void UsersController::getWorkSchedule(
-    const HttpRequestPtr& req,
-    std::function<void(const HttpResponsePtr&)>&& callback) {
+Task<HttpResponsePtr> UsersController::getWorkSchedule(HttpRequestPtr req) {
   const std::string userId = getPathVariableCompat(req, "id");
   if (userId.empty()) {
     auto resp =
         HttpResponse::newHttpJsonResponse(Json::Value("Missing user id"));
     resp->setStatusCode(k400BadRequest);
-    callback(resp);
-    return;
+    co_return resp;
   }
 
-  auto dbClient = app().getDbClient();
+  auto& pool = db::oltp();
   try {
-    auto res = dbClient->execSqlSync(
+    auto res = co_await pool.exec(
         "SELECT id, user_id, weekday, start_time::text AS start_time, "
         "end_time::text AS end_time "
         "FROM user_work_schedule WHERE user_id = $1 ORDER BY weekday ASC",
@@ -282,7 +267,7 @@ void UsersController::getWorkSchedule(
       else
         item["id"] = Json::Value();
       item["user_id"] = row["user_id"].as<std::string>();
-      item["day_of_week"] = row["weekday"].as<int>();
+      item["day_of_week"] = dayOfWeekOf(row["weekday"].as<int>());
       bool hasTimes = !row["start_time"].isNull() && !row["end_time"].isNull();
       item["is_working_day"] = hasTimes;
       if (hasTimes) {
@@ -297,36 +282,31 @@ void UsersController::getWorkSchedule(
 
     auto resp = HttpResponse::newHttpJsonResponse(out);
     resp->setStatusCode(k200OK);
-    callback(resp);
-    return;
+    co_return resp;
   } catch (const std::exception& e) {
     LOG_ERROR << "getWorkSchedule failed for user " << userId << ": "
               << e.what();
     auto resp =
         HttpResponse::newHttpJsonResponse(Json::Value("Internal server error"));
     resp->setStatusCode(k500InternalServerError);
-    callback(resp);
-    return;
+    co_return resp;
   }
 }
 
-void UsersController::searchUsers(
-    const HttpRequestPtr& req,
-    std::function<void(const HttpResponsePtr&)>&& callback) {
+Task<HttpResponsePtr> UsersController::searchUsers(HttpRequestPtr req) {
   const std::string q = req->getParameter("search");
   if (q.empty()) {
     auto resp =
         HttpResponse::newHttpJsonResponse(Json::Value(Json::arrayValue));
     resp->setStatusCode(k200OK);
-    callback(resp);
-    return;
+    co_return resp;
   }
 
   std::string pattern = "%" + q + "%";
 
-  auto dbClient = app().getDbClient();
+  auto& pool = db::reports();
   try {
-    auto res = dbClient->execSqlSync(
+    auto res = co_await pool.exec(
         "SELECT id, email, display_name, name, surname, locale, "
         "created_at::text AS created_at "
         "FROM app_user "
@@ -335,61 +315,40 @@ void UsersController::searchUsers(
         "LIMIT 20",
         pattern);
 
-    Json::Value out(Json::arrayValue);
+    serialization::JsonWriter out(192 * res.size() + 2);
+    out.beginArray();
     for (const auto& row : res) {
-      Json::Value u;
-      u["id"] = row["id"].as<std::string>();
-      u["email"] = row["email"].isNull()
-                       ? Json::Value()
-                       : Json::Value(row["email"].as<std::string>());
-      u["display_name"] =
-          row["display_name"].isNull()
-              ? Json::Value()
-              : Json::Value(row["display_name"].as<std::string>());
-      u["name"] = row["name"].isNull()
-                      ? Json::Value()
-                      : Json::Value(row["name"].as<std::string>());
-      u["surname"] = row["surname"].isNull()
-                         ? Json::Value()
-                         : Json::Value(row["surname"].as<std::string>());
-      u["locale"] = row["locale"].isNull()
-                        ? Json::Value()
-                        : Json::Value(row["locale"].as<std::string>());
-      if (!row["created_at"].isNull())
-        u["created_at"] = row["created_at"].as<std::string>();
-      out.append(u);
+      out.beginObject();
+      for (const char* column : {"id", "email", "display_name", "name",
+                                 "surname", "locale", "created_at"})
+        serialization::writeField(out, column, row[column]);
+      out.endObject();
     }
+    out.endArray();
 
-    auto resp = HttpResponse::newHttpJsonResponse(out);
-    resp->setStatusCode(k200OK);
-    callback(resp);
-    return;
+    co_return serialization::jsonResponse(out);
 
   } catch (const std::exception& e) {
     LOG_ERROR << "searchUsers failed: " << e.what();
     auto resp =
         HttpResponse::newHttpJsonResponse(Json::Value("Internal server error"));
     resp->setStatusCode(k500InternalServerError);
-    callback(resp);
-    return;
+    co_return resp;
   }
 }
 
-void UsersController::getUserProfile(
-    const HttpRequestPtr& req,
-    std::function<void(const HttpResponsePtr&)>&& callback) {
+Task<HttpResponsePtr> UsersController::getUserProfile(HttpRequestPtr req) {
   const std::string userId = getPathVariableCompat(req, "id");
   if (userId.empty()) {
     auto resp =
         HttpResponse::newHttpJsonResponse(Json::Value("Missing user id"));
     resp->setStatusCode(k400BadRequest);
-    callback(resp);
-    return;
+    co_return resp;
   }
 
-  auto dbClient = app().getDbClient();
+  auto& pool = db::oltp();
   try {
-    auto res = dbClient->execSqlSync(
+    auto res = co_await pool.exec(
         "SELECT id, email, display_name, name, surname, phone, telegram, "
         "locale, "
         "created_at::text AS created_at, updated_at::text AS updated_at "
@@ -400,51 +359,25 @@ void UsersController::getUserProfile(
       auto resp =
           HttpResponse::newHttpJsonResponse(Json::Value("User not found"));
       resp->setStatusCode(k404NotFound);
-      callback(resp);
-      return;
+      co_return resp;
     }
 
     const auto& row = res[0];
-    Json::Value out;
-    out["id"] = row["id"].as<std::string>();
-    out["email"] = row["email"].isNull()
-                       ? Json::Value()
-                       : Json::Value(row["email"].as<std::string>());
-    out["display_name"] =
-        row["display_name"].isNull()
-            ? Json::Value()
-            : Json::Value(row["display_name"].as<std::string>());
-    out["name"] = row["name"].isNull()
-                      ? Json::Value()
-                      : Json::Value(row["name"].as<std::string>());
-    out["surname"] = row["surname"].isNull()
-                         ? Json::Value()
-                         : Json::Value(row["surname"].as<std::string>());
-    out["phone"] = row["phone"].isNull()
-                       ? Json::Value()
-                       : Json::Value(row["phone"].as<std::string>());
-    out["telegram"] = row["telegram"].isNull()
-                          ? Json::Value()
-                          : Json::Value(row["telegram"].as<std::string>());
-    out["locale"] = row["locale"].isNull()
-                        ? Json::Value()
-                        : Json::Value(row["locale"].as<std::string>());
-    if (!row["created_at"].isNull())
-      out["created_at"] = row["created_at"].as<std::string>();
-    if (!row["updated_at"].isNull())
-      out["updated_at"] = row["updated_at"].as<std::string>();
-
-    auto resp = HttpResponse::newHttpJsonResponse(out);
-    resp->setStatusCode(k200OK);
-    callback(resp);
-    return;
+    serialization::JsonWriter out(512);
+    out.beginObject();
+    for (const char* column :
+         {"id", "email", "display_name", "name", "surname", "phone",
+          "telegram", "locale", "created_at", "updated_at"})
+      serialization::writeField(out, column, row[column]);
+    out.endObject();
+
+    co_return serialization::jsonResponse(out);
   } catch (const std::exception& e) {
     LOG_ERROR << "getUserProfile failed for user " << userId << ": "
               << e.what();
     auto resp =
         HttpResponse::newHttpJsonResponse(Json::Value("Internal server error"));
     resp->setStatusCode(k500InternalServerError);
-    callback(resp);
-    return;
+    co_return resp;
   }
 }
\ No newline at end of file
@@ -0,0 +1,94 @@
+#include "db/Pools.hpp"
+
+#include <drogon/drogon.h>
+#include <trantor/utils/Logger.h>
+
+#include <algorithm>
+
+namespace db {
+
+namespace {
+
+std::string poolLabel(const std::string& name) {
+  return "pool=\"" + name + "\"";
+}
+
+}  // namespace
+
+Pool::Pool(std::string name)
+    : name_(std::move(name)),
+      sharedName_(name_ + ".shared"),
+      inflight_(metrics::registry().gauge(
+          "pc_db_inflight",
+          "Statements and transactions currently holding or waiting for a "
+          "connection",
+          poolLabel(name_))),
+      queryLatency_(metrics::registry().histogram(
+          "pc_db_query_seconds",
+          "Time from issuing a statement to receiving its result, including "
+          "time queued for a connection",
+          poolLabel(name_))),
+      acquireWait_(metrics::registry().histogram(
+          "pc_db_acquire_wait_seconds",
+          "Time spent waiting for a connection to start a transaction",
+          poolLabel(name_))) {}
+
+void Pool::configure(const ConnectionInfo& conn,
+                     const PoolSettings& settings) {
+  fast_ = settings.fast;
+  const size_t connections = std::max<size_t>(1, settings.connections);
+
+  auto create = [&](const std::string& clientName, bool isFast) {
+    drogon::app().createDbClient("postgresql", conn.host, conn.port,
+                                 conn.database, conn.user, conn.password,
+                                 connections, "", clientName, isFast, "", 0.0,
+                                 true);
+  };
+
+  create(name_, fast_);
+  capacity_ = connections;
+  if (fast_) {
+    // Fast clients are bound to IO loops; timers and worker threads need a
+    // regular pool.
+    create(sharedName_, false);
+    capacity_ = connections * (drogon::app().getThreadNum() + 1);
+  }
+
+  const metrics::Gauge* inflight = &inflight_;
+  const size_t capacity = capacity_;
+  metrics::registry().gaugeFn(
+      "pc_db_connections", "Connections configured for the pool",
+      poolLabel(name_), [capacity] { return static_cast<double>(capacity); });
+  metrics::registry().gaugeFn(
+      "pc_db_queue_depth",
+      "Estimated statements waiting for a free connection (in-flight minus "
+      "connections)",
+      poolLabel(name_), [inflight, capacity] {
+        const auto n = inflight->value() - static_cast<int64_t>(capacity);
+        return static_cast<double>(std::max<int64_t>(0, n));
+      });
+
+  LOG_INFO << "Database pool " << name_ << ": " << connections
+           << (fast_ ? " connections per IO thread" : " connections");
+}
+
+drogon::orm::DbClientPtr Pool::client() const {
+  if (fast_) {
+    if (drogon::app().getCurrentThreadIndex() < drogon::app().getThreadNum())
+      return drogon::app().getFastDbClient(name_);
+    return drogon::app().getDbClient(sharedName_);
+  }
+  return drogon::app().getDbClient(name_);
+}
+
+Pool& oltp() {
+  static Pool pool("oltp");
+  return pool;
+}
+
+Pool& reports() {
+  static Pool pool("reports");
+  return pool;
+}
+
+}  // namespace db
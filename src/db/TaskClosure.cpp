@@ -0,0 +1,82 @@
+#include "db/TaskClosure.hpp"
+
+#include "db/Literals.hpp"
+
+namespace db {
+
+namespace {
+
+constexpr const char* kInsertSql = R"sql(
+      INSERT INTO task_closure (ancestor, descendant, depth)
+      SELECT $1::uuid, $1::uuid, 0
+      UNION ALL
+      SELECT ancestor, $1::uuid, depth + 1 FROM task_closure
+      WHERE descendant = NULLIF($2, '')::uuid
+    )sql";
+
+constexpr const char* kInsertManySql = R"sql(
+      INSERT INTO task_closure (ancestor, descendant, depth)
+      SELECT id, id, 0 FROM unnest($1::uuid[]) AS x(id)
+      UNION ALL
+      SELECT c.ancestor, x.id, c.depth + 1
+      FROM unnest($1::uuid[], $2::uuid[]) AS x(id, parent)
+      JOIN task_closure c ON c.descendant = x.parent
+    )sql";
+
+// Pairs whose ancestor lies outside the subtree are the old ancestors'.
+constexpr const char* kDetachSql = R"sql(
+      DELETE FROM task_closure c
+      USING task_closure sub
+      WHERE sub.ancestor = $1::uuid
+        AND c.descendant = sub.descendant
+        AND c.depth > sub.depth
+    )sql";
+
+constexpr const char* kAttachSql = R"sql(
+      INSERT INTO task_closure (ancestor, descendant, depth)
+      SELECT up.ancestor, sub.descendant, up.depth + sub.depth + 1
+      FROM task_closure up, task_closure sub
+      WHERE up.descendant = $2::uuid AND sub.ancestor = $1::uuid
+    )sql";
+
+// The top of the tree is the ancestor furthest from $1; rows that already
+// point at it are left alone.
+constexpr const char* kProjectRootSql = R"sql(
+      UPDATE task t SET project_root_id = top.ancestor
+      FROM task_closure sub,
+           (SELECT ancestor FROM task_closure WHERE descendant = $1::uuid
+            ORDER BY depth DESC LIMIT 1) top
+      WHERE sub.ancestor = $1::uuid AND t.id = sub.descendant
+        AND t.project_root_id IS DISTINCT FROM top.ancestor
+    )sql";
+
+}  // namespace
+
+void closureInsert(Pipeline& writes, const std::string& taskId,
+                   const std::string& parentId) {
+  writes.add(kInsertSql, taskId, parentId);
+}
+
+void closureInsertMany(Pipeline& writes,
+                       const std::vector<std::string>& taskIds,
+                       const std::vector<std::string>& parentIds) {
+  if (taskIds.empty()) return;
+  ArrayLiteral ids, parents;
+  for (size_t i = 0; i < taskIds.size(); ++i) {
+    ids.add(taskIds[i]);
+    parents.add(parentIds[i].empty() ? "NULL" : parentIds[i]);
+  }
+  writes.add(kInsertManySql, ids.release(), parents.release());
+}
+
+void closureMove(Pipeline& writes, const std::string& taskId,
+                 const std::string& parentId) {
+  writes.add(kDetachSql, taskId);
+  if (!parentId.empty()) writes.add(kAttachSql, taskId, parentId);
+}
+
+void resetProjectRoot(Pipeline& writes, const std::string& taskId) {
+  writes.add(kProjectRootSql, taskId);
+}
+
+}  // namespace db
@@ -0,0 +1,172 @@
+#include "db/Transaction.hpp"
+
+#include <drogon/HttpAppFramework.h>
+#include <trantor/utils/Logger.h>
+
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+
+namespace db {
+
+namespace {
+
+struct PipelineState {
+  explicit PipelineState(size_t n) : results(n), pending(n + 1) {}
+
+  std::vector<std::optional<drogon::orm::Result>> results;
+  std::exception_ptr error;
+  std::mutex errorMutex;
+  std::atomic<size_t> pending;
+  std::coroutine_handle<> handle;
+
+  void finishOne() {
+    if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) handle.resume();
+  }
+};
+
+struct PipelineAwaiter {
+  drogon::orm::DbClientPtr client;
+  const std::vector<Pipeline::Statement>* statements;
+  std::shared_ptr<PipelineState> state;
+
+  bool await_ready() const noexcept { return statements->empty(); }
+
+  bool await_suspend(std::coroutine_handle<> handle) {
+    state = std::make_shared<PipelineState>(statements->size());
+    state->handle = handle;
+    for (size_t i = 0; i < statements->size(); ++i) {
+      auto st = state;
+      (*statements)[i](
+          client,
+          [st, i](const drogon::orm::Result& r) {
+            st->results[i].emplace(r);
+            st->finishOne();
+          },
+          [st](const std::exception_ptr& ep) {
+            {
+              std::lock_guard<std::mutex> lock(st->errorMutex);
+              if (!st->error) st->error = ep;
+            }
+            st->finishOne();
+          });
+    }
+    // Drop the guard reference taken in the constructor; if every callback
+    // already fired, continue without suspending.
+    return state->pending.fetch_sub(1, std::memory_order_acq_rel) != 1;
+  }
+
+  std::vector<drogon::orm::Result> await_resume() {
+    std::vector<drogon::orm::Result> out;
+    if (!state) return out;
+    if (state->error) std::rethrow_exception(state->error);
+    out.reserve(state->results.size());
+    for (auto& r : state->results) out.push_back(std::move(*r));
+    return out;
+  }
+};
+
+struct CommitState {
+  std::atomic<int> pending{2};
+  bool committed = false;
+  std::coroutine_handle<> handle;
+
+  void finishOne() {
+    if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) handle.resume();
+  }
+};
+
+// Carries the commit callback's outcome. drogon only calls the callback when
+// it sends COMMIT; a transaction it already rolled back after a failed
+// statement drops the callback unused, which reports a failed commit here
+// instead of leaving the awaiter suspended.
+struct CommitReport {
+  explicit CommitReport(std::shared_ptr<CommitState> s) : state(std::move(s)) {}
+  CommitReport(const CommitReport&) = delete;
+  CommitReport& operator=(const CommitReport&) = delete;
+
+  std::shared_ptr<CommitState> state;
+  bool reported = false;
+
+  void report(bool ok) {
+    if (reported) return;
+    reported = true;
+    state->committed = ok;
+    state->finishOne();
+  }
+  ~CommitReport() { report(false); }
+};
+
+// How long a commit may wait for the last reference before it is logged.
+constexpr double kCommitStallSeconds = 5.0;
+
+struct CommitAwaiter {
+  std::shared_ptr<drogon::orm::Transaction> trans;
+  std::shared_ptr<CommitState> state;
+
+  bool await_ready() const noexcept { return false; }
+
+  bool await_suspend(std::coroutine_handle<> handle) {
+    state = std::make_shared<CommitState>();
+    state->handle = handle;
+    auto report = std::make_shared<CommitReport>(state);
+    trans->setCommitCallback([report](bool ok) { report->report(ok); });
+    // drogon issues COMMIT when the last reference to the transaction goes
+    // away. Its own callbacks may still hold one for a moment, but a copy of
+    // Tx::client() kept by the caller would stall the commit for good.
+    std::weak_ptr<drogon::orm::Transaction> weak = trans;
+    report.reset();
+    trans.reset();
+    if (!weak.expired()) {
+      drogon::app().getLoop()->runAfter(kCommitStallSeconds, [weak] {
+        if (!weak.expired())
+          LOG_ERROR << "Tx::commit() still waiting: a copy of Tx::client() "
+                       "outlives the commit";
+      });
+    }
+    return state->pending.fetch_sub(1, std::memory_order_acq_rel) != 1;
+  }
+
+  void await_resume() const {
+    if (!state->committed)
+      throw std::runtime_error("transaction commit failed");
+  }
+};
+
+}  // namespace
+
+drogon::Task<std::vector<drogon::orm::Result>> Pipeline::run(
+    drogon::orm::DbClientPtr client) {
+  co_return co_await PipelineAwaiter{std::move(client), &statements_, nullptr};
+}
+
+drogon::Task<Tx> Tx::begin(Pool& pool) {
+  auto lease = pool.lease();
+  const auto started = std::chrono::steady_clock::now();
+  auto trans = co_await pool.client()->newTransactionCoro();
+  pool.acquireWait().observe(std::chrono::steady_clock::now() - started);
+  co_return Tx(std::move(trans), std::move(lease));
+}
+
+Tx::Tx(std::shared_ptr<drogon::orm::Transaction> trans, Pool::Lease lease)
+    : trans_(std::move(trans)), lease_(std::move(lease)) {}
+
+Tx::~Tx() {
+  if (trans_) trans_->rollback();
+}
+
+drogon::Task<> Tx::commit() {
+  if (!trans_) throw std::logic_error("transaction already finished");
+  co_await CommitAwaiter{std::move(trans_), nullptr};
+}
+
+void Tx::rollback() {
+  if (!trans_) return;
+  trans_->rollback();
+  trans_.reset();
+}
+
+}  // namespace db
@@ -0,0 +1,291 @@
+#include "engine/Availability.hpp"
+
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace engine {
+
+namespace {
+
+constexpr uint64_t kAll = ~uint64_t{0};
+
+// Bits [from, to) of one word, 0 <= from < to <= 64.
+uint64_t bitRange(size_t from, size_t to) {
+  const uint64_t high = to == 64 ? kAll : (uint64_t{1} << to) - 1;
+  return high & ~((uint64_t{1} << from) - 1);
+}
+
+Minute floorDiv(Minute m, Minute d) {
+  return m >= 0 ? m / d : -((-m + d - 1) / d);
+}
+
+bool byStart(const Interval& a, const Interval& b) {
+  return a.start != b.start ? a.start < b.start : a.end < b.end;
+}
+
+}  // namespace
+
+FreeBusyMask::FreeBusyMask(int64_t firstDay, int64_t days)
+    : firstDay_(firstDay),
+      slots_(static_cast<size_t>(std::max<int64_t>(days, 0) * kSlotsPerDay)),
+      bits_((slots_ + 63) / 64, 0) {}
+
+void FreeBusyMask::setRange(size_t from, size_t to) {
+  to = std::min(to, slots_);
+  while (from < to) {
+    const size_t word = from / 64;
+    const size_t end = std::min(to, (word + 1) * 64);
+    bits_[word] |= bitRange(from % 64, end - word * 64);
+    from = end;
+  }
+}
+
+void FreeBusyMask::clearRange(size_t from, size_t to) {
+  to = std::min(to, slots_);
+  while (from < to) {
+    const size_t word = from / 64;
+    const size_t end = std::min(to, (word + 1) * 64);
+    bits_[word] &= ~bitRange(from % 64, end - word * 64);
+    from = end;
+  }
+}
+
+void FreeBusyMask::addWindows(const std::vector<WorkWindow>& windows) {
+  const int64_t days = static_cast<int64_t>(slots_) / kSlotsPerDay;
+  for (int64_t d = 0; d < days; ++d) {
+    const int weekday = weekdayOf(firstDay_ + d);
+    for (const auto& w : windows) {
+      if (w.weekday != weekday) continue;
+      // Partial slots at either end are not free.
+      const Minute start =
+          std::clamp<Minute>(w.startMinute, 0, kMinutesPerDay);
+      const Minute end = std::clamp<Minute>(w.endMinute, 0, kMinutesPerDay);
+      const Minute first = (start + kSlotMinutes - 1) / kSlotMinutes;
+      const Minute last = end / kSlotMinutes;
+      if (last > first)
+        setRange(static_cast<size_t>(d * kSlotsPerDay + first),
+                 static_cast<size_t>(d * kSlotsPerDay + last));
+    }
+  }
+}
+
+void FreeBusyMask::addBusy(Interval busy) {
+  const Minute origin = firstDay_ * kMinutesPerDay;
+  const Minute first = floorDiv(busy.start - origin, kSlotMinutes);
+  const Minute last = floorDiv(busy.end - origin + kSlotMinutes - 1,
+                               kSlotMinutes);
+  if (last <= 0 || first >= static_cast<Minute>(slots_) || last <= first)
+    return;
+  clearRange(static_cast<size_t>(std::max<Minute>(first, 0)),
+             static_cast<size_t>(last));
+}
+
+void FreeBusyMask::intersect(const FreeBusyMask& other) {
+  const size_t n = std::min(bits_.size(), other.bits_.size());
+  uint64_t* a = bits_.data();
+  const uint64_t* b = other.bits_.data();
+  size_t i = 0;
+#if defined(__SSE2__)
+  for (; i + 2 <= n; i += 2) {
+    const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+    const __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(a + i), _mm_and_si128(x, y));
+  }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  for (; i + 2 <= n; i += 2)
+    vst1q_u64(a + i, vandq_u64(vld1q_u64(a + i), vld1q_u64(b + i)));
+#endif
+  for (; i < n; ++i) a[i] &= b[i];
+}
+
+size_t FreeBusyMask::freeSlots() const {
+  size_t count = 0;
+  for (const uint64_t w : bits_)
+    count += static_cast<size_t>(__builtin_popcountll(w));
+  return count;
+}
+
+std::vector<Interval> FreeBusyMask::findRuns(size_t length,
+                                             size_t limit) const {
+  std::vector<Interval> out;
+  if (length == 0 || limit == 0) return out;
+  size_t run = 0;       // free slots in the current stretch not yet used
+  size_t runStart = 0;  // first of them
+  auto take = [&] {
+    while (run >= length && out.size() < limit) {
+      out.push_back({slotStart(runStart), slotStart(runStart + length)});
+      runStart += length;
+      run -= length;
+    }
+    return out.size() >= limit;
+  };
+
+  for (size_t w = 0; w < bits_.size(); ++w) {
+    const uint64_t bits = bits_[w];
+    const size_t base = w * 64;
+    if (bits == 0) {
+      run = 0;
+      continue;
+    }
+    if (bits == kAll) {
+      if (run == 0) runStart = base;
+      run += 64;
+      if (take()) return out;
+      continue;
+    }
+    // Mixed word: alternate between stretches of set and clear bits.
+    size_t b = 0;
+    while (b < 64) {
+      const uint64_t rest = bits >> b;
+      if (rest & 1) {
+        const uint64_t gaps = ~rest;
+        const size_t len =
+            gaps ? static_cast<size_t>(__builtin_ctzll(gaps)) : 64 - b;
+        if (run == 0) runStart = base + b;
+        run += std::min(len, 64 - b);
+        b += len;
+        if (take()) return out;
+      } else {
+        const size_t len =
+            rest ? static_cast<size_t>(__builtin_ctzll(rest)) : 64 - b;
+        run = 0;
+        b += len;
+      }
+    }
+  }
+  return out;
+}
+
+FreeSlotIndex::FreeSlotIndex(const std::vector<WorkWindow>& windows,
+                             int64_t firstDay)
+    : windows_(windows), firstDay_(firstDay) {
+  rebuild();
+}
+
+void FreeSlotIndex::assign(std::vector<Interval> blocks) {
+  blocks.erase(
+      std::remove_if(blocks.begin(), blocks.end(),
+                     [](const Interval& b) { return b.end <= b.start; }),
+      blocks.end());
+  std::sort(blocks.begin(), blocks.end(), byStart);
+  blocks_ = std::move(blocks);
+  rebuild();
+}
+
+void FreeSlotIndex::update(const std::vector<Interval>& removed,
+                           const std::vector<Interval>& added) {
+  for (const auto& block : removed) {
+    const auto it =
+        std::lower_bound(blocks_.begin(), blocks_.end(), block, byStart);
+    if (it != blocks_.end() && it->start == block.start &&
+        it->end == block.end)
+      blocks_.erase(it);
+  }
+  for (const auto& block : added) {
+    if (block.end <= block.start) continue;
+    blocks_.insert(
+        std::upper_bound(blocks_.begin(), blocks_.end(), block, byStart),
+        block);
+  }
+  rebuild();
+}
+
+void FreeSlotIndex::rebuild() {
+  const Minute origin = firstDay_ * kMinutesPerDay;
+  Minute lastEnd = origin;
+  for (const auto& b : blocks_) lastEnd = std::max(lastEnd, b.end);
+  horizon_ = (floorDiv(lastEnd - 1, kMinutesPerDay) + 1) * kMinutesPerDay;
+  if (horizon_ <= origin) horizon_ = origin;
+
+  // Blocks come sorted by start, so each one lands at the end of the busy
+  // vector or merges with its last interval.
+  UserCalendar calendar = windows_;
+  for (const auto& b : blocks_)
+    if (b.end > origin) calendar.addBusy(b);
+  std::vector<Interval> pieces;
+  calendar.freeSlots(origin, horizon_, pieces);
+  runs_.clear();
+  for (const auto& p : pieces) {
+    if (!runs_.empty() && runs_.back().end == p.start)
+      runs_.back().end = p.end;
+    else
+      runs_.push_back(p);
+  }
+
+  leaves_ = 1;
+  while (leaves_ < runs_.size()) leaves_ *= 2;
+  longest_.assign(2 * leaves_, 0);
+  for (size_t i = 0; i < runs_.size(); ++i)
+    longest_[leaves_ + i] = runs_[i].length();
+  for (size_t i = leaves_ - 1; i > 0; --i)
+    longest_[i] = std::max(longest_[2 * i], longest_[2 * i + 1]);
+}
+
+size_t FreeSlotIndex::firstAtLeast(size_t from, Minute length) const {
+  if (from >= runs_.size()) return runs_.size();
+  // Walk up from the leaf until a right sibling holds a long enough run,
+  // then down to the leftmost such leaf.
+  size_t node = leaves_ + from;
+  if (longest_[node] >= length) return from;
+  for (;;) {
+    while (node & 1) {
+      if (node == 1) return runs_.size();
+      node /= 2;
+    }
+    ++node;
+    if (longest_[node] >= length) break;
+  }
+  while (node < leaves_)
+    node = longest_[2 * node] >= length ? 2 * node : 2 * node + 1;
+  return node - leaves_;
+}
+
+std::optional<Interval> FreeSlotIndex::next(Minute after,
+                                            Minute length) const {
+  if (length <= 0) return std::nullopt;
+  after = std::max(after, firstDay_ * kMinutesPerDay);
+  Minute tailFrom = std::max(after, horizon_);
+  if (after < horizon_ && !runs_.empty()) {
+    const auto it = std::lower_bound(
+        runs_.begin(), runs_.end(), after,
+        [](const Interval& r, Minute value) { return r.end <= value; });
+    if (it != runs_.end()) {
+      const auto i = static_cast<size_t>(it - runs_.begin());
+      const Minute start = std::max(it->start, after);
+      if (it->end - start >= length) return Interval{start, start + length};
+      const size_t j = firstAtLeast(i + 1, length);
+      if (j < runs_.size())
+        return Interval{runs_[j].start, runs_[j].start + length};
+      // The last run may go on past the horizon.
+      if (runs_.back().end == horizon_)
+        tailFrom = i + 1 == runs_.size() ? start : runs_.back().start;
+    }
+  }
+  return nextAfterHorizon(tailFrom, length);
+}
+
+std::optional<Interval> FreeSlotIndex::nextAfterHorizon(Minute from,
+                                                        Minute length) const {
+  if (!windows_.hasWindows()) return std::nullopt;
+  // No blocks lie beyond the horizon, so a stretch of any length that exists
+  // at all begins within a week; the second week lets it run to its end.
+  const Minute until = from + (14 * kMinutesPerDay + length);
+  std::vector<Interval> pieces;
+  windows_.freeSlots(from, until, pieces);
+  Interval run{0, 0};
+  for (const auto& p : pieces) {
+    if (run.end == p.start && run.length() > 0)
+      run.end = p.end;
+    else
+      run = p;
+    if (run.length() >= length) return Interval{run.start, run.start + length};
+  }
+  return std::nullopt;
+}
+
+}  // namespace engine
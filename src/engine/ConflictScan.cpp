@@ -0,0 +1,110 @@
+#include "engine/ConflictScan.hpp"
+
+#include <algorithm>
+#include <map>
+#include <utility>
+
+namespace engine {
+
+namespace {
+
+int64_t dayOf(Minute m) {
+  return m >= 0 ? m / kMinutesPerDay
+                : -((-m + kMinutesPerDay - 1) / kMinutesPerDay);
+}
+
+struct DayTotal {
+  Minute minutes = 0;
+  std::map<uint32_t, Minute> byTask;
+};
+
+}  // namespace
+
+std::vector<Conflict> scanSchedule(std::vector<ScanBlock> blocks,
+                                   const UserCalendar& windows,
+                                   const std::vector<DailyLimit>& limits) {
+  std::vector<Conflict> found;
+  blocks.erase(std::remove_if(blocks.begin(), blocks.end(),
+                              [](const ScanBlock& b) {
+                                return b.slot.end <= b.slot.start;
+                              }),
+               blocks.end());
+  std::sort(blocks.begin(), blocks.end(),
+            [](const ScanBlock& a, const ScanBlock& b) {
+              if (a.slot.start != b.slot.start)
+                return a.slot.start < b.slot.start;
+              return a.slot.end < b.slot.end;
+            });
+
+  // Blocks still running at the sweep position. A user rarely has more
+  // than a couple at once, so a plain vector beats a heap here.
+  std::vector<const ScanBlock*> active;
+  std::map<std::pair<uint32_t, int64_t>, DayTotal> days;  // project, day
+  std::vector<Interval> inside;
+  for (const auto& b : blocks) {
+    std::erase_if(active, [&](const ScanBlock* a) {
+      return a->slot.end <= b.slot.start;
+    });
+    for (const ScanBlock* a : active) {
+      Conflict c;
+      c.kind = Conflict::Kind::Overlap;
+      c.task = b.task;
+      c.other = a->task;
+      c.slot = {b.slot.start, std::min(a->slot.end, b.slot.end)};
+      found.push_back(c);
+    }
+    active.push_back(&b);
+
+    if (windows.hasWindows()) {
+      inside.clear();
+      const Minute worked = windows.freeSlots(b.slot.start, b.slot.end, inside);
+      if (worked < b.slot.length()) {
+        Conflict c;
+        c.kind = Conflict::Kind::OutsideWorkHours;
+        c.task = b.task;
+        c.slot = b.slot;
+        c.minutes = b.slot.length() - worked;
+        found.push_back(c);
+      }
+    }
+
+    if (limits.empty()) continue;
+    for (int64_t day = dayOf(b.slot.start); day * kMinutesPerDay < b.slot.end;
+         ++day) {
+      const Minute from = std::max(b.slot.start, day * kMinutesPerDay);
+      const Minute to = std::min(b.slot.end, (day + 1) * kMinutesPerDay);
+      auto& total = days[{b.project, day}];
+      total.minutes += to - from;
+      total.byTask[b.task] += to - from;
+    }
+  }
+
+  for (const auto& [key, total] : days) {
+    const auto [project, day] = key;
+    const int weekday = weekdayOf(day);
+    Minute limit = 0;
+    bool limited = false;
+    for (const auto& l : limits) {
+      if (l.project != project || (l.weekday != -1 && l.weekday != weekday))
+        continue;
+      limit += l.minutes;
+      limited = true;
+    }
+    if (!limited || total.minutes <= limit) continue;
+    Conflict c;
+    c.kind = Conflict::Kind::Overallocation;
+    c.task = std::max_element(total.byTask.begin(), total.byTask.end(),
+                              [](const auto& x, const auto& y) {
+                                return x.second < y.second;
+                              })
+                 ->first;
+    c.other = project;
+    c.slot = {day * kMinutesPerDay, (day + 1) * kMinutesPerDay};
+    c.minutes = total.minutes;
+    c.limit = limit;
+    found.push_back(c);
+  }
+  return found;
+}
+
+}  // namespace engine
@@ -0,0 +1,331 @@
+#include "engine/DependencyGraph.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <utility>
+
+namespace engine {
+
+int64_t dependencyLag(DependencyKind kind, int64_t fromDuration,
+                      int64_t toDuration) {
+  switch (kind) {
+    case DependencyKind::FinishStart:
+      return fromDuration;
+    case DependencyKind::StartStart:
+      return 0;
+    case DependencyKind::FinishFinish:
+      return fromDuration - toDuration;
+    case DependencyKind::StartFinish:
+      return -toDuration;
+  }
+  return fromDuration;
+}
+
+namespace {
+
+// Heap entries carry the topological rank in the high half so plain integer
+// comparison orders them.
+uint64_t heapKey(uint32_t rank, uint32_t v) {
+  return (static_cast<uint64_t>(rank) << 32) | v;
+}
+
+}  // namespace
+
+std::optional<DependencyKind> parseDependencyKind(std::string_view kind) {
+  if (kind == "finish_start") return DependencyKind::FinishStart;
+  if (kind == "start_start") return DependencyKind::StartStart;
+  if (kind == "finish_finish") return DependencyKind::FinishFinish;
+  if (kind == "start_finish") return DependencyKind::StartFinish;
+  return std::nullopt;
+}
+
+const char* dependencyKindName(DependencyKind kind) {
+  switch (kind) {
+    case DependencyKind::FinishStart:
+      return "finish_start";
+    case DependencyKind::StartStart:
+      return "start_start";
+    case DependencyKind::FinishFinish:
+      return "finish_finish";
+    case DependencyKind::StartFinish:
+      return "start_finish";
+  }
+  return "finish_start";
+}
+
+DependencyGraph::DependencyGraph(std::vector<int64_t> durations,
+                                 const std::vector<Edge>& edges)
+    : duration_(std::move(durations)) {
+  const size_t n = duration_.size();
+  std::vector<Edge> sorted;
+  sorted.reserve(edges.size());
+  for (const auto& e : edges)
+    if (e.from < n && e.to < n && e.from != e.to) sorted.push_back(e);
+  std::sort(sorted.begin(), sorted.end(), [](const Edge& a, const Edge& b) {
+    return a.from != b.from ? a.from < b.from : a.to < b.to;
+  });
+  sorted.erase(std::unique(sorted.begin(), sorted.end(),
+                           [](const Edge& a, const Edge& b) {
+                             return a.from == b.from && a.to == b.to;
+                           }),
+               sorted.end());
+
+  // Counting sort into both directions.
+  outOffset_.assign(n + 1, 0);
+  inOffset_.assign(n + 1, 0);
+  for (const auto& e : sorted) {
+    ++outOffset_[e.from + 1];
+    ++inOffset_[e.to + 1];
+  }
+  for (size_t v = 0; v < n; ++v) {
+    outOffset_[v + 1] += outOffset_[v];
+    inOffset_[v + 1] += inOffset_[v];
+  }
+  outTarget_.resize(sorted.size());
+  outKind_.resize(sorted.size());
+  inSource_.resize(sorted.size());
+  inKind_.resize(sorted.size());
+  std::vector<uint32_t> outFill(outOffset_.begin(), outOffset_.end() - 1);
+  std::vector<uint32_t> inFill(inOffset_.begin(), inOffset_.end() - 1);
+  for (const auto& e : sorted) {
+    const uint32_t o = outFill[e.from]++;
+    outTarget_[o] = e.to;
+    outKind_[o] = e.kind;
+    const uint32_t i = inFill[e.to]++;
+    inSource_[i] = e.from;
+    inKind_[i] = e.kind;
+  }
+}
+
+bool DependencyGraph::hasEdge(uint32_t from, uint32_t to) const {
+  if (from >= nodeCount()) return false;
+  return std::find(outTarget_.begin() + outOffset_[from],
+                   outTarget_.begin() + outOffset_[from + 1],
+                   to) != outTarget_.begin() + outOffset_[from + 1];
+}
+
+bool DependencyGraph::addEdge(const Edge& edge) {
+  const size_t n = nodeCount();
+  if (edge.from >= n || edge.to >= n || edge.from == edge.to ||
+      hasEdge(edge.from, edge.to))
+    return false;
+  const uint32_t o = outOffset_[edge.from + 1];
+  outTarget_.insert(outTarget_.begin() + o, edge.to);
+  outKind_.insert(outKind_.begin() + o, edge.kind);
+  for (size_t v = edge.from + 1; v <= n; ++v) ++outOffset_[v];
+  const uint32_t i = inOffset_[edge.to + 1];
+  inSource_.insert(inSource_.begin() + i, edge.from);
+  inKind_.insert(inKind_.begin() + i, edge.kind);
+  for (size_t v = edge.to + 1; v <= n; ++v) ++inOffset_[v];
+  return true;
+}
+
+bool DependencyGraph::removeEdge(uint32_t from, uint32_t to) {
+  const size_t n = nodeCount();
+  if (from >= n || to >= n) return false;
+  const auto outFirst = outTarget_.begin() + outOffset_[from];
+  const auto outLast = outTarget_.begin() + outOffset_[from + 1];
+  const auto out = std::find(outFirst, outLast, to);
+  if (out == outLast) return false;
+  const auto o = out - outTarget_.begin();
+  outTarget_.erase(out);
+  outKind_.erase(outKind_.begin() + o);
+  for (size_t v = from + 1; v <= n; ++v) --outOffset_[v];
+
+  const auto inFirst = inSource_.begin() + inOffset_[to];
+  const auto inLast = inSource_.begin() + inOffset_[to + 1];
+  const auto in = std::find(inFirst, inLast, from);
+  const auto i = in - inSource_.begin();
+  inSource_.erase(in);
+  inKind_.erase(inKind_.begin() + i);
+  for (size_t v = to + 1; v <= n; ++v) --inOffset_[v];
+  return true;
+}
+
+CriticalPath::CriticalPath(DependencyGraph graph) : graph_(std::move(graph)) {
+  const size_t n = graph_.nodeCount();
+  es_.assign(n, 0);
+  tail_.assign(n, 0);
+  queued_.assign(n, 0);
+  acyclic_ = sort();
+  if (acyclic_) recomputeAll();
+}
+
+// Kahn's algorithm. Leaves order_ and rank_ untouched when there is a cycle.
+bool CriticalPath::sort() {
+  const auto n = static_cast<uint32_t>(graph_.nodeCount());
+  std::vector<uint32_t> indegree(n);
+  for (uint32_t v = 0; v < n; ++v)
+    indegree[v] = graph_.inEnd(v) - graph_.inBegin(v);
+  std::vector<uint32_t> order;
+  order.reserve(n);
+  for (uint32_t v = 0; v < n; ++v)
+    if (indegree[v] == 0) order.push_back(v);
+  for (size_t head = 0; head < order.size(); ++head) {
+    const uint32_t v = order[head];
+    for (uint32_t e = graph_.outBegin(v); e < graph_.outEnd(v); ++e)
+      if (--indegree[graph_.outTarget(e)] == 0)
+        order.push_back(graph_.outTarget(e));
+  }
+  if (order.size() != n) return false;
+  order_ = std::move(order);
+  rank_.resize(n);
+  for (uint32_t r = 0; r < n; ++r) rank_[order_[r]] = r;
+  return true;
+}
+
+int64_t CriticalPath::computeEs(uint32_t v) const {
+  int64_t es = 0;
+  for (uint32_t e = graph_.inBegin(v); e < graph_.inEnd(v); ++e) {
+    const uint32_t p = graph_.inSource(e);
+    es = std::max(es, es_[p] + dependencyLag(graph_.inKind(e),
+                                             graph_.duration(p),
+                                             graph_.duration(v)));
+  }
+  return es;
+}
+
+int64_t CriticalPath::computeTail(uint32_t v) const {
+  int64_t tail = graph_.duration(v);
+  for (uint32_t e = graph_.outBegin(v); e < graph_.outEnd(v); ++e) {
+    const uint32_t s = graph_.outTarget(e);
+    tail = std::max(tail, tail_[s] + dependencyLag(graph_.outKind(e),
+                                                   graph_.duration(v),
+                                                   graph_.duration(s)));
+  }
+  return tail;
+}
+
+void CriticalPath::recomputeAll() {
+  for (const uint32_t v : order_) es_[v] = computeEs(v);
+  for (auto it = order_.rbegin(); it != order_.rend(); ++it)
+    tail_[*it] = computeTail(*it);
+  updateMakespan();
+}
+
+// The makespan is the longest chain, so no task ends up with negative float
+// even when negative lags let an earliest start be clamped to zero.
+void CriticalPath::updateMakespan() {
+  int64_t makespan = 0;
+  for (size_t v = 0; v < es_.size(); ++v)
+    makespan = std::max(makespan, es_[v] + tail_[v]);
+  makespan_ = makespan;
+}
+
+void CriticalPath::propagateForward(const std::vector<uint32_t>& seeds) {
+  std::priority_queue<uint64_t, std::vector<uint64_t>, std::greater<>> heap;
+  auto push = [&](uint32_t v) {
+    if (queued_[v]) return;
+    queued_[v] = 1;
+    heap.push(heapKey(rank_[v], v));
+  };
+  for (const uint32_t v : seeds) push(v);
+  while (!heap.empty()) {
+    const auto v = static_cast<uint32_t>(heap.top());
+    heap.pop();
+    queued_[v] = 0;
+    const int64_t es = computeEs(v);
+    if (es == es_[v]) continue;
+    es_[v] = es;
+    for (uint32_t e = graph_.outBegin(v); e < graph_.outEnd(v); ++e)
+      push(graph_.outTarget(e));
+  }
+}
+
+void CriticalPath::propagateBackward(const std::vector<uint32_t>& seeds) {
+  std::priority_queue<uint64_t> heap;  // latest rank first
+  auto push = [&](uint32_t v) {
+    if (queued_[v]) return;
+    queued_[v] = 1;
+    heap.push(heapKey(rank_[v], v));
+  };
+  for (const uint32_t v : seeds) push(v);
+  while (!heap.empty()) {
+    const auto v = static_cast<uint32_t>(heap.top());
+    heap.pop();
+    queued_[v] = 0;
+    const int64_t tail = computeTail(v);
+    if (tail == tail_[v]) continue;
+    tail_[v] = tail;
+    for (uint32_t e = graph_.inBegin(v); e < graph_.inEnd(v); ++e)
+      push(graph_.inSource(e));
+  }
+}
+
+void CriticalPath::setDuration(uint32_t v, int64_t minutes) {
+  if (v >= graph_.nodeCount() || graph_.duration(v) == minutes) return;
+  graph_.setDuration(v, minutes);
+  if (!acyclic_) return;
+  // Lags of the edges on both sides of v depend on its duration.
+  std::vector<uint32_t> successors{v};
+  for (uint32_t e = graph_.outBegin(v); e < graph_.outEnd(v); ++e)
+    successors.push_back(graph_.outTarget(e));
+  std::vector<uint32_t> predecessors{v};
+  for (uint32_t e = graph_.inBegin(v); e < graph_.inEnd(v); ++e)
+    predecessors.push_back(graph_.inSource(e));
+  propagateForward(successors);
+  propagateBackward(predecessors);
+  updateMakespan();
+}
+
+bool CriticalPath::addEdge(const DependencyGraph::Edge& edge) {
+  if (!graph_.addEdge(edge)) return false;
+  if (!acyclic_) return true;
+  // An edge that agrees with the current order keeps it; otherwise the
+  // order is rebuilt and the edge refused if no order exists any more.
+  if (rank_[edge.from] > rank_[edge.to] && !sort()) {
+    graph_.removeEdge(edge.from, edge.to);
+    return false;
+  }
+  propagateForward({edge.to});
+  propagateBackward({edge.from});
+  updateMakespan();
+  return true;
+}
+
+bool CriticalPath::removeEdge(uint32_t from, uint32_t to) {
+  if (!graph_.removeEdge(from, to)) return false;
+  if (!acyclic_) {
+    acyclic_ = sort();
+    if (acyclic_) recomputeAll();
+    return true;
+  }
+  propagateForward({to});
+  propagateBackward({from});
+  updateMakespan();
+  return true;
+}
+
+std::vector<uint32_t> CriticalPath::criticalPath() const {
+  std::vector<uint32_t> path;
+  if (!acyclic_ || order_.empty()) return path;
+  uint32_t v = order_.front();
+  bool found = false;
+  for (const uint32_t u : order_) {
+    if (es_[u] == 0 && tail_[u] == makespan_) {
+      v = u;
+      found = true;
+      break;
+    }
+  }
+  if (!found) return path;
+  for (;;) {
+    path.push_back(v);
+    if (tail_[v] == graph_.duration(v)) break;
+    bool next = false;
+    for (uint32_t e = graph_.outBegin(v); e < graph_.outEnd(v); ++e) {
+      const uint32_t s = graph_.outTarget(e);
+      if (tail_[s] + dependencyLag(graph_.outKind(e), graph_.duration(v),
+                                   graph_.duration(s)) == tail_[v]) {
+        v = s;
+        next = true;
+        break;
+      }
+    }
+    if (!next) break;
+  }
+  return path;
+}
+
+}  // namespace engine
@@ -0,0 +1,349 @@
+#include "engine/DependencyOrder.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+
+namespace engine {
+
+namespace {
+
+// Window width per new arc above which a batch is checked arc by arc.
+constexpr size_t kWindowPerArc = 64;
+
+void erase(std::vector<uint32_t>& list, uint32_t v) {
+  const auto it = std::find(list.begin(), list.end(), v);
+  if (it == list.end()) return;
+  *it = list.back();
+  list.pop_back();
+}
+
+}  // namespace
+
+std::vector<DependencyOrder::Arc> DependencyOrder::build(
+    size_t nodes, const std::vector<Arc>& arcs) {
+  out_.assign(nodes, {});
+  in_.assign(nodes, {});
+  mark_.assign(nodes, 0);
+  parent_.assign(nodes, 0);
+
+  std::vector<Arc> rejected;
+  std::vector<Arc> unique;
+  unique.reserve(arcs.size());
+  for (const auto& a : arcs) {
+    if (a.first >= nodes || a.second >= nodes) continue;
+    if (a.first == a.second)
+      rejected.push_back(a);
+    else
+      unique.push_back(a);
+  }
+  std::sort(unique.begin(), unique.end());
+  unique.erase(std::unique(unique.begin(), unique.end()), unique.end());
+  for (const auto& a : unique) insert(a.first, a.second);
+
+  // Kahn's algorithm taking the lowest ready index first, so ranks follow
+  // the node numbering wherever the arcs allow. Callers number tasks in
+  // creation order, and new dependencies mostly point forward in it, which
+  // keeps most later insertions free of any reordering.
+  auto kahn = [&] {
+    std::vector<uint32_t> indegree(nodes);
+    std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<>> ready;
+    for (size_t v = 0; v < nodes; ++v) {
+      indegree[v] = static_cast<uint32_t>(in_[v].size());
+      if (indegree[v] == 0) ready.push(static_cast<uint32_t>(v));
+    }
+    std::vector<uint32_t> order;
+    order.reserve(nodes);
+    while (!ready.empty()) {
+      const uint32_t v = ready.top();
+      ready.pop();
+      order.push_back(v);
+      for (const uint32_t w : out_[v])
+        if (--indegree[w] == 0) ready.push(w);
+    }
+    return order;
+  };
+
+  auto order = kahn();
+  std::vector<Arc> deferred;
+  if (order.size() < nodes) {
+    // Every cycle lies among the nodes Kahn could not place. Arcs between
+    // those are set aside, the rest is ordered, and the set-aside arcs go
+    // back in one by one so only the ones closing a cycle are lost.
+    std::vector<uint8_t> placed(nodes, 0);
+    for (const uint32_t v : order) placed[v] = 1;
+    for (const auto& a : unique) {
+      if (placed[a.first] || placed[a.second]) continue;
+      deferred.push_back(a);
+      erase(out_[a.first], a.second);
+      erase(in_[a.second], a.first);
+    }
+    order = kahn();
+  }
+  order_ = std::move(order);
+  rank_.assign(nodes, 0);
+  for (uint32_t r = 0; r < order_.size(); ++r) rank_[order_[r]] = r;
+  for (const auto& a : deferred)
+    if (!addArc(a.first, a.second)) rejected.push_back(a);
+  return rejected;
+}
+
+uint32_t DependencyOrder::addNode() {
+  const auto v = static_cast<uint32_t>(out_.size());
+  out_.emplace_back();
+  in_.emplace_back();
+  rank_.push_back(v);
+  order_.push_back(v);
+  mark_.push_back(0);
+  parent_.push_back(0);
+  return v;
+}
+
+bool DependencyOrder::hasArc(uint32_t from, uint32_t to) const {
+  if (from >= out_.size()) return false;
+  const auto& out = out_[from];
+  return std::find(out.begin(), out.end(), to) != out.end();
+}
+
+void DependencyOrder::insert(uint32_t from, uint32_t to) {
+  out_[from].push_back(to);
+  in_[to].push_back(from);
+}
+
+bool DependencyOrder::addArc(uint32_t from, uint32_t to,
+                             std::vector<uint32_t>* cycle) {
+  if (from == to) {
+    if (cycle) *cycle = {from, from};
+    return false;
+  }
+  if (hasArc(from, to)) return true;
+  const uint32_t upper = rank_[from];
+  const uint32_t lower = rank_[to];
+  if (upper < lower) {
+    insert(from, to);
+    return true;
+  }
+
+  // Forward search from `to` through nodes ranked before `from`. Reaching
+  // `from` means the arc closes a cycle.
+  std::vector<uint32_t> forward, backward, stack{to};
+  mark_[to] = 1;
+  parent_[to] = to;
+  bool closes = false;
+  while (!stack.empty() && !closes) {
+    const uint32_t v = stack.back();
+    stack.pop_back();
+    forward.push_back(v);
+    for (const uint32_t w : out_[v]) {
+      if (w == from) {
+        if (cycle) {
+          cycle->clear();
+          for (uint32_t u = v;; u = parent_[u]) {
+            cycle->push_back(u);
+            if (u == to) break;
+          }
+          cycle->push_back(from);
+          std::reverse(cycle->begin(), cycle->end());
+          cycle->push_back(from);
+        }
+        closes = true;
+        break;
+      }
+      if (!mark_[w] && rank_[w] < upper) {
+        mark_[w] = 1;
+        parent_[w] = v;
+        stack.push_back(w);
+      }
+    }
+  }
+  if (closes) {
+    for (const uint32_t v : forward) mark_[v] = 0;
+    for (const uint32_t v : stack) mark_[v] = 0;
+    return false;
+  }
+
+  // Backward search from `from` through nodes ranked after `to`.
+  stack.push_back(from);
+  mark_[from] = 1;
+  while (!stack.empty()) {
+    const uint32_t v = stack.back();
+    stack.pop_back();
+    backward.push_back(v);
+    for (const uint32_t w : in_[v]) {
+      if (!mark_[w] && rank_[w] > lower) {
+        mark_[w] = 1;
+        stack.push_back(w);
+      }
+    }
+  }
+
+  // The affected nodes keep their ranks between them: everything that
+  // reaches `from` now comes first, then everything reachable from `to`,
+  // each group in its previous relative order.
+  auto byRank = [this](uint32_t a, uint32_t b) { return rank_[a] < rank_[b]; };
+  std::sort(forward.begin(), forward.end(), byRank);
+  std::sort(backward.begin(), backward.end(), byRank);
+  std::vector<uint32_t> slots;
+  slots.reserve(forward.size() + backward.size());
+  for (const uint32_t v : backward) slots.push_back(rank_[v]);
+  for (const uint32_t v : forward) slots.push_back(rank_[v]);
+  std::sort(slots.begin(), slots.end());
+  size_t i = 0;
+  for (const auto* group : {&backward, &forward}) {
+    for (const uint32_t v : *group) {
+      rank_[v] = slots[i];
+      order_[slots[i]] = v;
+      mark_[v] = 0;
+      ++i;
+    }
+  }
+  insert(from, to);
+  return true;
+}
+
+bool DependencyOrder::addArcs(const std::vector<Arc>& arcs,
+                              std::vector<uint32_t>* cycle) {
+  std::vector<Arc> fresh;
+  fresh.reserve(arcs.size());
+  for (const auto& a : arcs) {
+    if (a.first == a.second) {
+      if (cycle) *cycle = {a.first, a.first};
+      return false;
+    }
+    if (!hasArc(a.first, a.second)) fresh.push_back(a);
+  }
+  std::sort(fresh.begin(), fresh.end());
+  fresh.erase(std::unique(fresh.begin(), fresh.end()), fresh.end());
+
+  // Each arc that disagrees with the current order spans a window of ranks
+  // that has to be sorted again; all other ranks stay valid. Overlapping
+  // windows are merged. Arcs between separate windows point forward, so
+  // every cycle lies inside one window and each can be sorted on its own.
+  std::vector<std::pair<uint32_t, uint32_t>> windows;
+  for (const auto& a : fresh)
+    if (rank_[a.first] > rank_[a.second])
+      windows.emplace_back(rank_[a.second], rank_[a.first]);
+  std::sort(windows.begin(), windows.end());
+  size_t merged = 0;
+  for (size_t i = 0; i < windows.size(); ++i) {
+    if (merged > 0 && windows[i].first <= windows[merged - 1].second)
+      windows[merged - 1].second =
+          std::max(windows[merged - 1].second, windows[i].second);
+    else
+      windows[merged++] = windows[i];
+  }
+  windows.resize(merged);
+
+  // Sorting a window touches every task in it. When the windows are wide
+  // compared to the batch, searching from each arc (which only visits tasks
+  // the arc actually reorders) is cheaper.
+  size_t span = 0;
+  for (const auto& [lo, hi] : windows) span += hi - lo + 1;
+  if (span > kWindowPerArc * fresh.size()) {
+    for (size_t i = 0; i < fresh.size(); ++i) {
+      if (addArc(fresh[i].first, fresh[i].second, cycle)) continue;
+      for (size_t j = 0; j < i; ++j) removeArc(fresh[j].first, fresh[j].second);
+      return false;
+    }
+    return true;
+  }
+
+  for (const auto& a : fresh) insert(a.first, a.second);
+  for (const auto& [lo, hi] : windows) {
+    if (!sortWindow(lo, hi, cycle)) {
+      // Windows sorted so far stay valid without the arcs.
+      for (const auto& a : fresh) removeArc(a.first, a.second);
+      if (cycle) startAtNewArc(*cycle, fresh);
+      return false;
+    }
+  }
+  return true;
+}
+
+bool DependencyOrder::sortWindow(uint32_t lo, uint32_t hi,
+                                 std::vector<uint32_t>* cycle) {
+  const uint32_t size = hi - lo + 1;
+  auto inWindow = [&](uint32_t v) { return rank_[v] >= lo && rank_[v] <= hi; };
+  std::vector<uint32_t> indegree(size, 0);
+  std::vector<uint32_t> sorted;
+  sorted.reserve(size);
+  for (uint32_t r = lo; r <= hi; ++r) {
+    const uint32_t v = order_[r];
+    for (const uint32_t p : in_[v]) indegree[r - lo] += inWindow(p);
+    if (indegree[r - lo] == 0) sorted.push_back(v);
+  }
+  for (size_t head = 0; head < sorted.size(); ++head)
+    for (const uint32_t w : out_[sorted[head]])
+      if (inWindow(w) && --indegree[rank_[w] - lo] == 0) sorted.push_back(w);
+
+  if (sorted.size() == size) {
+    for (uint32_t i = 0; i < size; ++i) {
+      order_[lo + i] = sorted[i];
+      rank_[sorted[i]] = lo + i;
+    }
+    return true;
+  }
+  if (!cycle) return false;
+
+  // Every node left over still has a left-over predecessor, so walking
+  // predecessors from any of them must come back around.
+  auto leftOver = [&](uint32_t v) {
+    return inWindow(v) && indegree[rank_[v] - lo] > 0;
+  };
+  uint32_t v = 0;
+  for (uint32_t r = lo; r <= hi; ++r) {
+    if (indegree[r - lo] > 0) {
+      v = order_[r];
+      break;
+    }
+  }
+  std::vector<uint32_t> walk;
+  while (!mark_[v]) {
+    mark_[v] = 1;
+    walk.push_back(v);
+    for (const uint32_t p : in_[v]) {
+      if (leftOver(p)) {
+        v = p;
+        break;
+      }
+    }
+  }
+  for (const uint32_t u : walk) mark_[u] = 0;
+  cycle->assign(std::find(walk.begin(), walk.end(), v), walk.end());
+  std::reverse(cycle->begin(), cycle->end());
+  cycle->push_back(cycle->front());
+  return false;
+}
+
+// Rotates a closed cycle so it starts with one of the (sorted) new arcs, the
+// way addArc() reports it.
+void DependencyOrder::startAtNewArc(std::vector<uint32_t>& cycle,
+                                    const std::vector<Arc>& fresh) {
+  if (cycle.size() < 2) return;
+  cycle.pop_back();
+  for (size_t i = 0; i < cycle.size(); ++i) {
+    const Arc arc{cycle[i], cycle[(i + 1) % cycle.size()]};
+    if (std::binary_search(fresh.begin(), fresh.end(), arc)) {
+      std::rotate(cycle.begin(), cycle.begin() + static_cast<long>(i),
+                  cycle.end());
+      break;
+    }
+  }
+  cycle.push_back(cycle.front());
+}
+
+void DependencyOrder::removeArc(uint32_t from, uint32_t to) {
+  if (from >= out_.size() || to >= in_.size()) return;
+  erase(out_[from], to);
+  erase(in_[to], from);
+}
+
+void DependencyOrder::clearNode(uint32_t v) {
+  if (v >= out_.size()) return;
+  for (const uint32_t w : out_[v]) erase(in_[w], v);
+  for (const uint32_t p : in_[v]) erase(out_[p], v);
+  out_[v].clear();
+  in_[v].clear();
+}
+
+}  // namespace engine
@@ -0,0 +1,179 @@
+#include "engine/Forecast.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <utility>
+
+namespace engine {
+
+namespace {
+
+// Trials per chunk; each chunk has its own seed.
+constexpr uint32_t kChunk = 64;
+// Independent generators advanced side by side. The loop over them has no
+// dependency between lanes, so the compiler vectorizes it.
+constexpr size_t kLanes = 8;
+
+uint64_t splitmix(uint64_t& x) {
+  uint64_t z = (x += 0x9E3779B97F4A7C15ull);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  return z ^ (z >> 31);
+}
+
+// xorshift64* in kLanes lanes, filling a buffer with uniforms in [0, 1).
+class LaneRng {
+ public:
+  explicit LaneRng(uint64_t seed) {
+    for (auto& s : state_) s = splitmix(seed) | 1;
+  }
+
+  void fill(double* out, size_t n) {
+    size_t i = 0;
+    for (; i + kLanes <= n; i += kLanes)
+      for (size_t k = 0; k < kLanes; ++k) out[i + k] = next(state_[k]);
+    for (size_t k = 0; i < n; ++i, ++k) out[i] = next(state_[k]);
+  }
+
+ private:
+  static double next(uint64_t& x) {
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    return static_cast<double>((x * 0x2545F4914F6CDD1Dull) >> 11) * 0x1p-53;
+  }
+
+  uint64_t state_[kLanes];
+};
+
+// The project laid out in topological order, so a trial walks every array
+// front to back. dependencyLag() is from * d(from) - to * d(to) with 0/1
+// coefficients per kind.
+struct Layout {
+  std::vector<double> scale;  // calendar minutes at the estimate
+  std::vector<double> release;
+  std::vector<uint32_t> inOffset;
+  std::vector<uint32_t> inSource;
+  std::vector<double> fromCoef;
+  std::vector<double> toCoef;
+};
+
+Layout layOut(const CriticalPath& path,
+              const std::vector<ForecastTask>& tasks) {
+  const auto& graph = path.graph();
+  const auto& rank = path.rank();
+  const size_t n = graph.nodeCount();
+  std::vector<uint32_t> order(n);
+  for (uint32_t v = 0; v < n; ++v) order[rank[v]] = v;
+
+  Layout out;
+  out.scale.resize(n);
+  out.release.resize(n);
+  out.inOffset.assign(1, 0);
+  for (size_t i = 0; i < n; ++i) {
+    const uint32_t v = order[i];
+    const ForecastTask task = v < tasks.size() ? tasks[v] : ForecastTask{};
+    out.scale[i] = static_cast<double>(graph.duration(v)) * task.pace;
+    out.release[i] = static_cast<double>(task.release);
+    for (uint32_t e = graph.inBegin(v); e < graph.inEnd(v); ++e) {
+      const auto kind = graph.inKind(e);
+      out.inSource.push_back(rank[graph.inSource(e)]);
+      out.fromCoef.push_back(dependencyLag(kind, 1, 0));
+      out.toCoef.push_back(-dependencyLag(kind, 0, 1));
+    }
+    out.inOffset.push_back(static_cast<uint32_t>(out.inSource.size()));
+  }
+  return out;
+}
+
+}  // namespace
+
+Forecast::Forecast(std::vector<Minute> finishes)
+    : finishes_(std::move(finishes)) {
+  std::sort(finishes_.begin(), finishes_.end());
+}
+
+Minute Forecast::percentile(double q) const {
+  if (finishes_.empty()) return 0;
+  const double rank = std::ceil(std::clamp(q, 0.0, 1.0) * finishes_.size());
+  const size_t i = std::max<size_t>(static_cast<size_t>(rank), 1) - 1;
+  return finishes_[std::min(i, finishes_.size() - 1)];
+}
+
+double Forecast::mean() const {
+  if (finishes_.empty()) return 0;
+  double sum = 0;
+  for (const Minute m : finishes_) sum += static_cast<double>(m);
+  return sum / static_cast<double>(finishes_.size());
+}
+
+double Forecast::within(Minute deadline) const {
+  if (finishes_.empty()) return 0;
+  const auto met = std::upper_bound(finishes_.begin(), finishes_.end(),
+                                    deadline) -
+                   finishes_.begin();
+  return static_cast<double>(met) / static_cast<double>(finishes_.size());
+}
+
+Forecast forecastProject(const CriticalPath& path,
+                         const std::vector<ForecastTask>& tasks,
+                         const ForecastOptions& options) {
+  if (!path.acyclic() || options.trials == 0) return {};
+  const Layout layout = layOut(path, tasks);
+  const size_t n = layout.scale.size();
+
+  // Inverse CDF of the triangular distribution with mode 1.
+  const double low = std::min(options.optimistic, 1.0);
+  const double high = std::max(options.pessimistic, 1.0);
+  const double split = high > low ? (1.0 - low) / (high - low) : 0.0;
+  const double left = (high - low) * (1.0 - low);
+  const double right = (high - low) * (high - 1.0);
+
+  std::vector<Minute> finishes(options.trials);
+  const uint32_t chunks = (options.trials + kChunk - 1) / kChunk;
+  std::atomic<uint32_t> next{0};
+  auto work = [&] {
+    std::vector<double> u(n), d(n), es(n);
+    for (uint32_t c; (c = next.fetch_add(1)) < chunks;) {
+      uint64_t seed = options.seed ^ (static_cast<uint64_t>(c) << 32);
+      LaneRng rng(splitmix(seed));
+      const uint32_t end = std::min(options.trials, (c + 1) * kChunk);
+      for (uint32_t t = c * kChunk; t < end; ++t) {
+        rng.fill(u.data(), n);
+        for (size_t i = 0; i < n; ++i) {
+          const double x = u[i] < split
+                               ? low + std::sqrt(u[i] * left)
+                               : high - std::sqrt((1.0 - u[i]) * right);
+          d[i] = layout.scale[i] * x;
+        }
+        double finish = 0;
+        for (size_t i = 0; i < n; ++i) {
+          double start = layout.release[i];
+          for (uint32_t e = layout.inOffset[i]; e < layout.inOffset[i + 1];
+               ++e) {
+            const uint32_t p = layout.inSource[e];
+            start = std::max(start, es[p] + layout.fromCoef[e] * d[p] -
+                                        layout.toCoef[e] * d[i]);
+          }
+          es[i] = start;
+          finish = std::max(finish, start + d[i]);
+        }
+        finishes[t] = static_cast<Minute>(std::ceil(finish));
+      }
+    }
+  };
+
+  unsigned threads = options.threads ? options.threads
+                                     : std::thread::hardware_concurrency();
+  threads = std::clamp(threads, 1u, chunks);
+  std::vector<std::thread> pool;
+  pool.reserve(threads - 1);
+  for (unsigned i = 1; i < threads; ++i) pool.emplace_back(work);
+  work();
+  for (auto& t : pool) t.join();
+  return Forecast(std::move(finishes));
+}
+
+}  // namespace engine
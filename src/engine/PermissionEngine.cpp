@@ -0,0 +1,235 @@
+#include "engine/PermissionEngine.hpp"
+
+#include <algorithm>
+#include <vector>
+
+namespace engine {
+
+std::optional<Role> parseRole(std::string_view s) {
+  if (s == "admin") return Role::Admin;
+  if (s == "owner") return Role::Owner;
+  if (s == "supervisor") return Role::Supervisor;
+  if (s == "hybrid") return Role::Hybrid;
+  if (s == "executor") return Role::Executor;
+  if (s == "spectator") return Role::Spectator;
+  if (s == "audit_role") return Role::Audit;
+  return std::nullopt;
+}
+
+PermissionMatrix::PermissionMatrix(std::vector<std::string> keys,
+                                   const std::vector<Entry>& grants)
+    : keys_(std::move(keys)) {
+  std::sort(keys_.begin(), keys_.end());
+  keys_.erase(std::unique(keys_.begin(), keys_.end()), keys_.end());
+  // One bit per key; the schema defines 28.
+  if (keys_.size() > 64) keys_.resize(64);
+
+  std::array<PermissionMask, kRoleCount> local{};
+  std::array<PermissionMask, kRoleCount> full{};
+  for (const auto& g : grants) {
+    const auto role = parseRole(g.role);
+    const int b = bit(g.key);
+    if (!role || b < 0) continue;
+    const auto r = static_cast<size_t>(*role);
+    const PermissionMask m = PermissionMask{1} << b;
+    full[r] |= m;
+    if (!g.isGlobal) local[r] |= m;
+  }
+
+  for (size_t set = 0; set < localBySet_.size(); ++set) {
+    for (size_t r = 0; r < kRoleCount; ++r) {
+      if (set & (size_t{1} << r)) {
+        localBySet_[set] |= local[r];
+        fullBySet_[set] |= full[r];
+      }
+    }
+  }
+}
+
+int PermissionMatrix::bit(std::string_view key) const {
+  auto it = std::lower_bound(keys_.begin(), keys_.end(), key);
+  if (it == keys_.end() || *it != key) return -1;
+  return static_cast<int>(it - keys_.begin());
+}
+
+PermissionEngine::PermissionEngine()
+    : state_([] {
+        auto snap = std::make_shared<Snapshot>();
+        snap->matrix = std::make_shared<PermissionMatrix>();
+        snap->globalRoles = std::make_shared<
+            std::unordered_map<Uuid, RoleSet, UuidHash>>();
+        auto empty = std::make_shared<const Bucket>();
+        auto shard = std::make_shared<Shard>();
+        shard->fill(empty);
+        snap->shards.fill(shard);
+        return std::shared_ptr<const Snapshot>(std::move(snap));
+      }()) {}
+
+void PermissionEngine::load(
+    std::shared_ptr<const PermissionMatrix> matrix,
+    std::unordered_map<Uuid, RoleSet, UuidHash> globalRoles,
+    std::vector<TaskAcl> tasks) {
+  std::vector<std::shared_ptr<Bucket>> buckets(kShards * kBuckets);
+  for (auto& b : buckets) b = std::make_shared<Bucket>();
+  for (auto& t : tasks) {
+    const Uuid id = t.id;
+    (*buckets[slotOf(id)])[id] = std::move(t);
+  }
+
+  auto snap = std::make_shared<Snapshot>();
+  snap->matrix = std::move(matrix);
+  snap->globalRoles =
+      std::make_shared<const std::unordered_map<Uuid, RoleSet, UuidHash>>(
+          std::move(globalRoles));
+  for (size_t s = 0; s < kShards; ++s) {
+    auto shard = std::make_shared<Shard>();
+    for (size_t b = 0; b < kBuckets; ++b)
+      (*shard)[b] = std::move(buckets[s * kBuckets + b]);
+    snap->shards[s] = std::move(shard);
+  }
+  state_.publish(std::move(snap));
+}
+
+PermissionEngine::Bucket& PermissionEngine::mutableBucket(Snapshot& snap,
+                                                          const Uuid& task,
+                                                          Copies& copies) {
+  const size_t slot = slotOf(task);
+  if (auto it = copies.buckets.find(slot); it != copies.buckets.end())
+    return *it->second;
+
+  Shard*& shard = copies.shards[slot / kBuckets];
+  if (!shard) {
+    auto copy = std::make_shared<Shard>(*snap.shards[slot / kBuckets]);
+    shard = copy.get();
+    snap.shards[slot / kBuckets] = std::move(copy);
+  }
+  auto& entry = (*shard)[slot % kBuckets];
+  auto copy = std::make_shared<Bucket>(*entry);
+  Bucket& ref = *copy;
+  entry = std::move(copy);
+  copies.buckets.emplace(slot, &ref);
+  return ref;
+}
+
+void PermissionEngine::upsert(std::vector<TaskAcl> tasks) {
+  if (tasks.empty()) return;
+  state_.update([&](Snapshot& snap) {
+    Copies copies;
+    for (auto& t : tasks) {
+      const Uuid id = t.id;
+      mutableBucket(snap, id, copies)[id] = std::move(t);
+    }
+  });
+}
+
+void PermissionEngine::remove(const Uuid& task) {
+  if (!hasTask(task)) return;
+  state_.update([&](Snapshot& snap) {
+    Copies copies;
+    mutableBucket(snap, task, copies).erase(task);
+  });
+}
+
+TaskAcl* PermissionEngine::mutableAcl(Snapshot& snap, const Uuid& task) {
+  if (!bucketOf(snap, task).count(task)) return nullptr;
+  Copies copies;
+  return &mutableBucket(snap, task, copies)[task];
+}
+
+void PermissionEngine::grantRoles(const Uuid& task, const Uuid& user,
+                                  RoleSet roles) {
+  state_.update([&](Snapshot& snap) {
+    TaskAcl* acl = mutableAcl(snap, task);
+    if (!acl) return;
+    for (auto& g : acl->roles) {
+      if (g.user == user) {
+        g.local |= roles;
+        return;
+      }
+    }
+    acl->roles.push_back({user, roles, 0});
+  });
+}
+
+void PermissionEngine::revokeRoles(const Uuid& task, const Uuid& user) {
+  state_.update([&](Snapshot& snap) {
+    TaskAcl* acl = mutableAcl(snap, task);
+    if (!acl) return;
+    for (auto& g : acl->roles)
+      if (g.user == user) g.local = 0;
+  });
+}
+
+void PermissionEngine::reparent(const Uuid& task, std::optional<Uuid> parent) {
+  state_.update([&](Snapshot& snap) {
+    if (TaskAcl* acl = mutableAcl(snap, task)) acl->parent = parent;
+  });
+}
+
+int PermissionEngine::bit(std::string_view key) const {
+  return state_.local().matrix->bit(key);
+}
+
+bool PermissionEngine::hasTask(const Uuid& task) const {
+  return bucketOf(state_.local(), task).count(task) > 0;
+}
+
+PermissionResolution PermissionEngine::resolve(const Uuid& user,
+                                               const Uuid& task,
+                                               int64_t now) const {
+  return resolveIn(state_.local(), user, task, now);
+}
+
+PermissionResolution PermissionEngine::resolveIn(const Snapshot& snap,
+                                                 const Uuid& user,
+                                                 const Uuid& task,
+                                                 int64_t now) {
+  PermissionResolution out;
+
+  RoleSet localRoles = 0;
+  RoleSet fullRoles = 0;
+  PermissionMask allow = 0;
+  PermissionMask deny = 0;
+  if (auto g = snap.globalRoles->find(user); g != snap.globalRoles->end())
+    fullRoles |= g->second;
+
+  Uuid cur = task;
+  for (int depth = 0; depth < kMaxDepth; ++depth) {
+    const Bucket& bucket = bucketOf(snap, cur);
+    auto it = bucket.find(cur);
+    if (it == bucket.end()) break;
+    out.known = true;
+    const TaskAcl& acl = it->second;
+    if (acl.createdBy == user) localRoles |= roleBit(Role::Owner);
+    for (const auto& g : acl.roles) {
+      if (g.user == user) {
+        localRoles |= g.local;
+        fullRoles |= g.full;
+      }
+    }
+    for (const auto& d : acl.delegations) {
+      if (d.grantee == user && (d.expiresAt == 0 || d.expiresAt > now)) {
+        allow |= d.allow;
+        deny |= d.deny;
+      }
+    }
+    if (!acl.parent) break;
+    cur = *acl.parent;
+  }
+
+  const PermissionMatrix& m = *snap.matrix;
+  out.owner = ((localRoles | fullRoles) & roleBit(Role::Owner)) != 0;
+  out.mask = (m.local(localRoles) | m.full(fullRoles) | allow) & ~deny;
+  return out;
+}
+
+bool PermissionEngine::allowed(const Uuid& user, const Uuid& task,
+                               std::string_view key, int64_t now) const {
+  const Snapshot& snap = state_.local();
+  const int b = snap.matrix->bit(key);
+  const auto r = resolveIn(snap, user, task, now);
+  if (b < 0) return r.owner;
+  return (r.mask >> b) & 1;
+}
+
+}  // namespace engine
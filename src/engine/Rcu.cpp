@@ -0,0 +1,15 @@
+#include "engine/Rcu.hpp"
+
+namespace engine::detail {
+
+std::vector<RcuSlot>& rcuSlots() {
+  thread_local std::vector<RcuSlot> slots;
+  return slots;
+}
+
+uint32_t nextRcuId() {
+  static std::atomic<uint32_t> next{0};
+  return next.fetch_add(1, std::memory_order_relaxed);
+}
+
+}  // namespace engine::detail
@@ -0,0 +1,236 @@
+#include "engine/Rebalance.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <queue>
+#include <tuple>
+
+namespace engine {
+
+namespace {
+
+constexpr uint32_t kNone = std::numeric_limits<uint32_t>::max();
+constexpr int64_t kInfinity = std::numeric_limits<int64_t>::max() / 4;
+
+}  // namespace
+
+MinCostFlow::MinCostFlow(size_t nodes) : head_(nodes, kNone) {}
+
+uint32_t MinCostFlow::addNode() {
+  head_.push_back(kNone);
+  return static_cast<uint32_t>(head_.size() - 1);
+}
+
+size_t MinCostFlow::addArc(uint32_t from, uint32_t to, int64_t capacity,
+                           int64_t cost) {
+  const size_t id = to_.size();
+  auto half = [&](uint32_t a, uint32_t b, int64_t c, int64_t k) {
+    to_.push_back(b);
+    cap_.push_back(c);
+    cost_.push_back(k);
+    next_.push_back(head_[a]);
+    head_[a] = static_cast<uint32_t>(to_.size() - 1);
+  };
+  half(from, to, capacity, cost);
+  half(to, from, 0, -cost);
+  return id;
+}
+
+MinCostFlow::Result MinCostFlow::solve(uint32_t source, uint32_t sink,
+                                       int64_t limit) {
+  const size_t n = head_.size();
+  potential_.assign(n, 0);
+  dist_.resize(n);
+  level_.resize(n);
+  current_.resize(n);
+  Result result;
+
+  using Entry = std::pair<int64_t, uint32_t>;
+  std::priority_queue<Entry, std::vector<Entry>, std::greater<>> heap;
+  auto reduced = [&](uint32_t from, uint32_t arc) {
+    return cost_[arc] + potential_[from] - potential_[to_[arc]];
+  };
+
+  while (result.flow < limit) {
+    std::fill(dist_.begin(), dist_.end(), kInfinity);
+    dist_[source] = 0;
+    heap.push({0, source});
+    while (!heap.empty()) {
+      const auto [d, v] = heap.top();
+      heap.pop();
+      if (d > dist_[v]) continue;
+      for (uint32_t a = head_[v]; a != kNone; a = next_[a]) {
+        if (cap_[a] <= 0) continue;
+        const int64_t nd = d + reduced(v, a);
+        if (nd < dist_[to_[a]]) {
+          dist_[to_[a]] = nd;
+          heap.push({nd, to_[a]});
+        }
+      }
+    }
+    if (dist_[sink] >= kInfinity) break;
+    // Capping at the sink's distance keeps every residual reduced cost
+    // non-negative, including arcs out of nodes the search never reached.
+    for (size_t v = 0; v < n; ++v)
+      potential_[v] += std::min(dist_[v], dist_[sink]);
+
+    // Blocking flows over the arcs on shortest paths, which now have zero
+    // reduced cost, until the sink is cut off from them.
+    for (;;) {
+      std::fill(level_.begin(), level_.end(), kNone);
+      std::queue<uint32_t> bfs;
+      level_[source] = 0;
+      bfs.push(source);
+      while (!bfs.empty()) {
+        const uint32_t v = bfs.front();
+        bfs.pop();
+        for (uint32_t a = head_[v]; a != kNone; a = next_[a]) {
+          if (cap_[a] <= 0 || reduced(v, a) != 0 || level_[to_[a]] != kNone)
+            continue;
+          level_[to_[a]] = level_[v] + 1;
+          bfs.push(to_[a]);
+        }
+      }
+      if (level_[sink] == kNone) break;
+      std::copy(head_.begin(), head_.end(), current_.begin());
+      while (result.flow < limit) {
+        const int64_t pushed = push(source, sink, limit - result.flow);
+        if (pushed == 0) break;
+        result.flow += pushed;
+      }
+      if (result.flow >= limit) break;
+    }
+  }
+
+  for (size_t a = 0; a < to_.size(); a += 2)
+    result.cost += cap_[a + 1] * cost_[a];
+  return result;
+}
+
+int64_t MinCostFlow::push(uint32_t v, uint32_t sink, int64_t limit) {
+  if (v == sink) return limit;
+  for (uint32_t& a = current_[v]; a != kNone; a = next_[a]) {
+    const uint32_t w = to_[a];
+    if (cap_[a] <= 0 || level_[w] != level_[v] + 1 ||
+        cost_[a] + potential_[v] - potential_[w] != 0)
+      continue;
+    const int64_t pushed = push(w, sink, std::min(limit, cap_[a]));
+    if (pushed > 0) {
+      cap_[a] -= pushed;
+      cap_[a ^ 1] += pushed;
+      return pushed;
+    }
+  }
+  return 0;
+}
+
+std::vector<Move> rebalance(const std::vector<RebalanceTask>& tasks,
+                            const std::vector<Overload>& overloads,
+                            const std::vector<Spare>& spare,
+                            const RebalanceOptions& options) {
+  std::vector<Move> moves;
+  if (overloads.empty() || spare.empty()) return moves;
+
+  // Source -> overload (its excess) -> task share (cost by priority) ->
+  // day (cost by distance) -> spare entry (its minutes) -> sink. Days are
+  // shared by all users, which keeps the network linear in users x days;
+  // who gives time to whom is read back per day at the end.
+  int64_t firstDay = spare.front().day, lastDay = spare.front().day;
+  for (const auto& s : spare) {
+    firstDay = std::min(firstDay, s.day);
+    lastDay = std::max(lastDay, s.day);
+  }
+  MinCostFlow network(2);
+  const uint32_t source = 0, sink = 1;
+  std::vector<uint32_t> dayNode(static_cast<size_t>(lastDay - firstDay + 1),
+                                kNone);
+  for (const auto& s : spare) {
+    if (s.minutes <= 0) continue;
+    auto& node = dayNode[static_cast<size_t>(s.day - firstDay)];
+    if (node == kNone) node = network.addNode();
+  }
+  std::vector<size_t> spareArcs(spare.size(), SIZE_MAX);
+  for (size_t i = 0; i < spare.size(); ++i) {
+    if (spare[i].minutes <= 0) continue;
+    const uint32_t node = network.addNode();
+    network.addArc(dayNode[static_cast<size_t>(spare[i].day - firstDay)],
+                   node, spare[i].minutes, 0);
+    spareArcs[i] = network.addArc(node, sink, spare[i].minutes, 0);
+  }
+
+  struct ShareArc {
+    size_t arc;
+    size_t overload;
+    uint32_t task;
+    int64_t toDay;
+  };
+  std::vector<ShareArc> shareArcs;
+  for (size_t o = 0; o < overloads.size(); ++o) {
+    const auto& over = overloads[o];
+    if (over.excess <= 0) continue;
+    const uint32_t node = network.addNode();
+    network.addArc(source, node, over.excess, 0);
+    for (const auto& share : over.tasks) {
+      if (share.minutes <= 0 || share.task >= tasks.size()) continue;
+      const auto& task = tasks[share.task];
+      const int priority = std::clamp(task.priority, 0, 3);
+      const uint32_t shareNode = network.addNode();
+      network.addArc(node, shareNode, std::min(share.minutes, over.excess),
+                     options.priorityCost[priority]);
+      const int64_t from =
+          std::max({firstDay, task.firstDay, over.day - options.maxShiftDays});
+      const int64_t to =
+          std::min({lastDay, task.lastDay, over.day + options.maxShiftDays});
+      for (int64_t day = from; day <= to; ++day) {
+        const uint32_t target = dayNode[static_cast<size_t>(day - firstDay)];
+        if (target == kNone) continue;
+        shareArcs.push_back(
+            {network.addArc(shareNode, target, share.minutes,
+                            options.dayCost * std::llabs(day - over.day)),
+             o, share.task, day});
+      }
+    }
+  }
+  network.solve(source, sink);
+
+  // Pair what flowed into each day with what flowed out of it. Any pairing
+  // is as cheap as any other, since leaving a day costs nothing.
+  std::map<int64_t, std::vector<std::pair<size_t, Minute>>> given;  // share
+  std::map<int64_t, std::vector<std::pair<size_t, Minute>>> taken;  // spare
+  for (size_t i = 0; i < shareArcs.size(); ++i)
+    if (const auto f = network.flow(shareArcs[i].arc); f > 0)
+      given[shareArcs[i].toDay].push_back({i, f});
+  for (size_t i = 0; i < spare.size(); ++i)
+    if (spareArcs[i] != SIZE_MAX)
+      if (const auto f = network.flow(spareArcs[i]); f > 0)
+        taken[spare[i].day].push_back({i, f});
+
+  std::map<std::tuple<uint32_t, uint32_t, int64_t, uint32_t, int64_t>, Minute>
+      merged;
+  for (auto& [day, in] : given) {
+    auto& out = taken[day];
+    size_t j = 0;
+    for (auto& [share, amount] : in) {
+      while (amount > 0 && j < out.size()) {
+        const Minute moved = std::min(amount, out[j].second);
+        const auto& s = shareArcs[share];
+        const auto& over = overloads[s.overload];
+        merged[{s.task, over.user, over.day, spare[out[j].first].user, day}] +=
+            moved;
+        amount -= moved;
+        out[j].second -= moved;
+        if (out[j].second == 0) ++j;
+      }
+    }
+  }
+  moves.reserve(merged.size());
+  for (const auto& [key, minutes] : merged) {
+    const auto& [task, fromUser, fromDay, toUser, toDay] = key;
+    moves.push_back({task, fromUser, fromDay, toUser, toDay, minutes});
+  }
+  return moves;
+}
+
+}  // namespace engine
@@ -0,0 +1,287 @@
+#include "engine/Scheduler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <queue>
+#include <tuple>
+
+namespace engine {
+
+namespace {
+
+int64_t floorDiv(Minute m, Minute d) {
+  return m >= 0 ? m / d : -((-m + d - 1) / d);
+}
+
+// First busy interval that ends after `m`.
+std::vector<Interval>::const_iterator firstEndingAfter(
+    const std::vector<Interval>& busy, Minute m) {
+  return std::lower_bound(
+      busy.begin(), busy.end(), m,
+      [](const Interval& i, Minute value) { return i.end <= value; });
+}
+
+}  // namespace
+
+std::string formatDay(int64_t day) {
+  const std::chrono::year_month_day ymd{
+      std::chrono::sys_days{std::chrono::days{day}}};
+  char buf[16];
+  std::snprintf(buf, sizeof(buf), "%04d-%02u-%02u",
+                static_cast<int>(ymd.year()),
+                static_cast<unsigned>(ymd.month()),
+                static_cast<unsigned>(ymd.day()));
+  return buf;
+}
+
+std::string formatMinute(Minute minute) {
+  const int64_t day = floorDiv(minute, kMinutesPerDay);
+  const Minute ofDay = minute - day * kMinutesPerDay;
+  char buf[16];
+  std::snprintf(buf, sizeof(buf), "T%02d:%02d:00Z",
+                static_cast<int>(ofDay / 60), static_cast<int>(ofDay % 60));
+  return formatDay(day) + buf;
+}
+
+UserCalendar::UserCalendar(const std::vector<WorkWindow>& windows) {
+  for (const auto& w : windows) {
+    if (w.weekday < 0 || w.weekday > 6) continue;
+    const int start = std::max(0, w.startMinute);
+    const int end = std::min<int>(kMinutesPerDay, w.endMinute);
+    if (end <= start) continue;
+    windows_[static_cast<size_t>(w.weekday)].push_back({start, end});
+  }
+  for (auto& day : windows_) {
+    std::sort(day.begin(), day.end(), [](const Interval& a, const Interval& b) {
+      return a.start < b.start;
+    });
+    std::vector<Interval> merged;
+    for (const auto& i : day) {
+      if (!merged.empty() && i.start <= merged.back().end)
+        merged.back().end = std::max(merged.back().end, i.end);
+      else
+        merged.push_back(i);
+    }
+    day = std::move(merged);
+    hasWindows_ = hasWindows_ || !day.empty();
+  }
+}
+
+void UserCalendar::addBusy(Interval b) {
+  if (b.end <= b.start) return;
+  // Intervals that overlap or touch `b` are folded into it.
+  auto first = std::lower_bound(
+      busy_.begin(), busy_.end(), b.start,
+      [](const Interval& i, Minute value) { return i.end < value; });
+  auto last = first;
+  while (last != busy_.end() && last->start <= b.end) {
+    b.start = std::min(b.start, last->start);
+    b.end = std::max(b.end, last->end);
+    ++last;
+  }
+  if (first == last) {
+    busy_.insert(first, b);
+  } else {
+    *first = b;
+    busy_.erase(first + 1, last);
+  }
+}
+
+void UserCalendar::addBusy(const std::vector<Interval>& sorted) {
+  for (const auto& b : sorted) addBusy(b);
+}
+
+void UserCalendar::removeBusy(Interval freed) {
+  if (freed.end <= freed.start) return;
+  auto first = busy_.begin() + (firstEndingAfter(busy_, freed.start) -
+                                busy_.cbegin());
+  auto last = first;
+  Interval keep[2];
+  size_t kept = 0;
+  while (last != busy_.end() && last->start < freed.end) {
+    if (last->start < freed.start) keep[kept++] = {last->start, freed.start};
+    if (last->end > freed.end) keep[kept++] = {freed.end, last->end};
+    ++last;
+  }
+  first = busy_.erase(first, last);
+  busy_.insert(first, keep, keep + kept);
+}
+
+Minute UserCalendar::freeSlots(Minute from, Minute to,
+                               std::vector<Interval>& out,
+                               Minute limit) const {
+  if (!hasWindows_ || to <= from) return 0;
+  Minute got = 0;
+  for (int64_t day = floorDiv(from, kMinutesPerDay);
+       day * kMinutesPerDay < to; ++day) {
+    const Minute dayStart = day * kMinutesPerDay;
+    for (const auto& w : windows_[static_cast<size_t>(weekdayOf(day))]) {
+      const Minute ws = std::max(from, dayStart + w.start);
+      const Minute we = std::min(to, dayStart + w.end);
+      if (ws >= we) continue;
+      auto it = firstEndingAfter(busy_, ws);
+      Minute cursor = ws;
+      while (cursor < we) {
+        const bool blocked = it != busy_.end() && it->start < we;
+        const Minute stop = blocked ? std::max(it->start, cursor) : we;
+        if (stop > cursor) {
+          Minute take = stop - cursor;
+          if (limit) take = std::min(take, limit - got);
+          out.push_back({cursor, cursor + take});
+          got += take;
+          if (limit && got >= limit) return got;
+        }
+        if (!blocked) break;
+        cursor = std::max(cursor, it->end);
+        ++it;
+      }
+    }
+  }
+  return got;
+}
+
+Minute UserCalendar::place(int64_t fromDay, int64_t toDay, Minute minutes,
+                           std::vector<Interval>& out) {
+  if (minutes <= 0) return 0;
+  const size_t before = out.size();
+  const Minute got = freeSlots(fromDay * kMinutesPerDay,
+                               (toDay + 1) * kMinutesPerDay, out, minutes);
+  for (size_t i = before; i < out.size(); ++i) addBusy(out[i]);
+  return minutes - got;
+}
+
+size_t AutoScheduler::addUser(const std::vector<WorkWindow>& windows) {
+  users_.emplace_back(windows);
+  return users_.size() - 1;
+}
+
+AutoScheduler::Result AutoScheduler::place(
+    const std::vector<Assignment>& assignments) {
+  const size_t n = assignments.size();
+  Result result;
+  result.unplaced.resize(n);
+
+  std::vector<uint32_t> waiting(n, 0);
+  std::vector<std::vector<size_t>> dependents(n);
+  std::vector<Minute> ready(n);
+  for (size_t i = 0; i < n; ++i) {
+    const auto& a = assignments[i];
+    result.unplaced[i] = std::max<Minute>(a.minutes, 0);
+    ready[i] = a.startDay * kMinutesPerDay;
+    for (const size_t p : a.after) {
+      if (p >= n || p == i) continue;
+      ++waiting[i];
+      dependents[p].push_back(i);
+    }
+  }
+
+  // Highest priority first, then earliest due day, then earliest ready
+  // minute, then input order. Without priorities and dependencies this is
+  // plain earliest-deadline-first.
+  using Key = std::tuple<int, int64_t, Minute, size_t>;
+  std::priority_queue<Key, std::vector<Key>, std::greater<>> heap;
+  auto push = [&](size_t i) {
+    heap.push({-assignments[i].priority, assignments[i].dueDay, ready[i], i});
+  };
+  for (size_t i = 0; i < n; ++i)
+    if (waiting[i] == 0) push(i);
+
+  // Placed blocks per user by start minute, so the ones in a range can be
+  // found and taken back.
+  std::vector<std::map<Minute, Block>> placed(users_.size());
+  std::vector<Minute> finish(n, 0);
+  std::vector<uint8_t> released(n, 0);
+  std::vector<Interval> slots;
+  std::vector<std::map<Minute, Block>::iterator> victims;
+
+  auto book = [&](size_t i, UserCalendar& calendar, Minute from, Minute to) {
+    slots.clear();
+    const Minute got =
+        calendar.freeSlots(from, to, slots, result.unplaced[i]);
+    for (const auto& slot : slots) {
+      calendar.addBusy(slot);
+      placed[assignments[i].user].emplace(slot.start, Block{i, slot});
+      finish[i] = std::max(finish[i], slot.end);
+    }
+    result.unplaced[i] -= got;
+  };
+
+  auto placeOne = [&](size_t i) {
+    const auto& a = assignments[i];
+    if (result.unplaced[i] <= 0 || a.user >= users_.size() ||
+        a.dueDay < a.startDay)
+      return;
+    auto& calendar = users_[a.user];
+    const Minute from = ready[i];
+    const Minute to = (a.dueDay + 1) * kMinutesPerDay;
+    if (from >= to) return;
+    book(i, calendar, from, to);
+    if (result.unplaced[i] <= 0) return;
+
+    // Take back time from the least important work in the range first,
+    // and of that from whatever is due last.
+    auto& own = placed[a.user];
+    victims.clear();
+    for (auto it = own.lower_bound(from); it != own.end() && it->first < to;
+         ++it) {
+      const size_t v = it->second.assignment;
+      if (assignments[v].priority < a.priority && dependents[v].empty())
+        victims.push_back(it);
+    }
+    if (victims.empty()) return;
+    std::sort(victims.begin(), victims.end(), [&](auto x, auto y) {
+      const auto& vx = assignments[x->second.assignment];
+      const auto& vy = assignments[y->second.assignment];
+      if (vx.priority != vy.priority) return vx.priority < vy.priority;
+      if (vx.dueDay != vy.dueDay) return vx.dueDay > vy.dueDay;
+      return x->first > y->first;
+    });
+    Minute freed = 0;
+    for (const auto it : victims) {
+      if (freed >= result.unplaced[i]) break;
+      const Block block = it->second;
+      own.erase(it);
+      calendar.removeBusy(block.slot);
+      result.unplaced[block.assignment] += block.slot.length();
+      freed += block.slot.length();
+      ++result.preempted;
+      push(block.assignment);
+    }
+    book(i, calendar, from, to);
+  };
+
+  auto release = [&](size_t i) {
+    if (released[i]) return;
+    released[i] = 1;
+    for (const size_t d : dependents[i]) {
+      ready[d] = std::max(ready[d], finish[i]);
+      if (--waiting[d] == 0) push(d);
+    }
+  };
+
+  for (;;) {
+    if (heap.empty()) {
+      // Only a dependency cycle leaves assignments waiting; place them
+      // without their dependencies.
+      for (size_t i = 0; i < n; ++i)
+        if (!released[i] && waiting[i] > 0) {
+          waiting[i] = 0;
+          push(i);
+        }
+      if (heap.empty()) break;
+    }
+    const size_t i = std::get<3>(heap.top());
+    heap.pop();
+    placeOne(i);
+    release(i);
+  }
+
+  for (const auto& own : placed)
+    for (const auto& [start, block] : own) result.blocks.push_back(block);
+  return result;
+}
+
+}  // namespace engine
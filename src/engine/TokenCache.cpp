@@ -0,0 +1,68 @@
+#include "engine/TokenCache.hpp"
+
+#include <algorithm>
+#include <functional>
+
+namespace engine {
+
+TokenCache::TokenCache(size_t capacity, size_t shards) : capacity_(capacity) {
+  shards = std::max<size_t>(1, shards);
+  perShard_ = capacity == 0 ? 0 : std::max<size_t>(1, capacity / shards);
+  shards_.reserve(shards);
+  for (size_t i = 0; i < shards; ++i)
+    shards_.push_back(std::make_unique<Shard>());
+}
+
+TokenCache::Shard& TokenCache::shardFor(std::string_view token) {
+  // The low bits feed the per-shard hash table; pick shards from the top.
+  const size_t h = std::hash<std::string_view>{}(token);
+  return *shards_[(h >> 48) % shards_.size()];
+}
+
+std::optional<std::string> TokenCache::find(std::string_view token,
+                                            int64_t now) {
+  if (perShard_ == 0) return std::nullopt;
+  Shard& shard = shardFor(token);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto it = shard.index.find(token);
+  if (it == shard.index.end()) return std::nullopt;
+  auto entry = it->second;
+  if (entry->expiresAt != 0 && entry->expiresAt <= now) {
+    shard.index.erase(it);
+    shard.entries.erase(entry);
+    return std::nullopt;
+  }
+  shard.entries.splice(shard.entries.begin(), shard.entries, entry);
+  return entry->userId;
+}
+
+void TokenCache::insert(std::string_view token, std::string userId,
+                        int64_t expiresAt) {
+  if (perShard_ == 0) return;
+  Shard& shard = shardFor(token);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  if (auto it = shard.index.find(token); it != shard.index.end()) {
+    it->second->userId = std::move(userId);
+    it->second->expiresAt = expiresAt;
+    shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+    return;
+  }
+  shard.entries.push_front({std::string(token), std::move(userId), expiresAt});
+  // The key views the token stored in the list node, which never moves.
+  shard.index.emplace(shard.entries.front().token, shard.entries.begin());
+  if (shard.entries.size() > perShard_) {
+    shard.index.erase(shard.entries.back().token);
+    shard.entries.pop_back();
+  }
+}
+
+size_t TokenCache::size() const {
+  size_t n = 0;
+  for (const auto& shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    n += shard->entries.size();
+  }
+  return n;
+}
+
+}  // namespace engine
@@ -0,0 +1,256 @@
+#include "engine/WhatIf.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <utility>
+
+namespace engine {
+
+namespace {
+
+uint64_t heapKey(uint32_t rank, uint32_t v) {
+  return (static_cast<uint64_t>(rank) << 32) | v;
+}
+
+// Places one user's assignments, given in the baseline's order, into a
+// copy of their calendar. Assignments of different users never compete for
+// time, so placing users one at a time gives the same result as placing
+// everybody together.
+std::vector<PlacementSummary> placeUser(
+    const UserCalendar& calendar, const std::vector<PlanAssignment>& own) {
+  AutoScheduler scheduler;
+  scheduler.addUser({});
+  scheduler.user(0) = calendar;
+  std::vector<AutoScheduler::Assignment> batch;
+  batch.reserve(own.size());
+  for (const auto& a : own) {
+    AutoScheduler::Assignment b;
+    b.startDay = a.startDay;
+    b.dueDay = a.dueDay;
+    b.minutes = a.minutes;
+    b.priority = a.priority;
+    batch.push_back(std::move(b));
+  }
+  const auto placed = scheduler.place(batch);
+  std::vector<PlacementSummary> out(own.size());
+  for (size_t k = 0; k < own.size(); ++k) out[k].unplaced = placed.unplaced[k];
+  for (const auto& block : placed.blocks) {
+    auto& summary = out[block.assignment];
+    if (summary.start < 0 || block.slot.start < summary.start)
+      summary.start = block.slot.start;
+    summary.finish = std::max(summary.finish, block.slot.end);
+  }
+  return out;
+}
+
+}  // namespace
+
+PlanBaseline::PlanBaseline(
+    CriticalPath path, std::vector<PlanAssignment> assignments,
+    std::vector<std::shared_ptr<const UserCalendar>> calendars)
+    : path_(std::move(path)),
+      assignments_(std::move(assignments)),
+      calendars_(std::move(calendars)),
+      byUser_(calendars_.size()),
+      placement_(assignments_.size()) {
+  for (uint32_t i = 0; i < assignments_.size(); ++i)
+    if (assignments_[i].user < calendars_.size())
+      byUser_[assignments_[i].user].push_back(i);
+  std::vector<PlanAssignment> own;
+  for (uint32_t u = 0; u < calendars_.size(); ++u) {
+    own.clear();
+    for (const uint32_t i : byUser_[u]) own.push_back(assignments_[i]);
+    const auto placed = placeUser(*calendars_[u], own);
+    for (size_t k = 0; k < own.size(); ++k)
+      placement_[byUser_[u][k]] = placed[k];
+  }
+}
+
+Scenario::Scenario(std::shared_ptr<const PlanBaseline> base)
+    : base_(std::move(base)) {}
+
+void Scenario::setDuration(uint32_t task, Minute minutes) {
+  if (task < base_->path().graph().nodeCount())
+    duration_[task] = std::max<Minute>(minutes, 0);
+}
+
+void Scenario::delay(uint32_t task, Minute minutes) {
+  if (task < base_->path().graph().nodeCount()) delay_[task] += minutes;
+}
+
+void Scenario::addAbsence(uint32_t user, int64_t firstDay, int64_t lastDay) {
+  if (user >= base_->userCount() || lastDay < firstDay) return;
+  auto& calendar = calendars_[user];
+  if (!calendar)
+    calendar = std::make_shared<UserCalendar>(*base_->calendar(user));
+  calendar->addBusy(
+      {firstDay * kMinutesPerDay, (lastDay + 1) * kMinutesPerDay});
+}
+
+ScenarioDiff Scenario::run() const {
+  const auto& path = base_->path();
+  const auto& graph = path.graph();
+  const auto& rank = path.rank();
+  ScenarioDiff diff;
+  diff.makespanBefore = path.makespan();
+
+  // Values that differ from the baseline. Lookups fall through to it.
+  std::unordered_map<uint32_t, int64_t> es, tail;
+  auto duration = [&](uint32_t v) {
+    const auto it = duration_.find(v);
+    return it != duration_.end() ? it->second : graph.duration(v);
+  };
+  auto esOf = [&](uint32_t v) {
+    const auto it = es.find(v);
+    return it != es.end() ? it->second : path.earliestStart(v);
+  };
+  auto tailOf = [&](uint32_t v) {
+    const auto it = tail.find(v);
+    return it != tail.end() ? it->second
+                            : path.makespan() - path.latestStart(v);
+  };
+  auto release = [&](uint32_t v) -> int64_t {
+    const auto it = delay_.find(v);
+    return it != delay_.end() ? path.earliestStart(v) + it->second : 0;
+  };
+
+  // Forward pass in topological order from every edited task. A task is
+  // queued once per distinct key, and equal keys pop back to back.
+  std::priority_queue<uint64_t, std::vector<uint64_t>, std::greater<>> ahead;
+  for (const auto& [v, minutes] : duration_) {
+    ahead.push(heapKey(rank[v], v));
+    for (uint32_t e = graph.outBegin(v); e < graph.outEnd(v); ++e)
+      ahead.push(heapKey(rank[graph.outTarget(e)], graph.outTarget(e)));
+  }
+  for (const auto& [v, minutes] : delay_) ahead.push(heapKey(rank[v], v));
+  for (uint64_t last = UINT64_MAX; !ahead.empty();) {
+    const uint64_t key = ahead.top();
+    ahead.pop();
+    if (key == last) continue;
+    last = key;
+    const auto v = static_cast<uint32_t>(key);
+    int64_t start = release(v);
+    for (uint32_t e = graph.inBegin(v); e < graph.inEnd(v); ++e) {
+      const uint32_t p = graph.inSource(e);
+      start = std::max(start, esOf(p) + dependencyLag(graph.inKind(e),
+                                                      duration(p),
+                                                      duration(v)));
+    }
+    if (start == esOf(v)) continue;
+    es[v] = start;
+    for (uint32_t e = graph.outBegin(v); e < graph.outEnd(v); ++e)
+      ahead.push(heapKey(rank[graph.outTarget(e)], graph.outTarget(e)));
+  }
+
+  // Backward pass for the tails; only durations change them.
+  std::priority_queue<uint64_t> behind;
+  for (const auto& [v, minutes] : duration_) {
+    behind.push(heapKey(rank[v], v));
+    for (uint32_t e = graph.inBegin(v); e < graph.inEnd(v); ++e)
+      behind.push(heapKey(rank[graph.inSource(e)], graph.inSource(e)));
+  }
+  for (uint64_t last = UINT64_MAX; !behind.empty();) {
+    const uint64_t key = behind.top();
+    behind.pop();
+    if (key == last) continue;
+    last = key;
+    const auto v = static_cast<uint32_t>(key);
+    int64_t t = duration(v);
+    for (uint32_t e = graph.outBegin(v); e < graph.outEnd(v); ++e) {
+      const uint32_t s = graph.outTarget(e);
+      t = std::max(t, tailOf(s) + dependencyLag(graph.outKind(e), duration(v),
+                                                duration(s)));
+    }
+    if (t == tailOf(v)) continue;
+    tail[v] = t;
+    for (uint32_t e = graph.inBegin(v); e < graph.inEnd(v); ++e)
+      behind.push(heapKey(rank[graph.inSource(e)], graph.inSource(e)));
+  }
+
+  const auto n = static_cast<uint32_t>(graph.nodeCount());
+  for (uint32_t v = 0; v < n; ++v)
+    diff.makespanAfter = std::max(diff.makespanAfter, esOf(v) + tailOf(v));
+  for (uint32_t v = 0; v < n; ++v) {
+    if (esOf(v) != 0 || tailOf(v) != diff.makespanAfter) continue;
+    for (;;) {
+      diff.criticalPath.push_back(v);
+      if (tailOf(v) == duration(v)) break;
+      bool next = false;
+      for (uint32_t e = graph.outBegin(v); e < graph.outEnd(v); ++e) {
+        const uint32_t s = graph.outTarget(e);
+        if (tailOf(s) + dependencyLag(graph.outKind(e), duration(v),
+                                      duration(s)) == tailOf(v)) {
+          v = s;
+          next = true;
+          break;
+        }
+      }
+      if (!next) break;
+    }
+    break;
+  }
+
+  std::vector<uint32_t> touched;
+  for (const auto& [v, start] : es) touched.push_back(v);
+  for (const auto& [v, minutes] : duration_)
+    if (!es.count(v)) touched.push_back(v);
+  std::sort(touched.begin(), touched.end());
+  for (const uint32_t v : touched) {
+    const TaskShift shift{v, path.earliestStart(v), esOf(v),
+                          path.earliestFinish(v), esOf(v) + duration(v)};
+    if (shift.startBefore != shift.startAfter ||
+        shift.finishBefore != shift.finishAfter)
+      diff.tasks.push_back(shift);
+  }
+
+  // Only users with an absence or with an assignment on a task that moved
+  // or changed length are placed again.
+  auto edit = [&](PlanAssignment a) {
+    const int64_t later = esOf(a.task) - path.earliestStart(a.task);
+    if (later > 0) {
+      const int64_t days = (later + kMinutesPerDay - 1) / kMinutesPerDay;
+      a.startDay += days;
+      a.dueDay += days;
+    }
+    const auto d = duration_.find(a.task);
+    if (d != duration_.end() && graph.duration(a.task) > 0)
+      a.minutes = static_cast<Minute>(
+          static_cast<double>(a.minutes) * static_cast<double>(d->second) /
+              static_cast<double>(graph.duration(a.task)) +
+          0.5);
+    return a;
+  };
+  std::vector<uint32_t> users;
+  for (const auto& [user, calendar] : calendars_) users.push_back(user);
+  for (const auto& a : base_->assignments()) {
+    const auto e = edit(a);
+    if (e.startDay != a.startDay || e.minutes != a.minutes)
+      users.push_back(a.user);
+  }
+  std::sort(users.begin(), users.end());
+  users.erase(std::unique(users.begin(), users.end()), users.end());
+
+  std::vector<PlanAssignment> own;
+  for (const uint32_t u : users) {
+    const auto& indices = base_->assignmentsOf(u);
+    own.clear();
+    for (const uint32_t i : indices)
+      own.push_back(edit(base_->assignments()[i]));
+    const auto custom = calendars_.find(u);
+    const auto placed = placeUser(
+        custom != calendars_.end() ? *custom->second : *base_->calendar(u),
+        own);
+    for (size_t k = 0; k < indices.size(); ++k)
+      if (!(placed[k] == base_->placement()[indices[k]]))
+        diff.assignments.push_back(
+            {indices[k], base_->placement()[indices[k]], placed[k]});
+  }
+  std::sort(diff.assignments.begin(), diff.assignments.end(),
+            [](const auto& a, const auto& b) {
+              return a.assignment < b.assignment;
+            });
+  return diff;
+}
+
+}  // namespace engine
@@ -1,8 +1,37 @@
 #include <drogon/drogon.h>
 #include <drogon/orm/DbClient.h>
 #include <trantor/utils/Logger.h>
+#include <algorithm>
 #include <cstdlib>
+#include <exception>
 #include <string>
+#include <thread>
+
+#include "db/Pools.hpp"
+#include "services/ConflictService.hpp"
+#include "services/ForecastService.hpp"
+#include "services/PasswordHasher.hpp"
+#include "services/PermissionService.hpp"
+#include "services/RollupService.hpp"
+
+static size_t envSize(const char* name, size_t fallback) {
+  const char* value = std::getenv(name);
+  if (!value || !*value) return fallback;
+  try {
+    const long parsed = std::stol(value);
+    return parsed > 0 ? static_cast<size_t>(parsed) : fallback;
+  } catch (const std::exception&) {
+    LOG_WARN << "Ignoring invalid " << name << "=" << value;
+    return fallback;
+  }
+}
+
+static bool envFlag(const char* name) {
+  const char* value = std::getenv(name);
+  if (!value) return false;
+  const std::string v = value;
+  return v == "1" || v == "true" || v == "yes";
+}
 
 int main() {
   // Load configuration
@@ -16,38 +45,69 @@ int main() {
   const char* dbPassword = std::getenv("DB_PASSWORD");
 
   // Set defaults if environment variables are not set
-  std::string host = dbHost ? dbHost : "localhost";
-  int port = dbPort ? std::stoi(dbPort) : 5432;
-  std::string database = dbName ? dbName : "project_calendar";
-  std::string user = dbUser ? dbUser : "pc_admin";
-  std::string password = dbPassword ? dbPassword : "pc_password";
-
-  LOG_INFO << "Connecting to database: " << host << ":" << port << "/" << database;
-
-  // Configure database with createDbClient (13 params)
-  drogon::app().createDbClient(
-    "postgresql",  // dbType
-    host,          // host
-    static_cast<unsigned short>(port),  // port
-    database,      // databaseName
-    user,          // userName
-    password,      // password
-    1,             // connectionNum
-    "",            // filename (empty for postgres)
-    "default",     // name
-    false,         // isFast
-    "",            // characterSet
-    0.0,           // timeout
-    true           // autoBatch
-  );
+  db::ConnectionInfo conn;
+  conn.host = dbHost ? dbHost : "localhost";
+  conn.port = static_cast<unsigned short>(dbPort ? std::stoi(dbPort) : 5432);
+  conn.database = dbName ? dbName : "project_calendar";
+  conn.user = dbUser ? dbUser : "pc_admin";
+  conn.password = dbPassword ? dbPassword : "pc_password";
+
+  // One IO thread per core unless overridden
+  const unsigned cores = std::thread::hardware_concurrency();
+  const size_t httpThreads = envSize("HTTP_THREADS", cores ? cores : 4);
+
+  // Thread count must be known before fast (per-loop) clients are created
+  drogon::app().setThreadNum(httpThreads);
+
+  LOG_INFO << "Connecting to database: " << conn.host << ":" << conn.port
+           << "/" << conn.database;
+
+  // Short task/user statements and long calendar reads get separate pools
+  db::PoolSettings oltpSettings;
+  oltpSettings.connections = envSize("DB_POOL_SIZE", 8);
+  oltpSettings.fast = envFlag("DB_FAST_CLIENTS");
+  db::oltp().configure(conn, oltpSettings);
+
+  db::PoolSettings reportSettings;
+  reportSettings.connections = envSize("DB_REPORTS_POOL_SIZE", 4);
+  db::reports().configure(conn, reportSettings);
+
+  // bcrypt runs off the IO threads with its own bounded queue
+  services::PasswordHasherSettings hasherSettings;
+  hasherSettings.workers =
+      envSize("BCRYPT_WORKERS", std::max<size_t>(2, (cores ? cores : 4) / 2));
+  hasherSettings.queueLimit = envSize("BCRYPT_QUEUE_SIZE", 256);
+  hasherSettings.cost = static_cast<unsigned>(envSize("BCRYPT_COST", 10));
+  services::passwords().start(hasherSettings);
+
+  // Forecast trials share a few single-threaded workers behind a short queue
+  services::ForecastSettings forecastSettings;
+  forecastSettings.workers =
+      envSize("FORECAST_WORKERS", std::max<size_t>(1, (cores ? cores : 4) / 4));
+  forecastSettings.queueLimit = envSize("FORECAST_QUEUE_SIZE", 16);
+  services::forecasts().start(forecastSettings);
+
+  // Permission checks run against an in-memory snapshot of the role tables
+  services::permissions().start(
+      static_cast<double>(envSize("PERMISSIONS_RELOAD_SECONDS", 60)));
+
+  // Schedule conflicts are looked for in the background, per changed user
+  services::conflicts().start(
+      static_cast<double>(envSize("CONFLICT_SCAN_SECONDS", 30)),
+      envSize("CONFLICT_SCAN_BATCH", 64));
+
+  // Pending subtree deltas are folded into task_rollup in batches
+  services::rollups().start(
+      static_cast<double>(envSize("ROLLUP_FOLD_SECONDS", 5)),
+      envSize("ROLLUP_FOLD_BATCH", 10000));
 
   // Configure HTTP server
   drogon::app()
-      .setThreadNum(4)
       .addListener("0.0.0.0", 8080)
       .setLogLevel(trantor::Logger::kInfo);
 
-  LOG_INFO << "Server starting on http://0.0.0.0:8080";
+  LOG_INFO << "Server starting on http://0.0.0.0:8080 with " << httpThreads
+           << " IO threads";
   
   // Run the application
   drogon::app().run();
@@ -0,0 +1,138 @@
+#include "metrics/Metrics.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+
+namespace metrics {
+
+namespace {
+
+std::string formatDouble(double v) {
+  char buf[64];
+  std::snprintf(buf, sizeof(buf), "%.9g", v);
+  return buf;
+}
+
+std::string withLabels(const std::string& labels, const std::string& extra) {
+  if (labels.empty() && extra.empty()) return {};
+  if (labels.empty()) return "{" + extra + "}";
+  if (extra.empty()) return "{" + labels + "}";
+  return "{" + labels + "," + extra + "}";
+}
+
+}  // namespace
+
+const std::array<double, Histogram::kBuckets>& Histogram::bounds() {
+  static const std::array<double, kBuckets> b = [] {
+    std::array<double, kBuckets> out{};
+    double v = 0.00005;
+    for (auto& x : out) {
+      x = v;
+      v *= 2;
+    }
+    return out;
+  }();
+  return b;
+}
+
+void Histogram::observe(std::chrono::nanoseconds d) {
+  const uint64_t ns = d.count() > 0 ? static_cast<uint64_t>(d.count()) : 0;
+  const double seconds = static_cast<double>(ns) / 1e9;
+  const auto& b = bounds();
+  auto it = std::lower_bound(b.begin(), b.end(), seconds);
+  if (it != b.end())
+    buckets_[static_cast<size_t>(it - b.begin())].fetch_add(
+        1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sumNs_.fetch_add(ns, std::memory_order_relaxed);
+}
+
+void Histogram::observeSeconds(double seconds) {
+  observe(std::chrono::nanoseconds(static_cast<int64_t>(seconds * 1e9)));
+}
+
+double Histogram::sumSeconds() const {
+  return static_cast<double>(sumNs_.load(std::memory_order_relaxed)) / 1e9;
+}
+
+Registry::Family& Registry::family(const std::string& name,
+                                   const std::string& help, const char* type) {
+  auto& f = families_[name];
+  if (f.type.empty()) {
+    f.help = help;
+    f.type = type;
+  }
+  return f;
+}
+
+Counter& Registry::counter(const std::string& name, const std::string& help,
+                           const std::string& labels) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto& slot = family(name, help, "counter").counters[labels];
+  if (!slot) slot = std::make_unique<Counter>();
+  return *slot;
+}
+
+Gauge& Registry::gauge(const std::string& name, const std::string& help,
+                       const std::string& labels) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto& slot = family(name, help, "gauge").gauges[labels];
+  if (!slot) slot = std::make_unique<Gauge>();
+  return *slot;
+}
+
+Histogram& Registry::histogram(const std::string& name,
+                               const std::string& help,
+                               const std::string& labels) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto& slot = family(name, help, "histogram").histograms[labels];
+  if (!slot) slot = std::make_unique<Histogram>();
+  return *slot;
+}
+
+void Registry::gaugeFn(const std::string& name, const std::string& help,
+                       const std::string& labels, std::function<double()> fn) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  family(name, help, "gauge").callbacks[labels] = std::move(fn);
+}
+
+std::string Registry::render() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::ostringstream out;
+  for (const auto& [name, f] : families_) {
+    out << "# HELP " << name << ' ' << f.help << '\n';
+    out << "# TYPE " << name << ' ' << f.type << '\n';
+    for (const auto& [labels, c] : f.counters)
+      out << name << withLabels(labels, {}) << ' ' << c->value() << '\n';
+    for (const auto& [labels, g] : f.gauges)
+      out << name << withLabels(labels, {}) << ' ' << g->value() << '\n';
+    for (const auto& [labels, fn] : f.callbacks)
+      out << name << withLabels(labels, {}) << ' ' << formatDouble(fn())
+          << '\n';
+    for (const auto& [labels, h] : f.histograms) {
+      uint64_t cumulative = 0;
+      const auto& b = Histogram::bounds();
+      for (size_t i = 0; i < Histogram::kBuckets; ++i) {
+        cumulative += h->bucket(i);
+        out << name << "_bucket"
+            << withLabels(labels, "le=\"" + formatDouble(b[i]) + "\"") << ' '
+            << cumulative << '\n';
+      }
+      out << name << "_bucket" << withLabels(labels, "le=\"+Inf\"") << ' '
+          << h->count() << '\n';
+      out << name << "_sum" << withLabels(labels, {}) << ' '
+          << formatDouble(h->sumSeconds()) << '\n';
+      out << name << "_count" << withLabels(labels, {}) << ' ' << h->count()
+          << '\n';
+    }
+  }
+  return out.str();
+}
+
+Registry& registry() {
+  static Registry r;
+  return r;
+}
+
+}  // namespace metrics
@@ -0,0 +1,94 @@
+#include "serialization/JsonWriter.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace serialization {
+
+namespace {
+
+inline bool needsEscape(unsigned char c) {
+  return c < 0x20 || c == '"' || c == '\\';
+}
+
+// Index of the first byte that needs escaping, or n if there is none.
+size_t findEscape(const char* p, size_t n) {
+  size_t i = 0;
+#if defined(__SSE2__)
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i control = _mm_set1_epi8(0x1f);
+  for (; i + 16 <= n; i += 16) {
+    const __m128i v =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+    // Unsigned v <= 0x1f exactly when min(v, 0x1f) == v.
+    const __m128i hits = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+        _mm_cmpeq_epi8(_mm_min_epu8(v, control), v));
+    const int mask = _mm_movemask_epi8(hits);
+    if (mask) return i + static_cast<size_t>(__builtin_ctz(mask));
+  }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  const uint8x16_t quote = vdupq_n_u8('"');
+  const uint8x16_t backslash = vdupq_n_u8('\\');
+  const uint8x16_t control = vdupq_n_u8(0x1f);
+  for (; i + 16 <= n; i += 16) {
+    const uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t*>(p + i));
+    const uint8x16_t hits =
+        vorrq_u8(vorrq_u8(vceqq_u8(v, quote), vceqq_u8(v, backslash)),
+                 vcleq_u8(v, control));
+    if (vmaxvq_u8(hits)) break;
+  }
+#endif
+  for (; i < n; ++i)
+    if (needsEscape(static_cast<unsigned char>(p[i]))) return i;
+  return n;
+}
+
+}  // namespace
+
+void appendEscaped(std::string& out, std::string_view s) {
+  static const char kHex[] = "0123456789abcdef";
+  const char* p = s.data();
+  size_t n = s.size();
+  while (n) {
+    const size_t run = findEscape(p, n);
+    out.append(p, run);
+    if (run == n) return;
+    const unsigned char c = static_cast<unsigned char>(p[run]);
+    switch (c) {
+      case '"':
+        out += "\\\"";
+        break;
+      case '\\':
+        out += "\\\\";
+        break;
+      case '\b':
+        out += "\\b";
+        break;
+      case '\f':
+        out += "\\f";
+        break;
+      case '\n':
+        out += "\\n";
+        break;
+      case '\r':
+        out += "\\r";
+        break;
+      case '\t':
+        out += "\\t";
+        break;
+      default:
+        out += "\\u00";
+        out += kHex[c >> 4];
+        out += kHex[c & 0xf];
+    }
+    p += run + 1;
+    n -= run + 1;
+  }
+}
+
+}  // namespace serialization
@@ -0,0 +1,210 @@
+#include "services/AvailabilityService.hpp"
+
+#include <trantor/utils/Logger.h>
+
+#include <algorithm>
+#include <chrono>
+#include <unordered_map>
+#include <utility>
+
+#include "db/Literals.hpp"
+#include "db/Pools.hpp"
+
+namespace services {
+
+namespace {
+
+// Users whose slot index is kept in memory.
+constexpr size_t kMaxUsers = 1024;
+
+constexpr const char* kWindowsSql = R"sql(
+      SELECT user_id::text AS user_id, weekday,
+             (EXTRACT(EPOCH FROM start_time) / 60)::int AS start_minute,
+             (EXTRACT(EPOCH FROM end_time) / 60)::int AS end_minute
+      FROM user_work_schedule
+      WHERE user_id = ANY($1::uuid[]) AND weekday IS NOT NULL
+    )sql";
+
+engine::Minute nowMinute() {
+  return std::chrono::duration_cast<std::chrono::minutes>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+}  // namespace
+
+AvailabilityService::AvailabilityService()
+    : searchLatency_(metrics::registry().histogram(
+          "pc_availability_search_seconds",
+          "Time to build, intersect and scan the free/busy masks of one "
+          "availability search, excluding the database reads")),
+      loadLatency_(metrics::registry().histogram(
+          "pc_availability_index_load_seconds",
+          "Time to load one user's blocks and build their free-slot index")),
+      hits_(metrics::registry().counter(
+          "pc_availability_index_cache_hits_total",
+          "Next-free-slot queries served from a cached index")),
+      misses_(metrics::registry().counter(
+          "pc_availability_index_cache_misses_total",
+          "Next-free-slot queries that loaded the index from the database")) {}
+
+drogon::Task<CommonAvailability> AvailabilityService::commonFreeTime(
+    std::vector<std::string> userIds, int64_t firstDay, int64_t lastDay,
+    engine::Minute minutes, size_t limit) {
+  CommonAvailability result;
+  if (userIds.empty() || lastDay < firstDay) co_return result;
+
+  std::unordered_map<std::string, size_t> userIndex;
+  db::ArrayLiteral users;
+  for (auto& id : userIds) {
+    if (userIndex.try_emplace(id, userIndex.size()).second) users.add(id);
+  }
+  const std::string userArray = users.release();
+
+  auto& pool = db::reports();
+  auto windowRows = co_await pool.exec(kWindowsSql, userArray);
+  auto busyRows = co_await pool.exec(
+      R"sql(
+      SELECT user_id::text AS user_id,
+             floor(EXTRACT(EPOCH FROM start_ts) / 60)::bigint AS start_minute,
+             ceil(EXTRACT(EPOCH FROM end_ts) / 60)::bigint AS end_minute
+      FROM task_schedule
+      WHERE user_id = ANY($1::uuid[])
+        AND end_ts > to_timestamp($2::bigint * 86400)
+        AND start_ts < to_timestamp(($3::bigint + 1) * 86400)
+    )sql",
+      userArray, std::to_string(firstDay), std::to_string(lastDay));
+
+  metrics::ScopedTimer timer(searchLatency_);
+  std::vector<std::vector<engine::WorkWindow>> windows(userIndex.size());
+  for (const auto& row : windowRows) {
+    const auto u = userIndex.find(row["user_id"].as<std::string>());
+    if (u == userIndex.end()) continue;
+    windows[u->second].push_back({row["weekday"].as<int>(),
+                                  row["start_minute"].as<int>(),
+                                  row["end_minute"].as<int>()});
+  }
+  std::vector<engine::FreeBusyMask> masks(
+      userIndex.size(), engine::FreeBusyMask(firstDay, lastDay - firstDay + 1));
+  for (size_t u = 0; u < masks.size(); ++u) masks[u].addWindows(windows[u]);
+  for (const auto& row : busyRows) {
+    const auto u = userIndex.find(row["user_id"].as<std::string>());
+    if (u == userIndex.end()) continue;
+    masks[u->second].addBusy({row["start_minute"].as<int64_t>(),
+                              row["end_minute"].as<int64_t>()});
+  }
+
+  auto& common = masks[0];
+  for (size_t u = 1; u < masks.size(); ++u) common.intersect(masks[u]);
+  common.addBusy({firstDay * engine::kMinutesPerDay, nowMinute()});
+
+  const auto length = static_cast<size_t>(
+      (minutes + engine::kSlotMinutes - 1) / engine::kSlotMinutes);
+  result.slots = common.findRuns(length, limit);
+  result.freeMinutes =
+      static_cast<engine::Minute>(common.freeSlots()) * engine::kSlotMinutes;
+  co_return result;
+}
+
+drogon::Task<std::optional<engine::Interval>>
+AvailabilityService::nextFreeSlot(std::string userId, engine::Minute after,
+                                  engine::Minute minutes) {
+  std::shared_ptr<UserSlots> slots;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = users_.find(userId);
+    if (it != users_.end()) {
+      it->second->lastUsed = ++clock_;
+      slots = it->second;
+    }
+  }
+  if (slots) {
+    hits_.inc();
+  } else {
+    misses_.inc();
+    slots = co_await load(std::move(userId));
+  }
+  std::lock_guard<std::mutex> lock(slots->mutex);
+  co_return slots->index.next(std::max(after, nowMinute()), minutes);
+}
+
+drogon::Task<std::shared_ptr<UserSlots>> AvailabilityService::load(
+    std::string userId) {
+  metrics::ScopedTimer timer(loadLatency_);
+  uint64_t generation;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    generation = generation_;
+  }
+
+  // Blocks that end before today cannot affect a query, which never looks
+  // at the past.
+  const int64_t today = nowMinute() / engine::kMinutesPerDay;
+  auto& pool = db::reports();
+  db::ArrayLiteral users;
+  users.add(userId);
+  auto windowRows = co_await pool.exec(kWindowsSql, users.release());
+  auto blockRows = co_await pool.exec(
+      R"sql(
+      SELECT floor(EXTRACT(EPOCH FROM start_ts) / 60)::bigint AS start_minute,
+             ceil(EXTRACT(EPOCH FROM end_ts) / 60)::bigint AS end_minute
+      FROM task_schedule
+      WHERE user_id = $1::uuid AND end_ts > to_timestamp($2::bigint * 86400)
+    )sql",
+      userId, std::to_string(today));
+
+  std::vector<engine::WorkWindow> windows;
+  windows.reserve(windowRows.size());
+  for (const auto& row : windowRows)
+    windows.push_back({row["weekday"].as<int>(), row["start_minute"].as<int>(),
+                       row["end_minute"].as<int>()});
+  std::vector<engine::Interval> blocks;
+  blocks.reserve(blockRows.size());
+  for (const auto& row : blockRows)
+    blocks.push_back({row["start_minute"].as<int64_t>(),
+                      row["end_minute"].as<int64_t>()});
+  auto slots = std::make_shared<UserSlots>(windows, today);
+  slots->index.assign(std::move(blocks));
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  slots->lastUsed = ++clock_;
+  if (generation != generation_) co_return slots;
+  if (users_.size() >= kMaxUsers) {
+    auto oldest = users_.begin();
+    for (auto it = users_.begin(); it != users_.end(); ++it)
+      if (it->second->lastUsed < oldest->second->lastUsed) oldest = it;
+    users_.erase(oldest);
+  }
+  users_[userId] = slots;
+  LOG_DEBUG << "Free-slot index of " << userId << " loaded: "
+            << slots->index.blockCount() << " blocks";
+  co_return slots;
+}
+
+void AvailabilityService::blocksChanged(
+    const std::string& userId, const std::vector<engine::Interval>& removed,
+    const std::vector<engine::Interval>& added) {
+  std::shared_ptr<UserSlots> slots;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++generation_;
+    auto it = users_.find(userId);
+    if (it == users_.end()) return;
+    slots = it->second;
+  }
+  std::lock_guard<std::mutex> lock(slots->mutex);
+  slots->index.update(removed, added);
+}
+
+void AvailabilityService::workScheduleChanged(const std::string& userId) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ++generation_;
+  users_.erase(userId);
+}
+
+AvailabilityService& availability() {
+  static AvailabilityService service;
+  return service;
+}
+
+}  // namespace services
@@ -0,0 +1,379 @@
+#include "services/ConflictService.hpp"
+
+#include <drogon/drogon.h>
+#include <trantor/utils/Logger.h>
+
+#include <exception>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "db/Literals.hpp"
+#include "db/Pools.hpp"
+#include "db/Transaction.hpp"
+#include "engine/ConflictScan.hpp"
+#include "serialization/JsonWriter.hpp"
+#include "services/RebalanceService.hpp"
+
+namespace services {
+
+namespace {
+
+// Root task (project) of every task the user has blocks or assignments on.
+constexpr const char* kProjectsSql = R"sql(
+      WITH RECURSIVE chain AS (
+        SELECT t.id AS task_id, t.id, t.parent_task_id, 0 AS depth
+        FROM task t
+        WHERE t.id IN (SELECT task_id FROM task_schedule
+                       WHERE user_id = $1::uuid
+                       UNION
+                       SELECT task_id FROM task_assignment
+                       WHERE user_id = $1::uuid)
+        UNION ALL
+        SELECT c.task_id, p.id, p.parent_task_id, c.depth + 1
+        FROM chain c JOIN task p ON p.id = c.parent_task_id
+        WHERE c.depth < 256
+      )
+      SELECT task_id::text AS task_id, id::text AS project_id
+      FROM chain
+      WHERE parent_task_id IS NULL
+    )sql";
+
+constexpr const char* kBlocksSql = R"sql(
+      SELECT task_id::text AS task_id,
+             floor(EXTRACT(EPOCH FROM start_ts) / 60)::bigint AS start_minute,
+             ceil(EXTRACT(EPOCH FROM end_ts) / 60)::bigint AS end_minute
+      FROM task_schedule
+      WHERE user_id = $1::uuid
+        AND end_ts > to_timestamp((CURRENT_DATE - DATE '1970-01-01') * 86400)
+    )sql";
+
+constexpr const char* kWindowsSql = R"sql(
+      SELECT weekday,
+             (EXTRACT(EPOCH FROM start_time) / 60)::int AS start_minute,
+             (EXTRACT(EPOCH FROM end_time) / 60)::int AS end_minute
+      FROM user_work_schedule
+      WHERE user_id = $1::uuid AND weekday IS NOT NULL
+    )sql";
+
+constexpr const char* kLimitsSql = R"sql(
+      SELECT project_id::text AS project_id,
+             COALESCE(weekday, -1) AS weekday,
+             round(hours_per_day * 60)::bigint AS minutes
+      FROM project_allocation
+      WHERE user_id = $1::uuid AND hours_per_day IS NOT NULL
+    )sql";
+
+// Open assignments with hours and no block at all.
+constexpr const char* kUnscheduledSql = R"sql(
+      SELECT a.task_id::text AS task_id,
+             a.assigned_hours::float8 AS hours
+      FROM task_assignment a
+      JOIN task t ON t.id = a.task_id
+      WHERE a.user_id = $1::uuid
+        AND a.assigned_hours > 0
+        AND t.status NOT IN ('completed', 'cancelled')
+        AND NOT EXISTS (SELECT 1 FROM task_schedule ts
+                        WHERE ts.task_id = a.task_id
+                          AND ts.user_id = a.user_id)
+    )sql";
+
+// Open scanner suggestions of the user that were not found again.
+constexpr const char* kResolveSql = R"sql(
+      UPDATE conflict_resolution
+      SET status = 'resolved', decided_at = now()
+      WHERE target_user_id = $1::uuid
+        AND status = 'suggested'
+        AND payload->>'source' = 'scanner'
+        AND payload->>'key' NOT IN (
+          SELECT f->>'key' FROM jsonb_array_elements($2::jsonb) f)
+    )sql";
+
+// Findings nobody has seen yet. Accepted and declined ones stay decided.
+constexpr const char* kInsertSql = R"sql(
+      INSERT INTO conflict_resolution
+        (project_id, task_id, target_user_id, kind, payload, status,
+         suggested_at)
+      SELECT (f->>'project_id')::uuid, (f->>'task_id')::uuid, $1::uuid,
+             (f->>'kind')::resolution_kind_enum, f->'payload', 'suggested',
+             now()
+      FROM jsonb_array_elements($2::jsonb) f
+      WHERE NOT EXISTS (
+        SELECT 1 FROM conflict_resolution c
+        WHERE c.payload->>'key' = f->'payload'->>'key'
+          AND c.status IN ('suggested', 'accepted', 'declined'))
+      ON CONFLICT DO NOTHING
+    )sql";
+
+// Writes one element of the findings array. `payload` receives the
+// kind-specific members after source, key and type.
+template <typename Payload>
+void writeFinding(serialization::JsonWriter& out, std::string_view kind,
+                  std::string_view type, const std::string& key,
+                  const std::string& projectId, const std::string& taskId,
+                  Payload&& payload) {
+  out.beginObject();
+  out.key("kind");
+  out.string(kind);
+  out.key("project_id");
+  out.string(projectId);
+  out.key("task_id");
+  out.string(taskId);
+  out.key("payload");
+  out.beginObject();
+  out.key("source");
+  out.string("scanner");
+  out.key("key");
+  out.string(key);
+  out.key("type");
+  out.string(type);
+  payload();
+  out.endObject();
+  out.endObject();
+}
+
+}  // namespace
+
+ConflictService::ConflictService()
+    : scanLatency_(metrics::registry().histogram(
+          "pc_conflict_scan_seconds",
+          "Time to scan one user's schedule and update their suggestions")),
+      suggestions_(metrics::registry().counter(
+          "pc_conflict_suggestions_total",
+          "Conflict suggestions written by the background scanner")),
+      resolved_(metrics::registry().counter(
+          "pc_conflict_resolved_total",
+          "Open conflict suggestions closed because the conflict went away")),
+      failures_(metrics::registry().counter(
+          "pc_conflict_scan_failures_total",
+          "User scans that failed and were queued again")),
+      queued_(metrics::registry().gauge(
+          "pc_conflict_dirty_users",
+          "Users waiting for a conflict scan")) {}
+
+void ConflictService::start(double intervalSeconds, size_t batch) {
+  batch_ = batch;
+  drogon::app().registerBeginningAdvice([this, intervalSeconds] {
+    drogon::async_run([this]() -> drogon::Task<> {
+      try {
+        auto rows = co_await db::reports().exec(R"sql(
+            SELECT DISTINCT user_id::text AS user_id FROM task_schedule
+            WHERE end_ts > to_timestamp(
+              (CURRENT_DATE - DATE '1970-01-01') * 86400)
+            UNION
+            SELECT user_id::text FROM task_assignment
+            WHERE assigned_hours > 0
+          )sql");
+        for (const auto& row : rows)
+          markDirty(row["user_id"].as<std::string>());
+      } catch (const std::exception& e) {
+        LOG_WARN << "Queueing users for the first conflict scan failed: "
+                 << e.what();
+      }
+    });
+    drogon::app().getLoop()->runEvery(intervalSeconds, [this] {
+      drogon::async_run([this]() -> drogon::Task<> { co_await drain(); });
+    });
+  });
+}
+
+void ConflictService::markDirty(const std::string& userId) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (dirty_.insert(userId).second)
+    queued_.set(static_cast<int64_t>(dirty_.size()));
+}
+
+drogon::Task<> ConflictService::drain() {
+  std::vector<std::string> users;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (draining_ || dirty_.empty()) co_return;
+    draining_ = true;
+    while (!dirty_.empty() && users.size() < batch_)
+      users.push_back(std::move(dirty_.extract(dirty_.begin()).value()));
+    queued_.set(static_cast<int64_t>(dirty_.size()));
+  }
+  for (const auto& userId : users) {
+    try {
+      co_await scanUser(userId);
+    } catch (const std::exception& e) {
+      LOG_WARN << "Conflict scan of user " << userId << " failed: "
+               << e.what();
+      failures_.inc();
+      markDirty(userId);
+    }
+  }
+  // Moves are proposed once per round for every project that is still
+  // overallocated somewhere, after its users' suggestions are current.
+  std::set<std::string> projects;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    projects.swap(overallocated_);
+  }
+  for (const auto& projectId : projects) {
+    try {
+      co_await rebalancing().rebalanceProject(projectId);
+    } catch (const std::exception& e) {
+      LOG_WARN << "Rebalancing project " << projectId << " failed: "
+               << e.what();
+    }
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  draining_ = false;
+}
+
+drogon::Task<size_t> ConflictService::scanUser(std::string userId) {
+  metrics::ScopedTimer timer(scanLatency_);
+  auto tx = co_await db::Tx::begin(db::oltp());
+  // Scans of one user never overlap, so they cannot resolve each other's
+  // fresh suggestions.
+  co_await tx.client()->execSqlCoro(
+      "SELECT pg_advisory_xact_lock(hashtext('conflict_resolution:' || $1))",
+      userId);
+  auto projectRows = co_await tx.client()->execSqlCoro(kProjectsSql, userId);
+  auto blockRows = co_await tx.client()->execSqlCoro(kBlocksSql, userId);
+  auto windowRows = co_await tx.client()->execSqlCoro(kWindowsSql, userId);
+  auto limitRows = co_await tx.client()->execSqlCoro(kLimitsSql, userId);
+  auto unscheduledRows =
+      co_await tx.client()->execSqlCoro(kUnscheduledSql, userId);
+
+  // Tasks and projects share one index space for the engine.
+  std::vector<std::string> ids;
+  std::unordered_map<std::string, uint32_t> index;
+  auto indexOf = [&](std::string id) {
+    auto [it, added] =
+        index.try_emplace(id, static_cast<uint32_t>(ids.size()));
+    if (added) ids.push_back(std::move(id));
+    return it->second;
+  };
+  std::unordered_map<uint32_t, uint32_t> projectOf;
+  for (const auto& row : projectRows)
+    projectOf[indexOf(row["task_id"].as<std::string>())] =
+        indexOf(row["project_id"].as<std::string>());
+  auto project = [&](uint32_t task) {
+    const auto it = projectOf.find(task);
+    return it != projectOf.end() ? it->second : task;
+  };
+
+  std::vector<engine::ScanBlock> blocks;
+  blocks.reserve(blockRows.size());
+  for (const auto& row : blockRows) {
+    const uint32_t task = indexOf(row["task_id"].as<std::string>());
+    blocks.push_back({task, project(task),
+                      {row["start_minute"].as<int64_t>(),
+                       row["end_minute"].as<int64_t>()}});
+  }
+  std::vector<engine::WorkWindow> windows;
+  for (const auto& row : windowRows)
+    windows.push_back({row["weekday"].as<int>(), row["start_minute"].as<int>(),
+                       row["end_minute"].as<int>()});
+  std::vector<engine::DailyLimit> limits;
+  for (const auto& row : limitRows)
+    limits.push_back({indexOf(row["project_id"].as<std::string>()),
+                      row["weekday"].as<int>(),
+                      row["minutes"].as<int64_t>()});
+
+  const auto found = engine::scanSchedule(
+      std::move(blocks), engine::UserCalendar(windows), limits);
+  std::set<std::string> overallocated;
+
+  serialization::JsonWriter out(256 * (found.size() + unscheduledRows.size()) +
+                                2);
+  out.beginArray();
+  for (const auto& c : found) {
+    const std::string& task = ids[c.task];
+    const std::string& projectId = ids[project(c.task)];
+    const std::string start = engine::formatMinute(c.slot.start);
+    const std::string end = engine::formatMinute(c.slot.end);
+    switch (c.kind) {
+      case engine::Conflict::Kind::Overlap: {
+        const std::string& other = ids[c.other];
+        const auto& [first, second] =
+            task < other ? std::pair(task, other) : std::pair(other, task);
+        writeFinding(out, "schedule_conflict", "overlap",
+                     "overlap:" + userId + ':' + first + ':' + second + ':' +
+                         std::to_string(c.slot.start) + ':' +
+                         std::to_string(c.slot.end),
+                     projectId, task, [&] {
+                       out.key("other_task_id");
+                       out.string(other);
+                       out.key("start");
+                       out.string(start);
+                       out.key("end");
+                       out.string(end);
+                     });
+        break;
+      }
+      case engine::Conflict::Kind::OutsideWorkHours:
+        writeFinding(out, "schedule_conflict", "outside_work_hours",
+                     "outside_work_hours:" + userId + ':' + task + ':' +
+                         std::to_string(c.slot.start) + ':' +
+                         std::to_string(c.slot.end),
+                     projectId, task, [&] {
+                       out.key("start");
+                       out.string(start);
+                       out.key("end");
+                       out.string(end);
+                       out.key("outside_hours");
+                       out.raw(db::formatHours(c.minutes / 60.0));
+                     });
+        break;
+      case engine::Conflict::Kind::Overallocation: {
+        const std::string date =
+            engine::formatDay(c.slot.start / engine::kMinutesPerDay);
+        overallocated.insert(ids[c.other]);
+        writeFinding(out, "overallocation", "daily_hours",
+                     "daily_hours:" + userId + ':' + ids[c.other] + ':' + date,
+                     ids[c.other], task, [&] {
+                       out.key("date");
+                       out.string(date);
+                       out.key("hours");
+                       out.raw(db::formatHours(c.minutes / 60.0));
+                       out.key("limit_hours");
+                       out.raw(db::formatHours(c.limit / 60.0));
+                     });
+        break;
+      }
+    }
+  }
+  for (const auto& row : unscheduledRows) {
+    const auto task = row["task_id"].as<std::string>();
+    const uint32_t t = indexOf(task);
+    const std::string hours = db::formatHours(row["hours"].as<double>());
+    writeFinding(out, "missing_assignment", "unscheduled",
+                 "unscheduled:" + userId + ':' + task, ids[project(t)], task,
+                 [&] {
+                   out.key("assigned_hours");
+                   out.raw(hours);
+                 });
+  }
+  out.endArray();
+  const std::string findings = out.release();
+
+  db::Pipeline writes;
+  writes.add(kResolveSql, userId, findings);
+  writes.add(kInsertSql, userId, findings);
+  const auto results = co_await writes.run(tx.client());
+  co_await tx.commit();
+
+  const auto resolved = results[0].affectedRows();
+  const auto inserted = results[1].affectedRows();
+  resolved_.inc(resolved);
+  suggestions_.inc(inserted);
+  if (!overallocated.empty()) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    overallocated_.merge(overallocated);
+  }
+  if (resolved || inserted)
+    LOG_DEBUG << "Conflict scan of " << userId << ": " << inserted
+              << " new, " << resolved << " resolved";
+  co_return inserted;
+}
+
+ConflictService& conflicts() {
+  static ConflictService service;
+  return service;
+}
+
+}  // namespace services
@@ -0,0 +1,364 @@
+#include "services/DependencyService.hpp"
+
+#include <trantor/utils/Logger.h>
+
+#include <cmath>
+#include <exception>
+#include <set>
+#include <utility>
+
+#include "db/Literals.hpp"
+#include "db/Pools.hpp"
+#include "db/Transaction.hpp"
+
+namespace services {
+
+namespace {
+
+// Graphs kept in memory; the least recently used one is dropped beyond this.
+constexpr size_t kMaxProjects = 32;
+
+constexpr const char* kNodesSql = R"sql(
+      WITH RECURSIVE scope AS (
+        SELECT id, estimated_hours FROM task WHERE id = $1::uuid
+        UNION ALL
+        SELECT t.id, t.estimated_hours
+        FROM task t JOIN scope s ON t.parent_task_id = s.id
+      )
+      SELECT id::text AS id,
+             round(COALESCE(estimated_hours, 0) * 60)::bigint AS minutes
+      FROM scope
+    )sql";
+
+constexpr const char* kEdgesSql = R"sql(
+      WITH RECURSIVE scope AS (
+        SELECT id FROM task WHERE id = $1::uuid
+        UNION ALL
+        SELECT t.id FROM task t JOIN scope s ON t.parent_task_id = s.id
+      )
+      SELECT d.depends_on_id::text AS from_id,
+             d.task_id::text AS to_id,
+             COALESCE(d.kind, 'finish_start') AS kind
+      FROM task_dependency d
+      JOIN scope a ON a.id = d.task_id
+      JOIN scope b ON b.id = d.depends_on_id
+    )sql";
+
+int64_t minutesOf(double hours) { return std::llround(hours * 60.0); }
+
+}  // namespace
+
+DependencyService::DependencyService()
+    : loadLatency_(metrics::registry().histogram(
+          "pc_dependency_graph_load_seconds",
+          "Time to load a project's dependency graph and analyse it")),
+      hits_(metrics::registry().counter(
+          "pc_dependency_graph_cache_hits_total",
+          "Critical-path requests served from a cached graph")),
+      misses_(metrics::registry().counter(
+          "pc_dependency_graph_cache_misses_total",
+          "Critical-path requests that loaded the graph from the database")),
+      validateLatency_(metrics::registry().histogram(
+          "pc_dependency_insert_seconds",
+          "Time to validate and write a batch of task dependencies")),
+      cyclesRejected_(metrics::registry().counter(
+          "pc_dependency_cycles_rejected_total",
+          "Dependency batches refused because they would close a cycle")) {}
+
+drogon::Task<std::shared_ptr<ProjectGraph>> DependencyService::project(
+    std::string projectId) {
+  const auto root = engine::Uuid::parse(projectId);
+  if (!root) co_return nullptr;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = projects_.find(*root);
+    if (it != projects_.end()) {
+      it->second->lastUsed = ++clock_;
+      hits_.inc();
+      co_return it->second;
+    }
+  }
+  misses_.inc();
+  co_return co_await load(*root);
+}
+
+drogon::Task<std::shared_ptr<ProjectGraph>> DependencyService::load(
+    engine::Uuid root) {
+  metrics::ScopedTimer timer(loadLatency_);
+  uint64_t generation;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    generation = generation_;
+  }
+
+  auto& pool = db::reports();
+  const std::string rootId = root.str();
+  auto nodeRows = co_await pool.exec(kNodesSql, rootId);
+  if (nodeRows.empty()) co_return nullptr;
+  auto edgeRows = co_await pool.exec(kEdgesSql, rootId);
+
+  std::vector<engine::Uuid> ids;
+  std::unordered_map<engine::Uuid, uint32_t, engine::UuidHash> index;
+  std::vector<int64_t> durations;
+  ids.reserve(nodeRows.size());
+  index.reserve(nodeRows.size());
+  durations.reserve(nodeRows.size());
+  for (const auto& row : nodeRows) {
+    const auto id = engine::Uuid::parse(row["id"].as<std::string>());
+    if (!id) continue;
+    index.emplace(*id, static_cast<uint32_t>(ids.size()));
+    ids.push_back(*id);
+    durations.push_back(row["minutes"].as<int64_t>());
+  }
+
+  std::vector<engine::DependencyGraph::Edge> edges;
+  edges.reserve(edgeRows.size());
+  for (const auto& row : edgeRows) {
+    const auto from = engine::Uuid::parse(row["from_id"].as<std::string>());
+    const auto to = engine::Uuid::parse(row["to_id"].as<std::string>());
+    if (!from || !to) continue;
+    const auto f = index.find(*from);
+    const auto t = index.find(*to);
+    if (f == index.end() || t == index.end()) continue;
+    edges.push_back({f->second, t->second,
+                     engine::parseDependencyKind(row["kind"].as<std::string>())
+                         .value_or(engine::DependencyKind::FinishStart)});
+  }
+
+  auto graph = std::make_shared<ProjectGraph>(engine::CriticalPath(
+      engine::DependencyGraph(std::move(durations), edges)));
+  graph->ids = std::move(ids);
+  graph->index = std::move(index);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  graph->lastUsed = ++clock_;
+  if (generation != generation_) co_return graph;
+  if (projects_.size() >= kMaxProjects) {
+    auto oldest = projects_.begin();
+    for (auto it = projects_.begin(); it != projects_.end(); ++it)
+      if (it->second->lastUsed < oldest->second->lastUsed) oldest = it;
+    projects_.erase(oldest);
+  }
+  projects_[root] = graph;
+  LOG_DEBUG << "Dependency graph of " << rootId << " loaded: "
+            << graph->ids.size() << " tasks, " << edges.size() << " edges";
+  co_return graph;
+}
+
+drogon::Task<DependencyInsert> DependencyService::add(
+    std::vector<NewDependency> dependencies) {
+  metrics::ScopedTimer timer(validateLatency_);
+  DependencyInsert result;
+
+  // One writer at a time, so the in-memory order and the table move
+  // together.
+  auto tx = co_await db::Tx::begin(db::oltp());
+  co_await tx.client()->execSqlCoro(
+      "SELECT pg_advisory_xact_lock(hashtext('task_dependency'))");
+  bool loaded;
+  {
+    std::lock_guard<std::mutex> lock(orderMutex_);
+    loaded = orderLoaded_;
+  }
+  if (!loaded) co_await loadOrder(tx.client());
+
+  std::vector<engine::DependencyOrder::Arc> arcs;
+  std::vector<const NewDependency*> fresh;
+  for (int attempt = 0;; ++attempt) {
+    std::vector<engine::Uuid> cycle;
+    std::set<std::pair<engine::Uuid, engine::Uuid>> batch;
+    bool accepted;
+    {
+      std::lock_guard<std::mutex> lock(orderMutex_);
+      arcs.clear();
+      fresh.clear();
+      result.duplicates = 0;
+      std::set<engine::DependencyOrder::Arc> seen;
+      for (const auto& d : dependencies) {
+        const auto to = engine::Uuid::parse(d.taskId);
+        const auto from = engine::Uuid::parse(d.dependsOnId);
+        if (!to || !from) continue;
+        const engine::DependencyOrder::Arc arc{orderNode(*from),
+                                               orderNode(*to)};
+        if (order_.hasArc(arc.first, arc.second) || !seen.insert(arc).second) {
+          ++result.duplicates;
+          continue;
+        }
+        arcs.push_back(arc);
+        fresh.push_back(&d);
+        batch.emplace(*from, *to);
+      }
+      std::vector<uint32_t> nodes;
+      accepted = order_.addArcs(arcs, &nodes);
+      for (const uint32_t v : nodes) cycle.push_back(orderIds_[v]);
+    }
+    if (accepted) break;
+
+    // Subtasks deleted through the parent_task_id cascade take their
+    // dependencies along without a hook, so the order can hold arcs that
+    // are gone. Confirm the cycle against the table once before refusing.
+    if (attempt == 0) {
+      db::ArrayLiteral froms, tos;
+      size_t stored = 0;
+      for (size_t i = 0; i + 1 < cycle.size(); ++i) {
+        if (batch.count({cycle[i], cycle[i + 1]})) continue;
+        froms.add(cycle[i].str());
+        tos.add(cycle[i + 1].str());
+        ++stored;
+      }
+      auto found = co_await tx.client()->execSqlCoro(
+          R"sql(
+          SELECT count(*) AS found
+          FROM unnest($1::uuid[], $2::uuid[]) AS x(from_id, to_id)
+          WHERE EXISTS (SELECT 1 FROM task_dependency d
+                        WHERE d.depends_on_id = x.from_id
+                          AND d.task_id = x.to_id)
+        )sql",
+          froms.release(), tos.release());
+      if (found[0]["found"].as<int64_t>() != static_cast<int64_t>(stored)) {
+        LOG_WARN << "Dependency order was stale, reloading";
+        co_await loadOrder(tx.client());
+        continue;
+      }
+    }
+    cyclesRejected_.inc();
+    for (const auto& id : cycle) result.cycle.push_back(id.str());
+    co_return result;
+  }
+
+  if (arcs.empty()) co_return result;
+  db::ArrayLiteral tasks, dependsOn, kinds;
+  for (const auto* d : fresh) {
+    tasks.add(d->taskId);
+    dependsOn.add(d->dependsOnId);
+    kinds.add(engine::dependencyKindName(d->kind));
+  }
+
+  std::exception_ptr failure;
+  try {
+    auto rows = co_await tx.client()->execSqlCoro(
+        R"sql(
+        INSERT INTO task_dependency (task_id, depends_on_id, kind)
+        SELECT * FROM unnest($1::uuid[], $2::uuid[], $3::text[])
+        RETURNING id::text AS id, task_id::text AS task_id,
+                  depends_on_id::text AS depends_on_id, kind
+      )sql",
+        tasks.release(), dependsOn.release(), kinds.release());
+    co_await tx.commit();
+    result.created.reserve(rows.size());
+    for (const auto& row : rows)
+      result.created.push_back(
+          {row["id"].as<std::string>(), row["task_id"].as<std::string>(),
+           row["depends_on_id"].as<std::string>(),
+           engine::parseDependencyKind(row["kind"].as<std::string>())
+               .value_or(engine::DependencyKind::FinishStart)});
+  } catch (...) {
+    failure = std::current_exception();
+  }
+  if (failure) {
+    std::lock_guard<std::mutex> lock(orderMutex_);
+    for (const auto& arc : arcs) order_.removeArc(arc.first, arc.second);
+    std::rethrow_exception(failure);
+  }
+
+  for (const auto& c : result.created)
+    dependencyAdded(c.taskId, c.dependsOnId, c.kind);
+  co_return result;
+}
+
+drogon::Task<> DependencyService::loadOrder(drogon::orm::DbClientPtr client) {
+  auto rows = co_await client->execSqlCoro(
+      "SELECT depends_on_id::text AS from_id, task_id::text AS to_id "
+      "FROM task_dependency");
+
+  std::lock_guard<std::mutex> lock(orderMutex_);
+  orderLoaded_ = false;
+  orderIds_.clear();
+  orderIndex_.clear();
+  std::vector<engine::DependencyOrder::Arc> arcs;
+  arcs.reserve(rows.size());
+  for (const auto& row : rows) {
+    const auto from = engine::Uuid::parse(row["from_id"].as<std::string>());
+    const auto to = engine::Uuid::parse(row["to_id"].as<std::string>());
+    if (from && to) arcs.push_back({orderNode(*from), orderNode(*to)});
+  }
+  const auto rejected = order_.build(orderIds_.size(), arcs);
+  if (!rejected.empty())
+    LOG_WARN << "task_dependency already holds " << rejected.size()
+             << " dependencies that close cycles; they are ignored when "
+                "validating new ones";
+  orderLoaded_ = true;
+}
+
+uint32_t DependencyService::orderNode(const engine::Uuid& id) {
+  const auto [it, added] = orderIndex_.try_emplace(
+      id, static_cast<uint32_t>(orderIds_.size()));
+  if (added) {
+    orderIds_.push_back(id);
+    // While loading, build() sizes the order for all nodes at once.
+    if (orderLoaded_) order_.addNode();
+  }
+  return it->second;
+}
+
+void DependencyService::durationChanged(const std::string& taskId,
+                                        double estimatedHours) {
+  const auto id = engine::Uuid::parse(taskId);
+  if (!id) return;
+  std::lock_guard<std::mutex> lock(mutex_);
+  ++generation_;
+  for (auto& [root, graph] : projects_) {
+    const auto it = graph->index.find(*id);
+    if (it == graph->index.end()) continue;
+    std::lock_guard<std::mutex> graphLock(graph->mutex);
+    graph->path.setDuration(it->second, minutesOf(estimatedHours));
+  }
+}
+
+void DependencyService::dependencyAdded(const std::string& taskId,
+                                        const std::string& dependsOnId,
+                                        engine::DependencyKind kind) {
+  const auto to = engine::Uuid::parse(taskId);
+  const auto from = engine::Uuid::parse(dependsOnId);
+  if (!to || !from) return;
+  std::lock_guard<std::mutex> lock(mutex_);
+  ++generation_;
+  for (auto& [root, graph] : projects_) {
+    const auto t = graph->index.find(*to);
+    const auto f = graph->index.find(*from);
+    if (t == graph->index.end() || f == graph->index.end()) continue;
+    std::lock_guard<std::mutex> graphLock(graph->mutex);
+    graph->path.addEdge({f->second, t->second, kind});
+  }
+}
+
+void DependencyService::structureChanged(const std::string& taskId) {
+  const auto id = engine::Uuid::parse(taskId);
+  if (!id) return;
+  std::lock_guard<std::mutex> lock(mutex_);
+  ++generation_;
+  for (auto it = projects_.begin(); it != projects_.end();) {
+    if (it->second->index.count(*id))
+      it = projects_.erase(it);
+    else
+      ++it;
+  }
+}
+
+void DependencyService::taskDeleted(const std::string& taskId) {
+  const auto id = engine::Uuid::parse(taskId);
+  if (!id) return;
+  {
+    std::lock_guard<std::mutex> lock(orderMutex_);
+    const auto it = orderIndex_.find(*id);
+    if (it != orderIndex_.end()) order_.clearNode(it->second);
+  }
+  structureChanged(taskId);
+}
+
+DependencyService& dependencies() {
+  static DependencyService service;
+  return service;
+}
+
+}  // namespace services
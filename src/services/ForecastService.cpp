@@ -0,0 +1,283 @@
+#include "services/ForecastService.hpp"
+
+#include <trantor/net/EventLoop.h>
+#include <trantor/utils/Logger.h>
+
+#include <algorithm>
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "db/Pools.hpp"
+#include "services/DependencyService.hpp"
+
+namespace services {
+
+namespace {
+
+// Forecasts kept in memory; the least recently used one is dropped beyond
+// this.
+constexpr size_t kMaxForecasts = 64;
+
+// Weekly working minutes assumed for an assignee without a work schedule.
+constexpr double kDefaultWeeklyMinutes = 40 * 60;
+
+// Every task of the project with what the trials need: whether anything is
+// left, how many days from today it may start, and the weekly working
+// minutes of its assignees.
+constexpr const char* kTasksSql = R"sql(
+      WITH RECURSIVE scope AS (
+        SELECT id FROM task WHERE id = $1::uuid
+        UNION ALL
+        SELECT t.id FROM task t JOIN scope s ON t.parent_task_id = s.id
+      )
+      SELECT t.id::text AS id,
+             t.status IN ('completed', 'cancelled') AS done,
+             GREATEST(COALESCE(t.start_date - CURRENT_DATE, 0), 0)
+               AS release_days,
+             count(a.user_id) AS assignees,
+             COALESCE(sum(COALESCE(w.minutes, $2::float8)), 0)::float8
+               AS weekly_minutes,
+             t.due_date - DATE '1970-01-01' AS due_day,
+             CURRENT_DATE - DATE '1970-01-01' AS today
+      FROM scope s
+      JOIN task t ON t.id = s.id
+      LEFT JOIN task_assignment a ON a.task_id = t.id
+      LEFT JOIN LATERAL (
+        SELECT sum(EXTRACT(EPOCH FROM end_time - start_time) / 60) AS minutes
+        FROM user_work_schedule
+        WHERE user_id = a.user_id AND weekday IS NOT NULL
+      ) w ON true
+      GROUP BY t.id
+    )sql";
+
+int64_t utcDay() {
+  return std::chrono::floor<std::chrono::days>(
+             std::chrono::system_clock::now())
+      .time_since_epoch()
+      .count();
+}
+
+}  // namespace
+
+struct ForecastService::InFlight {
+  explicit InFlight(uint32_t trials) : trials(trials) {}
+
+  const uint32_t trials;
+  std::mutex mutex;
+  bool done = false;
+  std::shared_ptr<const ProjectForecast> result;
+  std::exception_ptr error;
+  std::vector<std::function<void()>> waiters;
+
+  void finish(std::shared_ptr<const ProjectForecast> r, std::exception_ptr e) {
+    std::vector<std::function<void()>> wake;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      done = true;
+      result = std::move(r);
+      error = std::move(e);
+      wake.swap(waiters);
+    }
+    for (auto& w : wake) w();
+  }
+};
+
+// Waits for a run started by another request and resumes on the event loop
+// it was suspended on.
+class ForecastService::InFlightAwaiter
+    : public drogon::CallbackAwaiter<std::shared_ptr<const ProjectForecast>> {
+ public:
+  explicit InFlightAwaiter(std::shared_ptr<InFlight> flight)
+      : flight_(std::move(flight)) {}
+
+  bool await_suspend(std::coroutine_handle<> handle) {
+    trantor::EventLoop* loop =
+        trantor::EventLoop::getEventLoopOfCurrentThread();
+    std::lock_guard<std::mutex> lock(flight_->mutex);
+    if (flight_->done) {
+      deliver();
+      return false;
+    }
+    flight_->waiters.push_back([this, handle, loop] {
+      deliver();
+      if (loop)
+        loop->queueInLoop([handle] { handle.resume(); });
+      else
+        handle.resume();
+    });
+    return true;
+  }
+
+ private:
+  void deliver() {
+    if (flight_->error)
+      setException(flight_->error);
+    else
+      setValue(flight_->result);
+  }
+
+  std::shared_ptr<InFlight> flight_;
+};
+
+ForecastService::ForecastService()
+    : pool_("pc_forecast", "Forecast"),
+      latency_(metrics::registry().histogram(
+          "pc_forecast_seconds",
+          "Time to load a project and run its forecast trials")),
+      hits_(metrics::registry().counter(
+          "pc_forecast_cache_hits_total",
+          "Forecast requests answered from the cache")),
+      misses_(metrics::registry().counter(
+          "pc_forecast_cache_misses_total",
+          "Forecast requests that ran the trials")),
+      shared_(metrics::registry().counter(
+          "pc_forecast_shared_total",
+          "Forecast requests that waited for a run already in flight")) {}
+
+void ForecastService::start(const ForecastSettings& settings) {
+  pool_.start(settings.workers, settings.queueLimit);
+  LOG_INFO << "Forecasts: " << std::max<size_t>(1, settings.workers)
+           << " workers, queue " << settings.queueLimit;
+}
+
+drogon::Task<std::shared_ptr<const ProjectForecast>> ForecastService::forecast(
+    std::string projectId, uint32_t trials) {
+  const auto root = engine::Uuid::parse(projectId);
+  if (!root) co_return nullptr;
+  std::shared_ptr<InFlight> flight;
+  bool leader = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = forecasts_.find(*root);
+    if (it != forecasts_.end() && it->second.trials == trials &&
+        it->second.day == utcDay()) {
+      it->second.lastUsed = ++clock_;
+      hits_.inc();
+      co_return it->second.forecast;
+    }
+    // A run with other trials keeps its slot; this one goes on unshared.
+    auto& slot = inFlight_[*root];
+    if (slot && slot->trials == trials) {
+      flight = slot;
+    } else {
+      flight = std::make_shared<InFlight>(trials);
+      if (!slot) slot = flight;
+      leader = true;
+    }
+  }
+  if (!leader) {
+    shared_.inc();
+    co_return co_await InFlightAwaiter(std::move(flight));
+  }
+
+  misses_.inc();
+  std::shared_ptr<const ProjectForecast> result;
+  std::exception_ptr error;
+  try {
+    result = co_await run(*root, trials);
+  } catch (...) {
+    error = std::current_exception();
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = inFlight_.find(*root);
+    if (it != inFlight_.end() && it->second == flight) inFlight_.erase(it);
+  }
+  flight->finish(result, error);
+  if (error) std::rethrow_exception(error);
+  co_return result;
+}
+
+void ForecastService::changed() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ++generation_;
+  forecasts_.clear();
+  // Runs already going finish for their waiters; new requests start over.
+  inFlight_.clear();
+}
+
+drogon::Task<std::shared_ptr<const ProjectForecast>> ForecastService::run(
+    engine::Uuid root, uint32_t trials) {
+  metrics::ScopedTimer timer(latency_);
+  uint64_t generation;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    generation = generation_;
+  }
+  const int64_t day = utcDay();
+
+  const std::string rootId = root.str();
+  const auto graph = co_await dependencies().project(rootId);
+  if (!graph) co_return nullptr;
+  std::shared_ptr<const engine::CriticalPath> path;
+  std::unordered_map<engine::Uuid, uint32_t, engine::UuidHash> index;
+  {
+    std::lock_guard<std::mutex> lock(graph->mutex);
+    path = std::make_shared<const engine::CriticalPath>(graph->path);
+    index = graph->index;
+  }
+
+  auto rows =
+      co_await db::reports().exec(kTasksSql, rootId, kDefaultWeeklyMinutes);
+  auto result = std::make_shared<ProjectForecast>();
+  std::vector<engine::ForecastTask> tasks(index.size());
+  for (const auto& row : rows) {
+    const auto taskId = row["id"].as<std::string>();
+    const auto id = engine::Uuid::parse(taskId);
+    const auto node = id ? index.find(*id) : index.end();
+    if (node == index.end()) continue;
+    auto& task = tasks[node->second];
+    task.release = row["release_days"].as<int64_t>() * engine::kMinutesPerDay;
+    const double weekly = row["assignees"].as<int64_t>() > 0
+                              ? row["weekly_minutes"].as<double>()
+                              : kDefaultWeeklyMinutes;
+    if (row["done"].as<bool>())
+      task.pace = 0;
+    else
+      task.pace = 7.0 * engine::kMinutesPerDay / std::max(weekly, 1.0);
+    result->today = row["today"].as<int64_t>();
+    if (*id == root && !row["due_day"].isNull())
+      result->dueDay = row["due_day"].as<int64_t>();
+  }
+
+  engine::ForecastOptions options;
+  options.trials = trials;
+  // One worker per run: the pool bounds how many cores forecasts take.
+  options.threads = 1;
+  result->forecast = co_await PoolAwaiter<engine::Forecast>(
+      pool_,
+      [path, tasks = std::move(tasks), options] {
+        return engine::forecastProject(*path, tasks, options);
+      },
+      [this] {
+        const uint64_t runs = latency_.count();
+        return std::make_exception_ptr(ForecastOverloaded(
+            pool_.retryAfterSeconds(runs ? latency_.sumSeconds() / runs : 1)));
+      });
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (generation != generation_) co_return result;
+  if (forecasts_.size() >= kMaxForecasts) {
+    auto oldest = forecasts_.begin();
+    for (auto it = forecasts_.begin(); it != forecasts_.end(); ++it)
+      if (it->second.lastUsed < oldest->second.lastUsed) oldest = it;
+    forecasts_.erase(oldest);
+  }
+  forecasts_[root] = {result, trials, day, ++clock_};
+  LOG_DEBUG << "Forecast of " << rootId << ": " << trials << " trials over "
+            << index.size() << " tasks, P50 "
+            << result->forecast.percentile(0.5) << " min, P90 "
+            << result->forecast.percentile(0.9) << " min";
+  co_return result;
+}
+
+ForecastService& forecasts() {
+  static ForecastService service;
+  return service;
+}
+
+}  // namespace services
@@ -0,0 +1,70 @@
+#include "services/PasswordHasher.hpp"
+
+#include <bcrypt.h>
+#include <trantor/utils/Logger.h>
+
+#include <algorithm>
+#include <exception>
+#include <utility>
+
+namespace services {
+
+PasswordHasher::PasswordHasher()
+    : pool_("pc_bcrypt", "Password hashing"),
+      hashLatency_(metrics::registry().histogram(
+          "pc_bcrypt_seconds", "Time spent in bcrypt per call",
+          "op=\"hash\"")),
+      verifyLatency_(metrics::registry().histogram(
+          "pc_bcrypt_seconds", "Time spent in bcrypt per call",
+          "op=\"verify\"")) {}
+
+void PasswordHasher::start(const PasswordHasherSettings& settings) {
+  settings_ = settings;
+  settings_.workers = std::max<size_t>(1, settings.workers);
+  // bcrypt accepts work factors 4..31.
+  settings_.cost = std::clamp(settings.cost, 4u, 31u);
+  pool_.start(settings_.workers, settings_.queueLimit);
+  LOG_INFO << "Password hashing: " << settings_.workers << " workers, queue "
+           << settings_.queueLimit << ", cost " << settings_.cost;
+}
+
+int PasswordHasher::retryAfterSeconds() const {
+  const uint64_t calls = hashLatency_.count() + verifyLatency_.count();
+  const double perCall =
+      calls ? (hashLatency_.sumSeconds() + verifyLatency_.sumSeconds()) / calls
+            : 0.1;
+  return pool_.retryAfterSeconds(perCall);
+}
+
+drogon::Task<std::string> PasswordHasher::hash(std::string password) {
+  const unsigned cost = settings_.cost;
+  co_return co_await PoolAwaiter<std::string>(
+      pool_,
+      [this, cost, password = std::move(password)] {
+        metrics::ScopedTimer timer(hashLatency_);
+        return bcrypt::generateHash(password, cost);
+      },
+      [this] {
+        return std::make_exception_ptr(HasherOverloaded(retryAfterSeconds()));
+      });
+}
+
+drogon::Task<bool> PasswordHasher::verify(std::string password,
+                                          std::string hash) {
+  co_return co_await PoolAwaiter<bool>(
+      pool_,
+      [this, password = std::move(password), hash = std::move(hash)] {
+        metrics::ScopedTimer timer(verifyLatency_);
+        return bcrypt::validatePassword(password, hash);
+      },
+      [this] {
+        return std::make_exception_ptr(HasherOverloaded(retryAfterSeconds()));
+      });
+}
+
+PasswordHasher& passwords() {
+  static PasswordHasher hasher;
+  return hasher;
+}
+
+}  // namespace services
@@ -0,0 +1,421 @@
+#include "services/PermissionService.hpp"
+
+#include <drogon/drogon.h>
+#include <trantor/utils/Logger.h>
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+
+#include "db/Literals.hpp"
+#include "db/Pools.hpp"
+
+namespace services {
+
+namespace {
+
+using engine::RoleSet;
+using engine::TaskAcl;
+using engine::Uuid;
+using engine::UuidHash;
+
+int64_t nowSeconds() {
+  return std::chrono::duration_cast<std::chrono::seconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+std::optional<Uuid> uuidOf(const drogon::orm::Field& f) {
+  if (f.isNull()) return std::nullopt;
+  return Uuid::parse(f.as<std::string>());
+}
+
+RoleSet roleSetOf(const drogon::orm::Field& f) {
+  if (f.isNull()) return 0;
+  const auto role = engine::parseRole(f.as<std::string>());
+  return role ? engine::roleBit(*role) : 0;
+}
+
+// Assembles TaskAcl entries from the rows of the permission tables. Rows for
+// tasks that were not added first are dropped.
+class AclBuilder {
+ public:
+  // Columns: id, parent_task_id, created_by.
+  void addTasks(const drogon::orm::Result& rows) {
+    tasks_.reserve(tasks_.size() + rows.size());
+    for (const auto& row : rows) {
+      const auto id = uuidOf(row["id"]);
+      if (!id) continue;
+      TaskAcl acl;
+      acl.id = *id;
+      acl.parent = uuidOf(row["parent_task_id"]);
+      acl.createdBy = uuidOf(row["created_by"]).value_or(Uuid{});
+      tasks_[*id] = std::move(acl);
+    }
+  }
+
+  // Columns: task_id, user_id, role.
+  void addRoles(const drogon::orm::Result& rows) {
+    for (const auto& row : rows) {
+      TaskAcl* acl = find(row["task_id"]);
+      const auto user = uuidOf(row["user_id"]);
+      if (acl && user) grant(*acl, *user).local |= roleSetOf(row["role"]);
+    }
+  }
+
+  // Columns: user_id, scope_type, scope_id, role. Global grants go to
+  // `globalRoles` when it is given.
+  void addScopedGrants(
+      const drogon::orm::Result& rows,
+      std::unordered_map<Uuid, RoleSet, UuidHash>* globalRoles) {
+    for (const auto& row : rows) {
+      const auto user = uuidOf(row["user_id"]);
+      if (!user) continue;
+      const RoleSet roles = roleSetOf(row["role"]);
+      const std::string scope =
+          row["scope_type"].isNull() ? "global"
+                                     : row["scope_type"].as<std::string>();
+      if (scope == "global") {
+        if (globalRoles) (*globalRoles)[*user] |= roles;
+        continue;
+      }
+      TaskAcl* acl = find(row["scope_id"]);
+      if (!acl) continue;
+      if (scope == "project")
+        grant(*acl, *user).full |= roles;
+      else
+        grant(*acl, *user).local |= roles;
+    }
+  }
+
+  // Columns: id, task_id, grantee_user_id, expires_at (unix seconds, 0 when
+  // open-ended), permission_key, allow. One row per delegated key.
+  template <typename BitFn>
+  void addDelegations(const drogon::orm::Result& rows, BitFn bit) {
+    std::unordered_map<Uuid, std::pair<TaskAcl*, size_t>, UuidHash> seen;
+    for (const auto& row : rows) {
+      const auto id = uuidOf(row["id"]);
+      TaskAcl* acl = find(row["task_id"]);
+      const auto grantee = uuidOf(row["grantee_user_id"]);
+      if (!id || !acl || !grantee) continue;
+      auto it = seen.find(*id);
+      if (it == seen.end()) {
+        TaskAcl::Delegation d;
+        d.grantee = *grantee;
+        d.expiresAt = row["expires_at"].as<int64_t>();
+        acl->delegations.push_back(d);
+        const size_t index = acl->delegations.size() - 1;
+        it = seen.emplace(*id, std::make_pair(acl, index)).first;
+      }
+      const int b = bit(row["permission_key"].as<std::string>());
+      if (b < 0) continue;
+      auto& d = it->second.first->delegations[it->second.second];
+      const engine::PermissionMask m = engine::PermissionMask{1} << b;
+      if (row["allow"].isNull() || row["allow"].as<bool>())
+        d.allow |= m;
+      else
+        d.deny |= m;
+    }
+  }
+
+  std::vector<TaskAcl> take() {
+    std::vector<TaskAcl> out;
+    out.reserve(tasks_.size());
+    for (auto& [id, acl] : tasks_) out.push_back(std::move(acl));
+    tasks_.clear();
+    return out;
+  }
+
+ private:
+  TaskAcl* find(const drogon::orm::Field& f) {
+    const auto id = uuidOf(f);
+    if (!id) return nullptr;
+    auto it = tasks_.find(*id);
+    return it == tasks_.end() ? nullptr : &it->second;
+  }
+
+  static TaskAcl::RoleGrant& grant(TaskAcl& acl, const Uuid& user) {
+    for (auto& g : acl.roles)
+      if (g.user == user) return g;
+    acl.roles.push_back({user, 0, 0});
+    return acl.roles.back();
+  }
+
+  std::unordered_map<Uuid, TaskAcl, UuidHash> tasks_;
+};
+
+constexpr const char* kDelegationColumns = R"sql(
+        SELECT d.id::text AS id,
+               d.task_id::text AS task_id,
+               d.grantee_user_id::text AS grantee_user_id,
+               COALESCE(EXTRACT(EPOCH FROM d.expires_at)::bigint, 0)
+                 AS expires_at,
+               dp.permission_key,
+               dp.allow
+        FROM delegation d
+        JOIN delegation_permission dp ON dp.delegation_id = d.id
+        WHERE d.status = 'active'
+      )sql";
+
+}  // namespace
+
+PermissionService::PermissionService()
+    : reloads_(metrics::registry().counter(
+          "pc_permission_reloads_total",
+          "Full reloads of the in-memory permission snapshot")),
+      reloadFailures_(metrics::registry().counter(
+          "pc_permission_reload_failures_total",
+          "Reloads of the permission snapshot that failed and kept the "
+          "previous one")),
+      misses_(metrics::registry().counter(
+          "pc_permission_misses_total",
+          "Permission checks that had to load the task from the database")) {}
+
+void PermissionService::start(double reloadSeconds) {
+  drogon::app().registerBeginningAdvice([this, reloadSeconds] {
+    drogon::async_run([this]() -> drogon::Task<> { co_await reload(); });
+    drogon::app().getLoop()->runEvery(reloadSeconds, [this] {
+      drogon::async_run([this]() -> drogon::Task<> { co_await reload(); });
+    });
+  });
+}
+
+drogon::Task<> PermissionService::reload() {
+  {
+    std::lock_guard<std::mutex> lock(pendingMutex_);
+    if (reloading_) co_return;
+    reloading_ = true;
+    pending_.clear();
+  }
+
+  auto& pool = db::reports();
+  bool loaded = false;
+  try {
+    auto keyRows = co_await pool.exec("SELECT key FROM permission");
+    auto grantRows = co_await pool.exec(
+        "SELECT role::text AS role, permission_key, "
+        "COALESCE(is_global, false) AS is_global FROM role_permission");
+    auto scopedRows = co_await pool.exec(
+        "SELECT user_id::text AS user_id, scope_type::text AS scope_type, "
+        "scope_id::text AS scope_id, role::text AS role "
+        "FROM global_role_grant");
+    auto taskRows = co_await pool.exec(
+        "SELECT id::text AS id, parent_task_id::text AS parent_task_id, "
+        "created_by::text AS created_by FROM task");
+    auto roleRows = co_await pool.exec(
+        "SELECT task_id::text AS task_id, user_id::text AS user_id, "
+        "role::text AS role FROM task_role_assignment");
+    auto delegationRows = co_await pool.exec(kDelegationColumns);
+
+    std::vector<std::string> keys;
+    keys.reserve(keyRows.size());
+    for (const auto& row : keyRows)
+      keys.push_back(row["key"].as<std::string>());
+    std::vector<engine::PermissionMatrix::Entry> entries;
+    entries.reserve(grantRows.size());
+    for (const auto& row : grantRows)
+      entries.push_back({row["role"].as<std::string>(),
+                         row["permission_key"].as<std::string>(),
+                         row["is_global"].as<bool>()});
+    auto matrix = std::make_shared<const engine::PermissionMatrix>(
+        std::move(keys), entries);
+
+    std::unordered_map<Uuid, RoleSet, UuidHash> globalRoles;
+    AclBuilder builder;
+    builder.addTasks(taskRows);
+    builder.addRoles(roleRows);
+    builder.addScopedGrants(scopedRows, &globalRoles);
+    builder.addDelegations(delegationRows, [&](std::string_view key) {
+      return matrix->bit(key);
+    });
+    const size_t taskCount = taskRows.size();
+
+    std::lock_guard<std::mutex> lock(pendingMutex_);
+    engine_.load(std::move(matrix), std::move(globalRoles), builder.take());
+    for (auto& op : pending_) op();
+    LOG_DEBUG << "Permission snapshot loaded: " << taskCount << " tasks, "
+              << pending_.size() << " writes replayed";
+    loaded = true;
+  } catch (const std::exception& e) {
+    LOG_ERROR << "Permission reload failed, keeping previous snapshot: "
+              << e.what();
+  }
+
+  if (loaded)
+    reloads_.inc();
+  else
+    reloadFailures_.inc();
+  std::lock_guard<std::mutex> lock(pendingMutex_);
+  pending_.clear();
+  reloading_ = false;
+}
+
+drogon::Task<> PermissionService::loadTask(std::string taskId) {
+  auto& pool = db::oltp();
+  auto taskRows = co_await pool.exec(
+      R"sql(
+      WITH RECURSIVE chain AS (
+        SELECT id, parent_task_id, created_by, 0 AS depth
+        FROM task WHERE id = $1::uuid
+        UNION ALL
+        SELECT t.id, t.parent_task_id, t.created_by, c.depth + 1
+        FROM task t JOIN chain c ON t.id = c.parent_task_id
+        WHERE c.depth < 256
+      )
+      SELECT id::text AS id, parent_task_id::text AS parent_task_id,
+             created_by::text AS created_by
+      FROM chain
+    )sql",
+      taskId);
+  if (taskRows.empty()) co_return;
+
+  db::ArrayLiteral idLiteral;
+  for (const auto& row : taskRows) idLiteral.add(row["id"].as<std::string>());
+  const std::string idArray = idLiteral.release();
+
+  auto roleRows = co_await pool.exec(
+      "SELECT task_id::text AS task_id, user_id::text AS user_id, "
+      "role::text AS role FROM task_role_assignment "
+      "WHERE task_id = ANY($1::uuid[])",
+      idArray);
+  auto scopedRows = co_await pool.exec(
+      "SELECT user_id::text AS user_id, scope_type::text AS scope_type, "
+      "scope_id::text AS scope_id, role::text AS role "
+      "FROM global_role_grant WHERE scope_id = ANY($1::uuid[])",
+      idArray);
+  auto delegationRows = co_await pool.exec(
+      std::string(kDelegationColumns) + " AND d.task_id = ANY($1::uuid[])",
+      idArray);
+
+  AclBuilder builder;
+  builder.addTasks(taskRows);
+  builder.addRoles(roleRows);
+  builder.addScopedGrants(scopedRows, nullptr);
+  builder.addDelegations(delegationRows, [this](std::string_view key) {
+    return engine_.bit(key);
+  });
+  auto acls = builder.take();
+  apply([this, acls = std::move(acls)] { engine_.upsert(acls); });
+}
+
+drogon::Task<bool> PermissionService::check(std::string userId,
+                                            std::string taskId,
+                                            std::string key) {
+  const auto user = Uuid::parse(userId);
+  const auto task = Uuid::parse(taskId);
+  if (!user || !task) co_return false;
+
+  if (!engine_.hasTask(*task)) {
+    misses_.inc();
+    try {
+      co_await loadTask(taskId);
+    } catch (const std::exception& e) {
+      LOG_ERROR << "Loading permissions for task " << taskId
+                << " failed: " << e.what();
+      co_return false;
+    }
+  }
+  co_return engine_.allowed(*user, *task, key, nowSeconds());
+}
+
+void PermissionService::apply(std::function<void()> op) {
+  {
+    std::lock_guard<std::mutex> lock(pendingMutex_);
+    if (reloading_) pending_.push_back(op);
+  }
+  op();
+}
+
+void PermissionService::taskCreated(const std::string& taskId,
+                                    const std::string& parentId,
+                                    const std::string& createdBy) {
+  const auto id = Uuid::parse(taskId);
+  const auto creator = Uuid::parse(createdBy);
+  if (!id || !creator) return;
+  TaskAcl acl;
+  acl.id = *id;
+  if (!parentId.empty()) acl.parent = Uuid::parse(parentId);
+  acl.createdBy = *creator;
+  acl.roles.push_back({*creator, engine::roleBit(engine::Role::Owner), 0});
+  apply([this, acl] { engine_.upsert({acl}); });
+}
+
+void PermissionService::tasksCreated(const std::vector<CreatedTask>& tasks,
+                                     const std::string& createdBy) {
+  const auto creator = Uuid::parse(createdBy);
+  if (!creator) return;
+  std::vector<TaskAcl> acls;
+  acls.reserve(tasks.size());
+  for (const auto& t : tasks) {
+    const auto id = Uuid::parse(t.id);
+    if (!id) continue;
+    TaskAcl acl;
+    acl.id = *id;
+    if (!t.parentId.empty()) acl.parent = Uuid::parse(t.parentId);
+    acl.createdBy = *creator;
+    for (const auto& [userId, role] : t.roles) {
+      const auto user = Uuid::parse(userId);
+      const auto r = engine::parseRole(role);
+      if (!user || !r) continue;
+      auto grant = std::find_if(
+          acl.roles.begin(), acl.roles.end(),
+          [&](const TaskAcl::RoleGrant& g) { return g.user == *user; });
+      if (grant == acl.roles.end())
+        acl.roles.push_back({*user, engine::roleBit(*r), 0});
+      else
+        grant->local |= engine::roleBit(*r);
+    }
+    acls.push_back(std::move(acl));
+  }
+  apply([this, acls = std::move(acls)] { engine_.upsert(acls); });
+}
+
+void PermissionService::taskDeleted(const std::string& taskId) {
+  const auto id = Uuid::parse(taskId);
+  if (!id) return;
+  apply([this, id = *id] { engine_.remove(id); });
+}
+
+void PermissionService::taskMoved(const std::string& taskId,
+                                  const std::string& parentId) {
+  const auto id = Uuid::parse(taskId);
+  if (!id) return;
+  std::optional<Uuid> parent;
+  if (!parentId.empty()) {
+    parent = Uuid::parse(parentId);
+    if (!parent) return;
+  }
+  apply([this, id = *id, parent] { engine_.reparent(id, parent); });
+}
+
+void PermissionService::roleGranted(const std::string& taskId,
+                                    const std::string& userId,
+                                    const std::string& role) {
+  const auto task = Uuid::parse(taskId);
+  const auto user = Uuid::parse(userId);
+  const auto r = engine::parseRole(role);
+  if (!task || !user || !r) return;
+  apply([this, task = *task, user = *user, roles = engine::roleBit(*r)] {
+    engine_.grantRoles(task, user, roles);
+  });
+}
+
+void PermissionService::rolesRevoked(const std::string& taskId,
+                                     const std::string& userId) {
+  const auto task = Uuid::parse(taskId);
+  const auto user = Uuid::parse(userId);
+  if (!task || !user) return;
+  apply([this, task = *task, user = *user] {
+    engine_.revokeRoles(task, user);
+  });
+}
+
+PermissionService& permissions() {
+  static PermissionService service;
+  return service;
+}
+
+}  // namespace services
@@ -0,0 +1,277 @@
+#include "services/RebalanceService.hpp"
+
+#include <trantor/utils/Logger.h>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "db/Literals.hpp"
+#include "db/Pools.hpp"
+#include "engine/Rebalance.hpp"
+#include "serialization/JsonWriter.hpp"
+
+namespace services {
+
+namespace {
+
+// Days from today that are balanced.
+constexpr int64_t kHorizonDays = 92;
+
+// Open tasks of the project with their priority as 0..3 and the days their
+// work may be moved within.
+constexpr const char* kTasksSql = R"sql(
+      WITH RECURSIVE subtree AS (
+        SELECT id, 0 AS depth FROM task WHERE id = $1::uuid
+        UNION ALL
+        SELECT t.id, s.depth + 1
+        FROM task t JOIN subtree s ON t.parent_task_id = s.id
+        WHERE s.depth < 256
+      )
+      SELECT t.id::text AS task_id,
+             array_position(enum_range(NULL::task_priority_enum),
+                            COALESCE(t.priority, 'normal')) - 1 AS priority,
+             COALESCE(t.start_date, DATE '1970-01-01' + $2::int)
+               - DATE '1970-01-01' AS first_day,
+             COALESCE(t.due_date, DATE '1970-01-01' + $3::int)
+               - DATE '1970-01-01' AS last_day
+      FROM task t JOIN subtree s ON s.id = t.id
+      WHERE t.status NOT IN ('completed', 'cancelled')
+    )sql";
+
+constexpr const char* kTeamSql = R"sql(
+      SELECT user_id::text AS user_id FROM project_allocation
+      WHERE project_id = $1::uuid
+      UNION
+      SELECT user_id::text FROM task_assignment
+      WHERE task_id = ANY($2::uuid[])
+    )sql";
+
+constexpr const char* kLimitsSql = R"sql(
+      SELECT user_id::text AS user_id,
+             COALESCE(weekday, -1) AS weekday,
+             round(hours_per_day * 60)::bigint AS minutes
+      FROM project_allocation
+      WHERE project_id = $1::uuid AND hours_per_day IS NOT NULL
+    )sql";
+
+constexpr const char* kWindowsSql = R"sql(
+      SELECT user_id::text AS user_id, weekday,
+             (EXTRACT(EPOCH FROM start_time) / 60)::int AS start_minute,
+             (EXTRACT(EPOCH FROM end_time) / 60)::int AS end_minute
+      FROM user_work_schedule
+      WHERE user_id = ANY($1::uuid[]) AND weekday IS NOT NULL
+    )sql";
+
+// Every block of the team in the horizon, also those of other projects:
+// they take time the team does not have for this one.
+constexpr const char* kBlocksSql = R"sql(
+      SELECT user_id::text AS user_id, task_id::text AS task_id,
+             floor(EXTRACT(EPOCH FROM start_ts) / 60)::bigint AS start_minute,
+             ceil(EXTRACT(EPOCH FROM end_ts) / 60)::bigint AS end_minute
+      FROM task_schedule
+      WHERE user_id = ANY($1::uuid[])
+        AND end_ts > to_timestamp($2::bigint * 60)
+        AND start_ts < to_timestamp($3::bigint * 60)
+    )sql";
+
+constexpr const char* kUpdateSql = R"sql(
+      UPDATE conflict_resolution c
+      SET payload = c.payload || jsonb_build_object('moves', m.moves)
+      FROM jsonb_to_recordset($1::jsonb) AS m(key text, moves jsonb)
+      WHERE c.payload->>'key' = m.key AND c.status = 'suggested'
+    )sql";
+
+}  // namespace
+
+RebalanceService::RebalanceService()
+    : latency_(metrics::registry().histogram(
+          "pc_rebalance_seconds",
+          "Time to load a project's team, solve the rebalancing and store "
+          "the moves")),
+      moves_(metrics::registry().counter(
+          "pc_rebalance_moves_total",
+          "Moves proposed for overallocated days")) {}
+
+drogon::Task<size_t> RebalanceService::rebalanceProject(
+    std::string projectId) {
+  metrics::ScopedTimer timer(latency_);
+  const engine::Minute now =
+      std::chrono::duration_cast<std::chrono::minutes>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count();
+  const int64_t today = now / engine::kMinutesPerDay;
+  const int64_t endDay = today + kHorizonDays;
+
+  auto& pool = db::reports();
+  auto taskRows = co_await pool.exec(kTasksSql, projectId, today, endDay - 1);
+  std::unordered_map<std::string, uint32_t> taskIndex;
+  std::vector<std::string> taskIds;
+  std::vector<engine::RebalanceTask> tasks;
+  db::ArrayLiteral taskLiteral;
+  for (const auto& row : taskRows) {
+    auto id = row["task_id"].as<std::string>();
+    taskLiteral.add(id);
+    taskIndex.emplace(id, static_cast<uint32_t>(tasks.size()));
+    taskIds.push_back(std::move(id));
+    tasks.push_back({row["priority"].as<int>(),
+                     row["first_day"].as<int64_t>(),
+                     row["last_day"].as<int64_t>()});
+  }
+  if (tasks.empty()) co_return 0;
+  const std::string taskArray = taskLiteral.release();
+
+  auto teamRows = co_await pool.exec(kTeamSql, projectId, taskArray);
+  std::unordered_map<std::string, uint32_t> userIndex;
+  std::vector<std::string> userIds;
+  db::ArrayLiteral userLiteral;
+  for (const auto& row : teamRows) {
+    auto id = row["user_id"].as<std::string>();
+    userLiteral.add(id);
+    userIndex.emplace(id, static_cast<uint32_t>(userIds.size()));
+    userIds.push_back(std::move(id));
+  }
+  if (userIds.empty()) co_return 0;
+  const std::string userArray = userLiteral.release();
+
+  auto limitRows = co_await pool.exec(kLimitsSql, projectId);
+  auto windowRows = co_await pool.exec(kWindowsSql, userArray);
+  auto blockRows =
+      co_await pool.exec(kBlocksSql, userArray, today * engine::kMinutesPerDay,
+                         endDay * engine::kMinutesPerDay);
+
+  struct Member {
+    std::vector<engine::WorkWindow> windows;
+    std::vector<std::pair<int, engine::Minute>> limits;  // weekday, minutes
+    std::vector<engine::Interval> busy;
+    // Project minutes per day of the horizon, by task.
+    std::vector<std::map<uint32_t, engine::Minute>> booked;
+  };
+  std::vector<Member> team(userIds.size());
+  for (const auto& row : limitRows) {
+    const auto it = userIndex.find(row["user_id"].as<std::string>());
+    if (it != userIndex.end())
+      team[it->second].limits.emplace_back(row["weekday"].as<int>(),
+                                           row["minutes"].as<int64_t>());
+  }
+  for (const auto& row : windowRows)
+    team[userIndex.at(row["user_id"].as<std::string>())].windows.push_back(
+        {row["weekday"].as<int>(), row["start_minute"].as<int>(),
+         row["end_minute"].as<int>()});
+  for (const auto& row : blockRows) {
+    auto& member = team[userIndex.at(row["user_id"].as<std::string>())];
+    const engine::Interval block{row["start_minute"].as<int64_t>(),
+                                 row["end_minute"].as<int64_t>()};
+    member.busy.push_back(block);
+    const auto task = taskIndex.find(row["task_id"].as<std::string>());
+    if (task == taskIndex.end()) continue;
+    member.booked.resize(kHorizonDays);
+    for (int64_t day = std::max(today, block.start / engine::kMinutesPerDay);
+         day < endDay && day * engine::kMinutesPerDay < block.end; ++day) {
+      const engine::Minute from =
+          std::max(block.start, day * engine::kMinutesPerDay);
+      const engine::Minute to =
+          std::min(block.end, (day + 1) * engine::kMinutesPerDay);
+      if (to > from)
+        member.booked[static_cast<size_t>(day - today)][task->second] +=
+            to - from;
+    }
+  }
+
+  std::vector<engine::Overload> overloads;
+  std::vector<engine::Spare> spare;
+  std::vector<engine::Interval> slots;
+  for (uint32_t u = 0; u < team.size(); ++u) {
+    auto& member = team[u];
+    std::sort(member.busy.begin(), member.busy.end(),
+              [](const auto& a, const auto& b) { return a.start < b.start; });
+    engine::UserCalendar calendar(member.windows);
+    calendar.addBusy(member.busy);
+    for (int64_t day = today; day < endDay; ++day) {
+      const int weekday = engine::weekdayOf(day);
+      engine::Minute limit = 0;
+      bool limited = false;
+      for (const auto& [w, minutes] : member.limits) {
+        if (w != -1 && w != weekday) continue;
+        limit += minutes;
+        limited = true;
+      }
+      engine::Minute booked = 0;
+      std::vector<engine::TaskShare> shares;
+      if (!member.booked.empty())
+        for (const auto& [task, minutes] :
+             member.booked[static_cast<size_t>(day - today)]) {
+          booked += minutes;
+          shares.push_back({task, minutes});
+        }
+      if (limited && booked > limit) {
+        overloads.push_back({u, day, booked - limit, std::move(shares)});
+        continue;
+      }
+      if (!calendar.hasWindows()) continue;
+      slots.clear();
+      engine::Minute free = calendar.freeSlots(
+          std::max(now, day * engine::kMinutesPerDay),
+          (day + 1) * engine::kMinutesPerDay, slots);
+      if (limited) free = std::min(free, limit - booked);
+      if (free > 0) spare.push_back({u, day, free});
+    }
+  }
+  if (overloads.empty()) co_return 0;
+
+  const auto moves = engine::rebalance(tasks, overloads, spare);
+  moves_.inc(moves.size());
+
+  std::map<std::pair<uint32_t, int64_t>, std::vector<const engine::Move*>>
+      byOverload;
+  for (const auto& over : overloads) byOverload[{over.user, over.day}];
+  for (const auto& move : moves)
+    byOverload[{move.fromUser, move.fromDay}].push_back(&move);
+
+  serialization::JsonWriter out(64 * overloads.size() + 192 * moves.size() +
+                                2);
+  out.beginArray();
+  for (const auto& [source, list] : byOverload) {
+    const std::string& userId = userIds[source.first];
+    const std::string date = engine::formatDay(source.second);
+    out.beginObject();
+    out.key("key");
+    out.string("daily_hours:" + userId + ':' + projectId + ':' + date);
+    out.key("moves");
+    out.beginArray();
+    for (const auto* move : list) {
+      out.beginObject();
+      out.key("task_id");
+      out.string(taskIds[move->task]);
+      out.key("from_user_id");
+      out.string(userId);
+      out.key("from_date");
+      out.string(date);
+      out.key("to_user_id");
+      out.string(userIds[move->toUser]);
+      out.key("to_date");
+      out.string(engine::formatDay(move->toDay));
+      out.key("hours");
+      out.raw(db::formatHours(move->minutes / 60.0));
+      out.endObject();
+    }
+    out.endArray();
+    out.endObject();
+  }
+  out.endArray();
+
+  const auto result = co_await db::oltp().exec(kUpdateSql, out.release());
+  LOG_DEBUG << "Rebalanced project " << projectId << ": " << moves.size()
+            << " moves for " << overloads.size() << " overloaded days";
+  co_return result.affectedRows();
+}
+
+RebalanceService& rebalancing() {
+  static RebalanceService service;
+  return service;
+}
+
+}  // namespace services
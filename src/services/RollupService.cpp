@@ -0,0 +1,187 @@
+#include "services/RollupService.hpp"
+
+#include <drogon/drogon.h>
+#include <trantor/utils/Logger.h>
+
+#include <cmath>
+#include <exception>
+
+#include "db/Literals.hpp"
+#include "db/Pools.hpp"
+
+namespace services {
+
+namespace {
+
+// Each delta row goes to its task and every ancestor, summed per task.
+constexpr const char* kAddSql = R"sql(
+      INSERT INTO task_rollup_delta
+        (task_id, estimated_hours, assigned_hours, scheduled_hours)
+      SELECT c.ancestor, sum(x.e), sum(x.a), sum(x.s)
+      FROM unnest($1::uuid[], $2::numeric[], $3::numeric[], $4::numeric[])
+           AS x(id, e, a, s)
+      JOIN task_closure c ON c.descendant = x.id
+      GROUP BY c.ancestor
+    )sql";
+
+constexpr const char* kSeedSql = R"sql(
+      INSERT INTO task_rollup AS r
+        (task_id, estimated_hours, assigned_hours, scheduled_hours)
+      SELECT * FROM unnest($1::uuid[], $2::numeric[], $3::numeric[],
+                           $4::numeric[])
+      ON CONFLICT (task_id) DO UPDATE SET
+        estimated_hours = r.estimated_hours + EXCLUDED.estimated_hours,
+        assigned_hours = r.assigned_hours + EXCLUDED.assigned_hours,
+        scheduled_hours = r.scheduled_hours + EXCLUDED.scheduled_hours
+    )sql";
+
+// The current totals of $1 times $2, added to each strict ancestor.
+constexpr const char* kShiftSql = R"sql(
+      WITH total AS (
+        SELECT sum(estimated_hours) AS e, sum(assigned_hours) AS a,
+               sum(scheduled_hours) AS s
+        FROM (
+          SELECT estimated_hours, assigned_hours, scheduled_hours
+          FROM task_rollup WHERE task_id = $1::uuid
+          UNION ALL
+          SELECT estimated_hours, assigned_hours, scheduled_hours
+          FROM task_rollup_delta WHERE task_id = $1::uuid
+        ) x
+      )
+      INSERT INTO task_rollup_delta
+        (task_id, estimated_hours, assigned_hours, scheduled_hours)
+      SELECT c.ancestor, $2::int * total.e, $2::int * total.a,
+             $2::int * total.s
+      FROM task_closure c, total
+      WHERE c.descendant = $1::uuid AND c.depth > 0 AND total.e IS NOT NULL
+    )sql";
+
+// Oldest deltas first; rows another folder holds are left to it.
+constexpr const char* kFoldSql = R"sql(
+      WITH moved AS (
+        DELETE FROM task_rollup_delta
+        WHERE id IN (SELECT id FROM task_rollup_delta ORDER BY id
+                     LIMIT $1::int FOR UPDATE SKIP LOCKED)
+        RETURNING task_id, estimated_hours, assigned_hours, scheduled_hours
+      ), folded AS (
+        INSERT INTO task_rollup AS r
+          (task_id, estimated_hours, assigned_hours, scheduled_hours)
+        SELECT task_id, sum(estimated_hours), sum(assigned_hours),
+               sum(scheduled_hours)
+        FROM moved GROUP BY task_id
+        ON CONFLICT (task_id) DO UPDATE SET
+          estimated_hours = r.estimated_hours + EXCLUDED.estimated_hours,
+          assigned_hours = r.assigned_hours + EXCLUDED.assigned_hours,
+          scheduled_hours = r.scheduled_hours + EXCLUDED.scheduled_hours
+      )
+      SELECT count(*) AS folded FROM moved
+    )sql";
+
+// Queues `sql` with the deltas as four arrays, unless none is left.
+void addDeltas(db::Pipeline& writes, const char* sql,
+               const std::vector<RollupDelta>& deltas) {
+  db::ArrayLiteral ids, estimated, assigned, scheduled;
+  for (const auto& d : deltas) {
+    // Below the columns' precision.
+    if (std::abs(d.estimatedHours) < 0.005 &&
+        std::abs(d.assignedHours) < 0.005 &&
+        std::abs(d.scheduledHours) < 0.005)
+      continue;
+    ids.add(d.taskId);
+    estimated.add(db::formatHours(d.estimatedHours));
+    assigned.add(db::formatHours(d.assignedHours));
+    scheduled.add(db::formatHours(d.scheduledHours));
+  }
+  if (ids.empty()) return;
+  writes.add(sql, ids.release(), estimated.release(), assigned.release(),
+             scheduled.release());
+}
+
+}  // namespace
+
+const char* const RollupService::kCurrentSql = R"sql(
+    LEFT JOIN LATERAL (
+      SELECT COALESCE(sum(x.estimated_hours), 0) AS subtree_estimated_hours,
+             COALESCE(sum(x.assigned_hours), 0) AS subtree_assigned_hours,
+             COALESCE(sum(x.scheduled_hours), 0) AS subtree_scheduled_hours
+      FROM (
+        SELECT estimated_hours, assigned_hours, scheduled_hours
+        FROM task_rollup WHERE task_id = t.id
+        UNION ALL
+        SELECT estimated_hours, assigned_hours, scheduled_hours
+        FROM task_rollup_delta WHERE task_id = t.id
+      ) x
+    ) ru ON true
+)sql";
+
+RollupService::RollupService()
+    : foldLatency_(metrics::registry().histogram(
+          "pc_rollup_fold_seconds",
+          "Time to fold one batch of subtree deltas into task_rollup")),
+      folded_(metrics::registry().counter(
+          "pc_rollup_deltas_folded_total",
+          "Subtree deltas folded into task_rollup")),
+      failures_(metrics::registry().counter(
+          "pc_rollup_fold_failures_total",
+          "Rollup folds that failed and were left for the next round")) {}
+
+void RollupService::start(double intervalSeconds, size_t batch) {
+  batch_ = batch;
+  drogon::app().registerBeginningAdvice([this, intervalSeconds] {
+    drogon::app().getLoop()->runEvery(intervalSeconds, [this] {
+      drogon::async_run([this]() -> drogon::Task<> { co_await drain(); });
+    });
+  });
+}
+
+void RollupService::add(db::Pipeline& writes,
+                        const std::vector<RollupDelta>& deltas) {
+  addDeltas(writes, kAddSql, deltas);
+}
+
+void RollupService::seed(db::Pipeline& writes,
+                         const std::vector<RollupDelta>& totals) {
+  addDeltas(writes, kSeedSql, totals);
+}
+
+void RollupService::detach(db::Pipeline& writes, const std::string& taskId) {
+  writes.add(kShiftSql, taskId, std::string("-1"));
+}
+
+void RollupService::attach(db::Pipeline& writes, const std::string& taskId) {
+  writes.add(kShiftSql, taskId, std::string("1"));
+}
+
+drogon::Task<size_t> RollupService::fold() {
+  metrics::ScopedTimer timer(foldLatency_);
+  auto rows = co_await db::oltp().exec(kFoldSql, std::to_string(batch_));
+  const auto count = static_cast<size_t>(rows[0]["folded"].as<int64_t>());
+  folded_.inc(count);
+  co_return count;
+}
+
+drogon::Task<> RollupService::drain() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (draining_) co_return;
+    draining_ = true;
+  }
+  try {
+    while (co_await fold() >= batch_) {
+    }
+  } catch (const std::exception& e) {
+    // Deltas of a task deleted mid-fold fail the batch; the cascade has
+    // removed them by the next round.
+    failures_.inc();
+    LOG_WARN << "Folding rollup deltas failed: " << e.what();
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  draining_ = false;
+}
+
+RollupService& rollups() {
+  static RollupService service;
+  return service;
+}
+
+}  // namespace services
@@ -0,0 +1,434 @@
+#include "services/SchedulingService.hpp"
+
+#include <trantor/utils/Logger.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+#include <utility>
+
+#include "db/Literals.hpp"
+#include "db/Transaction.hpp"
+#include "engine/Scheduler.hpp"
+#include "services/AvailabilityService.hpp"
+#include "services/ConflictService.hpp"
+#include "services/RollupService.hpp"
+#include "services/SimulationService.hpp"
+
+namespace services {
+
+namespace {
+
+// Assignments of a task and all of its subtasks. Work is never placed in
+// the past, so ranges start no earlier than today.
+constexpr const char* kTaskTreeAssignmentsSql = R"sql(
+      WITH RECURSIVE scope AS (
+        SELECT id FROM task WHERE id = $1::uuid
+        UNION ALL
+        SELECT t.id FROM task t JOIN scope s ON t.parent_task_id = s.id
+      )
+      SELECT a.task_id::text AS task_id,
+             a.user_id::text AS user_id,
+             a.assigned_hours::float8 AS hours,
+             GREATEST(t.start_date, CURRENT_DATE) - DATE '1970-01-01'
+               AS start_day,
+             t.due_date - DATE '1970-01-01' AS due_day,
+             array_position(enum_range(NULL::task_priority_enum),
+                            COALESCE(t.priority, 'normal')) - 1 AS priority,
+             CURRENT_DATE - DATE '1970-01-01' AS today
+      FROM scope s
+      JOIN task t ON t.id = s.id
+      JOIN task_assignment a ON a.task_id = t.id
+      WHERE a.assigned_hours > 0
+        AND t.start_date IS NOT NULL
+        AND t.due_date IS NOT NULL
+        AND t.status NOT IN ('completed', 'cancelled')
+    )sql";
+
+// Assignments of one task that were auto-scheduled before. Assignments the
+// planner never touched are left for an explicit auto-schedule run.
+constexpr const char* kTaskAssignmentsSql = R"sql(
+      SELECT a.task_id::text AS task_id,
+             a.user_id::text AS user_id,
+             a.assigned_hours::float8 AS hours,
+             GREATEST(t.start_date, CURRENT_DATE) - DATE '1970-01-01'
+               AS start_day,
+             t.due_date - DATE '1970-01-01' AS due_day,
+             array_position(enum_range(NULL::task_priority_enum),
+                            COALESCE(t.priority, 'normal')) - 1 AS priority,
+             CURRENT_DATE - DATE '1970-01-01' AS today
+      FROM task t
+      JOIN task_assignment a ON a.task_id = t.id
+      WHERE t.id = $1::uuid
+        AND a.assigned_hours > 0
+        AND t.start_date IS NOT NULL
+        AND t.due_date IS NOT NULL
+        AND t.status NOT IN ('completed', 'cancelled')
+        AND EXISTS (SELECT 1 FROM task_schedule ts
+                    WHERE ts.task_id = a.task_id AND ts.user_id = a.user_id
+                      AND ts.auto_placed)
+    )sql";
+
+// Auto-scheduled assignments of one user that are not overdue yet.
+constexpr const char* kUserAssignmentsSql = R"sql(
+      SELECT a.task_id::text AS task_id,
+             a.user_id::text AS user_id,
+             a.assigned_hours::float8 AS hours,
+             GREATEST(t.start_date, CURRENT_DATE) - DATE '1970-01-01'
+               AS start_day,
+             t.due_date - DATE '1970-01-01' AS due_day,
+             array_position(enum_range(NULL::task_priority_enum),
+                            COALESCE(t.priority, 'normal')) - 1 AS priority,
+             CURRENT_DATE - DATE '1970-01-01' AS today
+      FROM task_assignment a
+      JOIN task t ON t.id = a.task_id
+      WHERE a.user_id = $1::uuid
+        AND a.assigned_hours > 0
+        AND t.start_date IS NOT NULL
+        AND t.due_date >= CURRENT_DATE
+        AND t.status NOT IN ('completed', 'cancelled')
+        AND EXISTS (SELECT 1 FROM task_schedule ts
+                    WHERE ts.task_id = a.task_id AND ts.user_id = a.user_id
+                      AND ts.auto_placed)
+    )sql";
+
+// Other auto-scheduled assignments of the batch's users with blocks from
+// today to the batch's last day, whose task ranks below the most important
+// batch work of that user ($2, aligned with $1). Tasks on either side of a
+// finish-to-start dependency are left out: moving them could break the
+// order against tasks outside the batch.
+constexpr const char* kDisplaceableSql = R"sql(
+      SELECT DISTINCT a.task_id::text AS task_id,
+             a.user_id::text AS user_id,
+             a.assigned_hours::float8 AS hours,
+             GREATEST(t.start_date, CURRENT_DATE) - DATE '1970-01-01'
+               AS start_day,
+             t.due_date - DATE '1970-01-01' AS due_day,
+             array_position(enum_range(NULL::task_priority_enum),
+                            COALESCE(t.priority, 'normal')) - 1 AS priority
+      FROM unnest($1::uuid[], $2::int[]) AS b(user_id, priority)
+      JOIN task_schedule ts ON ts.user_id = b.user_id AND ts.auto_placed
+      JOIN task_assignment a
+        ON a.task_id = ts.task_id AND a.user_id = ts.user_id
+      JOIN task t ON t.id = a.task_id
+      WHERE ts.end_ts > to_timestamp($3::bigint * 86400)
+        AND ts.start_ts < to_timestamp(($4::bigint + 1) * 86400)
+        AND array_position(enum_range(NULL::task_priority_enum),
+                           COALESCE(t.priority, 'normal')) - 1 < b.priority
+        AND a.assigned_hours > 0
+        AND t.start_date IS NOT NULL
+        AND t.due_date >= CURRENT_DATE
+        AND t.status NOT IN ('completed', 'cancelled')
+        AND NOT EXISTS (
+          SELECT 1 FROM task_dependency d
+          WHERE COALESCE(d.kind, 'finish_start') = 'finish_start'
+            AND (d.task_id = t.id OR d.depends_on_id = t.id))
+    )sql";
+
+std::string assignmentKey(std::string_view taskId, std::string_view userId) {
+  std::string key;
+  key.reserve(taskId.size() + userId.size() + 1);
+  key.append(taskId).append(1, '|').append(userId);
+  return key;
+}
+
+}  // namespace
+
+SchedulingService::SchedulingService()
+    : runLatency_(metrics::registry().histogram(
+          "pc_scheduler_run_seconds",
+          "Time to load, place and write back one auto-scheduling run")),
+      blocksPlaced_(metrics::registry().counter(
+          "pc_scheduler_blocks_placed_total",
+          "Schedule blocks written by the auto-scheduler")),
+      taskReschedules_(metrics::registry().counter(
+          "pc_scheduler_reschedules_total",
+          "Incremental re-placements after a change", "trigger=\"task\"")),
+      userReschedules_(metrics::registry().counter(
+          "pc_scheduler_reschedules_total",
+          "Incremental re-placements after a change",
+          "trigger=\"work_schedule\"")) {}
+
+drogon::Task<ScheduleReport> SchedulingService::scheduleTaskTree(
+    std::string rootTaskId) {
+  co_return co_await run(kTaskTreeAssignmentsSql, std::move(rootTaskId));
+}
+
+drogon::Task<ScheduleReport> SchedulingService::rescheduleTask(
+    std::string taskId) {
+  taskReschedules_.inc();
+  co_return co_await run(kTaskAssignmentsSql, std::move(taskId));
+}
+
+drogon::Task<ScheduleReport> SchedulingService::rescheduleUser(
+    std::string userId) {
+  userReschedules_.inc();
+  co_return co_await run(kUserAssignmentsSql, std::move(userId));
+}
+
+drogon::Task<ScheduleReport> SchedulingService::run(std::string selectSql,
+                                                    std::string param) {
+  metrics::ScopedTimer timer(runLatency_);
+  ScheduleReport report;
+
+  auto tx = co_await db::Tx::begin(db::oltp());
+  co_await tx.client()->execSqlCoro(
+      "SELECT pg_advisory_xact_lock(hashtext('task_schedule.auto'))");
+
+  auto rows = co_await tx.client()->execSqlCoro(selectSql, param);
+  if (rows.empty()) {
+    co_await tx.commit();
+    co_return report;
+  }
+
+  engine::AutoScheduler scheduler;
+  std::unordered_map<std::string, size_t> userIndex;
+  std::unordered_map<std::string, size_t> assignmentIndex;
+  std::vector<engine::AutoScheduler::Assignment> assignments;
+  std::vector<std::pair<std::string, std::string>> ids;  // task, user
+  std::unordered_map<std::string, std::vector<size_t>> tasksById;
+  db::ArrayLiteral users, tasks, taskUsers;
+  // Blocks before today are history: they are never moved and count towards
+  // the hours of their assignment whether placed by hand or not.
+  const int64_t today = rows[0]["today"].as<int64_t>();
+  int64_t lastDay = std::numeric_limits<int64_t>::min();
+
+  auto addAssignment = [&](const drogon::orm::Row& row) {
+    auto taskId = row["task_id"].as<std::string>();
+    auto userId = row["user_id"].as<std::string>();
+    auto [it, added] = userIndex.try_emplace(userId, userIndex.size());
+    if (added) users.add(userId);
+
+    engine::AutoScheduler::Assignment a;
+    a.user = it->second;
+    a.startDay = row["start_day"].as<int64_t>();
+    a.dueDay = row["due_day"].as<int64_t>();
+    a.minutes = std::llround(row["hours"].as<double>() * 60.0);
+    a.priority = row["priority"].as<int>();
+    lastDay = std::max(lastDay, a.dueDay);
+    tasksById[taskId].push_back(assignments.size());
+
+    assignmentIndex.emplace(assignmentKey(taskId, userId), assignments.size());
+    tasks.add(taskId);
+    taskUsers.add(userId);
+    assignments.push_back(a);
+    ids.emplace_back(std::move(taskId), std::move(userId));
+  };
+  assignments.reserve(rows.size());
+  ids.reserve(rows.size());
+  for (const auto& row : rows) addAssignment(row);
+  const std::string userArray = users.release();
+
+  // Blocks earlier runs gave to less important work are only movable when
+  // that work is in the batch, so it joins the batch: the engine places it
+  // after the more urgent work, in whatever time is left.
+  size_t displaced = 0;
+  if (today <= lastDay) {
+    std::vector<int> top(userIndex.size(), std::numeric_limits<int>::min());
+    for (const auto& a : assignments)
+      top[a.user] = std::max(top[a.user], a.priority);
+    db::ArrayLiteral priorities;
+    for (const int p : top) priorities.add(std::to_string(p));
+    auto displaceable = co_await tx.client()->execSqlCoro(
+        kDisplaceableSql, userArray, priorities.release(),
+        std::to_string(today), std::to_string(lastDay));
+    for (const auto& row : displaceable) {
+      if (assignmentIndex.count(assignmentKey(
+              row["task_id"].as<std::string>(),
+              row["user_id"].as<std::string>())))
+        continue;
+      addAssignment(row);
+      ++displaced;
+    }
+  }
+  const std::string taskArray = tasks.release();
+  const std::string pairUsers = taskUsers.release();
+
+  // Work on a task waits for the finish-to-start dependencies inside the
+  // batch to be placed.
+  auto dependencyRows = co_await tx.client()->execSqlCoro(
+      R"sql(
+      SELECT task_id::text AS task_id, depends_on_id::text AS depends_on_id
+      FROM task_dependency
+      WHERE task_id = ANY($1::uuid[]) AND depends_on_id = ANY($1::uuid[])
+        AND COALESCE(kind, 'finish_start') = 'finish_start'
+    )sql",
+      taskArray);
+  for (const auto& row : dependencyRows) {
+    const auto& before = tasksById.at(row["depends_on_id"].as<std::string>());
+    for (const size_t i : tasksById.at(row["task_id"].as<std::string>()))
+      assignments[i].after.insert(assignments[i].after.end(), before.begin(),
+                                  before.end());
+  }
+
+  // Users are added in index order so engine indices match userIndex.
+  std::vector<std::vector<engine::WorkWindow>> windows(userIndex.size());
+  auto windowRows = co_await tx.client()->execSqlCoro(
+      R"sql(
+      SELECT user_id::text AS user_id, weekday,
+             (EXTRACT(EPOCH FROM start_time) / 60)::int AS start_minute,
+             (EXTRACT(EPOCH FROM end_time) / 60)::int AS end_minute
+      FROM user_work_schedule
+      WHERE user_id = ANY($1::uuid[]) AND weekday IS NOT NULL
+    )sql",
+      userArray);
+  for (const auto& row : windowRows) {
+    const auto u = userIndex.find(row["user_id"].as<std::string>());
+    if (u == userIndex.end()) continue;
+    windows[u->second].push_back({row["weekday"].as<int>(),
+                                  row["start_minute"].as<int>(),
+                                  row["end_minute"].as<int>()});
+  }
+  for (const auto& w : windows) scheduler.addUser(w);
+
+  auto doneRows = co_await tx.client()->execSqlCoro(
+      R"sql(
+      SELECT ts.task_id::text AS task_id, ts.user_id::text AS user_id,
+             sum(ceil(EXTRACT(EPOCH FROM ts.end_ts - ts.start_ts) / 60))::bigint
+               AS minutes
+      FROM task_schedule ts
+      JOIN unnest($1::uuid[], $2::uuid[]) AS x(task_id, user_id)
+        ON ts.task_id = x.task_id AND ts.user_id = x.user_id
+      WHERE ts.start_ts < to_timestamp($3::bigint * 86400)
+      GROUP BY ts.task_id, ts.user_id
+    )sql",
+      taskArray, pairUsers, std::to_string(today));
+  for (const auto& row : doneRows) {
+    const auto owned = assignmentIndex.find(assignmentKey(
+        row["task_id"].as<std::string>(), row["user_id"].as<std::string>()));
+    if (owned != assignmentIndex.end())
+      assignments[owned->second].minutes -= row["minutes"].as<int64_t>();
+  }
+
+  // Existing blocks from today to the last due date. Auto-placed blocks of
+  // the assignments being scheduled are replaced; everything else is busy
+  // time, and manual blocks of an assignment count towards its hours. Only
+  // the calendars of the affected users inside this window are read, so a
+  // re-placement costs what the change touches, not the whole calendar.
+  if (today <= lastDay) {
+    auto busyRows = co_await tx.client()->execSqlCoro(
+        R"sql(
+        SELECT task_id::text AS task_id, user_id::text AS user_id,
+               floor(EXTRACT(EPOCH FROM start_ts) / 60)::bigint AS start_minute,
+               ceil(EXTRACT(EPOCH FROM end_ts) / 60)::bigint AS end_minute,
+               COALESCE(auto_placed, true) AS auto_placed
+        FROM task_schedule
+        WHERE user_id = ANY($1::uuid[])
+          AND end_ts > to_timestamp($2::bigint * 86400)
+          AND start_ts < to_timestamp(($3::bigint + 1) * 86400)
+      )sql",
+        userArray, std::to_string(today), std::to_string(lastDay));
+    for (const auto& row : busyRows) {
+      const auto userId = row["user_id"].as<std::string>();
+      const auto key = assignmentKey(row["task_id"].as<std::string>(), userId);
+      const auto owned = assignmentIndex.find(key);
+      const bool autoPlaced = row["auto_placed"].as<bool>();
+      const engine::Interval block{row["start_minute"].as<int64_t>(),
+                                   row["end_minute"].as<int64_t>()};
+      const bool history = block.start < today * engine::kMinutesPerDay;
+      if (owned != assignmentIndex.end() && autoPlaced && !history) continue;
+
+      scheduler.user(userIndex.at(userId)).addBusy(block);
+      // History was already credited above.
+      if (owned != assignmentIndex.end() && !history)
+        assignments[owned->second].minutes -= block.length();
+    }
+  }
+
+  const auto placed = scheduler.place(assignments);
+
+  db::ArrayLiteral blockTasks, blockUsers, blockStarts, blockEnds, blockHours;
+  for (const auto& b : placed.blocks) {
+    blockTasks.add(ids[b.assignment].first);
+    blockUsers.add(ids[b.assignment].second);
+    blockStarts.add(std::to_string(b.slot.start));
+    blockEnds.add(std::to_string(b.slot.end));
+    blockHours.add(db::formatHours(b.slot.length() / 60.0));
+  }
+
+  db::Pipeline writes;
+  writes.add(
+      R"sql(
+      DELETE FROM task_schedule ts
+      USING unnest($1::uuid[], $2::uuid[]) AS x(task_id, user_id)
+      WHERE ts.task_id = x.task_id AND ts.user_id = x.user_id
+        AND ts.auto_placed
+        AND ts.start_ts >= to_timestamp($3::bigint * 86400)
+      RETURNING ts.user_id::text AS user_id,
+                floor(EXTRACT(EPOCH FROM ts.start_ts) / 60)::bigint
+                  AS start_minute,
+                ceil(EXTRACT(EPOCH FROM ts.end_ts) / 60)::bigint AS end_minute,
+                ts.task_id::text AS task_id, ts.hours::float8 AS hours
+    )sql",
+      taskArray, pairUsers, std::to_string(today));
+  if (!placed.blocks.empty())
+    writes.add(
+        R"sql(
+        INSERT INTO task_schedule
+          (task_id, user_id, start_ts, end_ts, hours, auto_placed)
+        SELECT x.task_id, x.user_id, to_timestamp(x.start_minute * 60),
+               to_timestamp(x.end_minute * 60), x.hours, true
+        FROM unnest($1::uuid[], $2::uuid[], $3::bigint[], $4::bigint[],
+                    $5::numeric[])
+             AS x(task_id, user_id, start_minute, end_minute, hours)
+      )sql",
+        blockTasks.release(), blockUsers.release(), blockStarts.release(),
+        blockEnds.release(), blockHours.release());
+  const auto written = co_await writes.run(tx.client());
+
+  // Net change of each task's scheduled hours, one delta per task.
+  std::unordered_map<std::string, double> scheduled;
+  for (const auto& row : written[0])
+    scheduled[row["task_id"].as<std::string>()] -= row["hours"].as<double>();
+  for (const auto& b : placed.blocks)
+    scheduled[ids[b.assignment].first] +=
+        static_cast<double>(b.slot.length()) / 60.0;
+  std::vector<RollupDelta> deltas;
+  deltas.reserve(scheduled.size());
+  for (const auto& [taskId, hours] : scheduled)
+    deltas.push_back({taskId, 0, 0, hours});
+  db::Pipeline rollup;
+  rollups().add(rollup, deltas);
+  co_await rollup.run(tx.client());
+  co_await tx.commit();
+
+  // Keep the users' free-slot indexes in step with the rewrite.
+  std::vector<std::vector<engine::Interval>> removed(userIndex.size()),
+      added(userIndex.size());
+  for (const auto& row : written[0]) {
+    const auto u = userIndex.find(row["user_id"].as<std::string>());
+    if (u == userIndex.end()) continue;
+    removed[u->second].push_back({row["start_minute"].as<int64_t>(),
+                                  row["end_minute"].as<int64_t>()});
+  }
+  for (const auto& b : placed.blocks)
+    added[assignments[b.assignment].user].push_back(b.slot);
+  for (const auto& [userId, u] : userIndex) {
+    if (!removed[u].empty() || !added[u].empty())
+      availability().blocksChanged(userId, removed[u], added[u]);
+    conflicts().markDirty(userId);
+  }
+  simulations().changed();
+
+  report.assignments = assignments.size();
+  report.blocks = placed.blocks.size();
+  for (size_t i = 0; i < placed.unplaced.size(); ++i) {
+    if (placed.unplaced[i] <= 0) continue;
+    report.unplaced.push_back({ids[i].first, ids[i].second,
+                               static_cast<double>(placed.unplaced[i]) / 60.0});
+  }
+  blocksPlaced_.inc(report.blocks);
+  LOG_DEBUG << "Auto-scheduled " << report.assignments << " assignments into "
+            << report.blocks << " blocks, " << report.unplaced.size()
+            << " short, " << displaced << " displaced from earlier runs, "
+            << placed.preempted << " blocks pre-empted";
+  co_return report;
+}
+
+SchedulingService& scheduling() {
+  static SchedulingService service;
+  return service;
+}
+
+}  // namespace services
@@ -0,0 +1,236 @@
+#include "services/SimulationService.hpp"
+
+#include <trantor/utils/Logger.h>
+
+#include <algorithm>
+#include <cmath>
+#include <optional>
+#include <string_view>
+
+#include "db/Literals.hpp"
+#include "db/Pools.hpp"
+#include "services/DependencyService.hpp"
+
+namespace services {
+
+namespace {
+
+// Plans kept in memory; the least recently used one is dropped beyond this.
+constexpr size_t kMaxPlans = 16;
+
+// The assignments an auto-schedule run of the project would place.
+constexpr const char* kAssignmentsSql = R"sql(
+      WITH RECURSIVE scope AS (
+        SELECT id FROM task WHERE id = $1::uuid
+        UNION ALL
+        SELECT t.id FROM task t JOIN scope s ON t.parent_task_id = s.id
+      )
+      SELECT a.task_id::text AS task_id,
+             a.user_id::text AS user_id,
+             a.assigned_hours::float8 AS hours,
+             GREATEST(t.start_date, CURRENT_DATE) - DATE '1970-01-01'
+               AS start_day,
+             t.due_date - DATE '1970-01-01' AS due_day,
+             array_position(enum_range(NULL::task_priority_enum),
+                            COALESCE(t.priority, 'normal')) - 1 AS priority,
+             CURRENT_DATE - DATE '1970-01-01' AS today
+      FROM scope s
+      JOIN task t ON t.id = s.id
+      JOIN task_assignment a ON a.task_id = t.id
+      WHERE a.assigned_hours > 0
+        AND t.start_date IS NOT NULL
+        AND t.due_date IS NOT NULL
+        AND t.status NOT IN ('completed', 'cancelled')
+    )sql";
+
+constexpr const char* kWindowsSql = R"sql(
+      SELECT user_id::text AS user_id, weekday,
+             (EXTRACT(EPOCH FROM start_time) / 60)::int AS start_minute,
+             (EXTRACT(EPOCH FROM end_time) / 60)::int AS end_minute
+      FROM user_work_schedule
+      WHERE user_id = ANY($1::uuid[]) AND weekday IS NOT NULL
+    )sql";
+
+// The assignees' blocks up to the last due date, and any earlier ones of
+// the project's own tasks, which count towards their hours.
+constexpr const char* kBlocksSql = R"sql(
+      SELECT task_id::text AS task_id, user_id::text AS user_id,
+             floor(EXTRACT(EPOCH FROM start_ts) / 60)::bigint AS start_minute,
+             ceil(EXTRACT(EPOCH FROM end_ts) / 60)::bigint AS end_minute,
+             COALESCE(auto_placed, true) AS auto_placed
+      FROM task_schedule
+      WHERE user_id = ANY($1::uuid[])
+        AND start_ts < to_timestamp(($2::bigint + 1) * 86400)
+        AND (end_ts > to_timestamp($3::bigint * 86400)
+             OR task_id = ANY($4::uuid[]))
+    )sql";
+
+std::string assignmentKey(std::string_view taskId, std::string_view userId) {
+  std::string key;
+  key.reserve(taskId.size() + userId.size() + 1);
+  key.append(taskId).append(1, '|').append(userId);
+  return key;
+}
+
+}  // namespace
+
+SimulationService::SimulationService()
+    : loadLatency_(metrics::registry().histogram(
+          "pc_simulation_baseline_load_seconds",
+          "Time to freeze a project's plan for what-if simulations")),
+      hits_(metrics::registry().counter(
+          "pc_simulation_baseline_cache_hits_total",
+          "Simulations that reused a frozen plan")),
+      misses_(metrics::registry().counter(
+          "pc_simulation_baseline_cache_misses_total",
+          "Simulations that froze the project's plan first")) {}
+
+drogon::Task<std::shared_ptr<const ProjectPlan>> SimulationService::plan(
+    std::string projectId) {
+  const auto root = engine::Uuid::parse(projectId);
+  if (!root) co_return nullptr;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = plans_.find(*root);
+    if (it != plans_.end()) {
+      it->second->lastUsed = ++clock_;
+      hits_.inc();
+      co_return it->second;
+    }
+  }
+  misses_.inc();
+  co_return co_await load(*root);
+}
+
+void SimulationService::changed() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ++generation_;
+  plans_.clear();
+}
+
+drogon::Task<std::shared_ptr<const ProjectPlan>> SimulationService::load(
+    engine::Uuid root) {
+  metrics::ScopedTimer timer(loadLatency_);
+  uint64_t generation;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    generation = generation_;
+  }
+
+  const std::string rootId = root.str();
+  const auto graph = co_await dependencies().project(rootId);
+  if (!graph) co_return nullptr;
+  std::optional<engine::CriticalPath> path;
+  std::vector<engine::Uuid> taskIds;
+  std::unordered_map<engine::Uuid, uint32_t, engine::UuidHash> taskIndex;
+  {
+    std::lock_guard<std::mutex> lock(graph->mutex);
+    path.emplace(graph->path);
+    taskIds = graph->ids;
+    taskIndex = graph->index;
+  }
+
+  auto& pool = db::reports();
+  auto rows = co_await pool.exec(kAssignmentsSql, rootId);
+  std::vector<engine::PlanAssignment> assignments;
+  std::unordered_map<std::string, size_t> assignmentIndex;
+  std::vector<std::string> userIds;
+  std::unordered_map<std::string, uint32_t> userIndex;
+  db::ArrayLiteral users, tasks;
+  int64_t today = 0, lastDay = 0;
+  for (const auto& row : rows) {
+    const auto taskId = row["task_id"].as<std::string>();
+    const auto id = engine::Uuid::parse(taskId);
+    const auto node = id ? taskIndex.find(*id) : taskIndex.end();
+    if (node == taskIndex.end()) continue;
+    auto userId = row["user_id"].as<std::string>();
+    const auto [user, added] = userIndex.try_emplace(
+        userId, static_cast<uint32_t>(userIds.size()));
+    if (added) {
+      users.add(userId);
+      userIds.push_back(userId);
+    }
+    engine::PlanAssignment a;
+    a.task = node->second;
+    a.user = user->second;
+    a.startDay = row["start_day"].as<int64_t>();
+    a.dueDay = row["due_day"].as<int64_t>();
+    a.minutes = std::llround(row["hours"].as<double>() * 60.0);
+    a.priority = row["priority"].as<int>();
+    today = row["today"].as<int64_t>();
+    lastDay = std::max(lastDay, a.dueDay);
+    assignmentIndex.emplace(assignmentKey(taskId, userId), assignments.size());
+    tasks.add(taskId);
+    assignments.push_back(a);
+  }
+  const std::string userArray = users.release();
+  const std::string taskArray = tasks.release();
+
+  std::vector<std::vector<engine::WorkWindow>> windows(userIds.size());
+  std::vector<std::vector<engine::Interval>> busy(userIds.size());
+  if (!assignments.empty()) {
+    auto windowRows = co_await pool.exec(kWindowsSql, userArray);
+    for (const auto& row : windowRows)
+      windows[userIndex.at(row["user_id"].as<std::string>())].push_back(
+          {row["weekday"].as<int>(), row["start_minute"].as<int>(),
+           row["end_minute"].as<int>()});
+
+    // Same rules as an auto-schedule run: auto-placed blocks of these
+    // assignments from today on are placed again, everything else is busy
+    // time, and history and manual blocks count towards the hours.
+    auto blockRows =
+        co_await pool.exec(kBlocksSql, userArray, lastDay, today, taskArray);
+    for (const auto& row : blockRows) {
+      const auto userId = row["user_id"].as<std::string>();
+      const auto owned = assignmentIndex.find(
+          assignmentKey(row["task_id"].as<std::string>(), userId));
+      const engine::Interval block{row["start_minute"].as<int64_t>(),
+                                   row["end_minute"].as<int64_t>()};
+      const bool mine = owned != assignmentIndex.end();
+      const bool history = block.start < today * engine::kMinutesPerDay;
+      if (mine && row["auto_placed"].as<bool>() && !history) continue;
+      if (mine) assignments[owned->second].minutes -= block.length();
+      if (block.end > today * engine::kMinutesPerDay)
+        busy[userIndex.at(userId)].push_back(block);
+    }
+  }
+
+  std::vector<std::shared_ptr<const engine::UserCalendar>> calendars;
+  calendars.reserve(userIds.size());
+  for (size_t u = 0; u < userIds.size(); ++u) {
+    auto calendar = std::make_shared<engine::UserCalendar>(windows[u]);
+    std::sort(busy[u].begin(), busy[u].end(),
+              [](const auto& a, const auto& b) { return a.start < b.start; });
+    calendar->addBusy(busy[u]);
+    calendars.push_back(std::move(calendar));
+  }
+
+  auto frozen = std::make_shared<ProjectPlan>(engine::PlanBaseline(
+      std::move(*path), std::move(assignments), std::move(calendars)));
+  frozen->taskIds = std::move(taskIds);
+  frozen->taskIndex = std::move(taskIndex);
+  frozen->userIds = std::move(userIds);
+  frozen->userIndex = std::move(userIndex);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  frozen->lastUsed = ++clock_;
+  if (generation != generation_) co_return frozen;
+  if (plans_.size() >= kMaxPlans) {
+    auto oldest = plans_.begin();
+    for (auto it = plans_.begin(); it != plans_.end(); ++it)
+      if (it->second->lastUsed < oldest->second->lastUsed) oldest = it;
+    plans_.erase(oldest);
+  }
+  plans_[root] = frozen;
+  LOG_DEBUG << "Plan of " << rootId << " frozen for simulations: "
+            << frozen->taskIds.size() << " tasks, "
+            << frozen->baseline.assignments().size() << " assignments";
+  co_return frozen;
+}
+
+SimulationService& simulations() {
+  static SimulationService service;
+  return service;
+}
+
+}  // namespace services
@@ -0,0 +1,86 @@
+#include "services/WorkerPool.hpp"
+
+#include <trantor/utils/Logger.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace services {
+
+WorkerPool::WorkerPool(const std::string& prefix, const std::string& what)
+    : prefix_(prefix),
+      what_(what),
+      queueDepth_(metrics::registry().gauge(
+          prefix + "_queue_depth", what + " jobs waiting for a worker")),
+      busy_(metrics::registry().gauge(prefix + "_busy_workers",
+                                      what + " workers currently busy")),
+      queueWait_(metrics::registry().histogram(
+          prefix + "_queue_wait_seconds",
+          what + " jobs: time waited for a worker")),
+      rejected_(metrics::registry().counter(
+          prefix + "_rejected_total",
+          what + " jobs refused because the queue was full")) {}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_all();
+  for (auto& t : workers_) t.join();
+}
+
+void WorkerPool::start(size_t workers, size_t queueLimit) {
+  workers = std::max<size_t>(1, workers);
+  queueLimit_ = queueLimit;
+  for (size_t i = 0; i < workers; ++i)
+    workers_.emplace_back([this] { workerLoop(); });
+
+  metrics::registry().gaugeFn(
+      prefix_ + "_workers", what_ + " worker threads", {},
+      [workers] { return static_cast<double>(workers); });
+}
+
+bool WorkerPool::tryEnqueue(std::function<void()> job) {
+  const auto queuedAt = std::chrono::steady_clock::now();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (queue_.size() >= queueLimit_ || workers_.empty()) {
+      rejected_.inc();
+      return false;
+    }
+    queue_.push_back([this, queuedAt, job = std::move(job)] {
+      queueWait_.observe(std::chrono::steady_clock::now() - queuedAt);
+      job();
+    });
+    queueDepth_.set(static_cast<int64_t>(queue_.size()));
+  }
+  wake_.notify_one();
+  return true;
+}
+
+int WorkerPool::retryAfterSeconds(double secondsPerJob) const {
+  const double backlog = static_cast<double>(queueDepth_.value()) /
+                         static_cast<double>(std::max<size_t>(1, workers()));
+  return std::max(1, static_cast<int>(std::ceil(backlog * secondsPerJob)));
+}
+
+void WorkerPool::workerLoop() {
+  for (;;) {
+    std::function<void()> job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wake_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+      if (stopping_ && queue_.empty()) return;
+      job = std::move(queue_.front());
+      queue_.pop_front();
+      queueDepth_.set(static_cast<int64_t>(queue_.size()));
+    }
+    busy_.add(1);
+    job();
+    busy_.add(-1);
+  }
+}
+
+}  // namespace services
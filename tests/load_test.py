@@ -0,0 +1,165 @@
+"""
+Load test for Project Calendar API
+Measures throughput and latency of read endpoints at increasing concurrency.
+
+Usage:
+    python3 load_test.py [--duration 10] [--levels 1,2,4,8,16,32,64]
+    python3 load_test.py --page-sizes 10,100,2000 [--samples 20]
+"""
+
+import argparse
+import statistics
+import threading
+import time
+import uuid
+from concurrent.futures import ThreadPoolExecutor
+import os
+
+import requests
+
+# Configuration
+BASE_URL = os.getenv("TEST_BASE_URL", "http://localhost:8081")
+API_PREFIX = "/api"
+
+
+def register_user(session: requests.Session) -> str:
+    """Register a throwaway user and return its token"""
+    user_data = {
+        "email": f"load_{uuid.uuid4().hex[:8]}@example.com",
+        "password": "LoadPassword123!",
+        "display_name": "Load User",
+        "work_schedule": [
+            {"weekday": d, "start_time": "09:00:00", "end_time": "18:00:00"}
+            for d in range(5)
+        ],
+    }
+    response = session.post(f"{BASE_URL}{API_PREFIX}/auth/register", json=user_data)
+    assert response.status_code == 201, f"Registration failed: {response.text}"
+    return response.json()["token"]
+
+
+def seed_tasks(session: requests.Session, headers: dict, count: int):
+    """Create tasks so that read endpoints return non-trivial payloads"""
+    for i in range(count):
+        task_data = {
+            "title": f"Load Task {i}",
+            "start_date": "2024-01-10",
+            "due_date": "2024-01-20",
+            "estimated_hours": 8,
+        }
+        response = session.post(
+            f"{BASE_URL}{API_PREFIX}/tasks", json=task_data, headers=headers
+        )
+        assert response.status_code == 201, f"Seeding failed: {response.text}"
+
+
+def run_level(endpoint: str, params: dict, headers: dict, concurrency: int,
+              duration: float):
+    """Hammer one endpoint with `concurrency` workers for `duration` seconds"""
+    latencies = []
+    errors = 0
+    lock = threading.Lock()
+    deadline = time.monotonic() + duration
+
+    def worker():
+        nonlocal errors
+        session = requests.Session()
+        local = []
+        local_errors = 0
+        while time.monotonic() < deadline:
+            started = time.perf_counter()
+            response = session.get(
+                f"{BASE_URL}{API_PREFIX}{endpoint}", params=params, headers=headers
+            )
+            local.append(time.perf_counter() - started)
+            if response.status_code != 200:
+                local_errors += 1
+        with lock:
+            latencies.extend(local)
+            errors += local_errors
+
+    with ThreadPoolExecutor(max_workers=concurrency) as pool:
+        for _ in range(concurrency):
+            pool.submit(worker)
+
+    latencies.sort()
+    count = len(latencies)
+    p50 = latencies[count // 2] if count else 0.0
+    p99 = latencies[min(count - 1, int(count * 0.99))] if count else 0.0
+    return {
+        "requests": count,
+        "errors": errors,
+        "rps": count / duration,
+        "p50_ms": p50 * 1000,
+        "p99_ms": p99 * 1000,
+        "mean_ms": statistics.fmean(latencies) * 1000 if count else 0.0,
+    }
+
+
+def run_page_sizes(headers: dict, sizes, samples: int):
+    """Sequential GET /tasks latency for each page size"""
+    session = requests.Session()
+    print(f"\n== GET {API_PREFIX}/tasks by page size")
+    print(f"{'limit':>6} {'rows':>6} {'p50 ms':>10} {'p99 ms':>10} {'mean ms':>10}")
+    for size in sizes:
+        latencies = []
+        rows = 0
+        for _ in range(samples):
+            started = time.perf_counter()
+            response = session.get(
+                f"{BASE_URL}{API_PREFIX}/tasks", params={"limit": size},
+                headers=headers
+            )
+            latencies.append(time.perf_counter() - started)
+            assert response.status_code == 200, response.text
+            rows = len(response.json())
+        latencies.sort()
+        p50 = latencies[len(latencies) // 2]
+        p99 = latencies[min(len(latencies) - 1, int(len(latencies) * 0.99))]
+        print(
+            f"{size:>6} {rows:>6} {p50 * 1000:>10.2f} {p99 * 1000:>10.2f} "
+            f"{statistics.fmean(latencies) * 1000:>10.2f}"
+        )
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--duration", type=float, default=10.0)
+    parser.add_argument("--levels", default="1,2,4,8,16,32,64")
+    parser.add_argument("--tasks", type=int, default=50)
+    parser.add_argument("--page-sizes", default="",
+                        help="benchmark GET /tasks at these limits instead")
+    parser.add_argument("--samples", type=int, default=20)
+    args = parser.parse_args()
+
+    session = requests.Session()
+    token = register_user(session)
+    headers = {"Authorization": f"Bearer {token}"}
+
+    if args.page_sizes:
+        sizes = [int(x) for x in args.page_sizes.split(",")]
+        seed_tasks(session, headers, max(args.tasks, max(sizes)))
+        run_page_sizes(headers, sizes, args.samples)
+        return
+
+    seed_tasks(session, headers, args.tasks)
+
+    scenarios = [
+        ("/tasks", {"limit": 100}),
+        ("/calendar/tasks", {"start_date": "2024-01-01", "end_date": "2024-01-31"}),
+    ]
+    levels = [int(x) for x in args.levels.split(",")]
+
+    for endpoint, params in scenarios:
+        print(f"\n== GET {API_PREFIX}{endpoint}")
+        print(f"{'conc':>6} {'req/s':>10} {'p50 ms':>10} {'p99 ms':>10} {'errors':>8}")
+        for level in levels:
+            stats = run_level(endpoint, params, headers, level, args.duration)
+            print(
+                f"{level:>6} {stats['rps']:>10.1f} {stats['p50_ms']:>10.2f} "
+                f"{stats['p99_ms']:>10.2f} {stats['errors']:>8}"
+            )
+
+
+if __name__ == "__main__":
+    main()